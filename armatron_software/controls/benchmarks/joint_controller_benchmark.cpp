@@ -0,0 +1,114 @@
+/**
+ * @brief Time JointController::update against the per-joint PI loop RobotInterface::trackSetpoint
+ *        used before it, on the same setpoints, and check that both command the same speeds.
+ *
+ * Build with -DARMATRON_BUILD_BENCHMARKS=ON, then run bin/joint_controller_benchmark [iterations].
+ * Both are built with the project's compile flags, as in realtime_daemon; pass a build type
+ * (e.g. -DCMAKE_BUILD_TYPE=Release) to time optimized code.
+ */
+#include "joint_controller.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+constexpr size_t NUM_JOINTS = JointController::NUM_JOINTS;
+constexpr float DIFFERENTIAL_UNITS_PER_DEG = 10.0f;
+constexpr float DT = 0.005f;
+const float SPEED_LIMITS[NUM_JOINTS] = { 100.0f, 100.0f, 100.0f, 100.0f, 100.0f, 300.0f, 300.0f };
+
+// The previous trackSetpoint: PI on the position error, then the clamp setMultiJointSpeeds applies
+struct ReferencePi
+{
+    float positionError[NUM_JOINTS] = {};
+    float integralError[NUM_JOINTS] = {};
+    float kp = 8.0f;
+    float ki = 0.0f;
+    float maxIntegral = 10.0f;
+
+    __attribute__((noinline)) void update(const float* position, const float* velocity, const double* measured,
+                                          float dt, float* command)
+    {
+        float speeds[NUM_JOINTS];
+        std::copy(velocity, velocity + NUM_JOINTS, speeds);
+        speeds[5] /= DIFFERENTIAL_UNITS_PER_DEG;
+        speeds[6] /= DIFFERENTIAL_UNITS_PER_DEG;
+        for (size_t i = 0; i < NUM_JOINTS; ++i) {
+            positionError[i] = position[i] - static_cast<float>(measured[i]);
+            integralError[i] = std::clamp(integralError[i] + positionError[i] * dt, -maxIntegral, maxIntegral);
+            speeds[i] += kp * positionError[i] + ki * integralError[i];
+        }
+        for (size_t i = 0; i < NUM_JOINTS; ++i) {
+            command[i] = std::clamp(speeds[i], -SPEED_LIMITS[i], SPEED_LIMITS[i]);
+        }
+    }
+};
+
+// A smooth move with a tracking error that changes sign, in trajectory units
+void setpoint(int k, JointController::Lanes& position, JointController::Lanes& velocity,
+              JointController::Lanes& measured)
+{
+    for (size_t i = 0; i < NUM_JOINTS; ++i) {
+        position[i] = 50.0f * std::sin(k * 0.01f + i);
+        velocity[i] = 20.0f * std::cos(k * 0.01f + i);
+        measured[i] = position[i] + 2.0f * std::sin(k * 0.3f);
+    }
+}
+}
+
+int main(int argc, char** argv)
+{
+    const long iterations = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    // Configured as RobotInterface does: the differential joints in raw units, scaled to motor degrees
+    JointController controller;
+    JointGains differential;
+    differential.kp = 8.0f * DIFFERENTIAL_UNITS_PER_DEG;
+    for (size_t i = 5; i < NUM_JOINTS; ++i) {
+        controller.setUnitScale(i, 1.0f / DIFFERENTIAL_UNITS_PER_DEG);
+        controller.setGains(i, differential);
+    }
+    ReferencePi reference;
+
+    JointController::Lanes position {}, velocity {}, acceleration {}, measured {}, limit {}, command {};
+    float referenceCommand[NUM_JOINTS];
+    double measuredDeg[NUM_JOINTS];
+    std::copy(SPEED_LIMITS, SPEED_LIMITS + NUM_JOINTS, limit.begin());
+
+    float maxDifference = 0.0f;
+    for (int k = 0; k < 1000; ++k) {
+        setpoint(k, position, velocity, measured);
+        std::copy(measured.begin(), measured.begin() + NUM_JOINTS, measuredDeg);
+        reference.update(position.data(), velocity.data(), measuredDeg, DT, referenceCommand);
+        controller.update(position, velocity, acceleration, measured, limit, DT, command);
+        for (size_t i = 0; i < NUM_JOINTS; ++i) {
+            maxDifference = std::max(maxDifference, std::abs(referenceCommand[i] - command[i]));
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    for (long k = 0; k < iterations; ++k) {
+        measuredDeg[k & 3] += 1e-6;
+        reference.update(position.data(), velocity.data(), measuredDeg, DT, referenceCommand);
+        asm volatile("" : : "r"(referenceCommand) : "memory");
+    }
+    auto referenceDone = Clock::now();
+    for (long k = 0; k < iterations; ++k) {
+        measured[k & 3] += 1e-6f;
+        controller.update(position, velocity, acceleration, measured, limit, DT, command);
+        asm volatile("" : : "r"(command.data()) : "memory");
+    }
+    auto controllerDone = Clock::now();
+
+    auto nsPerCall = [iterations](Clock::duration d) {
+        return std::chrono::duration<double, std::nano>(d).count() / iterations;
+    };
+    std::printf("max command difference: %g deg/s\n", maxDifference);
+    std::printf("reference PI loop:      %.1f ns/cycle\n", nsPerCall(referenceDone - start));
+    std::printf("JointController:        %.1f ns/cycle\n", nsPerCall(controllerDone - referenceDone));
+    return maxDifference < 1e-3f ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+/**
+ * @brief Run a simulated telemetry stream through telemetry::DeltaEncoder and DeltaDecoder,
+ *        dropping every 7th delta frame on the way, and check that every decoded channel stays
+ *        within its group's DeltaOptions threshold of the true value (integer channels: exact).
+ *        Prints the bytes sent in delta mode against full Telemetry frames per field group.
+ *
+ * Build with -DARMATRON_BUILD_BENCHMARKS=ON, then run bin/telemetry_delta_benchmark [frames].
+ * Exits nonzero if any channel exceeded its threshold.
+ */
+#include "telemetry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace
+{
+constexpr unsigned DROP_EVERY = 7;   // every 7th delta frame never reaches the decoder
+constexpr double DT = 0.002;         // 500 Hz control rate
+
+// Slow joint moves with sensor noise, a thermal drift and an occasional gain change
+TelemetrySnapshot simulate(uint32_t cycle, std::mt19937& rng)
+{
+    std::normal_distribution<double> noise(0.0, 1.0);
+    const double t = cycle * DT;
+
+    TelemetrySnapshot snap;
+    snap.cycle = cycle;
+    for (size_t i = 0; i < ipc::NUM_MOTORS; ++i) {
+        MotorState& m = snap.motors[i];
+        m.multiTurnDeg_Mapped = 40.0 * std::sin(0.3 * t + i) + 0.002 * noise(rng);
+        m.speedDeg_s = 12.0 * std::cos(0.3 * t + i) + 0.05 * noise(rng);
+        m.torqueCurrentA = 0.8 * std::sin(0.3 * t + i) + 0.005 * noise(rng);
+        m.temperatureC = std::floor(35.0 + t / 20.0 + i);
+        m.busVoltage = 24.0 + 0.2 * noise(rng);
+        m.errorCode = (cycle / 3000 + i) % 5 == 0 ? 2 : 0;
+        m.m_gains.angKp = static_cast<uint8_t>(100 + (cycle / 5000) % 2 * 20);
+        m.m_gains.angKi = 50;
+        m.m_gains.spdKp = 50;
+        m.m_gains.spdKi = 20;
+        m.m_gains.iqKp = 50;
+        m.m_gains.iqKi = 50;
+    }
+    snap.diffRollRad = 0.4 * std::sin(0.5 * t);
+    snap.diffPitchRad = 0.3 * std::cos(0.5 * t);
+
+    snap.twinActive = (cycle / 4000) % 2 == 1;
+    for (size_t i = 0; i < ipc::NUM_MOTORS; ++i) {
+        snap.twinJointAnglesDeg[i] = snap.motors[i].multiTurnDeg_Mapped + 0.5;
+    }
+
+    snap.poseValid = true;
+    for (size_t k = 0; k < 3; ++k) {
+        snap.posePosition[k] = 0.3 + 0.1 * std::sin(0.3 * t + k) + 1e-5 * noise(rng);
+        snap.poseRPY[k] = 0.2 * std::cos(0.3 * t + k);
+    }
+    return snap;
+}
+
+// Feed one encoded buffer (a single binary frame) to a decoder
+bool decode(const telemetry::DeltaEncoder::Buffer& buffer, telemetry::DeltaDecoder& decoder)
+{
+    ipc::FrameReader reader;
+    reader.append(buffer->data(), buffer->size());
+    ipc::FrameType type;
+    std::string payload;
+    return reader.next(type, payload)
+        && decoder.apply(type, reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+}
+
+struct GroupResult
+{
+    size_t fullBytes = 0;
+    size_t deltaBytes = 0;
+    unsigned keyframes = 0;
+    unsigned deltas = 0;
+    unsigned dropped = 0;
+    unsigned violations = 0;
+    double maxError = 0.0;
+    std::string worstChannel;
+};
+
+GroupResult runGroup(telemetry::FieldGroup group, float threshold, unsigned frames)
+{
+    // Zero thresholds and a keyframe every frame: the exact channel values, as the reference
+    telemetry::DeltaOptions exactOptions;
+    exactOptions.keyframeInterval = 1;
+    exactOptions.thresholds.fill(0.0f);
+    telemetry::DeltaOptions options;
+
+    telemetry::DeltaEncoder encoder(true, group, options);
+    telemetry::DeltaEncoder exactEncoder(true, group, exactOptions);
+    telemetry::DeltaDecoder decoder, exact;
+    const std::vector<std::string> names = telemetry::channelNames(group);
+
+    std::mt19937 rng(1234);
+    GroupResult r;
+    for (uint32_t cycle = 0; cycle < frames; ++cycle) {
+        TelemetrySnapshot snap = simulate(cycle, rng);
+        std::string full;
+        std::string payload = telemetry::encodeBinary(snap, group);
+        ipc::appendFrame(full, ipc::FrameType::Telemetry, reinterpret_cast<const uint8_t*>(payload.data()),
+                         payload.size());
+        r.fullBytes += full.size();
+
+        bool keyframe = false;
+        telemetry::DeltaEncoder::Buffer buffer = encoder.encode(snap, keyframe);
+        bool ignored = false;
+        if (!decode(exactEncoder.encode(snap, ignored), exact)) {
+            std::fprintf(stderr, "reference stream failed to decode at cycle %u\n", cycle);
+            std::exit(2);
+        }
+
+        r.deltaBytes += buffer->size();
+        if (keyframe) {
+            r.keyframes++;
+        } else if (++r.deltas % DROP_EVERY == 0) {
+            r.dropped++;
+            continue;
+        }
+        if (!decode(buffer, decoder)) {
+            std::fprintf(stderr, "delta stream failed to decode at cycle %u\n", cycle);
+            std::exit(2);
+        }
+
+        for (size_t i = 0; i < names.size(); ++i) {
+            // Same float arithmetic as the encoder's threshold test
+            float error = std::fabs(decoder.values()[i] - exact.values()[i]);
+            if (error > r.maxError) {
+                r.maxError = error;
+                r.worstChannel = names[i];
+            }
+            if (error > threshold) {
+                r.violations++;
+            }
+        }
+    }
+    return r;
+}
+}
+
+int main(int argc, char** argv)
+{
+    const unsigned frames = argc > 1 ? static_cast<unsigned>(std::atol(argv[1])) : 30000;
+    const telemetry::DeltaOptions defaults;
+
+    std::printf("%u frames, every %uth delta frame dropped\n\n", frames, DROP_EVERY);
+    std::printf("%-10s %12s %12s %7s %9s %8s %8s %12s %10s\n", "group", "full bytes", "delta bytes", "ratio",
+                "keyframes", "deltas", "dropped", "max error", "threshold");
+
+    unsigned violations = 0;
+    for (size_t g = 0; g < telemetry::NUM_FIELD_GROUPS; ++g) {
+        auto group = static_cast<telemetry::FieldGroup>(1u << g);
+        float threshold = defaults.thresholds[g];
+        GroupResult r = runGroup(group, threshold, frames);
+        violations += r.violations;
+        std::printf("%-10s %12zu %12zu %6.1f%% %9u %8u %8u %12g %10g%s\n", telemetry::fieldGroupName(group),
+                    r.fullBytes, r.deltaBytes, 100.0 * r.deltaBytes / std::max<size_t>(r.fullBytes, 1),
+                    r.keyframes, r.deltas, r.dropped, r.maxError, threshold,
+                    r.violations ? "  EXCEEDED" : "");
+        if (r.violations) {
+            std::printf("  %u samples over threshold, worst channel %s\n", r.violations, r.worstChannel.c_str());
+        }
+    }
+    return violations == 0 ? 0 : 1;
+}
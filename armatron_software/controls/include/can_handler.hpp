@@ -6,7 +6,14 @@
 #include <sys/socket.h>
 #include <net/if.h>
 #include <string>
-#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief The 7 data bytes after the command byte. Fixed size so building a command never allocates.
+ */
+using CanPayload = std::array<uint8_t, 7>;
 
 /**
  * @brief Manages SocketCAN communication for the MG motors. 
@@ -30,10 +37,34 @@ public:
      * @brief Send a CAN frame (ID, command byte, plus data bytes).
      * @param can_id  Standard 11-bit ID, e.g. 0x141 for motor ID=1
      * @param command The first data byte from doc (0x88, 0x9C, etc.)
-     * @param data    Additional data up to 7 bytes
+     * @param data    The 7 bytes following the command byte
      * @return True if write succeeded, false otherwise
      */
-    bool sendMessage(int can_id, uint8_t command, const std::vector<uint8_t>& data);
+    bool sendMessage(int can_id, uint8_t command, const CanPayload& data = {});
+
+    /**
+     * @brief Build the frame sendMessage() would send, so it can be encoded ahead of time.
+     */
+    static struct can_frame makeFrame(int can_id, uint8_t command, const CanPayload& data = {});
+
+    /**
+     * @brief Send pre-built frames with as few syscalls as possible (one sendmmsg() when
+     *        the TX queue has room). Safe to call from any thread.
+     * @return Number of frames accepted by the socket
+     */
+    size_t sendFrames(const struct can_frame* frames, size_t count);
+
+    /**
+     * @brief Command latency tracing: start watching for the next actuation frame (anything
+     *        but a state read) sent by the calling thread.
+     */
+    static void armEgressProbe();
+
+    /**
+     * @brief When the calling thread sent its first actuation frame since armEgressProbe()
+     * @return false if it has not sent one
+     */
+    static bool egressSince(std::chrono::steady_clock::time_point& sentAt);
 
     /**
      * @brief Attempt to read one CAN frame into 'frame'.
@@ -0,0 +1,172 @@
+#ifndef CLIENT_CONNECTION_HPP
+#define CLIENT_CONNECTION_HPP
+
+#include "ipc_protocol.hpp"
+#include "telemetry.hpp"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Wire protocol spoken on a connection. Unknown until the first bytes arrive.
+ */
+enum class ClientProtocol { Unknown, Json, Binary };
+
+/**
+ * @brief Kind of outbound message. Slow-consumer policies only ever discard State messages.
+ */
+enum class MessageKind { State, Control };
+
+/**
+ * @brief What to do with state frames when a client reads slower than we broadcast
+ */
+enum class SlowConsumerPolicy
+{
+    DropOldest,     ///< Queue is bounded; when full, the oldest unsent state frame is dropped
+    CoalesceLatest, ///< At most one unsent state frame is queued; a newer one replaces it
+    Disconnect,     ///< When the queue is full the client is disconnected
+};
+
+/**
+ * @brief Parse a policy name ("dropOldest", "coalesce", "disconnect")
+ * @return false if the name is unknown
+ */
+bool parseSlowConsumerPolicy(const std::string& name, SlowConsumerPolicy& policy);
+const char* slowConsumerPolicyName(SlowConsumerPolicy policy);
+
+/**
+ * @brief Per-client outbound counters
+ */
+struct ClientStats
+{
+    uint64_t sentMessages      = 0;
+    uint64_t sentBytes         = 0;
+    uint64_t droppedMessages   = 0; ///< State frames discarded by DropOldest (or an overfull queue)
+    uint64_t coalescedMessages = 0; ///< State frames replaced by a newer one under CoalesceLatest
+    size_t   maxQueueDepth     = 0; ///< High-water mark of the outbound queue
+};
+
+/**
+ * @brief One socket client of the RealTimeDaemon.
+ *        Holds the inbound framing buffers and a bounded outbound queue.
+ *        Owned and used only by the daemon's I/O thread, so it has no locking.
+ */
+class ClientConnection
+{
+public:
+    /**
+     * @brief Shared, immutable message buffer. A broadcast is encoded once and
+     *        the same buffer is queued on every client that receives it.
+     */
+    using Buffer = std::shared_ptr<const std::string>;
+
+    enum class FlushResult { Done, WouldBlock, Error };
+
+    /**
+     * @param fd                Connected, non-blocking socket. Closed by the destructor.
+     * @param maxQueuedMessages Outbound queue bound for state frames
+     * @param policy            Slow-consumer policy applied when the bound is reached
+     */
+    ClientConnection(int fd, size_t maxQueuedMessages, SlowConsumerPolicy policy);
+    ~ClientConnection();
+
+    ClientConnection(const ClientConnection&) = delete;
+    ClientConnection& operator=(const ClientConnection&) = delete;
+
+    int fd() const { return m_fd; }
+
+    ClientProtocol protocol() const { return m_protocol; }
+    void setProtocol(ClientProtocol protocol) { m_protocol = protocol; }
+
+    /**
+     * @brief JSON mode: text after the last newline. Unknown mode: bytes not yet classified.
+     */
+    std::string& pendingText() { return m_pendingText; }
+
+    /**
+     * @brief Binary mode: frame reassembly buffer
+     */
+    ipc::FrameReader& frames() { return m_frames; }
+
+    /**
+     * @brief Queue a message for sending, applying the slow-consumer policy to state frames.
+     *        Control messages (replies, acks) are never dropped.
+     * @return false if the client must be disconnected (Disconnect policy, or a
+     *         client that stopped reading even its control replies)
+     */
+    bool enqueue(Buffer msg, MessageKind kind = MessageKind::Control);
+
+    /**
+     * @brief Write as much queued data as the socket accepts without blocking.
+     */
+    FlushResult flush();
+
+    bool hasPendingOutput() const { return !m_outQueue.empty(); }
+
+    /**
+     * @brief Whether EPOLLOUT is currently registered for this fd
+     */
+    bool writeArmed() const { return m_writeArmed; }
+    void setWriteArmed(bool armed) { m_writeArmed = armed; }
+
+    SlowConsumerPolicy policy() const { return m_policy; }
+    void setPolicy(SlowConsumerPolicy policy) { m_policy = policy; }
+
+    size_t maxQueuedMessages() const { return m_maxQueuedMessages; }
+    void setMaxQueuedMessages(size_t maxQueued) { m_maxQueuedMessages = maxQueued > 0 ? maxQueued : 1; }
+
+    /**
+     * @brief Telemetry this client subscribed to (inactive = legacy full-state broadcast)
+     */
+    const telemetry::Subscription& subscription() const { return m_subscription; }
+    void setSubscription(const telemetry::Subscription& sub) { m_subscription = sub; m_needsKeyframe = true; }
+
+    /**
+     * @brief Delta mode: true until this client has been sent a keyframe of its stream
+     */
+    bool needsKeyframe() const { return m_needsKeyframe; }
+    void setNeedsKeyframe(bool needs) { m_needsKeyframe = needs; }
+
+    size_t queueDepth() const { return m_outQueue.size(); }
+
+    /**
+     * @brief Age of the oldest message still waiting to be written (0 if the queue is empty)
+     */
+    std::chrono::microseconds lag(std::chrono::steady_clock::time_point now) const;
+
+    const ClientStats& stats() const { return m_stats; }
+
+private:
+    struct QueuedMessage
+    {
+        Buffer data;
+        MessageKind kind;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    /**
+     * @brief Index of the first queued entry that has not been partially written yet
+     */
+    size_t firstUnsentIndex() const { return m_outOffset > 0 ? 1 : 0; }
+
+    int m_fd;
+    ClientProtocol m_protocol = ClientProtocol::Unknown;
+    std::string m_pendingText;
+    ipc::FrameReader m_frames;
+
+    std::deque<QueuedMessage> m_outQueue;
+    size_t m_outOffset = 0;          // bytes of m_outQueue.front() already written
+    size_t m_maxQueuedMessages;
+    SlowConsumerPolicy m_policy;
+    ClientStats m_stats;
+    telemetry::Subscription m_subscription;
+    bool m_needsKeyframe = true;
+    bool m_writeArmed = false;
+
+    // Control replies are never dropped, but a client that lets this many pile up is gone
+    static constexpr size_t CONTROL_QUEUE_HARD_LIMIT = 256;
+};
+
+#endif // CLIENT_CONNECTION_HPP
@@ -0,0 +1,184 @@
+#ifndef COMMAND_REGISTRY_HPP
+#define COMMAND_REGISTRY_HPP
+
+#include "robot_interface.hpp"
+#include "ipc_protocol.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <jsoncpp/json/json.h>
+
+class RealTimeDaemon;
+class ClientConnection;
+
+/**
+ * @brief Compile-time table of every command the daemon accepts.
+ *
+ * Each entry names the command, its binary opcode (if any), its argument schema and
+ * its handler. JSON and binary commands are both turned into the same CommandArgs
+ * (validated against the schema) and run through the same handler, so adding a
+ * command means adding one table entry in command_registry.cpp.
+ *
+ * Robot commands are queued for the control thread. Entries flagged IoThread (client
+ * settings, statistics, uploads) are answered by the I/O thread itself, through an
+ * IoCommandHandler that gets the daemon (see IoCommands).
+ */
+namespace commands {
+
+constexpr size_t MAX_COMMAND_ARGS = 6;
+constexpr size_t MAX_ARRAY_LEN    = 7;
+
+enum class ArgType : uint8_t { Int, Float, FloatArray, Bool, String, Json };
+
+/**
+ * @brief One argument of a command.
+ *        Scalars are validated against [min, max]; arrays use min/max as the allowed length.
+ *        String and Json (any JSON value, checked by the handler) are for I/O-thread commands
+ *        only; their handlers read them from the request (IoCommandContext::text / json).
+ */
+struct ArgSpec
+{
+    const char* name    = nullptr;
+    ArgType  type       = ArgType::Int;
+    bool     required   = false;
+    double   defaultValue = 0.0;
+    double   min        = 0.0;
+    double   max        = 0.0;
+    int8_t   binSlot    = -1;   ///< Binary: index into CommandMessage::i (Int) or ::f (Float, first element of arrays)
+    int8_t   binLenSlot = -1;   ///< Binary arrays: index into CommandMessage::i holding the length (-1 = always max)
+};
+
+enum CommandFlags : uint8_t
+{
+    NeedsMotor   = 1u << 0,   ///< Acts on the motor given by motorID (JSON) / motorId (binary)
+    IoThread     = 1u << 1,   ///< Answered on the I/O thread by ioHandler, never queued for the control thread
+    HighPriority = 1u << 2,   ///< ESTOP/hold: executed on receipt, ahead of (and clearing) the command queue
+};
+
+/**
+ * @brief Validated arguments, by position in the command's schema
+ */
+struct CommandArgs
+{
+    int    motorId = 1;
+    double value[MAX_COMMAND_ARGS] = {0.0};
+    float  array[MAX_COMMAND_ARGS][MAX_ARRAY_LEN] = {{0.0f}};
+    uint8_t arrayLen[MAX_COMMAND_ARGS] = {0};
+
+    int32_t i(size_t k) const { return static_cast<int32_t>(value[k]); }
+    double  d(size_t k) const { return value[k]; }
+};
+
+/**
+ * @brief What a handler may touch. 'motor' is null unless the command has NeedsMotor.
+ */
+struct CommandContext
+{
+    RobotInterface& robot;
+    Motor* motor;
+};
+
+using CommandHandler = void (*)(CommandContext& ctx, const CommandArgs& args);
+
+struct CommandSpec;
+
+/**
+ * @brief What an I/O-thread handler may touch: the daemon, the client that sent the command,
+ *        and the validated request
+ */
+struct IoCommandContext
+{
+    RealTimeDaemon& daemon;
+    ClientConnection& client;
+    const Json::Value& request;
+    const CommandSpec& spec;
+
+    /**
+     * @brief Whether argument k was given (omitted optional arguments keep the current setting)
+     */
+    bool has(size_t k) const;
+
+    /**
+     * @brief String argument k, or 'fallback' if it was omitted
+     */
+    std::string text(size_t k, const std::string& fallback = "") const;
+
+    /**
+     * @brief Json argument k (null if omitted)
+     */
+    const Json::Value& json(size_t k) const;
+};
+
+using IoCommandHandler = void (*)(IoCommandContext& ctx, const CommandArgs& args);
+
+struct CommandSpec
+{
+    std::string_view name;
+    uint16_t opcode = 0;        ///< ipc::Opcode, 0 = JSON only
+    uint8_t  flags  = 0;
+    ArgSpec  args[MAX_COMMAND_ARGS] = {};
+    CommandHandler handler = nullptr;
+    IoCommandHandler ioHandler = nullptr;   ///< IoThread commands only
+    const char* description = "";
+
+    constexpr size_t argCount() const
+    {
+        size_t n = 0;
+        while (n < MAX_COMMAND_ARGS && args[n].name != nullptr) n++;
+        return n;
+    }
+};
+
+/**
+ * @brief O(1) lookup by name (compile-time open-addressing hash table)
+ * @return nullptr for unknown commands
+ */
+const CommandSpec* find(std::string_view name);
+
+/**
+ * @brief O(1) lookup by binary opcode
+ * @return nullptr for unknown opcodes
+ */
+const CommandSpec* find(ipc::Opcode opcode);
+
+/**
+ * @brief Number of commands; every CommandSpec has a stable index in 0..count()-1
+ *        (for per-command tables such as latency histograms)
+ */
+size_t count();
+size_t index(const CommandSpec& spec);
+const CommandSpec& at(size_t index);
+
+/**
+ * @brief Fill and validate 'args' from a JSON command object
+ * @param error Output: reason on failure
+ */
+bool parseJson(const CommandSpec& spec, const Json::Value& root, CommandArgs& args, std::string& error);
+
+/**
+ * @brief Fill and validate 'args' from a binary command
+ * @param error Output: reason on failure
+ */
+bool parseBinary(const CommandSpec& spec, const ipc::CommandMessage& msg, CommandArgs& args, std::string& error);
+
+/**
+ * @brief Run a command with already validated arguments
+ * @throws std::out_of_range for a bad motor ID (like RobotInterface::getMotor)
+ */
+void execute(const CommandSpec& spec, RobotInterface& robot, const CommandArgs& args);
+
+/**
+ * @brief Run an IoThread command with already validated arguments. I/O thread only.
+ */
+void executeIo(const CommandSpec& spec, RealTimeDaemon& daemon, ClientConnection& client, const Json::Value& request,
+               const CommandArgs& args);
+
+/**
+ * @brief Every command with its schema, for the "listCommands" reply
+ */
+Json::Value describe();
+
+} // namespace commands
+
+#endif // COMMAND_REGISTRY_HPP
@@ -0,0 +1,114 @@
+#ifndef COMMAND_TRACE_HPP
+#define COMMAND_TRACE_HPP
+
+#include "loop_timing.hpp"
+#include "spsc_ring.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <jsoncpp/json/json.h>
+
+/**
+ * @brief Points a command passes on its way from the socket to the CAN bus, in order
+ */
+enum class TraceHop : uint8_t
+{
+    Received = 0,   ///< recv() on the I/O thread returned the bytes
+    Queued,         ///< Parsed, validated and pushed to the inbound queue
+    Dequeued,       ///< Popped by the control thread
+    Executed,       ///< Handler returned (RobotInterface call done)
+    CanEgress,      ///< First actuation frame the control thread sent after that
+    Count
+};
+
+constexpr size_t NUM_TRACE_HOPS = static_cast<size_t>(TraceHop::Count);
+
+const char* traceHopName(TraceHop hop);
+
+/**
+ * @brief Timestamps of one command. A default time_point means the hop was not reached
+ *        (e.g. no CAN frame went out in the cycle that executed the command).
+ */
+struct CommandTrace
+{
+    uint16_t command = 0;                             ///< commands::index() of the spec
+    uint32_t cycle = 0;                               ///< Control cycle that executed it
+    std::chrono::steady_clock::time_point cycleStart;
+    int64_t periodNs = 0;                             ///< Control period of that cycle
+    std::array<std::chrono::steady_clock::time_point, NUM_TRACE_HOPS> at {};
+
+    std::chrono::steady_clock::time_point& operator[](TraceHop hop) { return at[static_cast<size_t>(hop)]; }
+    const std::chrono::steady_clock::time_point& operator[](TraceHop hop) const { return at[static_cast<size_t>(hop)]; }
+    bool reached(TraceHop hop) const { return (*this)[hop] != std::chrono::steady_clock::time_point{}; }
+};
+
+/**
+ * @brief End-to-end command latency: per-command histograms of every hop-to-hop segment,
+ *        plus the most recent traces for a Chrome trace / Perfetto export.
+ *
+ * The control thread hands finished traces over with record() (lock-free, no allocation);
+ * everything else runs on the I/O thread.
+ */
+class CommandTracer
+{
+public:
+    static constexpr size_t RING_CAPACITY = 256;
+    static constexpr size_t EXPORT_WINDOW = 2048;   ///< Traces kept for exportChromeTrace()
+
+    /**
+     * @brief Control thread: hand over a finished trace
+     */
+    void record(const CommandTrace& trace);
+
+    /**
+     * @brief I/O thread: aggregate everything recorded since the last call
+     */
+    void drain();
+
+    /**
+     * @brief I/O thread: {"commands": {name: {count, noEgress, parse, queue, execute, egress, total}}, "dropped"}
+     *        with each segment as {count, meanUs, p50Us, p99Us, p999Us, maxUs}
+     */
+    Json::Value toJson() const;
+
+    /**
+     * @brief I/O thread: copy of the last EXPORT_WINDOW traces, oldest first
+     */
+    std::vector<CommandTrace> recent() const;
+
+    /**
+     * @brief Any thread: write 'traces' (from recent()) in Chrome trace event format (chrome://tracing,
+     *        ui.perfetto.dev), one lane per stage plus the control cycles they fell into
+     * @return false with 'error' set if the file could not be written
+     */
+    static bool exportChromeTrace(const std::vector<CommandTrace>& traces, const std::string& path, std::string& error);
+
+    /**
+     * @brief I/O thread: forget all histograms and traces
+     */
+    void reset();
+
+private:
+    enum Segment : size_t { Parse = 0, Queue, Execute, Egress, Total, NUM_SEGMENTS };
+
+    struct PerCommand
+    {
+        std::array<LatencyHistogram, NUM_SEGMENTS> segments;
+        uint64_t count = 0;
+        uint64_t noEgress = 0;
+    };
+
+    SpscRing<CommandTrace, RING_CAPACITY> m_ring;
+    std::atomic<uint64_t> m_dropped { 0 };
+
+    // I/O thread only
+    std::vector<std::unique_ptr<PerCommand>> m_perCommand;   // by command index, created on first use
+    std::deque<CommandTrace> m_recent;
+};
+
+#endif // COMMAND_TRACE_HPP
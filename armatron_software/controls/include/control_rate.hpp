@@ -0,0 +1,42 @@
+#ifndef CONTROL_RATE_HPP
+#define CONTROL_RATE_HPP
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @brief The control loop rate and everything derived from it.
+ *
+ * The rate is chosen when the daemon is constructed (ARMATRON_CONTROL_RATE_HZ for the
+ * realtime daemon) and can be switched at runtime with "setControlRate"; the switch is
+ * applied by the control thread between trajectories. Timing constants elsewhere (Ruckig
+ * delta_time, velocity estimate, PI integral step, telemetry dividers) are derived from
+ * the current period instead of being written out.
+ */
+namespace control_rate {
+
+constexpr unsigned int DEFAULT_HZ = 200;
+constexpr unsigned int MIN_HZ = 50;
+constexpr unsigned int MAX_HZ = 1000;
+
+constexpr bool valid(unsigned int hz) { return hz >= MIN_HZ && hz <= MAX_HZ; }
+
+constexpr std::chrono::nanoseconds period(unsigned int hz)
+{
+    return std::chrono::nanoseconds(1000000000LL / hz);
+}
+
+constexpr double periodSeconds(unsigned int hz) { return 1.0 / hz; }
+
+/**
+ * @brief Control cycles between samples of a 'sampleHz' stream (at least 1)
+ */
+inline unsigned int divider(unsigned int controlHz, double sampleHz)
+{
+    if (sampleHz <= 0.0) return 1;
+    return std::max(1u, static_cast<unsigned int>(controlHz / sampleHz + 0.5));
+}
+
+} // namespace control_rate
+
+#endif // CONTROL_RATE_HPP
@@ -0,0 +1,114 @@
+#ifndef EMERGENCY_CHANNEL_HPP
+#define EMERGENCY_CHANNEL_HPP
+
+#include "robot_interface.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Emergency action requested on the emergency channel
+ */
+enum class EmergencyAction : uint8_t { None = 0, Stop = 1, Hold = 2 };
+
+const char* emergencyActionName(EmergencyAction action);
+
+/**
+ * @brief Latency counters for emergency requests, measured from the moment the
+ *        request was read from its socket until the last CAN frame of the burst
+ *        was accepted by the CAN socket.
+ */
+struct EmergencyStats
+{
+    uint64_t count      = 0;
+    uint64_t overBudget = 0;   ///< Requests slower than EmergencyChannel::LATENCY_BUDGET_US
+    uint64_t failed     = 0;   ///< Bursts where not every frame was accepted
+    double   lastUs     = 0.0;
+    double   maxUs      = 0.0;
+    double   meanUs     = 0.0;
+};
+
+/**
+ * @brief Out-of-band ESTOP / hold path.
+ *
+ * Has its own Unix socket and thread, so an ESTOP never waits behind telemetry,
+ * command parsing or the control cycle. Clients write single-byte requests:
+ *
+ *     'E' or 'S' -> motor stop (0x81) on all motors
+ *     'H'        -> speed 0 (0xA2) on all motors
+ *
+ * Requests are coalesced per read: all bytes one recv() returns trigger a single burst for
+ * the most severe of them (stop wins over hold; other bytes are ignored), answered with one
+ * JSON line: {"type":"estopAck","action":...,"latencyUs":...,"ok":...}. Two presses that
+ * arrive in the same read therefore get one ack, not two.
+ *
+ * The burst is pre-encoded and sent in one batch straight from this thread. The control
+ * thread then picks up the pending action (takePending) at the start of its next cycle,
+ * resets Ruckig and repeats the burst so that nothing it sent during the in-flight cycle
+ * can restart motion.
+ */
+class EmergencyChannel
+{
+public:
+    static constexpr double LATENCY_BUDGET_US = 1000.0;  // socket read -> last stop frame handed to the CAN socket
+
+    EmergencyChannel(RobotInterface& robot, const std::string& socketPath);
+    ~EmergencyChannel();
+
+    /**
+     * @brief Bind the emergency socket and start its thread
+     */
+    void start();
+    void stop();
+
+    /**
+     * @brief Send the burst for 'action' right now and flag it for the control thread.
+     *        Callable from any thread (the main socket's ESTOP fast path uses it too).
+     * @param received  When the request was read from its socket
+     * @param latencyUs Output: microseconds from 'received' until the burst was sent
+     * @return true if every frame of the burst was accepted by the CAN socket
+     */
+    bool trigger(EmergencyAction action, std::chrono::steady_clock::time_point received, double& latencyUs);
+
+    /**
+     * @brief Take (and clear) the action the control thread still has to apply
+     */
+    EmergencyAction takePending() { return static_cast<EmergencyAction>(m_pending.exchange(0)); }
+
+    EmergencyStats stats() const;
+
+    const std::string& socketPath() const { return m_socketPath; }
+
+private:
+    void threadFunc();
+
+    /**
+     * @brief Read all pending request bytes from a client; each read triggers (and acks) one
+     *        burst for its most severe request
+     * @return false if the client disconnected
+     */
+    bool handleClient(int fd);
+
+    RobotInterface& m_robot;
+    std::string m_socketPath;
+    int m_listenFd = -1;
+    int m_wakeFd = -1;
+    std::thread m_thread;
+    std::atomic<bool> m_running { false };
+    std::atomic<uint8_t> m_pending { 0 };
+
+    // Latency bookkeeping in nanoseconds, updated lock-free from whichever thread triggered
+    std::atomic<uint64_t> m_count { 0 };
+    std::atomic<uint64_t> m_overBudget { 0 };
+    std::atomic<uint64_t> m_failed { 0 };
+    std::atomic<uint64_t> m_lastNs { 0 };
+    std::atomic<uint64_t> m_maxNs { 0 };
+    std::atomic<uint64_t> m_totalNs { 0 };
+
+    static constexpr int EMERGENCY_THREAD_PRIORITY = 98;  // just below the control loop
+    static constexpr size_t MAX_CLIENTS = 8;
+};
+
+#endif // EMERGENCY_CHANNEL_HPP
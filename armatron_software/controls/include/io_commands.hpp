@@ -0,0 +1,47 @@
+#ifndef IO_COMMANDS_HPP
+#define IO_COMMANDS_HPP
+
+#include "command_registry.hpp"
+
+/**
+ * @brief Handlers of the commands the daemon's I/O thread answers itself: the IoThread entries
+ *        of the command table (command_registry.cpp). RealTimeDaemon befriends this struct; the
+ *        handlers are defined in real_time_daemon.cpp, next to the state they use.
+ */
+struct IoCommands
+{
+    using Context = commands::IoCommandContext;
+    using Args = commands::CommandArgs;
+
+    // Clients and telemetry
+    static void setClientPolicy(Context& c, const Args& a);
+    static void getClientStats(Context& c, const Args& a);
+    static void subscribe(Context& c, const Args& a);
+    static void unsubscribe(Context& c, const Args& a);
+    static void listCommands(Context& c, const Args& a);
+    static void getRobotState(Context& c, const Args& a);
+
+    // Control loop and diagnostics
+    static void getLoopStats(Context& c, const Args& a);
+    static void setOverrunPolicy(Context& c, const Args& a);
+    static void setControlRate(Context& c, const Args& a);
+    static void setLogLevel(Context& c, const Args& a);
+    static void getEstopStats(Context& c, const Args& a);
+    static void getCommandLatency(Context& c, const Args& a);
+    static void exportCommandTrace(Context& c, const Args& a);
+    static void resetCommandLatency(Context& c, const Args& a);
+    static void getTrackingStats(Context& c, const Args& a);
+    static void resetTrackingStats(Context& c, const Args& a);
+
+    // Routines, motion library and recordings
+    static void uploadRoutine(Context& c, const Args& a);
+    static void stopRoutine(Context& c, const Args& a);
+    static void getRoutineStatus(Context& c, const Args& a);
+    static void listMotions(Context& c, const Args& a);
+    static void loadMotionLibrary(Context& c, const Args& a);
+    static void saveRecording(Context& c, const Args& a);
+    static void compileRecording(Context& c, const Args& a);
+    static void compilePath(Context& c, const Args& a);
+};
+
+#endif // IO_COMMANDS_HPP
@@ -0,0 +1,73 @@
+#ifndef IO_WORKER_HPP
+#define IO_WORKER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Worker thread for the I/O thread's slow jobs (file writes, mmap, path compilation), so
+ *        epoll keeps serving clients and ESTOP/hold replies while they run.
+ *
+ * post() queues a job. The job runs on the worker and returns a completion, which is handed back
+ * to the I/O thread: the worker calls 'notify' (the daemon writes its wake eventfd) and the I/O
+ * thread runs it from runCompletions(). Jobs run one at a time, in the order they were posted.
+ *
+ * A job must only touch what it captured (or state the I/O thread leaves alone until the
+ * completion ran); the completion runs on the I/O thread and may touch anything it does.
+ */
+class IoWorker
+{
+public:
+    using Completion = std::function<void()>;
+    using Job = std::function<Completion()>;
+
+    explicit IoWorker(std::function<void()> notify);
+    ~IoWorker();
+
+    IoWorker(const IoWorker&) = delete;
+    IoWorker& operator=(const IoWorker&) = delete;
+
+    void start();
+
+    /**
+     * @brief Wait for the running job; jobs not started yet and completions not run are dropped
+     */
+    void stop();
+
+    /**
+     * @brief I/O thread: queue a job for the worker
+     */
+    void post(Job job);
+
+    /**
+     * @brief I/O thread: run the completions of the jobs that finished since the last call
+     */
+    void runCompletions();
+
+    /**
+     * @brief I/O thread: jobs posted whose completion has not run yet
+     */
+    size_t pending() const { return m_pending; }
+
+private:
+    void run();
+
+    std::function<void()> m_notify;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Job> m_jobs;
+    std::vector<Completion> m_completions;
+    bool m_stopping = false;
+
+    // I/O thread only
+    size_t m_pending = 0;
+};
+
+#endif // IO_WORKER_HPP
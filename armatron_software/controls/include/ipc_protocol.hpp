@@ -0,0 +1,222 @@
+#ifndef IPC_PROTOCOL_HPP
+#define IPC_PROTOCOL_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Compact binary protocol for the daemon's Unix socket.
+ *
+ * Every connection starts in JSON mode (newline-delimited text, used by the web UI).
+ * A client switches its connection to binary by sending the 8-byte hello first:
+ *
+ *     'A' 'R' 'M' 'B' | u16 version | u16 flags (reserved, 0)
+ *
+ * JSON lines always start with '{', so the first byte is enough to tell the modes apart.
+ * The daemon answers with a HelloAck frame and from then on only speaks binary frames
+ * on that connection:
+ *
+ *     u16 payload length | u8 frame type | u8 reserved | payload...
+ *
+ * All multi-byte fields are little-endian, floats are IEEE-754 binary32.
+ */
+namespace ipc {
+
+constexpr char     HELLO_MAGIC[4]    = {'A', 'R', 'M', 'B'};
+constexpr uint16_t PROTOCOL_VERSION  = 1;
+constexpr size_t   HELLO_SIZE        = 8;
+constexpr size_t   FRAME_HEADER_SIZE = 4;
+constexpr size_t   MAX_FRAME_PAYLOAD = 4096;
+constexpr size_t   NUM_MOTORS        = 7;
+
+enum class FrameType : uint8_t
+{
+    HelloAck       = 0x01, ///< u16 version, u8 number of motors, u8 reserved
+    Command        = 0x10, ///< CommandMessage, client -> daemon
+    State          = 0x20, ///< StateMessage, daemon -> client
+    Telemetry      = 0x21, ///< Subscription telemetry (see telemetry.hpp), daemon -> client
+    TelemetryKey   = 0x22, ///< Delta-mode keyframe (see telemetry::DeltaEncoder), daemon -> client
+    TelemetryDelta = 0x23, ///< Delta-mode change-only frame, daemon -> client
+    Json           = 0x30, ///< UTF-8 JSON text, for replies that have no fixed layout
+};
+
+/**
+ * @brief Binary command opcodes. Argument slots used by each opcode:
+ *
+ *  MotorOn, MotorOff, MotorStop, SyncSingleAndMulti,
+ *  ReadState1_Error, ClearError, ReadState2, ReadState3  -> motorId
+ *  SetHoldPosition, SetESTOP                             -> (none)
+ *  OpenLoopControl, SetTorque, SetSpeed, SetMultiAngle,
+ *  SetIncrementAngle, WriteAcceleration                  -> motorId, i[0] = value
+ *  SetMultiAngleWithSpeed, SetIncrementAngleWithSpeed    -> motorId, i[0] = angle, i[1] = maxSpeed
+ *  SetSingleAngle                                        -> motorId, i[0] = spinDirection, i[1] = angle
+ *  SetSingleAngleWithSpeed                               -> motorId, i[0] = spinDirection, i[1] = angle, i[2] = maxSpeed
+ *  SetMultiJointAngles                                   -> i[0] = joint count, f[0..6] = angles, f[7..13] = speeds
+ *  SetDifferentialAngles                                 -> f[0] = roll [rad], f[1] = pitch [rad], f[2] = maxSpeed [deg/s]
+ *  MoveToJointPositionRuckig                             -> f[0..6] = joint targets [deg]
+ *  SetMaxSpeedModifier                                   -> f[0] = modifier
+ */
+enum class Opcode : uint16_t
+{
+    MotorOn                    = 1,
+    MotorOff                   = 2,
+    MotorStop                  = 3,
+    SetHoldPosition            = 4,
+    SetESTOP                   = 5,
+    OpenLoopControl            = 6,
+    SetTorque                  = 7,
+    SetSpeed                   = 8,
+    SetMultiAngle              = 9,
+    SetMultiAngleWithSpeed     = 10,
+    SetSingleAngle             = 11,
+    SetSingleAngleWithSpeed    = 12,
+    SetIncrementAngle          = 13,
+    SetIncrementAngleWithSpeed = 14,
+    SetMultiJointAngles        = 15,
+    SetDifferentialAngles      = 16,
+    MoveToJointPositionRuckig  = 17,
+    SetMaxSpeedModifier        = 18,
+    SyncSingleAndMulti         = 19,
+    WriteAcceleration          = 20,
+    ReadState1_Error           = 21,
+    ClearError                 = 22,
+    ReadState2                 = 23,
+    ReadState3                 = 24,
+};
+
+/**
+ * @brief Fixed-layout command, 76 bytes on the wire.
+ */
+struct CommandMessage
+{
+    uint16_t opcode   = 0;
+    uint8_t  motorId  = 1;
+    uint8_t  reserved = 0;
+    int32_t  i[4]     = {0};
+    float    f[14]    = {0.0f};
+};
+constexpr size_t COMMAND_MESSAGE_SIZE = 4 + 4 * 4 + 14 * 4;
+
+/**
+ * @brief Per-motor record inside a StateMessage, 24 bytes on the wire.
+ */
+struct MotorStateRecord
+{
+    int8_t   temperatureC        = 0;
+    uint8_t  errorCode           = 0;
+    uint16_t encoderVal          = 0;
+    int16_t  torqueCurrentRaw    = 0;
+    uint16_t reserved            = 0;
+    float    speedDeg_s          = 0.0f;
+    float    positionDeg_Mapped  = 0.0f;
+    float    multiTurnDeg_Mapped = 0.0f;
+    float    multiTurnRaw        = 0.0f;
+};
+constexpr size_t MOTOR_STATE_RECORD_SIZE = 8 + 4 * 4;
+
+/**
+ * @brief Fixed-layout robot state broadcast, 212 bytes on the wire
+ *        (vs. roughly 2.5 kB for the equivalent motorStates JSON).
+ */
+struct StateMessage
+{
+    uint32_t cycle        = 0;
+    uint8_t  numMotors    = NUM_MOTORS;
+    uint8_t  twinActive   = 0;
+    uint16_t reserved     = 0;
+    float    diffRollRad  = 0.0f;
+    float    diffPitchRad = 0.0f;
+    float    twinJointAnglesDeg[NUM_MOTORS] = {0.0f}; ///< Joints 1-5 [deg], then twin pitch and roll [rad] (same order as the JSON twin array)
+    MotorStateRecord motors[NUM_MOTORS];
+};
+constexpr size_t STATE_MESSAGE_SIZE = 4 + 4 + 2 * 4 + NUM_MOTORS * 4 + NUM_MOTORS * MOTOR_STATE_RECORD_SIZE;
+
+/**
+ * @brief Check whether the first bytes of a connection are the binary hello.
+ * @param data Received bytes
+ * @param len  Number of received bytes (must be >= HELLO_SIZE)
+ * @param version Output: protocol version requested by the client
+ */
+bool parseHello(const uint8_t* data, size_t len, uint16_t& version);
+
+/**
+ * @brief Append one framed message (header + payload) to 'out'.
+ */
+void appendFrame(std::string& out, FrameType type, const uint8_t* payload, size_t len);
+
+/**
+ * @brief Little-endian appenders for building variable-layout payloads
+ */
+void appendU8(std::string& out, uint8_t val);
+void appendU16(std::string& out, uint16_t val);
+void appendU32(std::string& out, uint32_t val);
+void appendFloat(std::string& out, float val);
+
+/**
+ * @brief Little-endian readers matching the appenders; advance 'p' past the value
+ */
+uint16_t readU16(const uint8_t*& p);
+uint32_t readU32(const uint8_t*& p);
+float readFloat(const uint8_t*& p);
+
+/**
+ * @brief Append a HelloAck frame to 'out'.
+ */
+void appendHelloAck(std::string& out);
+
+/**
+ * @brief Serialize a command into exactly COMMAND_MESSAGE_SIZE bytes.
+ */
+void encodeCommand(const CommandMessage& msg, uint8_t* out);
+
+/**
+ * @brief Deserialize a command payload.
+ * @return false if the payload has the wrong size
+ */
+bool decodeCommand(const uint8_t* data, size_t len, CommandMessage& msg);
+
+/**
+ * @brief Serialize a state message into exactly STATE_MESSAGE_SIZE bytes.
+ */
+void encodeState(const StateMessage& msg, uint8_t* out);
+
+/**
+ * @brief Deserialize a state payload (reference decoder for clients).
+ * @return false if the payload has the wrong size
+ */
+bool decodeState(const uint8_t* data, size_t len, StateMessage& msg);
+
+/**
+ * @brief Incremental reassembly of binary frames from a byte stream.
+ */
+class FrameReader
+{
+public:
+    /**
+     * @brief Add received bytes to the internal buffer.
+     */
+    void append(const char* data, size_t len) { m_buffer.append(data, len); }
+
+    /**
+     * @brief Pop the next complete frame, if any.
+     * @param type    Output: frame type
+     * @param payload Output: frame payload
+     * @return true if a frame was extracted
+     */
+    bool next(FrameType& type, std::string& payload);
+
+    /**
+     * @brief True if the stream carried a frame larger than MAX_FRAME_PAYLOAD.
+     *        The connection cannot be resynchronized after this.
+     */
+    bool corrupt() const { return m_corrupt; }
+
+private:
+    std::string m_buffer;
+    bool m_corrupt = false;
+};
+
+} // namespace ipc
+
+#endif // IPC_PROTOCOL_HPP
@@ -0,0 +1,78 @@
+#ifndef JOINT_CONTROLLER_HPP
+#define JOINT_CONTROLLER_HPP
+
+#include <array>
+#include <cstddef>
+
+/**
+ * @brief Gains of one joint's tracking controller (JointController), in motor units
+ */
+struct JointGains
+{
+    float kp = 8.0f;              // [1/s] commanded deg/s per deg of position error
+    float ki = 0.0f;              // [1/s^2]
+    float kv = 1.0f;              // velocity feedforward, share of the setpoint velocity
+    float ka = 0.0f;              // acceleration feedforward [s]: how far ahead the velocity is commanded
+    float maxIntegral = 10.0f;    // limit of the integrated error [deg*s]
+};
+
+/**
+ * @brief Velocity-command tracking controller for the 7 joints: feedforward of the setpoint
+ *        velocity and acceleration plus PI on the position error, saturated at each joint's speed
+ *        limit, with conditional-integration anti-windup (the integrator holds while saturated).
+ *
+ *        Gains and state are structure-of-arrays padded to LANES floats and update() has no
+ *        per-joint branches. That leaves the compiler free to vectorize it, but is not by itself
+ *        faster than a plain per-joint loop; benchmarks/joint_controller_benchmark.cpp compares both.
+ *        Inputs are in trajectory units and are scaled per joint (setUnitScale) to motor degrees
+ *        first, so the gains mean the same for the differential joints as for the others.
+ */
+class JointController
+{
+public:
+    static constexpr size_t NUM_JOINTS = 7;
+    static constexpr size_t LANES = 8;
+    using Lanes = std::array<float, LANES>;     // one value per joint; the last lane is padding
+
+    JointController();
+
+    void setGains(size_t joint, const JointGains& gains);
+    JointGains gains(size_t joint) const;
+
+    /**
+     * @brief Motor degrees per trajectory unit of 'joint' (1 unless the joint is tracked in raw units)
+     */
+    void setUnitScale(size_t joint, float scale);
+
+    /**
+     * @brief Clear the integrators, e.g. at the start of a move
+     */
+    void reset();
+
+    /**
+     * @brief One control cycle
+     * @param position, velocity, acceleration Setpoint in trajectory units (/s, /s^2)
+     * @param measured Joint positions in trajectory units
+     * @param limit Speed limit of each joint [motor deg/s]
+     * @param command Velocity command of each joint [motor deg/s], within +-limit
+     */
+    void update(const Lanes& position, const Lanes& velocity, const Lanes& acceleration, const Lanes& measured,
+                const Lanes& limit, float dt, Lanes& command);
+
+    /**
+     * @brief Setpoint - measured position of the last update, trajectory units
+     */
+    float positionError(size_t joint) const { return m_error[joint]; }
+
+private:
+    alignas(32) Lanes m_kp {};
+    alignas(32) Lanes m_ki {};
+    alignas(32) Lanes m_kv {};
+    alignas(32) Lanes m_ka {};
+    alignas(32) Lanes m_maxIntegral {};
+    alignas(32) Lanes m_scale {};
+    alignas(32) Lanes m_integral {};
+    alignas(32) Lanes m_error {};
+};
+
+#endif // JOINT_CONTROLLER_HPP
@@ -6,6 +6,7 @@
 #include <kdl/chainfksolverpos_recursive.hpp>
 #include <kdl/chainiksolvervel_pinv.hpp>
 #include <kdl/chainiksolverpos_nr.hpp>
+#include <kdl/jntarray.hpp>
 #include <string>
 #include <memory>
 #include <array>
@@ -64,6 +65,7 @@ private:
     std::unique_ptr<KDL::ChainFkSolverPos_recursive> fk_solver;
     std::unique_ptr<KDL::ChainIkSolverVel_pinv> ik_solver_vel;
     std::unique_ptr<KDL::ChainIkSolverPos_NR> ik_solver_pos;
+    KDL::JntArray fk_joints;    // reused by getForwardKinematics so the control loop does not allocate
 };
 
 #endif // KINEMATICS_INTERFACE_HPP 
\ No newline at end of file
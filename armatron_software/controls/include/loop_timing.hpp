@@ -0,0 +1,140 @@
+#ifndef LOOP_TIMING_HPP
+#define LOOP_TIMING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <jsoncpp/json/json.h>
+
+/**
+ * @brief Phases of one control cycle, in execution order
+ */
+enum class LoopPhase : uint8_t
+{
+    CommandDrain = 0,   ///< ESTOP pickup + inbound command queue
+    JointStates,        ///< RobotInterface::updateJointStates
+    Differential,       ///< RobotInterface::updateDifferentialMotors
+    Trajectories,       ///< RobotInterface::updateJointTrajectories
+    Broadcast,          ///< Telemetry snapshot hand-off
+    Wait,               ///< Idle time until the next tick
+    Count
+};
+
+constexpr size_t NUM_LOOP_PHASES = static_cast<size_t>(LoopPhase::Count);
+
+const char* loopPhaseName(LoopPhase phase);
+
+/**
+ * @brief Copy of a LatencyHistogram taken at one instant; safe to do math on
+ */
+struct HistogramSnapshot
+{
+    static constexpr unsigned SUB_BUCKET_BITS = 4;                      // 16 buckets per power of two, ~6% resolution
+    static constexpr unsigned SUB_BUCKETS     = 1u << SUB_BUCKET_BITS;
+    static constexpr unsigned MAX_VALUE_BITS  = 31;                     // values clamp at ~2.1 s
+    static constexpr size_t   NUM_BUCKETS     = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    std::array<uint64_t, NUM_BUCKETS> counts {};
+    uint64_t count = 0;
+    uint64_t sumNs = 0;
+    uint64_t maxNs = 0;
+
+    static size_t bucketIndex(uint64_t ns);
+    static uint64_t bucketUpperNs(size_t index);
+
+    /**
+     * @brief Value below which 'percentile' percent of the samples fall (bucket upper bound)
+     */
+    double percentileUs(double percentile) const;
+    double meanUs() const { return count > 0 ? (sumNs / 1000.0) / count : 0.0; }
+
+    /**
+     * @brief Samples recorded between 'earlier' and this snapshot (max to bucket resolution)
+     */
+    HistogramSnapshot since(const HistogramSnapshot& earlier) const;
+
+    /**
+     * @brief {count, meanUs, p50Us, p99Us, p999Us, maxUs}
+     */
+    Json::Value toJson() const;
+};
+
+/**
+ * @brief HDR-style (log-linear) latency histogram.
+ *
+ * Single writer, any number of readers: record() only does relaxed atomic increments so the
+ * control thread never blocks on a reader, and readers see a consistent-enough snapshot.
+ */
+class LatencyHistogram
+{
+public:
+    void record(uint64_t ns)
+    {
+        size_t idx = HistogramSnapshot::bucketIndex(ns);
+        m_counts[idx].store(m_counts[idx].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_sumNs.store(m_sumNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > m_maxNs.load(std::memory_order_relaxed)) {
+            m_maxNs.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    HistogramSnapshot snapshot() const;
+
+private:
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::NUM_BUCKETS> m_counts {};
+    std::atomic<uint64_t> m_count { 0 };
+    std::atomic<uint64_t> m_sumNs { 0 };
+    std::atomic<uint64_t> m_maxNs { 0 };
+};
+
+/**
+ * @brief Timing of the control loop: one histogram per phase, whole-cycle work time,
+ *        wake-up jitter and deadline misses. Written by the control thread only.
+ */
+class LoopTiming
+{
+public:
+    struct Snapshot
+    {
+        std::array<HistogramSnapshot, NUM_LOOP_PHASES> phases;
+        HistogramSnapshot work;       ///< Everything except Wait
+        HistogramSnapshot jitter;     ///< How late the loop woke up after its tick
+        uint64_t cycles = 0;
+        uint64_t missedDeadlines = 0; ///< Cycles whose work ended past the next tick
+        uint64_t maxConsecutiveMisses = 0;
+
+        Snapshot since(const Snapshot& earlier) const;
+        Json::Value toJson(double periodUs) const;
+
+        /**
+         * @brief One-line human readable summary for the log
+         */
+        std::string summary(double periodUs) const;
+    };
+
+    void recordPhase(LoopPhase phase, uint64_t ns) { m_phases[static_cast<size_t>(phase)].record(ns); }
+    void recordJitter(uint64_t ns) { m_jitter.record(ns); }
+
+    /**
+     * @brief Close one cycle
+     * @param workNs   Time from cycle start until the wait began
+     * @param missed   True if the work ran past the next tick
+     */
+    void recordCycle(uint64_t workNs, bool missed);
+
+    Snapshot snapshot() const;
+
+private:
+    std::array<LatencyHistogram, NUM_LOOP_PHASES> m_phases;
+    LatencyHistogram m_work;
+    LatencyHistogram m_jitter;
+    std::atomic<uint64_t> m_cycles { 0 };
+    std::atomic<uint64_t> m_missed { 0 };
+    std::atomic<uint64_t> m_maxConsecutiveMisses { 0 };
+    uint64_t m_consecutiveMisses = 0;   // control thread only
+};
+
+#endif // LOOP_TIMING_HPP
@@ -0,0 +1,121 @@
+#ifndef MOTION_LIBRARY_HPP
+#define MOTION_LIBRARY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief On-disk layout of a motion library (little-endian, version 1):
+ *
+ *   FileHeader | ClipEntry[clipCount] | samples of clip 0 | samples of clip 1 | ...
+ *
+ * Each clip is a joint trajectory sampled once per control period at ClipEntry::rateHz, in
+ * trajectory space: joints 1-5 in degrees, joints 6/7 in differential motor units (as Ruckig
+ * plans them). Playback needs no planning and is bit-for-bit the same on every run and robot.
+ */
+namespace motion_library {
+
+constexpr char MAGIC[8] = { 'A', 'R', 'M', 'M', 'O', 'T', 'N', '\0' };
+constexpr uint16_t VERSION = 1;
+constexpr size_t NAME_LENGTH = 32;
+
+struct FileHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t headerSize;     // sizeof(FileHeader), so later versions can grow it
+    uint32_t clipCount;
+    uint64_t fileSize;       // catches truncated copies
+};
+
+struct ClipEntry
+{
+    char name[NAME_LENGTH];  // NUL-terminated
+    uint32_t rateHz;         // sample rate = control rate the clip plays at
+    uint32_t sampleCount;
+    uint64_t offset;         // of the first Sample, from the start of the file
+    uint32_t crc32;          // of the samples
+    uint32_t reserved;
+};
+
+struct Sample
+{
+    float position[7];
+    float velocity[7];
+    float acceleration[7];
+};
+
+static_assert(sizeof(FileHeader) == 24, "motion library header layout changed");
+static_assert(sizeof(ClipEntry) == 56, "motion library clip entry layout changed");
+static_assert(sizeof(Sample) == 84, "motion library sample layout changed");
+
+} // namespace motion_library
+
+/**
+ * @brief One clip of a loaded library; 'samples' points into the mapped file
+ */
+struct MotionClip
+{
+    const char* name = "";
+    uint32_t rateHz = 0;
+    uint32_t sampleCount = 0;
+    const motion_library::Sample* samples = nullptr;
+
+    double duration() const { return rateHz > 0 ? static_cast<double>(sampleCount) / rateHz : 0.0; }
+};
+
+/**
+ * @brief A clip to write with MotionLibrary::write
+ */
+struct MotionClipData
+{
+    std::string name;
+    uint32_t rateHz = 0;
+    std::vector<motion_library::Sample> samples;
+};
+
+/**
+ * @brief Read-only motion library, mmap'ed and locked into memory at startup so the control
+ *        thread can play clips back without touching the disk or allocating.
+ */
+class MotionLibrary
+{
+public:
+    MotionLibrary() = default;
+    ~MotionLibrary();
+    MotionLibrary(const MotionLibrary&) = delete;
+    MotionLibrary& operator=(const MotionLibrary&) = delete;
+
+    /**
+     * @brief Map 'path' and check its header, layout and every clip's CRC. Not while a clip plays.
+     * @return false with 'error' set if the file is missing, truncated or not a version 1 library
+     */
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    bool loaded() const { return m_base != nullptr; }
+    const std::string& path() const { return m_path; }
+    size_t size() const { return m_clips.size(); }
+    const MotionClip& clip(size_t index) const { return m_clips[index]; }
+
+    /**
+     * @return the clip's index, or -1
+     */
+    int find(const std::string& name) const;
+
+    /**
+     * @brief Write a library file (written to a temporary file, then renamed into place)
+     * @return false with 'error' set if a clip is invalid or the file could not be written
+     */
+    static bool write(const std::string& path, const std::vector<MotionClipData>& clips, std::string& error);
+
+private:
+    void* m_base = nullptr;
+    size_t m_length = 0;
+    std::string m_path;
+    std::vector<MotionClip> m_clips;
+};
+
+#endif // MOTION_LIBRARY_HPP
@@ -135,9 +135,9 @@ public:
     void clearMultiLoopAngle();
 
     /**
-     * @brief Read PID (0x30). Returns array of 6 param bytes: [AngKp,AngKi,SpdKp,SpdKi,TrqKp,TrqKi]
+     * @brief Read PID (0x30). Returns the gains parsed from the reply (also kept in getState().m_gains)
      */
-    std::vector<uint8_t> readPID();
+    MotorGains readPID();
 
     /**
      * @brief Write PID to RAM (0x31). Not persistent after power-off.
@@ -244,6 +244,11 @@ public:
      */
     float getMaxJerk() const { return m_max_jerk; }
 
+    /**
+     * @brief Build the CAN frame for a command without sending it (for pre-encoded bursts)
+     */
+    struct can_frame encodeCommand(uint8_t command, const CanPayload& data = {}) const { return CANHandler::makeFrame(canID(), command, data); }
+
 private:
     uint8_t    m_motorId;
     CANHandler &m_can;
@@ -272,7 +277,7 @@ private:
     /**
      * @brief Low-level send
      */
-    bool sendCmd(uint8_t command, const std::vector<uint8_t>& data = {});
+    bool sendCmd(uint8_t command, const CanPayload& data = {});
 
     /**
      * @brief Low-level receive & parse. For each command, we parse the 
@@ -0,0 +1,117 @@
+#ifndef OVERRUN_POLICY_HPP
+#define OVERRUN_POLICY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief What the control loop does when a cycle runs past its tick
+ */
+enum class OverrunPolicy : uint8_t
+{
+    CatchUp = 0,   ///< Old behaviour: run the missed cycles back to back
+    Skip,          ///< Drop the missed ticks and resume on the next aligned tick
+    Shed,          ///< Skip, and shed subscription telemetry then the state broadcast while overloaded
+    Downrate       ///< Skip, and halve the control rate after 'downrateAfter' consecutive misses
+};
+
+bool parseOverrunPolicy(const std::string& name, OverrunPolicy& policy);
+const char* overrunPolicyName(OverrunPolicy policy);
+
+/**
+ * @brief Work the control loop may leave out under the Shed policy, lowest priority first
+ */
+enum class ShedLevel : uint8_t
+{
+    None = 0,
+    Telemetry,   ///< No subscription telemetry
+    Broadcast    ///< No telemetry at all, including the default state broadcast
+};
+
+const char* shedLevelName(ShedLevel level);
+
+struct OverrunConfig
+{
+    OverrunPolicy policy = OverrunPolicy::Skip;
+    unsigned int downrateAfter = 10;    ///< Downrate: consecutive misses before halving the rate
+    unsigned int recoverAfter = 1000;   ///< Shed/Downrate: clean cycles before stepping back up
+};
+
+struct OverrunStats
+{
+    OverrunConfig config;
+    uint64_t skippedTicks = 0;
+    uint64_t shedTransitions = 0;
+    uint64_t rateTransitions = 0;
+    ShedLevel shedLevel = ShedLevel::None;
+    unsigned int rateDivider = 1;       ///< Current period = base period * rateDivider
+};
+
+/**
+ * @brief Decides, cycle by cycle, how the control loop reacts to deadline misses.
+ *
+ * endCycle() runs on the control thread only. The configuration may be changed from any
+ * thread; it is picked up at the next cycle. Every shed or rate transition is logged and counted.
+ */
+class OverrunGovernor
+{
+public:
+    static constexpr unsigned int MAX_RATE_DIVIDER = 4;   // never slower than a quarter of the base rate
+
+    explicit OverrunGovernor(std::chrono::nanoseconds basePeriod);
+
+    void configure(const OverrunConfig& config);
+
+    /**
+     * @brief Account for one finished cycle and pick the tick the next one starts on
+     * @param deadline The tick this cycle had to finish by
+     * @param workEnd  When its work actually finished
+     * @return The tick to wait for before starting the next cycle
+     */
+    std::chrono::steady_clock::time_point endCycle(std::chrono::steady_clock::time_point deadline,
+                                                   std::chrono::steady_clock::time_point workEnd);
+
+    /**
+     * @brief Change the base (configured) period, e.g. after a control rate switch.
+     *        Any downrating is undone. Control thread only.
+     */
+    void setBasePeriod(std::chrono::nanoseconds basePeriod);
+
+    std::chrono::nanoseconds basePeriod() const
+    {
+        return std::chrono::nanoseconds(m_basePeriodNs.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief Current control period (base period * rate divider)
+     */
+    std::chrono::nanoseconds period() const { return basePeriod() * m_rateDivider.load(std::memory_order_relaxed); }
+
+    ShedLevel shedLevel() const { return static_cast<ShedLevel>(m_shedLevel.load(std::memory_order_relaxed)); }
+
+    OverrunStats stats() const;
+
+private:
+    void setShedLevel(ShedLevel level);
+    void setRateDivider(unsigned int divider);
+
+    std::atomic<int64_t> m_basePeriodNs;
+
+    std::atomic<OverrunPolicy> m_policy { OverrunPolicy::Skip };
+    std::atomic<unsigned int> m_downrateAfter { 10 };
+    std::atomic<unsigned int> m_recoverAfter { 1000 };
+
+    std::atomic<uint8_t> m_shedLevel { 0 };
+    std::atomic<unsigned int> m_rateDivider { 1 };
+    std::atomic<uint64_t> m_skippedTicks { 0 };
+    std::atomic<uint64_t> m_shedTransitions { 0 };
+    std::atomic<uint64_t> m_rateTransitions { 0 };
+
+    // Control thread only
+    unsigned int m_consecutiveMisses = 0;
+    unsigned int m_cleanCycles = 0;
+};
+
+#endif // OVERRUN_POLICY_HPP
@@ -0,0 +1,99 @@
+#ifndef PATH_PARAMETERIZATION_HPP
+#define PATH_PARAMETERIZATION_HPP
+
+#include "motion_library.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Geometric joint path: a C2 (natural) cubic spline through joint waypoints in trajectory
+ *        space, parameterized by chord length s. s counts degrees of joint travel for every joint,
+ *        joints 6/7 included (their motor units are divided out), so no joint dominates the path.
+ */
+class JointPath
+{
+public:
+    using Point = std::array<double, 7>;
+
+    /**
+     * @param waypoints Trajectory space: joints 1-5 [deg], joints 6/7 in differential motor units
+     * @param speeds Share of the limits for the segment ending at each waypoint (the first is unused)
+     * @param unitsPerDeg Trajectory units per degree of each joint
+     * @return false with 'error' set if there are fewer than two distinct waypoints
+     */
+    bool build(const std::vector<Point>& waypoints, const std::vector<double>& speeds, const Point& unitsPerDeg,
+               std::string& error);
+
+    double length() const { return m_knots.empty() ? 0.0 : m_knots.back(); }
+    size_t waypoints() const { return m_points.size(); }
+
+    /**
+     * @brief Position, dq/ds and d2q/ds2 at 's' (clamped to 0..length())
+     */
+    void evaluate(double s, Point& q, Point& dq, Point& ddq) const;
+
+    /**
+     * @brief Speed share of the segment 's' lies on
+     */
+    double speedAt(double s) const;
+
+private:
+    size_t segmentAt(double s) const;
+
+    std::vector<double> m_knots;               // s at each waypoint
+    std::vector<Point> m_points;
+    std::vector<Point> m_curvature;            // d2q/ds2 at each waypoint
+    std::vector<double> m_speeds;
+};
+
+/**
+ * @brief Joint limits for parameterizePath, in trajectory units (as Ruckig gets them)
+ */
+struct PathLimits
+{
+    JointPath::Point maxVelocity {};
+    JointPath::Point maxAcceleration {};
+    JointPath::Point maxJerk {};
+    JointPath::Point minPosition;
+    JointPath::Point maxPosition;
+
+    PathLimits()
+    {
+        minPosition.fill(-std::numeric_limits<double>::infinity());
+        maxPosition.fill(std::numeric_limits<double>::infinity());
+    }
+};
+
+/**
+ * @brief What parameterizePath did
+ */
+struct PathParameterization
+{
+    double durationS = 0.0;
+    double optimalDurationS = 0.0;   // of the velocity/acceleration-optimal profile, before jerk smoothing
+    double stretch = 1.0;            // uniform slowdown applied after smoothing, 1 = none
+    size_t gridPoints = 0;
+    double computeMs = 0.0;
+};
+
+/**
+ * @brief Time-parameterize 'path' from rest to rest and sample it at 'rateHz' for playback.
+ *
+ * TOPP-RA (reachability analysis): a backward pass computes, on a grid along s, the largest
+ * squared path speed from which the end can still be reached within the velocity and acceleration
+ * limits; a forward pass then accelerates as hard as those sets allow. The result is time-optimal
+ * for velocity and acceleration. Jerk is bounded afterwards by a moving average over the path
+ * acceleration (2 * maxAcceleration / maxJerk wide), and if the smoothed profile is still over a
+ * limit anywhere, the whole profile is slowed down uniformly until it is not.
+ *
+ * @return false with 'error' set if the spline leaves the position limits or the path cannot be
+ *         parameterized
+ */
+bool parameterizePath(const JointPath& path, const PathLimits& limits, uint32_t rateHz,
+                      std::vector<motion_library::Sample>& samples, PathParameterization& result, std::string& error);
+
+#endif // PATH_PARAMETERIZATION_HPP
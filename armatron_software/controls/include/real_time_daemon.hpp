@@ -2,21 +2,53 @@
 #define REAL_TIME_DAEMON_HPP
 
 #include "robot_interface.hpp"
+#include "ipc_protocol.hpp"
+#include "client_connection.hpp"
+#include "telemetry.hpp"
+#include "emergency_channel.hpp"
+#include "loop_timing.hpp"
+#include "overrun_policy.hpp"
+#include "command_registry.hpp"
+#include "io_commands.hpp"
+#include "io_worker.hpp"
+#include "spsc_ring.hpp"
+#include "control_rate.hpp"
+#include "rt_config.hpp"
+#include "triple_buffer.hpp"
+#include "command_trace.hpp"
+#include "routine.hpp"
+#include "motion_library.hpp"
 #include <string>
+#include <array>
 #include <thread>
 #include <atomic>
 #include <mutex>
-#include <queue>
 #include <vector>
-#include <sched.h>
-#include <sys/mman.h>
-#include <sys/resource.h>
+#include <memory>
+#include <unordered_map>
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <jsoncpp/json/json.h>
 
 /**
- * @brief A minimal message structure to pass between Node and the real-time code
+ * @brief A command from Node, parsed and validated on the I/O thread so the control
+ *        thread only has to execute it (no JSON, no strings, no allocation)
  */
-struct IPCMessage {
-    std::string json; 
+struct QueuedCommand {
+    const commands::CommandSpec* spec = nullptr;
+    commands::CommandArgs args;
+    std::chrono::steady_clock::time_point received;   // recv() that delivered it (latency tracing)
+    std::chrono::steady_clock::time_point queued;     // pushed to the inbound queue
+};
+
+/**
+ * @brief A message from the control thread waiting to be handed to the I/O thread
+ */
+struct OutboundMessage {
+    ClientProtocol protocol;           // Only clients speaking this protocol receive it
+    MessageKind kind;                  // State frames are subject to each client's slow-consumer policy
+    ClientConnection::Buffer data;
 };
 
 /**
@@ -24,21 +56,39 @@ struct IPCMessage {
  *  1) A high-frequency control loop for the motors
  *  2) A Unix domain socket server to receive commands from Node
  *  3) A mechanism to send motor states to Node
+ *  4) A separate emergency socket for ESTOP/hold (see EmergencyChannel)
+ *
+ * Clients receive the full motorStates broadcast at STATE_BROADCAST_RATE_HZ unless they
+ * send "subscribe" to pick their own field groups and rate divider. The control thread
+ * only copies a TelemetrySnapshot into a triple buffer; the I/O thread encodes it once per
+ * distinct (protocol, field groups) pair and shares that buffer between clients. The I/O
+ * thread reads robot state only through RobotInterface::latestSnapshot() ("getRobotState").
+ *
+ * "uploadRoutine" hands a whole list of waypoints to the control thread in one message; it
+ * runs with no client involvement and reports "routineProgress" to every client (routine.hpp).
+ *
+ * All client sockets are served by a single epoll-driven I/O thread, so attaching
+ * more dashboards or scripts does not add threads competing with the control loop.
  * 
- * The control loop runs at 200Hz with hard real-time scheduling when available.
- * If real-time scheduling is not available, it falls back to maximum normal priority.
+ * The control loop runs at the configured control rate (200Hz by default, see control_rate.hpp)
+ * on an RtThread (see rt_config.hpp): SCHED_FIFO or SCHED_DEADLINE when granted, otherwise
+ * maximum normal priority. What was actually granted is logged at start() and reported by
+ * "getLoopStats".
  */
 class RealTimeDaemon
 {
 public:
-    RealTimeDaemon(RobotInterface& robot);
+    /**
+     * @param controlRateHz Initial control loop rate, control_rate::MIN_HZ..MAX_HZ
+     */
+    explicit RealTimeDaemon(RobotInterface& robot, unsigned int controlRateHz = control_rate::DEFAULT_HZ);
     ~RealTimeDaemon();
 
     /**
      * @brief Start the daemon:
      *  1) Binds /home/debian/.armatron/robot_socket
      *  2) Spawns a real-time loop thread at high freq
-     *  3) Spawns a socket listener thread
+     *  3) Spawns the socket I/O thread
      */
     void start();
 
@@ -50,95 +100,375 @@ public:
     /**
      * @brief Emergency stop handler - bypasses command queue for immediate execution
      * Can be safely called from any thread (socket, web, etc)
+     * @param received When the request arrived, for latency accounting
      */
-    void handleEmergencyStop();
+    void handleEmergencyStop(std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now());
     
     /**
      * @brief Hold position handler - bypasses command queue for immediate execution
      * Can be safely called from any thread (socket, web, etc)
+     * @param received When the request arrived, for latency accounting
+     */
+    void handleHoldPosition(std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now());
+
+    /**
+     * @brief Slow-consumer policy and queue bound given to newly connected clients.
+     *        Clients can override their own with the "setClientPolicy" command.
+     */
+    void setDefaultClientPolicy(SlowConsumerPolicy policy, size_t maxQueuedMessages);
+
+    /**
+     * @brief How the control loop reacts to deadline misses. Clients can change it with "setOverrunPolicy".
+     */
+    void setOverrunPolicy(const OverrunConfig& config) { m_overrun.configure(config); }
+
+    /**
+     * @brief Request a new control loop rate. The control thread switches once no trajectory is
+     *        running, so a move never changes period halfway. Clients can use "setControlRate".
+     * @return false if the rate is outside control_rate::MIN_HZ..MAX_HZ
+     */
+    bool setControlRate(unsigned int hz);
+
+    /**
+     * @brief Scheduling policy, CPU, stack and memory locking for the control thread.
+     *        Takes effect at start(); what was granted is logged and reported by "getLoopStats".
      */
-    void handleHoldPosition();
+    void setRtConfig(const rt::ThreadConfig& config) { m_rtConfig = config; }
+
+    /**
+     * @brief Control loop rate currently in effect (before any overrun downrating)
+     */
+    unsigned int controlRate() const { return m_controlRateHz.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Map a motion library for "playMotion" and hand it to the control thread, which switches
+     *        to it once no clip plays. Blocks: before start(), or from the I/O thread (the
+     *        "loadMotionLibrary" command opens the file on the IoWorker instead).
+     * @return false with 'error' set if the file is invalid, or the previous library was not adopted yet
+     */
+    bool loadMotionLibrary(const std::string& path, std::string& error);
 
 private:
+    friend struct IoCommands;   // the I/O-thread command handlers of the command table
+
     RobotInterface& m_robot;
     std::atomic<bool> m_running { false };
 
     // Socket stuff
     int m_sockfd;
+    int m_epollFd;
+    int m_wakeFd;                        // eventfd used to wake the I/O thread
     std::thread m_socketThread;
     std::string m_socketPath;
 
+    // Slow command work (file writes, library loads, path compilation) off the I/O thread;
+    // the results come back through m_wakeFd
+    IoWorker m_worker;
+
     // Real-time loop
-    std::thread m_controlThread;
+    rt::RtThread m_controlThread;
+    rt::ThreadConfig m_rtConfig;
 
-    // Thread-safe queue for inbound commands
-    std::mutex m_inboundMutex;
-    std::queue<IPCMessage> m_inboundQueue;
+    // Inbound commands (I/O thread -> control thread), preallocated and lock-free
+    static constexpr size_t INBOUND_QUEUE_CAPACITY = 256;
+    SpscRing<QueuedCommand, INBOUND_QUEUE_CAPACITY> m_inboundQueue;
+    std::atomic<uint64_t> m_droppedCommands { 0 };
 
-    // Outbound queuing 
-    std::mutex m_outboundMutex;
-    std::queue<IPCMessage> m_outboundQueue;
+    // Outbound queuing (control thread -> I/O thread)
+    rt::PiMutex m_outboundMutex;                   // priority inheritance: the control thread takes it
+    std::vector<OutboundMessage> m_outboundQueue;
 
-    // Client Handling
-    std::vector<int> m_clientFds;
-    std::mutex m_clientFdsMutex;
+    // Client Handling - only touched by the I/O thread
+    std::unordered_map<int, std::unique_ptr<ClientConnection>> m_clients;
+    std::atomic<SlowConsumerPolicy> m_defaultClientPolicy { SlowConsumerPolicy::DropOldest };
+    std::atomic<size_t> m_defaultClientQueueSize { 32 };    // ~0.5s of state broadcasts
+
+    // Telemetry (control thread -> I/O thread). Only the latest snapshot is kept; no lock on either side.
+    TripleBuffer<TelemetrySnapshot> m_telemetry;
+
+    // What the connected clients need, recomputed by the I/O thread when clients or subscriptions change
+    std::atomic<unsigned int> m_legacyClientCount { 0 };     // clients on the default full-state broadcast
+    std::atomic<unsigned int> m_telemetryDivider { 0 };      // gcd of all subscription dividers, 0 = no subscribers
+    std::atomic<bool> m_cartesianWanted { false };           // some subscriber wants the FK pose
+
+    // Delta-mode streams, one encoder per distinct subscription (I/O thread only)
+    using DeltaStreamKey = std::tuple<ClientProtocol, uint32_t, unsigned int, unsigned int,
+                                      std::array<float, telemetry::NUM_FIELD_GROUPS>>;
+    std::map<DeltaStreamKey, std::unique_ptr<telemetry::DeltaEncoder>> m_deltaEncoders;
     
-    // Emergency handling mutex
-    std::mutex m_emergency_mutex;
+    // Out-of-band ESTOP/hold channel (own socket + thread); also used by the fast path on the main socket
+    EmergencyChannel m_emergency;
+    std::chrono::steady_clock::time_point m_lastReceiveTime;   // last recv() on the main socket (I/O thread only)
+
+    // Socket-to-CAN command latency ("getCommandLatency", "exportCommandTrace"), recorded by the control thread
+    CommandTracer m_commandTracer;
+    static constexpr size_t MAX_TRACES_AWAITING_EGRESS = 32;   // per cycle, the rest are recorded without egress
+    static constexpr const char* DEFAULT_TRACE_PATH = "/tmp/armatron_command_trace.json";
 
-    // Real-time thread configuration
-    static constexpr int RT_THREAD_PRIORITY = 99;  // Maximum real-time priority
-    static constexpr int RT_THREAD_POLICY = SCHED_FIFO;  // First-in-first-out scheduling
-    static constexpr size_t RT_STACK_SIZE = 1024 * 1024;  // 1MB stack for real-time thread
+    // Routines ("uploadRoutine"): parsed and solved on the I/O thread, run by the control thread.
+    // An upload replaces the previous one; only the newest unread upload is kept.
+    TripleBuffer<Routine> m_routineUploads;                     // I/O thread -> control thread
+    std::atomic<bool> m_routineStopRequested { false };         // "stopRoutine"
+    RoutineRunner m_routineRunner;                              // control thread only
+    TripleBuffer<RoutineStatus> m_routineStatus;                // control thread -> I/O thread
+    RoutineStatus m_lastRoutineReport;                          // I/O thread only
+    std::chrono::steady_clock::time_point m_nextRoutineReport;  // I/O thread only
+    std::unique_ptr<KinematicsInterface> m_routineKinematics;   // I/O thread's own IK for pose waypoints
+    uint32_t m_nextRoutineId = 1;                               // I/O thread only
+    static constexpr std::chrono::milliseconds ROUTINE_REPORT_INTERVAL{250};   // progress while running
 
-    // Control loop configuration
-    static constexpr unsigned int CONTROL_RATE_HZ = 200;  // 200Hz control loop
+    // Motion libraries: two slots, so a reload never unmaps the one the control thread plays from
+    std::array<MotionLibrary, 2> m_motionLibraries;             // I/O thread only
+    int m_offeredLibrary = -1;                                  // slot last handed to the robot
+    bool m_libraryBusy = false;                                 // the other slot is being filled (IoWorker)
+    static constexpr const char* DEFAULT_MOTION_LIBRARY_PATH = "/home/debian/.armatron/motions.armmot";
+    static constexpr const char* DEFAULT_RECORDING_PATH = "/home/debian/.armatron/last_recording.armrec";
+
+    // Control loop timing, written by the control thread; "getLoopStats" and the periodic summary read it
+    LoopTiming m_loopTiming;
+    LoopTiming::Snapshot m_lastLoopSummary;                    // I/O thread only
+    uint64_t m_lastLoopSummaryAllocations = 0;                 // I/O thread only
+    std::chrono::steady_clock::time_point m_nextLoopSummary;   // I/O thread only
+    OverrunGovernor m_overrun;                                  // what to do when a cycle misses its tick
+
+    // Control rate: requested by any thread, applied by the control thread between trajectories
+    std::atomic<unsigned int> m_controlRateHz;
+    std::atomic<unsigned int> m_requestedRateHz { 0 };          // 0 = no switch pending
+    unsigned int m_subscriptionRateHz;                          // rate the subscription dividers were computed for (I/O thread only)
+
+    // Control loop configuration (the rate itself is m_controlRateHz)
     static constexpr unsigned int STATE_BROADCAST_RATE_HZ = 60;  // 60Hz state broadcast
-    static constexpr unsigned int BROADCAST_DIVIDER = CONTROL_RATE_HZ / STATE_BROADCAST_RATE_HZ;
+
+    // Socket I/O configuration
+    static constexpr size_t MAX_CLIENT_LINE_BYTES = 64 * 1024;   // Longest accepted JSON command line
+    static constexpr int MAX_EPOLL_EVENTS = 32;
+    static constexpr unsigned int MAX_TELEMETRY_PERIOD_S = 10;   // slowest subscription: one sample per 10s
+    static constexpr std::chrono::seconds LOOP_SUMMARY_INTERVAL{10};
 
     /**
-     * @brief Configure the real-time thread with proper scheduling and memory locking
-     * @return true if real-time scheduling was successfully configured, false otherwise
+     * @brief epoll loop owning the listening socket and all client connections
      */
-    bool configureRealTimeThread();
+    void socketThreadFunc();
 
     /**
-     * @brief Lock all current and future memory pages to prevent paging
-     * This helps ensure deterministic real-time behavior
+     * @brief Accept all pending connections on the listening socket
      */
-    void lockMemory();
+    void acceptClients();
 
     /**
-     * @brief Set CPU affinity to pin the thread to a specific CPU core
-     * This helps reduce scheduling jitter
+     * @brief Read everything available from a client and process complete messages
+     * @return false if the connection should be closed
      */
-    void setThreadAffinity();
+    bool handleClientReadable(ClientConnection& client);
 
     /**
-     * @brief Configure the socket server and start accepting connections
+     * @brief Flush a client's outbound queue and (de)register EPOLLOUT as needed
+     * @return false if the connection should be closed
      */
-    void socketThreadFunc();
+    bool flushClient(ClientConnection& client);
+
+    /**
+     * @brief Close and forget a client connection
+     */
+    void closeClient(int fd);
+
+    /**
+     * @brief Log control loop timing since the previous summary (I/O thread)
+     */
+    void logLoopSummary();
+
+    /**
+     * @brief Hand messages queued by the control thread to the matching clients
+     */
+    void distributeOutbound();
+
+    /**
+     * @brief Encode the latest telemetry snapshot for every client that is due one
+     */
+    void distributeTelemetry();
+
+    /**
+     * @brief Delta encoder key for a client's subscription; clients with equal keys share one stream
+     */
+    static DeltaStreamKey deltaStreamKey(const ClientConnection& client);
 
     /**
-     * @brief Handle incoming messages from a specific client
-     * @param clientFd The file descriptor of the client connection
+     * @brief Send "routineProgress" to every client when the routine's state or step changed, and
+     *        every ROUTINE_REPORT_INTERVAL while it runs (I/O thread)
      */
-    void clientHandler(int clientFd);
+    void distributeRoutineProgress();
 
     /**
-     * @brief Main control loop running at CONTROL_RATE_HZ
-     * This thread is configured for real-time scheduling when available
+     * @brief Handle "uploadRoutine": validate, solve pose waypoints and hand the routine to the
+     *        control thread (I/O thread)
+     */
+    void handleUploadRoutine(ClientConnection& client, const Json::Value& root);
+
+    /**
+     * @brief Handle "saveRecording": write the stopped teach-in recording to a file (on the IoWorker)
+     */
+    void handleSaveRecording(ClientConnection& client, const Json::Value& root);
+
+    /**
+     * @brief Handle "compileRecording": turn a recording into a clip of the motion library and
+     *        reload the library (on the IoWorker)
+     */
+    void handleCompileRecording(ClientConnection& client, const Json::Value& root);
+
+    /**
+     * @brief Handle "compilePath": time-parameterize a spline through routine-style waypoints into a
+     *        clip of the motion library (waypoints solved on the I/O thread, the path on the IoWorker)
+     */
+    void handleCompilePath(ClientConnection& client, const Json::Value& root);
+
+    /**
+     * @brief Reserve the slot the control thread does not play from, to load a library into (I/O thread)
+     * @return false with 'error' set while a clip still plays from the other slot or another load runs
+     */
+    bool reserveLibrarySlot(int& slot, std::string& error);
+
+    /**
+     * @brief End the reservation; if 'loaded', offer the slot to the robot (I/O thread)
+     */
+    void releaseLibrarySlot(int slot, bool loaded);
+
+    /**
+     * @brief IoWorker: add 'clip' to the library file at 'libraryPath' (replacing a clip of the same
+     *        name), write it and open it into 'target', a slot from reserveLibrarySlot()
+     * @param offered The library last offered to the robot (read only), or nullptr
+     * @param index Index of the clip in the new library
+     */
+    static bool addMotionClip(MotionClipData clip, const std::string& libraryPath, const MotionLibrary* offered,
+                              MotionLibrary& target, size_t& index, std::string& error);
+
+    /**
+     * @brief The library last offered to the robot, nullptr if none was loaded
+     */
+    const MotionLibrary* offeredLibrary() const;
+
+    /**
+     * @brief The request's "library", else the loaded library's file, else DEFAULT_MOTION_LIBRARY_PATH
+     */
+    std::string motionLibraryPath(const Json::Value& root) const;
+
+    /**
+     * @brief Max speed modifier of the last control cycle (1 before the first)
+     */
+    double speedModifier();
+
+    /**
+     * @brief The I/O thread's IK solver for pose waypoints, loaded on first use; nullptr without a URDF
+     */
+    KinematicsInterface* routineKinematics();
+
+    /**
+     * @brief Joint angles [rad] (wrist roll and pitch last) the first pose waypoint is solved from
+     */
+    std::array<double, 7> ikSeed();
+
+    /**
+     * @brief Recompute m_legacyClientCount, m_telemetryDivider and m_cartesianWanted from the
+     *        client list, and drop delta encoders no client uses any more
+     */
+    void refreshTelemetryDemand();
+
+    /**
+     * @brief After a control rate switch, recompute the dividers of subscriptions that asked for a
+     *        rate in Hz so they keep their rate (I/O thread)
+     */
+    void rescaleSubscriptions();
+
+    /**
+     * @brief Handle "subscribe" (subscribe = true) / "unsubscribe" for one client
+     */
+    void handleSubscribe(ClientConnection& client, bool subscribe, const Json::Value& root);
+
+    /**
+     * @brief Queue a message for the I/O thread and wake it up
+     */
+    void postOutbound(ClientProtocol protocol, MessageKind kind, std::string data);
+
+    /**
+     * @brief Queue a JSON reply for one client, framed for its protocol (I/O thread only)
+     * @return false if the reply could not be queued or written
+     */
+    bool replyToClient(ClientConnection& client, const std::string& json);
+
+    /**
+     * @brief replyToClient() for the client on 'fd', if it is still connected (IoWorker completions)
+     */
+    bool replyToClient(int fd, const std::string& json);
+
+    /**
+     * @brief Validate an IoThread command against its schema and run its IoCommands handler.
+     *        Runs on the I/O thread.
+     */
+    void handleIoCommand(ClientConnection& client, const commands::CommandSpec& spec, const std::string& line);
+
+    /**
+     * @brief Per-client queue depth, lag and drop counters as a JSON document
+     */
+    std::string clientStatsJson();
+
+    /**
+     * @brief Queue (or directly execute, for ESTOP/hold) one JSON line received from a client
+     */
+    void processJsonLine(ClientConnection& client, const std::string& line);
+
+    /**
+     * @brief Queue (or directly execute, for ESTOP/hold) one binary frame received from a client
+     */
+    void processBinaryFrame(ClientConnection& client, ipc::FrameType type, const std::string& payload);
+
+    /**
+     * @brief Run a command flagged HighPriority (ESTOP or hold) from the I/O thread, bypassing the queue
+     */
+    void handleHighPriority(const commands::CommandSpec& spec);
+
+    /**
+     * @brief Main control loop running at the control rate (m_controlRateHz)
+     * Runs on m_controlThread, already configured per m_rtConfig
      */
     void controlThreadFunc();
 
     /**
-     * @brief Parse and execute a command received from the web interface
+     * @brief Control thread: switch to a requested control rate if one is pending and no
+     *        trajectory is running
+     * @return true if the rate changed
+     */
+    bool applyRequestedControlRate();
+
+    /**
+     * @brief Parse and validate a command received from the web interface (I/O thread)
      * @param jsonStr The JSON string containing the command
+     * @return false (after logging why) if the command is invalid
+     */
+    bool parseCommand(const std::string& jsonStr, QueuedCommand& out);
+
+    /**
+     * @brief Validate a command received over the binary protocol (I/O thread)
+     * @param msg The decoded fixed-layout command
+     */
+    bool parseBinaryCommand(const ipc::CommandMessage& msg, QueuedCommand& out);
+
+    /**
+     * @brief Hand a parsed command to the control thread
+     */
+    void queueCommand(QueuedCommand& command);
+
+    /**
+     * @brief Execute a queued command (control thread)
+     */
+    void executeCommand(const QueuedCommand& command);
+
+    /**
+     * @brief Copy the robot state into the telemetry snapshot and wake the I/O thread
+     * @param poseValid RobotState::current_pose was computed this cycle
      */
-    void handleCommand(const std::string& jsonStr);
+    void publishTelemetry(unsigned int cycle, bool poseValid);
 
     /**
-     * @brief Send a JSON message to all connected clients
+     * @brief Send a JSON message to all connected JSON clients (non-blocking, via the I/O thread)
      * @param jsonStr The JSON string to send
      */
     void sendJson(const std::string& jsonStr);
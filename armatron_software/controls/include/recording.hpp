@@ -0,0 +1,90 @@
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include "motion_library.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One control cycle of a teach-in recording (RobotInterface::startRecording)
+ */
+struct RecordedSample
+{
+    float position[7];    // joint_angles_deg: joints 1-5 [deg], 6/7 in differential motor units
+    float velocity[7];    // joint_speeds_deg_s, same units per second
+    float roll_deg;       // differential wrist, for reference; playback follows 'position'
+    float pitch_deg;
+};
+
+/**
+ * @brief Idle: nothing recorded yet. Stopped: a recording can be saved. Reading: it is being saved.
+ */
+enum class RecordingState : uint8_t { Idle, Recording, Stopped, Reading };
+
+const char* recordingStateName(RecordingState state);
+
+/**
+ * @brief Recording files and turning a recording into a motion library clip.
+ *
+ * File layout (little-endian, version 1): FileHeader, then for every sample and channel
+ * (position[7], velocity[7], roll, pitch) the zigzag varint of the change of the quantized
+ * value since the previous sample. A still or slow arm costs about one byte per channel.
+ */
+namespace recording {
+
+constexpr char MAGIC[8] = { 'A', 'R', 'M', 'R', 'E', 'C', '\0', '\0' };
+constexpr uint16_t VERSION = 1;
+constexpr size_t NUM_CHANNELS = 16;
+
+struct FileHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t channels;                    // NUM_CHANNELS
+    uint32_t rateHz;                      // sample rate = control rate while recording
+    uint32_t sampleCount;
+    uint32_t payloadBytes;
+    float quantum[NUM_CHANNELS];          // resolution of each channel
+};
+
+static_assert(sizeof(FileHeader) == 88, "recording header layout changed");
+
+/**
+ * @brief Delta-encode 'count' samples into 'path'
+ */
+bool save(const std::string& path, const RecordedSample* samples, size_t count, uint32_t rateHz, std::string& error);
+
+/**
+ * @brief Read a file written by save()
+ */
+bool load(const std::string& path, std::vector<RecordedSample>& samples, uint32_t& rateHz, std::string& error);
+
+/**
+ * @brief How compile() turns a demonstration into a clip
+ */
+struct CompileOptions
+{
+    double timeScale = 1.0;                 // playback speed, 2 = twice as fast
+    double smoothingS = 0.05;               // moving-average window [s of recording], applied twice; 0 = none
+    bool limit = true;                      // slow the whole clip down until it respects the limits below
+    uint32_t rateHz = 200;                  // clip sample rate = control rate it will play at
+    std::array<double, 7> maxVelocity {};   // trajectory units, as Ruckig gets them
+    std::array<double, 7> maxAcceleration {};
+    std::array<double, 7> maxJerk {};
+};
+
+/**
+ * @brief Resample, smooth and (optionally) time-scale a recording into a clip. Velocities and
+ *        accelerations are differentiated from the smoothed positions; the clip starts and ends
+ *        at rest on the recording's first and last positions.
+ * @param appliedSlowdown Factor the limits stretched the clip by (1 = none)
+ */
+bool compile(const std::vector<RecordedSample>& samples, uint32_t rateHz, const CompileOptions& options,
+             MotionClipData& clip, double& appliedSlowdown, std::string& error);
+
+} // namespace recording
+
+#endif // RECORDING_HPP
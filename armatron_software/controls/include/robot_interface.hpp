@@ -3,10 +3,25 @@
 
 #include "motor_interface.hpp"
 #include "kinematics_interface.hpp"
+#include "control_rate.hpp"
+#include "loop_timing.hpp"
+#include "triple_buffer.hpp"
+#include "trajectory_cache.hpp"
+#include "motion_library.hpp"
+#include "recording.hpp"
+#include "joint_controller.hpp"
+#include "tracking_stats.hpp"
 #include <kdl/frames.hpp>
 #include <ruckig/ruckig.hpp>
 #include <vector>
 #include <array>
+#include <chrono>
+#include <atomic>
+
+/**
+ * @brief One value per joint. Fixed size so the control cycle never allocates.
+ */
+using JointValues = std::array<float, 7>;
 
 struct DifferentialMotorState
 {
@@ -18,6 +33,33 @@ struct DifferentialMotorState
     double pitch_angle_deg = 0.0;
 };
 
+/**
+ * @brief How a joint trajectory is followed.
+ *        Online:   Ruckig::update() every cycle (recalculates whenever its input changes).
+ *        PlanOnce: Ruckig::calculate() once per move, sampled with Trajectory::at_time(); the PI
+ *                  loop closes the loop and the move is only replanned, from the measured position,
+ *                  when the tracking error exceeds RobotState::replan_threshold_deg.
+ */
+enum class TrajectoryMode : uint8_t
+{
+    Online = 0,
+    PlanOnce
+};
+
+/**
+ * @brief One point of a multi-point move (RobotInterface::queueWaypoint)
+ */
+struct JointWaypoint
+{
+    static constexpr double MIN_SPEED = 0.01;
+
+    std::array<double, 7> position {};   // joints 1-5 [deg], wrist roll and pitch [deg] - as moveToJointPosition
+    std::array<double, 5> velocity {};   // pass-through speed of joints 1-5 [deg/s], see velocityCount
+    size_t velocityCount = 0;            // joints with an explicit pass-through speed; the rest are blended
+    double speed = 1.0;                  // share of the joint limits for the segment ending here, MIN_SPEED..1
+    double dwell_s = 0.0;                // stop here and wait this long before the next segment [s]
+};
+
 /* 
  * @brief Holds the current state of the robot.
  *        
@@ -34,6 +76,8 @@ struct RobotState
     double joint_accelerations_deg_s2[7] = {0.0};
     double prev_joint_angles_deg[7] = {0.0};    // Previous cycle positions for velocity calculation
     double prev_joint_speeds_deg_s[7] = {0.0};  // Previous cycle speeds for acceleration calculation
+    double control_period_s = control_rate::periodSeconds(control_rate::DEFAULT_HZ);  // Nominal cycle time, see setControlPeriod
+    double state_dt_s = control_rate::periodSeconds(control_rate::DEFAULT_HZ);        // Time covered by the last updateJointStates (whole periods)
     DifferentialMotorState differential_motors;
 
     // State Targets (radians and degrees for convenience)
@@ -59,12 +103,20 @@ struct RobotState
     // Ruckig State
     ruckig::InputParameter<7> ruckig_input;
     ruckig::OutputParameter<7> ruckig_output;
-    ruckig::Ruckig<7> ruckig_otg{0.005}; // otg = online trajectory generation lol (SCREW ACRONYMS)
+    ruckig::Ruckig<7> ruckig_otg{control_rate::periodSeconds(control_rate::DEFAULT_HZ)}; // otg = online trajectory generation lol (SCREW ACRONYMS)
 
     // Trajectory State
     bool trajectory_active{false};
     double trajectory_duration{0.0};
     double trajectory_progress{0.0};
+    TrajectoryMode trajectory_mode{TrajectoryMode::Online};   // used by the next move
+    bool trajectory_planned{false};                            // the active move runs on planned_trajectory
+    ruckig::Trajectory<7> planned_trajectory;                  // PlanOnce: result of Ruckig::calculate
+    double trajectory_time{0.0};                               // PlanOnce: time along planned_trajectory [s]
+    double replan_threshold_deg{5.0};                          // PlanOnce: tracking error that triggers a replan
+    uint32_t replan_count{0};                                  // PlanOnce: replans since startup
+    double segment_dwell_s{0.0};                               // waypoints: hold at the end of the active segment [s]
+    double tracking_error_deg{0.0};                            // worst joint error to the last setpoint tracked
 
     // Max Speed Modifier
     float max_speed_modifier = 0.16666666667;
@@ -77,16 +129,57 @@ struct RobotState
     double twin_joint_accelerations_deg_s2[7] = {0.0};
     bool twin_active = true;
 
-    // PI Controller State
+    // Tracking controller (gains and integrators live in RobotInterface's JointController)
     struct {
-        float position_error[7] = {0.0f};      // Current position error for each joint
-        float integral_error[7] = {0.0f};      // Accumulated integral error for each joint
-        float Kp = 8.0f;                       // Proportional gain - Tuned manually NOT mathematically derived
-        float Ki = 0.0f;                       // Integral gain
-        float max_integral = 10.0f;            // Maximum integral term to prevent windup
+        float position_error[7] = {0.0f};      // Setpoint - measured position of each joint, trajectory units
     } pi_controller;
 };
 
+/**
+ * @brief Immutable copy of the robot state, published by the control thread at the end of
+ *        each cycle (RobotInterface::publishSnapshot). Every field comes from the same cycle,
+ *        so a reader on another thread never sees joint 1 from one cycle and joint 7 from the next.
+ */
+struct RobotSnapshot
+{
+    uint64_t sequence = 0;                            // publish count, 0 = nothing published yet
+    std::chrono::steady_clock::time_point stamp;      // when the cycle's state was read
+    double control_period_s = 0.0;
+
+    MotorState motors[7];
+    double joint_angles_deg[7] = {0.0};
+    double joint_speeds_deg_s[7] = {0.0};
+    double joint_accelerations_deg_s2[7] = {0.0};
+    double target_joint_angles_deg[7] = {0.0};
+    double target_joint_speeds_deg_s[7] = {0.0};
+    DifferentialMotorState differential_motors;
+
+    bool trajectory_active = false;
+    double trajectory_duration = 0.0;
+    double trajectory_progress = 0.0;
+    TrajectoryMode trajectory_mode = TrajectoryMode::Online;
+    uint32_t replan_count = 0;
+    uint32_t queued_waypoints = 0;
+    int32_t motion_clip = -1;                         // clip being played back, -1 = none
+    RecordingState recording = RecordingState::Idle;
+    double feed_override = 1.0;
+    double feed_override_target = 1.0;
+    uint32_t recorded_samples = 0;
+    TrajectoryCache::Stats trajectory_cache;
+    bool trajectory_cache_enabled = false;
+    double tracking_error_deg = 0.0;
+    float max_speed_modifier = 0.0f;
+    JointGains joint_gains[7];
+
+    bool twin_active = false;
+    double twin_joint_angles_deg[7] = {0.0};
+    double twin_diff_roll_rad = 0.0;
+    double twin_diff_pitch_rad = 0.0;
+
+    bool pose_valid = false;                          // current_pose was computed from this cycle's joints
+    KDL::Frame current_pose;
+};
+
 /**
  * @brief RobotInterface manages multiple MG motors and kinematics.
  *        It can easily scale from 1 to 7 or more joints.
@@ -100,28 +193,68 @@ public:
      */
     RobotInterface(CANHandler& canRef, const std::string& urdf_path);
 
+    /**
+     * @brief URDF the kinematics were loaded from (empty if none), for threads that need their own solver
+     */
+    const std::string& urdfPath() const { return m_urdfPath; }
+
     /**
      * @brief Get a reference to motor i [1..numMotors].
      */
     Motor& getMotor(int i);
 
     /**
-     * @brief Example update: read each motor's state for logging or safety checks.
+     * @brief One full cycle: updateCycle(), then publishSnapshot().
      */
     void updateAll();
 
+    /**
+     * @brief The robot's part of a control cycle, in order: joint states; differential motors and
+     *        teach-in recording; trajectories and tracking statistics. Calls phaseDone(phase) after each of them, so the
+     *        daemon can time the phases and hook in between. Anything that has to run every cycle
+     *        belongs in here, not in updateAll(). Control thread only.
+     */
+    template <typename PhaseDone>
+    void updateCycle(PhaseDone&& phaseDone)
+    {
+        updateJointStates();
+        phaseDone(LoopPhase::JointStates);
+        updateDifferentialMotors();
+        if (m_recordingState.load(std::memory_order_relaxed) == RecordingState::Recording) {
+            recordSamples();
+        }
+        phaseDone(LoopPhase::Differential);
+        updateJointTrajectories();
+        m_trackingStats.settle(m_state.joint_angles_deg, m_state.state_dt_s);
+        phaseDone(LoopPhase::Trajectories);
+    }
+
+    /**
+     * @brief Copy the current state into the snapshot buffer and publish it. Control thread only;
+     *        lock-free and allocation-free.
+     */
+    void publishSnapshot();
+
+    /**
+     * @brief Latest published snapshot. For ONE reader thread other than the control thread
+     *        (the daemon's I/O thread); the returned reference stays valid and unchanged until
+     *        that thread calls latestSnapshot() again.
+     */
+    const RobotSnapshot& latestSnapshot();
+
     /**
      * @brief Set joint angles for multiple joints
      * @param joint_angles Target joint angles in radians
      * @param joint_speeds Target joint speeds in rad/s
+     * @param count Number of joints to command, starting at joint 1
      */
-    void setMultiJointAngles(std::vector<float> joint_angles, std::vector<float> joint_speeds);
+    void setMultiJointAngles(const JointValues& joint_angles, const JointValues& joint_speeds, size_t count);
 
     /**
-     * @brief Set joint speeds for multiple joints
+     * @brief Set joint speeds for all joints
      * @param joint_speeds Target joint speeds 
      */
-    void setMultiJointSpeeds(std::vector<float> joint_speeds);
+    void setMultiJointSpeeds(const JointValues& joint_speeds);
 
     /**
      * @brief Move the end-effector to a specific Cartesian pose
@@ -142,7 +275,118 @@ public:
     void updateJointTrajectories();
 
     /**
-     * @brief Get the current robot state
+     * @brief Append a waypoint to the move queue. Consecutive waypoints are passed through
+     *        without stopping: each segment ends at a blended (or the given) velocity and the
+     *        next segment is planned while the current one runs. The last waypoint stops, and
+     *        so does one with a dwell (JointWaypoint::dwell_s).
+     * @return false if the queue is full
+     */
+    bool queueWaypoint(const JointWaypoint& waypoint);
+
+    /**
+     * @brief Drop the queued waypoints; the active segment is replanned to stop at its target
+     */
+    void clearWaypoints();
+
+    size_t queuedWaypoints() const { return m_waypointCount; }
+
+    /**
+     * @brief Waypoints whose segment has been started since startup
+     */
+    uint64_t waypointsStarted() const { return m_waypointsStarted; }
+
+    /**
+     * @brief Bumped whenever queued waypoints are dropped (clearWaypoints, a new move, hold, ESTOP),
+     *        so whoever fed the queue can tell its waypoints will not be reached
+     */
+    uint32_t waypointEpoch() const { return m_waypointEpoch; }
+
+    /**
+     * @brief Choose how the next moveToJointPosition is followed (the active move keeps its mode)
+     * @param replanThresholdDeg PlanOnce: largest joint tracking error [deg] before the move is replanned
+     */
+    void setTrajectoryMode(TrajectoryMode mode, double replanThresholdDeg);
+
+    /**
+     * @brief Feed-rate override: run the active move, and every later one, at 'scale' times its
+     *        planned speed (0 pauses, at most MAX_FEED_OVERRIDE) by scaling how fast its clock runs.
+     *        The override ramps to 'scale' jerk-limited, so nothing is replanned and the motion stays
+     *        smooth. Above 1 the joints exceed the limits the move was planned with.
+     */
+    void setFeedOverride(double scale);
+    double feedOverride() const { return m_feedOutput.new_position[0]; }
+
+    static constexpr double MAX_FEED_OVERRIDE = 2.0;
+
+    /**
+     * @brief Reuse plans of repeated moves (PlanOnce, waypoints, routines) instead of calling
+     *        Ruckig::calculate again; see TrajectoryCache. Disabling also empties the cache.
+     */
+    void setTrajectoryCacheEnabled(bool enabled);
+    void clearTrajectoryCache() { m_trajectoryCache.clear(); }
+
+    /**
+     * @brief Hand a loaded library to the control thread (any thread). It is adopted at the start of
+     *        the next cycle in which no clip plays; the library must stay loaded and unchanged while
+     *        it is motionLibraryInUse(), or pending.
+     */
+    void offerMotionLibrary(const MotionLibrary* library) { m_pendingLibrary.store(library, std::memory_order_release); }
+
+    /**
+     * @brief Library playMotion() plays from, nullptr before one was adopted (any thread)
+     */
+    const MotionLibrary* motionLibraryInUse() const { return m_libraryInUse.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Play a precompiled clip: each control cycle takes the next sample as the setpoint for
+     *        the PI loop, with no planning. Replaces the active move. Refused unless the clip was
+     *        sampled at the current control rate and starts within PLAYBACK_START_TOLERANCE_DEG of
+     *        the measured position.
+     * @return false (after logging why) if the clip was not started
+     */
+    bool playMotion(size_t index);
+
+    /**
+     * @brief Joint targets as the trajectory tracks them: joints 6/7 (roll, pitch [deg]) become
+     *        differential motor angles. Depends on nothing else, so any thread can use it.
+     */
+    static std::array<double, 7> toTrajectorySpace(const std::array<double, 7>& target_position);
+    static constexpr double DIFFERENTIAL_UNITS_PER_DEG = 10.0;  // joints 6/7 are tracked in raw motor units
+
+    /**
+     * @brief Replace the tracking gains of one joint (0-6), in motor units. Control thread.
+     */
+    void setJointGains(size_t joint, const JointGains& gains) { m_controller.setGains(joint, gains); }
+    JointGains jointGains(size_t joint) const { return m_controller.gains(joint); }
+
+    /**
+     * @brief Per-trajectory tracking error, settling and overshoot. The control thread feeds it;
+     *        other threads only call drain(), toJson() and reset().
+     */
+    TrackingStats& trackingStats() { return m_trackingStats; }
+
+    /**
+     * @brief Teach-in: sample joint_angles_deg, joint_speeds_deg_s and the differential roll/pitch at
+     *        RECORDING_RATE_HZ into a preallocated buffer of RECORDING_CAPACITY samples, replacing
+     *        the previous recording. Stops by itself when the buffer is full. Control thread.
+     * @return false if the previous recording is being read (beginReadRecording)
+     */
+    bool startRecording();
+    void stopRecording();
+
+    /**
+     * @brief Borrow the stopped recording from another thread; a new recording cannot start until
+     *        endReadRecording(). Pairs of these must not overlap.
+     * @return false if there is no stopped recording
+     */
+    bool beginReadRecording(const RecordedSample*& samples, size_t& count);
+    void endReadRecording();
+
+    static constexpr uint32_t RECORDING_RATE_HZ = 200;
+    static constexpr size_t RECORDING_CAPACITY = 120 * RECORDING_RATE_HZ;   // two minutes
+
+    /**
+     * @brief Get the live robot state. Control thread only - other threads use latestSnapshot().
      * @return Reference to the current robot state
      */
     const RobotState& getState() const { return m_state; }
@@ -171,23 +415,36 @@ public:
      */
     void setESTOP();
 
+    /**
+     * @brief Send motor stop (0x81) to every motor as one pre-encoded CAN batch.
+     *        Safe to call from any thread: it only touches the CAN socket, does not wait
+     *        for replies and leaves the trajectory state to the control thread.
+     * @return true if every frame was accepted by the CAN socket
+     */
+    bool sendStopBurst();
+
+    /**
+     * @brief Send speed 0 (0xA2) to every motor as one pre-encoded CAN batch. Same rules as sendStopBurst().
+     */
+    bool sendHoldBurst();
+
     /**
      * @brief Set the digital twin joint angles
      * @param angles Array of 7 joint angles in degrees
      */
-    void setTwinJointAngles(std::vector<float> angles);
+    void setTwinJointAngles(const JointValues& angles);
 
     /**
      * @brief Set the digital twin joint speeds
      * @param speeds Array of 7 joint speeds in degrees per second
      */
-    void setTwinJointSpeeds(std::vector<float> speeds);
+    void setTwinJointSpeeds(const JointValues& speeds);
 
     /**
      * @brief Set the digital twin joint accelerations
      * @param accelerations Array of 7 joint accelerations in degrees per second squared
      */
-    void setTwinJointAccelerations(std::vector<float> accelerations);
+    void setTwinJointAccelerations(const JointValues& accelerations);
 
     /**
      * @brief Set whether the digital twin is active
@@ -204,12 +461,150 @@ public:
     void updateTwinDifferentialAnglesRad();
 
     void updateJointStates();
+
+    /**
+     * @brief Drive the wrist differential motors towards their targets (a phase of updateCycle())
+     */
+    void updateDifferentialMotors();
+
+    /**
+     * @brief Compute the end-effector pose (RobotState::current_pose) from the measured joint angles
+     * @return false if no kinematic chain is loaded or forward kinematics failed
+     */
+    bool updateCartesianPose();
+
+    /**
+     * @brief Set the nominal control period used by Ruckig, the finite differences and the PI integrator.
+     *        Called by the daemon when it changes its loop rate.
+     */
+    void setControlPeriod(double seconds);
+    double getControlPeriod() const { return m_state.control_period_s; }
 private:
+    CANHandler& m_can;
+    std::string m_urdfPath;
     std::vector<Motor> m_motors;
+    std::array<struct can_frame, 7> m_stopFrames;   // built once in the constructor, read-only afterwards
+    std::array<struct can_frame, 7> m_holdFrames;
     RobotState m_state;
+    TripleBuffer<RobotSnapshot> m_snapshots;
+    uint64_t m_snapshotSequence = 0;
+    bool m_poseFresh = false;                                // current_pose matches the last joint read
     KinematicsInterface m_kinematics;
-    void updateDifferentialMotors();
-    std::pair<int32_t, int32_t> getDifferentialAngles(double target_roll_rad, double target_pitch_rad);
+    std::chrono::steady_clock::time_point m_lastStateRead;   // start of the previous updateJointStates
+    static std::pair<int32_t, int32_t> getDifferentialAngles(double target_roll_rad, double target_pitch_rad);
+
+    /**
+     * @brief PlanOnce: Ruckig::calculate from ruckig_input into planned_trajectory, restarting its clock
+     */
+    bool planTrajectory();
+
+    /**
+     * @brief PlanOnce: one cycle of the active move - sample, replan if needed, track
+     */
+    void samplePlannedTrajectory(double step);
+
+    /**
+     * @brief Drive the joints along a setpoint: twin state, then JointController turns the setpoint and
+     *        the measured joint angles into speed commands
+     */
+    void trackSetpoint(const std::array<double, 7>& position, const std::array<double, 7>& velocity,
+                       const std::array<double, 7>& acceleration);
+
+    /**
+     * @brief Finish the active move: start the next queued waypoint, or log it and hold position
+     */
+    void finishTrajectory(double duration);
+
+    /**
+     * @brief Follow the playing clip for one cycle (updateJointTrajectories)
+     */
+    void samplePlayback(double step);
+
+    /**
+     * @brief Advance the feed override one cycle; returns the trajectory time that passed
+     */
+    double advanceFeedOverride();
+
+    /**
+     * @brief A setpoint sampled in trajectory time, converted to wall-clock time at the current override
+     */
+    void applyFeedOverride(std::array<double, 7>& velocity, std::array<double, 7>& acceleration) const;
+
+    /**
+     * @brief Append the recording samples due this cycle, interpolated between the last two joint reads
+     */
+    void recordSamples();
+
+    /**
+     * @brief Ruckig::calculate through the trajectory cache
+     */
+    ruckig::Result calculateTrajectory(const ruckig::InputParameter<7>& input, ruckig::Trajectory<7>& trajectory);
+
+    /**
+     * @brief Waypoint 'index' positions after the front of the queue, nullptr past the end
+     */
+    const JointWaypoint* waypointAt(size_t index) const;
+    JointWaypoint popWaypoint();
+
+    /**
+     * @brief Velocity to pass 'via' with, coming from 'from' and heading for 'next' (zero if none)
+     */
+    std::array<double, 7> passThroughVelocity(const std::array<double, 7>& from, const JointWaypoint& via,
+                                              const JointWaypoint* next) const;
+
+    /**
+     * @brief Targets and limits of a segment ending at 'target' with 'targetVelocity'
+     */
+    void setSegmentTarget(ruckig::InputParameter<7>& input, const std::array<double, 7>& target,
+                          const std::array<double, 7>& targetVelocity, double speed) const;
+
+    /**
+     * @brief Start a segment to the front waypoint from the measured state (nothing active)
+     */
+    void startWaypointSegment();
+
+    /**
+     * @brief Plan the segment after the active one, from the active segment's target state
+     */
+    void planNextSegment();
+
+    static constexpr double REPLAN_HOLDOFF_S = 0.1;            // minimum time on a plan before replanning again
+
+    // Waypoint queue (control thread only, preallocated). Positions are stored in trajectory space.
+    static constexpr size_t MAX_WAYPOINTS = 64;
+    static constexpr double BLEND_SPEED_FRACTION = 0.5;    // of the joint speed limit, at a straight pass-through
+    std::array<JointWaypoint, MAX_WAYPOINTS> m_waypoints;
+    size_t m_waypointHead = 0;
+    size_t m_waypointCount = 0;
+    ruckig::InputParameter<7> m_nextInput;                 // segment after the active one, planned ahead
+    ruckig::Trajectory<7> m_nextSegment;
+    bool m_nextSegmentReady = false;
+    // Motion library playback (control thread only)
+    static constexpr double PLAYBACK_START_TOLERANCE_DEG = 1.0;
+    const MotionLibrary* m_motionLibrary = nullptr;
+    std::atomic<const MotionLibrary*> m_pendingLibrary { nullptr };
+    std::atomic<const MotionLibrary*> m_libraryInUse { nullptr };
+    const MotionClip* m_playback = nullptr;
+    int32_t m_playbackIndex = -1;
+    uint32_t m_playbackSample = 0;
+    double m_playbackCursor = 0.0;                            // [samples], fractional under a feed override
+    JointController m_controller;                            // control thread only
+    TrackingStats m_trackingStats{{1.0, 1.0, 1.0, 1.0, 1.0, DIFFERENTIAL_UNITS_PER_DEG, DIFFERENTIAL_UNITS_PER_DEG}};
+    TrajectoryCache m_trajectoryCache{{1.0, 1.0, 1.0, 1.0, 1.0, DIFFERENTIAL_UNITS_PER_DEG, DIFFERENTIAL_UNITS_PER_DEG}};
+    // Feed override (control thread only): the override itself is a one-axis jerk-limited trajectory
+    static constexpr double FEED_OVERRIDE_MAX_RATE = 1.0;      // [1/s], 0 -> 100% in one second
+    static constexpr double FEED_OVERRIDE_MAX_ACCEL = 4.0;     // [1/s^2]
+    static constexpr double FEED_OVERRIDE_MAX_JERK = 40.0;     // [1/s^3]
+    ruckig::Ruckig<1> m_feedOtg{control_rate::periodSeconds(control_rate::DEFAULT_HZ)};
+    ruckig::InputParameter<1> m_feedInput;
+    ruckig::OutputParameter<1> m_feedOutput;
+    // Teach-in recording: written by the control thread while Recording, read by others while Reading
+    std::vector<RecordedSample> m_recording;                 // RECORDING_CAPACITY, allocated in the constructor
+    size_t m_recordedCount = 0;
+    double m_recordingElapsed = 0.0;                         // since the last sample [s]
+    std::atomic<RecordingState> m_recordingState { RecordingState::Idle };
+    uint64_t m_waypointsStarted = 0;
+    uint32_t m_waypointEpoch = 0;
     static double wrap180(double deg) {double w = std::fmod(deg + 180.0, 360.0); if (w < 0) w += 360.0; return w - 180.0;}
     double m_pi = 3.14159265359;
 };
@@ -0,0 +1,129 @@
+#ifndef ROUTINE_HPP
+#define ROUTINE_HPP
+
+#include "robot_interface.hpp"
+#include "kinematics_interface.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <jsoncpp/json/json.h>
+
+/**
+ * @brief A motion routine uploaded in one message ("uploadRoutine") and run by the control
+ *        thread with no client involvement: joint waypoints, each with its own speed and dwell.
+ *        Fixed size, so it can be handed to the control thread through a TripleBuffer.
+ */
+struct Routine
+{
+    static constexpr size_t MAX_STEPS = 256;
+    static constexpr size_t NAME_LENGTH = 32;
+    static constexpr double MAX_DWELL_S = 60.0;
+
+    uint32_t id = 0;
+    std::array<char, NAME_LENGTH> name {};         // NUL-terminated, truncated
+    size_t count = 0;
+    std::array<JointWaypoint, MAX_STEPS> steps;    // Cartesian waypoints are already solved to joints
+};
+
+enum class RoutineState : uint8_t
+{
+    Idle = 0,
+    Running,
+    Done,
+    Aborted
+};
+
+const char* routineStateName(RoutineState state);
+
+/**
+ * @brief Progress of the current (or last) routine, published by the control thread
+ */
+struct RoutineStatus
+{
+    uint32_t id = 0;
+    std::array<char, Routine::NAME_LENGTH> name {};
+    RoutineState state = RoutineState::Idle;
+    const char* reason = "";                // why it was aborted (string literal)
+    uint32_t step = 0;                      // waypoints reached (after their dwell)
+    uint32_t steps = 0;
+    double elapsed_s = 0.0;
+    double tracking_error_deg = 0.0;        // worst joint, this cycle
+    double max_tracking_error_deg = 0.0;    // worst joint, whole routine
+    double rms_tracking_error_deg = 0.0;    // of the per-cycle worst joint, whole routine
+    uint32_t replans = 0;                   // PlanOnce replans during the routine
+
+    /**
+     * @brief {id, name, state, step, steps, elapsedS, trackingErrorDeg, maxTrackingErrorDeg,
+     *        rmsTrackingErrorDeg, replans} plus "reason" when aborted
+     */
+    Json::Value toJson() const;
+};
+
+/**
+ * @brief Parse and validate an "uploadRoutine" request (I/O thread):
+ *        {"name":"pick", "speed":0.5, "dwell":0,
+ *         "waypoints":[{"angles":[j1..j5, roll, pitch]},
+ *                      {"pose":{"position":[x,y,z], "rpy":[r,p,y]}, "speed":0.2, "dwell":1.5},
+ *                      {"angles":[...], "velocities":[...]}]}
+ *        Angles in degrees as moveToJointPosition, poses in meters / radians. "speed" and
+ *        "dwell" at the top level are the defaults for every waypoint. Every target (after IK
+ *        for poses) is checked against JOINT_n_ANGLE_LIMIT_* and the wrist pitch against
+ *        DIFF_PITCH_ANGLE_LIMIT_*; one bad waypoint rejects the whole routine.
+ * @param kinematics Solver for "pose" waypoints, nullptr to reject them. Not the control
+ *        thread's: KDL solvers keep internal state.
+ * @param seed Joint angles [rad] (wrist roll and pitch last) the first pose is solved from;
+ *        later poses start from the previous waypoint
+ * @return false with 'error' set (naming the waypoint) if the routine is invalid; 'out' is
+ *         then partly written
+ */
+bool parseRoutine(const Json::Value& request, KinematicsInterface* kinematics,
+                  const std::array<double, 7>& seed, Routine& out, std::string& error);
+
+/**
+ * @brief Runs a Routine on the control thread by keeping RobotInterface's waypoint queue topped
+ *        up, and tracks progress and tracking error. No allocation.
+ *
+ * A routine ends Done once its last waypoint (and dwell) is reached, or Aborted by abort() or
+ * when something else drops the queued waypoints (hold, ESTOP, another move, a failed plan).
+ */
+class RoutineRunner
+{
+public:
+    /**
+     * @brief Start 'routine', which must stay unchanged until it ends or another one starts.
+     *        Replaces a running routine. The first waypoint is queued once the arm is idle.
+     */
+    void start(const Routine& routine, RobotInterface& robot);
+
+    /**
+     * @brief Stop feeding waypoints; the active segment still ends at rest on its target
+     */
+    void abort(RobotInterface& robot, const char* reason);
+
+    /**
+     * @brief Once per cycle, after RobotInterface::updateJointTrajectories
+     * @return true if the state or step changed since the previous call (worth telling clients)
+     */
+    bool cycle(RobotInterface& robot);
+
+    bool running() const { return m_status.state == RoutineState::Running; }
+    const RoutineStatus& status() const { return m_status; }
+
+private:
+    static constexpr size_t FEED_AHEAD = 8;   // waypoints kept queued, enough to plan ahead and blend
+
+    void finish(RoutineState state, const char* reason);
+
+    const Routine* m_routine = nullptr;
+    size_t m_next = 0;                  // next step to queue
+    uint64_t m_startedBase = 0;         // RobotInterface::waypointsStarted() at start
+    uint32_t m_epoch = 0;               // RobotInterface::waypointEpoch() at start
+    uint32_t m_replanBase = 0;
+    double m_sumSquaredError = 0.0;
+    uint64_t m_errorSamples = 0;
+    bool m_waiting = false;             // accepted, waiting for the arm to be idle
+    bool m_changed = false;
+    RoutineStatus m_status;
+};
+
+#endif // ROUTINE_HPP
@@ -0,0 +1,40 @@
+#ifndef RT_ALLOC_GUARD_HPP
+#define RT_ALLOC_GUARD_HPP
+
+#include <cstdint>
+
+/**
+ * @brief Heap allocation guard for the real-time thread.
+ *
+ * Built with RT_ALLOC_GUARD (cmake -DARMATRON_RT_ALLOC_GUARD=ON), malloc/calloc/realloc/free
+ * (and so every operator new) are interposed. Any allocation made by an armed thread is
+ * counted, and with the environment variable ARMATRON_RT_ALLOC_TRAP=1 it aborts the
+ * daemon so the offending call shows up in a core dump / debugger backtrace.
+ *
+ * Without RT_ALLOC_GUARD every function here is a no-op and costs nothing.
+ */
+namespace rtalloc {
+
+/**
+ * @brief True if the daemon was built with the guard
+ */
+bool enabled();
+
+/**
+ * @brief Start guarding the calling thread (the control thread, once it is warmed up)
+ */
+void armThisThread();
+
+/**
+ * @brief Stop guarding the calling thread
+ */
+void disarmThisThread();
+
+/**
+ * @brief Allocations made by armed threads since start
+ */
+uint64_t allocationCount();
+
+} // namespace rtalloc
+
+#endif // RT_ALLOC_GUARD_HPP
@@ -0,0 +1,133 @@
+#ifndef RT_CONFIG_HPP
+#define RT_CONFIG_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <pthread.h>
+#include <jsoncpp/json/json.h>
+
+/**
+ * @brief Real-time thread configuration: scheduling policy, CPU pinning, memory locking and
+ *        a prefaulted stack of known size, plus a report of what the kernel actually granted.
+ *
+ * Policies are tried in order Deadline -> Fifo -> Other; whatever was not granted is
+ * reported (and logged) instead of being silently dropped.
+ */
+namespace rt {
+
+enum class SchedPolicy : uint8_t
+{
+    Other = 0,   // SCHED_OTHER at the highest nice level we may use
+    Fifo,        // SCHED_FIFO at 'priority'
+    Deadline     // SCHED_DEADLINE, runtime/deadline/period derived from the control period
+};
+
+bool parseSchedPolicy(const std::string& name, SchedPolicy& policy);
+const char* schedPolicyName(SchedPolicy policy);
+
+struct ThreadConfig
+{
+    SchedPolicy policy = SchedPolicy::Fifo;
+    int priority = 99;                      // SCHED_FIFO priority
+    int cpu = 0;                            // CPU to pin to, -1 = no pinning (not possible under SCHED_DEADLINE)
+    size_t stackSize = 1024 * 1024;         // pthread stack size, prefaulted before the body runs
+    bool lockMemory = true;                 // mlockall(MCL_CURRENT | MCL_FUTURE)
+    double deadlineRuntimeFraction = 0.6;   // SCHED_DEADLINE runtime as a share of the period
+};
+
+/**
+ * @brief What the thread really got
+ */
+struct ThreadReport
+{
+    SchedPolicy requested = SchedPolicy::Other;
+    SchedPolicy granted = SchedPolicy::Other;
+    int priority = 0;                                  // SCHED_FIFO priority (granted == Fifo)
+    std::chrono::nanoseconds deadlineRuntime { 0 };    // granted == Deadline
+    std::chrono::nanoseconds deadlinePeriod { 0 };
+    int cpu = -1;                                      // pinned CPU, -1 if not pinned
+    bool memoryLocked = false;
+    size_t stackSize = 0;                              // 0 = default pthread stack
+    size_t prefaultedBytes = 0;
+    std::string notes;                                 // why something was not granted
+
+    std::string summary() const;
+    Json::Value toJson() const;
+};
+
+/**
+ * @brief A pthread started with a ThreadConfig. start() returns once the thread has
+ *        configured itself, so the report is complete by then.
+ */
+class RtThread
+{
+public:
+    RtThread() = default;
+    ~RtThread();
+    RtThread(const RtThread&) = delete;
+    RtThread& operator=(const RtThread&) = delete;
+
+    /**
+     * @param period Control period, used for SCHED_DEADLINE
+     * @return false if no thread could be created at all
+     */
+    bool start(const ThreadConfig& config, std::chrono::nanoseconds period, std::function<void()> body);
+    void join();
+    bool joinable() const { return m_started; }
+
+    const ThreadReport& report() const { return m_report; }
+
+private:
+    static void* entry(void* self);
+
+    pthread_t m_thread {};
+    bool m_started = false;
+    ThreadConfig m_config;
+    std::chrono::nanoseconds m_period { 0 };
+    std::function<void()> m_body;
+    ThreadReport m_report;
+
+    pthread_mutex_t m_readyMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t m_readyCond = PTHREAD_COND_INITIALIZER;
+    bool m_ready = false;
+};
+
+/**
+ * @brief Move the calling SCHED_DEADLINE thread to a new period (after a control rate switch)
+ * @return false (with errno set) if the kernel refused
+ */
+bool setDeadline(std::chrono::nanoseconds period, double runtimeFraction);
+
+/**
+ * @brief Sleep until an absolute steady_clock time. A SCHED_DEADLINE thread must sleep rather
+ *        than spin, or it exhausts its runtime and gets throttled.
+ */
+void sleepUntil(std::chrono::steady_clock::time_point t);
+
+/**
+ * @brief Mutex with priority inheritance (PTHREAD_PRIO_INHERIT), for every lock the control
+ *        thread takes: a lower priority holder is boosted instead of the control thread
+ *        waiting behind whatever preempted it. BasicLockable, so std::lock_guard works.
+ */
+class PiMutex
+{
+public:
+    PiMutex();
+    ~PiMutex();
+    PiMutex(const PiMutex&) = delete;
+    PiMutex& operator=(const PiMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    pthread_mutex_t m_mutex;
+};
+
+} // namespace rt
+
+#endif // RT_CONFIG_HPP
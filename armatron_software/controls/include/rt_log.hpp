@@ -0,0 +1,235 @@
+#ifndef RT_LOG_HPP
+#define RT_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * @brief Asynchronous logger that is safe to call from the real-time threads.
+ *
+ * A log call copies its format string pointer and arguments into a fixed-size record in a
+ * preallocated lock-free ring (no locks, no allocation, no syscalls); a background thread
+ * formats the records and writes them to stdout (Debug/Info) or stderr (Warn/Error).
+ * If the ring is full the record is dropped and counted.
+ *
+ * Format strings use "{}" placeholders and must be string literals:
+ *
+ *     RTLOG_INFO(Robot, "[RobotInterface] Control period set to {} ms", period * 1000.0);
+ *
+ * Debug records are compiled out unless DEBUG is defined, and per module unless the
+ * module's flag is set as well (CAN_DEBUG for Can, REALTIME_DEBUG for Daemon/Emergency).
+ * At run time each module has its own minimum level (setLevel, "setLogLevel" command).
+ */
+namespace rtlog {
+
+enum class Level : uint8_t { Debug = 0, Info, Warn, Error, Off };
+
+enum class Module : uint8_t
+{
+    General = 0,
+    Can,
+    Motor,
+    Robot,
+    Kinematics,
+    Daemon,
+    Emergency,
+    Count
+};
+
+constexpr size_t NUM_MODULES = static_cast<size_t>(Module::Count);
+
+const char* levelName(Level level);
+const char* moduleName(Module module);
+bool parseLevel(const std::string& name, Level& level);
+bool parseModule(const std::string& name, Module& module);
+
+/**
+ * @brief True if records of this level/module are compiled in at all
+ */
+constexpr bool compiledIn(Level level, Module module)
+{
+    if (level != Level::Debug) return true;
+#ifndef DEBUG
+    (void)module;
+    return false;
+#else
+    switch (module) {
+    case Module::Can:
+#ifdef CAN_DEBUG
+        return true;
+#else
+        return false;
+#endif
+    case Module::Daemon:
+    case Module::Emergency:
+#ifdef REALTIME_DEBUG
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return true;
+    }
+#endif
+}
+
+/**
+ * @brief Print an integer argument as hex (0x..)
+ */
+struct Hex { uint64_t value; };
+template <typename T> Hex hex(T v) { return Hex{ static_cast<uint64_t>(v) }; }
+
+/**
+ * @brief One log call, as stored in the ring
+ */
+struct Record
+{
+    static constexpr size_t MAX_ARGS   = 8;
+    static constexpr size_t TEXT_BYTES = 112;   // copies of string arguments
+
+    enum class ArgType : uint8_t { Int, UInt, Double, Bool, Char, Hex, Text };
+
+    struct Arg
+    {
+        ArgType type;
+        union {
+            int64_t  i;
+            uint64_t u;
+            double   d;
+        };
+    };
+
+    const char* format = nullptr;
+    Level  level = Level::Info;
+    Module module = Module::General;
+    uint8_t numArgs = 0;
+    uint8_t textUsed = 0;
+    Arg  args[MAX_ARGS];
+    char text[TEXT_BYTES];
+
+    template <typename T> void add(const T& value);
+    void addText(const char* s, size_t len);
+};
+
+/**
+ * @brief Runtime filter check (one relaxed atomic load)
+ */
+bool enabled(Level level, Module module);
+
+/**
+ * @brief Minimum level for one module, or for every module
+ */
+void setLevel(Module module, Level level);
+void setLevel(Level level);
+Level level(Module module);
+
+/**
+ * @brief Start / stop the background writer. Before start() (and after stop()) records are
+ *        formatted and written by the calling thread.
+ */
+void start();
+void stop();
+
+/**
+ * @brief Records lost because the ring was full
+ */
+uint64_t droppedCount();
+
+// Internal: reserve a slot (nullptr if the ring is full) and publish it once filled
+Record* beginRecord();
+void commitRecord(Record* record);
+
+template <typename... Args>
+void log(Level level, Module module, const char* format, const Args&... args)
+{
+    static_assert(sizeof...(Args) <= Record::MAX_ARGS, "Too many log arguments");
+    if (!enabled(level, module)) return;
+    Record* r = beginRecord();
+    if (!r) return;
+    r->format = format;
+    r->level = level;
+    r->module = module;
+    r->numArgs = 0;
+    r->textUsed = 0;
+    (r->add(args), ...);
+    commitRecord(r);
+}
+
+template <typename T>
+void Record::add(const T& value)
+{
+    using V = std::decay_t<T>;
+    Arg& a = args[numArgs++];
+    if constexpr (std::is_same_v<V, bool>) {
+        a.type = ArgType::Bool;
+        a.u = value ? 1 : 0;
+    } else if constexpr (std::is_same_v<V, char>) {
+        a.type = ArgType::Char;
+        a.u = static_cast<uint8_t>(value);
+    } else if constexpr (std::is_same_v<V, Hex>) {
+        a.type = ArgType::Hex;
+        a.u = value.value;
+    } else if constexpr (std::is_enum_v<V>) {
+        a.type = ArgType::Int;
+        a.i = static_cast<int64_t>(value);
+    } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+        a.type = ArgType::Int;
+        a.i = value;
+    } else if constexpr (std::is_integral_v<V>) {
+        a.type = ArgType::UInt;
+        a.u = value;
+    } else if constexpr (std::is_floating_point_v<V>) {
+        a.type = ArgType::Double;
+        a.d = static_cast<double>(value);
+    } else if constexpr (std::is_same_v<V, std::string> || std::is_same_v<V, std::string_view>) {
+        numArgs--;
+        addText(value.data(), value.size());
+    } else {
+        static_assert(std::is_convertible_v<V, const char*>, "Unsupported log argument type");
+        numArgs--;
+        const char* s = value;
+        if constexpr (!std::is_array_v<T>) {
+            if (!s) s = "(null)";
+        }
+        addText(s, std::strlen(s));
+    }
+}
+
+inline void Record::addText(const char* s, size_t len)
+{
+    // Strings are copied (the caller's buffer may be gone by the time the record is formatted)
+    Arg& a = args[numArgs++];
+    a.type = ArgType::Text;
+    size_t room = TEXT_BYTES - textUsed;
+    if (room <= 1) {
+        // Out of space: point at the last terminator (prints as an empty string)
+        a.u = TEXT_BYTES - 1;
+        text[TEXT_BYTES - 1] = '\0';
+        return;
+    }
+    size_t n = len < room - 1 ? len : room - 1;
+    a.u = textUsed;
+    std::memcpy(text + textUsed, s, n);
+    text[textUsed + n] = '\0';
+    textUsed = static_cast<uint8_t>(textUsed + n + 1);
+}
+
+} // namespace rtlog
+
+#define RTLOG(level, module, ...) \
+    do { \
+        if constexpr (rtlog::compiledIn(level, module)) { \
+            rtlog::log(level, module, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define RTLOG_DEBUG(module, ...) RTLOG(rtlog::Level::Debug, rtlog::Module::module, __VA_ARGS__)
+#define RTLOG_INFO(module, ...)  RTLOG(rtlog::Level::Info,  rtlog::Module::module, __VA_ARGS__)
+#define RTLOG_WARN(module, ...)  RTLOG(rtlog::Level::Warn,  rtlog::Module::module, __VA_ARGS__)
+#define RTLOG_ERROR(module, ...) RTLOG(rtlog::Level::Error, rtlog::Module::module, __VA_ARGS__)
+
+#endif // RT_LOG_HPP
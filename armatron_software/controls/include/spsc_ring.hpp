@@ -0,0 +1,71 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Fixed-capacity single-producer / single-consumer ring buffer.
+ *
+ * Lock-free and allocation-free: push() may only be called from one thread and
+ * pop() from one (other) thread. Capacity must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /**
+     * @brief Producer: copy 'item' into the ring
+     * @return false if the ring is full
+     */
+    bool push(const T& item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_items[head & (Capacity - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consumer: take the oldest item
+     * @return false if the ring is empty
+     */
+    bool pop(T& item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_items[tail & (Capacity - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consumer: drop everything queued so far
+     * @return Number of items dropped
+     */
+    size_t clear()
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+        m_tail.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+    size_t size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    std::array<T, Capacity> m_items {};
+    alignas(64) std::atomic<size_t> m_head { 0 };   // next slot to write (producer)
+    alignas(64) std::atomic<size_t> m_tail { 0 };   // next slot to read (consumer)
+};
+
+#endif // SPSC_RING_HPP
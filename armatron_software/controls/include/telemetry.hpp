@@ -0,0 +1,211 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include "motor_interface.hpp"
+#include "ipc_protocol.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Copy of everything the daemon reports to clients, taken once by the
+ *        control thread. All encoding happens on the I/O thread from this copy,
+ *        so the control loop never touches JSON or socket buffers.
+ */
+struct TelemetrySnapshot
+{
+    uint32_t cycle = 0;
+    MotorState motors[ipc::NUM_MOTORS];
+
+    double diffRollRad  = 0.0;
+    double diffPitchRad = 0.0;
+    double diffRollDeg  = 0.0;
+    double diffPitchDeg = 0.0;
+
+    bool   twinActive = false;
+    double twinJointAnglesDeg[ipc::NUM_MOTORS] = {0.0}; ///< Joints 1-5 [deg], then twin pitch and roll [rad]
+
+    bool   poseValid = false;   ///< false if no subscriber asked for the pose or no URDF is loaded
+    double posePosition[3] = {0.0}; ///< End-effector x, y, z [m]
+    double poseRPY[3] = {0.0};      ///< End-effector roll, pitch, yaw [rad]
+};
+
+namespace telemetry {
+
+/**
+ * @brief Field groups a client can subscribe to. A subscription is any OR of these.
+ */
+enum FieldGroup : uint32_t
+{
+    Positions = 1u << 0, ///< Joint angles [deg] and differential roll/pitch [rad]
+    Speeds    = 1u << 1, ///< Joint speeds [deg/s]
+    Currents  = 1u << 2, ///< Torque currents
+    Health    = 1u << 3, ///< Temperature, bus voltage, error flags
+    Gains     = 1u << 4, ///< Motor PI gains
+    Twin      = 1u << 5, ///< Digital twin joint angles
+    Cartesian = 1u << 6, ///< End-effector pose from forward kinematics
+    AllGroups = (1u << 7) - 1,
+};
+constexpr size_t NUM_FIELD_GROUPS = 7;
+
+/**
+ * @brief Delta-mode settings. A value is left out of a delta frame while it stays
+ *        within its group's threshold of the last keyframe, so the decoded value is
+ *        never further than the threshold from the true one. Integer fields (error
+ *        codes, gains, flags) are always compared exactly.
+ */
+struct DeltaOptions
+{
+    unsigned keyframeInterval = 60; ///< Frames between forced keyframes
+    std::array<float, NUM_FIELD_GROUPS> thresholds = {
+        0.01f,   // positions [deg / rad]
+        0.1f,    // speeds [deg/s]
+        0.01f,   // currents
+        0.5f,    // health: temperature [C], bus voltage [V]
+        0.0f,    // gains (exact)
+        0.01f,   // twin [deg / rad]
+        0.0001f, // cartesian [m / rad]
+    };
+};
+
+/**
+ * @brief What one client wants to receive. Inactive clients get the legacy
+ *        full-state broadcast (motorStates JSON / StateMessage) at the default rate.
+ */
+struct Subscription
+{
+    bool     active  = false;
+    uint32_t groups  = 0;
+    unsigned divider = 1;   ///< Send every 'divider'-th control cycle
+    double   rateHz  = 0.0; ///< Rate asked for in Hz (divider follows control rate changes), 0 if given as a divider
+    bool     delta   = false; ///< Keyframe + change-only frames instead of full frames
+    DeltaOptions deltaOptions;
+};
+
+/**
+ * @brief Map a field group name ("positions", "speeds", "currents", "health",
+ *        "gains", "twin", "cartesian", "all") to its bit(s)
+ * @return false if the name is unknown
+ */
+bool parseFieldGroup(const std::string& name, uint32_t& bits);
+const char* fieldGroupName(FieldGroup group);
+
+/**
+ * @brief Encode the subscribed groups as one newline-terminated JSON line:
+ *        {"type":"telemetry","cycle":N,"positionDeg":[...], ...}
+ *        Per-joint values are arrays indexed by joint (motor 1 first).
+ */
+std::string encodeJson(const TelemetrySnapshot& snap, uint32_t groups);
+
+/**
+ * @brief Encode the subscribed groups as one Telemetry frame. Payload layout:
+ *
+ *     u32 cycle | u32 groups | one section per set bit, in bit order
+ *
+ *  Positions: 7 x f32 joint angle [deg], f32 diff roll [rad], f32 diff pitch [rad]
+ *  Speeds:    7 x f32 [deg/s]
+ *  Currents:  7 x f32 torque current
+ *  Health:    7 x (i8 temperature, u8 error code, u16 reserved, f32 bus voltage)
+ *  Gains:     7 x (u8 angKp, angKi, spdKp, spdKi, iqKp, iqKi)
+ *  Twin:      u8 active, 3 x u8 reserved, 7 x f32 (same order as the JSON twin array)
+ *  Cartesian: u8 valid, 3 x u8 reserved, 3 x f32 position [m], 3 x f32 roll/pitch/yaw [rad]
+ */
+std::string encodeBinary(const TelemetrySnapshot& snap, uint32_t groups);
+
+/**
+ * @brief Names of the flattened delta-mode channels for 'groups', e.g. "positionDeg[1]".
+ *        Index i in a keyframe or delta frame refers to names[i].
+ */
+std::vector<std::string> channelNames(uint32_t groups);
+
+/**
+ * @brief Encodes one subscription's telemetry stream in delta mode.
+ *
+ * The subscribed groups are flattened into float channels (same order as encodeBinary).
+ * A keyframe carries every channel; a delta frame carries only the channels that moved
+ * past their threshold relative to the last keyframe. Deltas are relative to the keyframe,
+ * not to the previous frame, so a client that misses delta frames still decodes the next
+ * one correctly. A keyframe is sent every keyframeInterval frames, or earlier when a delta
+ * would not be smaller than a keyframe.
+ *
+ * Binary payloads (TelemetryKey / TelemetryDelta frames):
+ *
+ *     keyframe: u32 cycle | u32 groups | u16 keyframe seq | u16 count | count x f32 value
+ *     delta:    u32 cycle | u32 groups | u16 keyframe seq | u16 count | count x (u16 index, f32 value)
+ *
+ * JSON lines: {"type":"telemetryKey","cycle":N,"seq":S,"values":[...]} and
+ *             {"type":"telemetryDelta","cycle":N,"seq":S,"idx":[...],"val":[...]}
+ */
+class DeltaEncoder
+{
+public:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    DeltaEncoder(bool binary, uint32_t groups, const DeltaOptions& options);
+
+    /**
+     * @brief Encode the next frame of the stream
+     * @param keyframe Output: true if the returned frame is a keyframe
+     */
+    Buffer encode(const TelemetrySnapshot& snap, bool& keyframe);
+
+    /**
+     * @brief Most recent keyframe, for clients joining mid-stream (null before the first frame)
+     */
+    const Buffer& lastKeyframe() const { return m_lastKeyframe; }
+
+private:
+    bool m_binary;
+    uint32_t m_groups;
+    DeltaOptions m_options;
+    std::vector<float> m_thresholds;   // per channel, negative = exact compare
+    std::vector<float> m_keyValues;    // channel values of the last keyframe
+    std::vector<float> m_current;
+    std::vector<uint16_t> m_changed;
+    Buffer m_lastKeyframe;
+    uint16_t m_keyframeSeq = 0;
+    unsigned m_framesSinceKeyframe = 0;
+};
+
+/**
+ * @brief Reference decoder for binary delta-mode frames
+ */
+class DeltaDecoder
+{
+public:
+    /**
+     * @brief Apply one TelemetryKey or TelemetryDelta payload
+     * @return true if values() now holds a complete, current state. Deltas that
+     *         refer to a keyframe we do not have return false until the next keyframe.
+     */
+    bool apply(ipc::FrameType type, const uint8_t* payload, size_t len);
+
+    const std::vector<float>& values() const { return m_values; }
+    uint32_t groups() const { return m_groups; }
+    uint32_t cycle() const { return m_cycle; }
+    bool synced() const { return m_synced; }
+
+private:
+    std::vector<float> m_keyValues;
+    std::vector<float> m_values;
+    uint32_t m_groups = 0;
+    uint32_t m_cycle = 0;
+    uint16_t m_keyframeSeq = 0;
+    bool m_synced = false;
+};
+
+/**
+ * @brief Legacy motorStates document sent to JSON clients without a subscription
+ */
+std::string encodeLegacyJson(const TelemetrySnapshot& snap);
+
+/**
+ * @brief Legacy State frame sent to binary clients without a subscription
+ */
+std::string encodeLegacyBinary(const TelemetrySnapshot& snap);
+
+} // namespace telemetry
+
+#endif // TELEMETRY_HPP
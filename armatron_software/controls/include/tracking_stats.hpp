@@ -0,0 +1,115 @@
+#ifndef TRACKING_STATS_HPP
+#define TRACKING_STATS_HPP
+
+#include "spsc_ring.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <jsoncpp/json/json.h>
+
+/**
+ * @brief How well one trajectory was followed, per joint, in degrees (joints 6/7 in motor degrees)
+ */
+struct TrackingSummary
+{
+    uint32_t id = 0;                            ///< Trajectories measured since the daemon started
+    bool completed = false;                     ///< Reached Finished; false if stopped or replaced before
+    bool settled = false;                       ///< Every joint ended the settling window within the band
+    double durationS = 0.0;                     ///< First tracked cycle to Finished (or the abort)
+    double settleWindowS = 0.0;                 ///< How long the arm was watched after Finished
+    uint32_t samples = 0;                       ///< Control cycles tracked
+    std::array<double, 7> rmsErrorDeg {};
+    std::array<double, 7> maxErrorDeg {};
+    std::array<double, 7> settlingS {};         ///< Finished -> last time outside the band, -1 = not settled
+    std::array<double, 7> overshootDeg {};      ///< Furthest past the final target in the direction of travel
+    std::array<double, 7> finalErrorDeg {};     ///< Target - position at the end of the settling window
+};
+
+/**
+ * @brief Per-trajectory tracking analytics with constant memory: running sums for the RMS error,
+ *        running maxima, and for settling the last time each joint was outside SETTLE_BAND_DEG.
+ *
+ * A trajectory starts with the first sample() and runs until finish() (Result::Finished - the arm
+ * should now come to rest on 'target') or abort(). After finish(), settle() watches the arm for
+ * SETTLE_WINDOW_S, or until the next trajectory starts, and then the summary is published: logged,
+ * and handed to the I/O thread, which keeps the last HISTORY of them.
+ *
+ * Inputs are in trajectory units; unitsPerDeg converts them (joints 6/7 are raw motor units).
+ * sample() to settle() are control thread only and lock-free; drain(), toJson() and reset() run
+ * on the I/O thread.
+ */
+class TrackingStats
+{
+public:
+    static constexpr double SETTLE_BAND_DEG = 0.2;
+    static constexpr double SETTLE_WINDOW_S = 1.0;
+    static constexpr size_t RING_CAPACITY = 16;
+    static constexpr size_t HISTORY = 100;
+
+    explicit TrackingStats(const std::array<double, 7>& unitsPerDeg);
+
+    /**
+     * @brief Control thread: one tracked cycle (starts a trajectory if none is running)
+     * @param error Setpoint - measured position (pi_controller.position_error)
+     */
+    void sample(const float (&error)[7], const double (&position)[7], double dt);
+
+    /**
+     * @brief Control thread: the trajectory reached Result::Finished; settling towards 'target' begins
+     */
+    void finish(const double (&target)[7]);
+
+    /**
+     * @brief Control thread: the trajectory was stopped before it finished (hold, E-stop, replaced)
+     */
+    void abort();
+
+    /**
+     * @brief Control thread: once per cycle; only does something while settling
+     */
+    void settle(const double (&position)[7], double dt);
+
+    /**
+     * @brief I/O thread: move the summaries published since the last call into the history
+     */
+    void drain();
+
+    /**
+     * @brief I/O thread: {"history": [summary, ...] oldest first, "dropped"}, each summary
+     *        {id, completed, settled, durationS, settleWindowS, samples, joints: [{rmsDeg, maxDeg,
+     *        settlingS, overshootDeg, finalErrorDeg}]}
+     */
+    Json::Value toJson() const;
+
+    /**
+     * @brief I/O thread: forget the history
+     */
+    void reset();
+
+private:
+    enum class Phase : uint8_t { Idle, Tracking, Settling };
+
+    void publish();
+
+    std::array<double, 7> m_unitsPerDeg;
+
+    // Control thread only
+    Phase m_phase = Phase::Idle;
+    TrackingSummary m_current;
+    std::array<double, 7> m_sumSquared {};
+    std::array<double, 7> m_start {};           // position at the first sample [deg]
+    std::array<double, 7> m_target {};         // final target [deg]
+    std::array<double, 7> m_direction {};       // sign of the travel start -> target, 0 = joint did not move
+    std::array<double, 7> m_lastOutside {};     // settling time at which the joint was last outside the band
+    uint32_t m_nextId = 1;
+
+    SpscRing<TrackingSummary, RING_CAPACITY> m_ring;
+    std::atomic<uint64_t> m_dropped { 0 };
+
+    // I/O thread only
+    std::deque<TrackingSummary> m_history;
+};
+
+#endif // TRACKING_STATS_HPP
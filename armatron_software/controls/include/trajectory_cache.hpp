@@ -0,0 +1,94 @@
+#ifndef TRAJECTORY_CACHE_HPP
+#define TRAJECTORY_CACHE_HPP
+
+#include <ruckig/ruckig.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief LRU cache of Ruckig::calculate results, for moves that repeat between fixed poses.
+ *
+ * The key is the planning input quantized: start state, target state and the kinematic limits
+ * (which already include the max speed modifier and any per-segment speed). A lookup only hits
+ * when, on top of that, the cached plan started within START_*_TOLERANCE of the actual start;
+ * the PI loop absorbs the rest. Entries are preallocated, so lookup() and insert() copy into
+ * existing trajectories and never allocate - both run on the control thread.
+ */
+class TrajectoryCache
+{
+public:
+    static constexpr size_t CAPACITY = 32;
+
+    // In degrees (deg/s, deg/s^2); multiplied by the joint's unit scale
+    static constexpr double START_POSITION_QUANTUM = 0.2;
+    static constexpr double START_VELOCITY_QUANTUM = 1.0;
+    static constexpr double START_ACCELERATION_QUANTUM = 10.0;
+    static constexpr double START_POSITION_TOLERANCE = 0.1;
+    static constexpr double START_VELOCITY_TOLERANCE = 0.5;
+    static constexpr double START_ACCELERATION_TOLERANCE = 5.0;
+    static constexpr double TARGET_QUANTUM = 1e-3;   // targets and limits: repeated moves match exactly
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t outOfTolerance = 0;   // key matched, actual start too far from the cached one
+        uint64_t evictions = 0;
+        size_t size = 0;
+    };
+
+    /**
+     * @param unitsPerDeg Trajectory units per degree of each joint (the differential joints are
+     *        planned in raw motor units)
+     */
+    explicit TrajectoryCache(const std::array<double, 7>& unitsPerDeg);
+
+    /**
+     * @brief Copy the cached plan for 'input' into 'out'
+     * @return false on a miss ('out' untouched) or while disabled
+     */
+    bool lookup(const ruckig::InputParameter<7>& input, ruckig::Trajectory<7>& out);
+
+    /**
+     * @brief Remember a plan for 'input', evicting the least recently used one if full
+     */
+    void insert(const ruckig::InputParameter<7>& input, const ruckig::Trajectory<7>& trajectory);
+
+    void clear();
+    void setEnabled(bool enabled);
+    bool enabled() const { return m_enabled; }
+    Stats stats() const;
+
+private:
+    static constexpr size_t KEY_VALUES = 9 * 7;   // start, target and limit triplets per joint
+
+    struct Key
+    {
+        std::array<int64_t, KEY_VALUES> values;
+        uint64_t hash = 0;
+        bool operator==(const Key& other) const { return hash == other.hash && values == other.values; }
+    };
+
+    struct Entry
+    {
+        bool used = false;
+        uint64_t lastUsed = 0;
+        Key key;
+        std::array<double, 7> startPosition {};
+        std::array<double, 7> startVelocity {};
+        std::array<double, 7> startAcceleration {};
+        ruckig::Trajectory<7> trajectory;
+    };
+
+    Key makeKey(const ruckig::InputParameter<7>& input) const;
+    bool startWithinTolerance(const Entry& entry, const ruckig::InputParameter<7>& input) const;
+
+    std::array<double, 7> m_unitsPerDeg;
+    std::array<Entry, CAPACITY> m_entries;
+    uint64_t m_tick = 0;
+    bool m_enabled = true;
+    Stats m_stats;
+};
+
+#endif // TRAJECTORY_CACHE_HPP
@@ -0,0 +1,67 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Single-writer / single-reader triple buffer for "latest value" hand-off.
+ *
+ * The writer fills writeBuffer() and publish()es it; the reader calls update() and then
+ * reads read(). Each side owns one buffer and the third is swapped through an atomic
+ * index, so neither side ever waits, the writer never blocks on a slow reader, and the
+ * reader always sees a complete value (never half of two). Intermediate values the reader
+ * did not pick up are simply overwritten.
+ *
+ * writeBuffer() holds whatever was written two publishes ago, so the writer must fill
+ * every field it publishes.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    /**
+     * @brief Writer: the buffer to fill before publish()
+     */
+    T& writeBuffer() { return m_buffers[m_write]; }
+
+    /**
+     * @brief Writer: make writeBuffer() the latest value
+     */
+    void publish()
+    {
+        uint8_t previous = m_shared.exchange(static_cast<uint8_t>(m_write | FRESH), std::memory_order_acq_rel);
+        m_write = previous & INDEX_MASK;
+    }
+
+    /**
+     * @brief Reader: take the latest published value, if there is a new one
+     * @return false if nothing was published since the last update(); read() is unchanged
+     */
+    bool update()
+    {
+        if ((m_shared.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        uint8_t previous = m_shared.exchange(m_read, std::memory_order_acq_rel);
+        m_read = previous & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * @brief Reader: the value taken by the last successful update()
+     */
+    const T& read() const { return m_buffers[m_read]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4;   // set by publish(), cleared by update()
+
+    std::array<T, 3> m_buffers {};
+    alignas(64) uint8_t m_write = 0;                 // writer only
+    alignas(64) std::atomic<uint8_t> m_shared { 1 }; // the buffer in between, plus FRESH
+    alignas(64) uint8_t m_read = 2;                  // reader only
+};
+
+#endif // TRIPLE_BUFFER_HPP
@@ -1,34 +1,13 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
-// Global Debug Flag
-#ifdef DEBUG
+#include "rt_log.hpp"
 
-    // CAN Debugging
-    #ifdef CAN_DEBUG
-        #define IFCANDEBUG(x) do { x; } while (0)
-    #else
-        #define IFCANDEBUG(x) do {} while (0)
-    #endif
+// Debug output goes through the asynchronous logger (rt_log.hpp): RTLOG_DEBUG records are
+// compiled out unless DEBUG is defined, and per module unless CAN_DEBUG / REALTIME_DEBUG is too.
 
-    // Realtime Debugging
-    #ifdef REALTIME_DEBUG
-        #define IFRTDEBUG(x) do { x; } while (0)
-    #else
-        #define IFRTDEBUG(x) do {} while (0)
-    #endif
-
-    // General Debugging
-    #define IFDEBUG(x) do { x; } while (0)
-
-#else
-    #define IFCANDEBUG(x) do {} while (0)
-    #define IFRTDEBUG(x) do {} while (0)
-    #define IFDEBUG(x) do {} while (0)
-#endif
-
-#define LOG_ERROR(x) std::cerr << "[ERROR] " << x << std::endl;
-#define LOG_WARNING(x) std::cerr << "[WARNING] " << x << std::endl;
-#define LOG_INFO(x) std::cout << "[INFO] " << x << std::endl;
+#define LOG_ERROR(...) RTLOG_ERROR(General, __VA_ARGS__)
+#define LOG_WARNING(...) RTLOG_WARN(General, __VA_ARGS__)
+#define LOG_INFO(...) RTLOG_INFO(General, __VA_ARGS__)
 
 #endif // UTILS_HPP
@@ -1,10 +1,14 @@
 #include "real_time_daemon.hpp"
 #include "can_handler.hpp"
 #include "robot_interface.hpp"
-#include <iostream>
+#include "rt_log.hpp"
+#include <cstdlib>
 
 int main()
 {
+    // Log records from the real-time threads are written by a background thread
+    rtlog::start();
+
     try {
         // Bring up can0 externally:
         // sudo ip link set can0 type can bitrate 500000
@@ -16,12 +20,34 @@ int main()
         // 2) RobotInterface with up to 7 motors
         RobotInterface robot(can, "../web/dist/models/urdf/armatron.urdf");
 
-        // 3) RealTimeDaemon
-        RealTimeDaemon daemon(robot);
+        // 3) RealTimeDaemon, at ARMATRON_CONTROL_RATE_HZ if set (default 200 Hz)
+        unsigned int controlRateHz = control_rate::DEFAULT_HZ;
+        if (const char* rate = std::getenv("ARMATRON_CONTROL_RATE_HZ")) {
+            controlRateHz = static_cast<unsigned int>(std::strtoul(rate, nullptr, 10));
+        }
+        RealTimeDaemon daemon(robot, controlRateHz);
+
+        // Precompiled motions for "playMotion": ARMATRON_MOTION_LIBRARY=<file>; clients can load another later
+        if (const char* path = std::getenv("ARMATRON_MOTION_LIBRARY")) {
+            std::string error;
+            if (!daemon.loadMotionLibrary(path, error)) {
+                RTLOG_ERROR(General, "[main_realtime] Motion library not loaded: {}", error);
+            }
+        }
+
+        // Control thread scheduling: ARMATRON_RT_POLICY=deadline|fifo|other (default fifo)
+        rt::ThreadConfig rtConfig;
+        if (const char* policy = std::getenv("ARMATRON_RT_POLICY")) {
+            if (!rt::parseSchedPolicy(policy, rtConfig.policy)) {
+                RTLOG_WARN(General, "[main_realtime] Unknown ARMATRON_RT_POLICY '{}', using {}", policy,
+                           rt::schedPolicyName(rtConfig.policy));
+            }
+        }
+        daemon.setRtConfig(rtConfig);
         daemon.start();
 
         // Wait until Ctrl+C or kill
-        std::cout << "[main_realtime] Running. Press Ctrl+C to exit.\n";
+        RTLOG_INFO(General, "[main_realtime] Running. Press Ctrl+C to exit.");
         while(true) {
             std::this_thread::sleep_for(std::chrono::seconds(10));
         }
@@ -30,8 +56,10 @@ int main()
         daemon.stop();
     } 
     catch (std::exception &ex) {
-        std::cerr << "Exception: " << ex.what() << std::endl;
+        RTLOG_ERROR(General, "Exception: {}", ex.what());
+        rtlog::stop();
         return 1;
     }
+    rtlog::stop();
     return 0;
 }
@@ -1,19 +1,56 @@
 #include "can_handler.hpp"
 #include <stdexcept>
 #include <cstring>
-#include <iostream>
+#include <cstdio>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
-#include "utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include "rt_log.hpp"
 
+namespace
+{
+// "0x01, 0xA2, ..." for debug records
+void formatBytes(const uint8_t* data, size_t count, char* out, size_t size)
+{
+    size_t len = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < count && len < size; ++i) {
+        len += snprintf(out + len, size - len, i + 1 < count ? "0x%X, " : "0x%X", data[i]);
+    }
+}
+
+// Motor commands that only read state (0x30 PID, 0x33 accel, 0x90/0x92/0x94 encoder and
+// angles, 0x9A/0x9C/0x9D states); everything else changes what a motor does
+bool isStateRead(uint8_t command)
+{
+    switch (command) {
+    case 0x30: case 0x33: case 0x90: case 0x92: case 0x94: case 0x9A: case 0x9C: case 0x9D:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Egress probe for command latency tracing, per sending thread
+thread_local bool t_probeArmed = false;
+thread_local std::chrono::steady_clock::time_point t_probeHit;
+
+void noteEgress(uint8_t command)
+{
+    if (t_probeArmed && t_probeHit == std::chrono::steady_clock::time_point{} && !isStateRead(command)) {
+        t_probeHit = std::chrono::steady_clock::now();
+    }
+}
+}
 
 CANHandler::CANHandler(const std::string& interface_name)
     : m_socket_fd(-1)
 {
     // Create raw CAN socket
     m_socket_fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
-    IFCANDEBUG(std::cout << "[CANHandler][DEBUG] Socket created: " << m_socket_fd << "\n");
+    RTLOG_DEBUG(Can, "[CANHandler][DEBUG] Socket created: {}", m_socket_fd);
     if (m_socket_fd < 0) {
         throw std::runtime_error("[CANHandler] Failed to open CAN socket");
     }
@@ -26,7 +63,7 @@ CANHandler::CANHandler(const std::string& interface_name)
         close(m_socket_fd);
         throw std::runtime_error("[CANHandler] Failed to get IF index for " + interface_name);
     }
-    IFCANDEBUG(std::cout << "[CANHandler][DEBUG] Interface index obtained: " << m_ifr.ifr_ifindex << "\n");
+    RTLOG_DEBUG(Can, "[CANHandler][DEBUG] Interface index obtained: {}", m_ifr.ifr_ifindex);
 
     std::memset(&m_addr, 0, sizeof(m_addr));
     m_addr.can_family = AF_CAN;
@@ -37,33 +74,68 @@ CANHandler::CANHandler(const std::string& interface_name)
         close(m_socket_fd);
         throw std::runtime_error("[CANHandler] Failed to bind CAN socket to " + interface_name);
     }
-    IFCANDEBUG(std::cout << "[CANHandler][DEBUG] Socket bound to interface " << interface_name << "\n");
+    RTLOG_DEBUG(Can, "[CANHandler][DEBUG] Socket bound to interface {}", interface_name);
 
     struct timeval tv;
     tv.tv_sec = 0;        // 0 seconds
     tv.tv_usec = 10000;   // 10 milliseconds timeout
 
-    IFCANDEBUG(std::cout << "[CANHandler][DEBUG] Setting socket receive timeout\n");
+    RTLOG_DEBUG(Can, "[CANHandler][DEBUG] Setting socket receive timeout");
     if (setsockopt(m_socket_fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv)) < 0) {
-        std::cerr << "[CANHandler][ERROR] Failed to set socket receive timeout.\n";
+        RTLOG_ERROR(Can, "[CANHandler][ERROR] Failed to set socket receive timeout.");
     }
 }
 
 CANHandler::~CANHandler()
 {
-    IFCANDEBUG(std::cout << "[CANHandler][DEBUG] Destructor called. Closing socket.\n");
+    RTLOG_DEBUG(Can, "[CANHandler][DEBUG] Destructor called. Closing socket.");
     if (m_socket_fd >= 0) {
         close(m_socket_fd);
     }
 }
 
-bool CANHandler::sendMessage(int can_id, uint8_t command, const std::vector<uint8_t>& data)
+bool CANHandler::sendMessage(int can_id, uint8_t command, const CanPayload& data)
 {
     if (m_socket_fd < 0) {
-        std::cerr << "[CANHandler] Socket not open.\n";
+        RTLOG_ERROR(Can, "[CANHandler] Socket not open.");
+        return false;
+    }
+
+    struct can_frame frame = makeFrame(can_id, command, data);
+    if constexpr (rtlog::compiledIn(rtlog::Level::Debug, rtlog::Module::Can)) {
+        char bytes[64];
+        formatBytes(frame.data + 1, 7, bytes, sizeof(bytes));
+        RTLOG_DEBUG(Can, "[CANHandler][DEBUG] Sending CAN message: ID={}, Command={}, Data=[{}]",
+                    can_id & 0x7FF, rtlog::hex(command), bytes);
+    }
+
+    // Write the frame
+    ssize_t nbytes = write(m_socket_fd, &frame, sizeof(frame));
+    RTLOG_DEBUG(Can, "[CANHandler][DEBUG] write() returned {}", nbytes);
+    if (nbytes != static_cast<ssize_t>(sizeof(frame))) {
+        return false;
+    }
+    noteEgress(command);
+    return true;
+}
+
+void CANHandler::armEgressProbe()
+{
+    t_probeArmed = true;
+    t_probeHit = {};
+}
+
+bool CANHandler::egressSince(std::chrono::steady_clock::time_point& sentAt)
+{
+    if (!t_probeArmed || t_probeHit == std::chrono::steady_clock::time_point{}) {
         return false;
     }
+    sentAt = t_probeHit;
+    return true;
+}
 
+struct can_frame CANHandler::makeFrame(int can_id, uint8_t command, const CanPayload& data)
+{
     struct can_frame frame;
     std::memset(&frame, 0, sizeof(frame));
 
@@ -77,50 +149,69 @@ bool CANHandler::sendMessage(int can_id, uint8_t command, const std::vector<uint
     // The first data byte is the command
     frame.data[0] = command;
 
-    // Copy up to 7 bytes from 'data' into frame.data[1..7].
-    const size_t maxCopy = 7; // since data[0] is command
-    const size_t toCopy = (data.size() < maxCopy) ? data.size() : maxCopy;
-    if (toCopy > 0) {
-        std::memcpy(&frame.data[1], data.data(), toCopy);
-    }
-    IFCANDEBUG(
-        std::cout << "[CANHandler][DEBUG] Sending CAN message: ID=" << (can_id & 0x7FF) 
-                  << ", Command=0x" << std::hex << static_cast<int>(command) << std::dec
-                  << ", Data=[";
-        for (size_t i = 0; i < 7; ++i) {
-            std::cout << "0x" << std::hex << static_cast<int>(frame.data[i+1]) << std::dec;
-            if (i < 6) std::cout << ", ";
+    // The 7 payload bytes go into frame.data[1..7]
+    std::memcpy(&frame.data[1], data.data(), data.size());
+    return frame;
+}
+
+size_t CANHandler::sendFrames(const struct can_frame* frames, size_t count)
+{
+    if (m_socket_fd < 0) {
+        RTLOG_ERROR(Can, "[CANHandler] Socket not open.");
+        return 0;
+    }
+
+    constexpr size_t MAX_BATCH = 16;
+    struct iovec iov[MAX_BATCH];
+    struct mmsghdr msgs[MAX_BATCH];
+
+    size_t sent = 0;
+    int retries = 0;
+    while (sent < count) {
+        size_t batch = std::min(count - sent, MAX_BATCH);
+        std::memset(msgs, 0, sizeof(msgs[0]) * batch);
+        for (size_t i = 0; i < batch; ++i) {
+            iov[i].iov_base = const_cast<struct can_frame*>(&frames[sent + i]);
+            iov[i].iov_len = sizeof(struct can_frame);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
         }
-        std::cout << "]\n"
-    );
 
-    // Write the frame
-    ssize_t nbytes = write(m_socket_fd, &frame, sizeof(frame));
-    IFCANDEBUG(std::cout << "[CANHandler][DEBUG] write() returned " << nbytes << "\n");
-    return (nbytes == static_cast<ssize_t>(sizeof(frame)));
+        int n = sendmmsg(m_socket_fd, msgs, static_cast<unsigned int>(batch), 0);
+        if (n < 0) {
+            // ENOBUFS: TX queue full. Retry a few times rather than dropping a stop frame.
+            if ((errno == ENOBUFS || errno == EAGAIN || errno == EINTR) && retries++ < 100) {
+                continue;
+            }
+            RTLOG_ERROR(Can, "[CANHandler] sendmmsg failed: {}", strerror(errno));
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    if (sent > 0) {
+        noteEgress(frames[0].data[0]);
+    }
+    RTLOG_DEBUG(Can, "[CANHandler][DEBUG] sendFrames sent {}/{} frames", sent, count);
+    return sent;
 }
 
-
 bool CANHandler::receiveMessage(struct can_frame& frame)
 {
     if (m_socket_fd < 0) {
-        std::cerr << "[CANHandler] Socket not open.\n";
+        RTLOG_ERROR(Can, "[CANHandler] Socket not open.");
         return false;
     }
 
     ssize_t nbytes = read(m_socket_fd, &frame, sizeof(frame));
-    IFCANDEBUG(
+    if constexpr (rtlog::compiledIn(rtlog::Level::Debug, rtlog::Module::Can)) {
         if (nbytes == static_cast<ssize_t>(sizeof(frame))) {
-            std::cout << "[CANHandler][DEBUG] Received CAN message: ID=" << (frame.can_id & 0x7FF)
-                      << ", Data=[";
-            for (int i = 0; i < frame.can_dlc; ++i) {
-                std::cout << "0x" << std::hex << static_cast<int>(frame.data[i]) << std::dec;
-                if (i < frame.can_dlc - 1) std::cout << ", ";
-            }
-            std::cout << "]\n";
+            char bytes[64];
+            formatBytes(frame.data, frame.can_dlc, bytes, sizeof(bytes));
+            RTLOG_DEBUG(Can, "[CANHandler][DEBUG] Received CAN message: ID={}, Data=[{}]",
+                        frame.can_id & 0x7FF, bytes);
         } else {
-            std::cout << "[CANHandler][DEBUG] read() returned " << nbytes << "\n";
+            RTLOG_DEBUG(Can, "[CANHandler][DEBUG] read() returned {}", nbytes);
         }
-    );
+    }
     return (nbytes == static_cast<ssize_t>(sizeof(frame)));
 }
@@ -0,0 +1,117 @@
+#include "client_connection.hpp"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+bool parseSlowConsumerPolicy(const std::string& name, SlowConsumerPolicy& policy)
+{
+    if (name == "dropOldest") {
+        policy = SlowConsumerPolicy::DropOldest;
+    } else if (name == "coalesce") {
+        policy = SlowConsumerPolicy::CoalesceLatest;
+    } else if (name == "disconnect") {
+        policy = SlowConsumerPolicy::Disconnect;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* slowConsumerPolicyName(SlowConsumerPolicy policy)
+{
+    switch (policy) {
+    case SlowConsumerPolicy::DropOldest:     return "dropOldest";
+    case SlowConsumerPolicy::CoalesceLatest: return "coalesce";
+    case SlowConsumerPolicy::Disconnect:     return "disconnect";
+    }
+    return "unknown";
+}
+
+ClientConnection::ClientConnection(int fd, size_t maxQueuedMessages, SlowConsumerPolicy policy)
+    : m_fd(fd)
+    , m_maxQueuedMessages(maxQueuedMessages > 0 ? maxQueuedMessages : 1)
+    , m_policy(policy)
+{
+}
+
+ClientConnection::~ClientConnection()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool ClientConnection::enqueue(Buffer msg, MessageKind kind)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    if (kind == MessageKind::Control) {
+        if (m_outQueue.size() >= CONTROL_QUEUE_HARD_LIMIT) {
+            return false;
+        }
+        m_outQueue.push_back(QueuedMessage{ std::move(msg), kind, now });
+    } else if (m_policy == SlowConsumerPolicy::CoalesceLatest) {
+        // Replace the newest unsent state frame, so at most one snapshot is ever waiting
+        for (size_t i = m_outQueue.size(); i-- > firstUnsentIndex(); ) {
+            if (m_outQueue[i].kind == MessageKind::State) {
+                m_outQueue[i].data = std::move(msg);
+                m_outQueue[i].queuedAt = now;
+                m_stats.coalescedMessages++;
+                return true;
+            }
+        }
+        m_outQueue.push_back(QueuedMessage{ std::move(msg), kind, now });
+    } else {
+        if (m_outQueue.size() >= m_maxQueuedMessages) {
+            if (m_policy == SlowConsumerPolicy::Disconnect) {
+                return false;
+            }
+            // DropOldest: discard the oldest state frame that has not started going out
+            bool dropped = false;
+            for (size_t i = firstUnsentIndex(); i < m_outQueue.size(); ++i) {
+                if (m_outQueue[i].kind == MessageKind::State) {
+                    m_outQueue.erase(m_outQueue.begin() + i);
+                    dropped = true;
+                    break;
+                }
+            }
+            m_stats.droppedMessages++;
+            if (!dropped) {
+                return true; // Queue is all control replies; drop the new frame instead
+            }
+        }
+        m_outQueue.push_back(QueuedMessage{ std::move(msg), kind, now });
+    }
+
+    m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, m_outQueue.size());
+    return true;
+}
+
+std::chrono::microseconds ClientConnection::lag(std::chrono::steady_clock::time_point now) const
+{
+    if (m_outQueue.empty()) return std::chrono::microseconds(0);
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - m_outQueue.front().queuedAt);
+}
+
+ClientConnection::FlushResult ClientConnection::flush()
+{
+    while (!m_outQueue.empty()) {
+        const std::string& msg = *m_outQueue.front().data;
+        // MSG_NOSIGNAL: a client that went away must not SIGPIPE the daemon
+        ssize_t written = send(m_fd, msg.data() + m_outOffset, msg.size() - m_outOffset, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return FlushResult::WouldBlock;
+            if (errno == EINTR) continue;
+            return FlushResult::Error;
+        }
+        m_outOffset += static_cast<size_t>(written);
+        m_stats.sentBytes += static_cast<uint64_t>(written);
+        if (m_outOffset == msg.size()) {
+            m_stats.sentMessages++;
+            m_outQueue.pop_front();
+            m_outOffset = 0;
+        }
+    }
+    return FlushResult::Done;
+}
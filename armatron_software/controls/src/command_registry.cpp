@@ -0,0 +1,772 @@
+#include "command_registry.hpp"
+#include "control_rate.hpp"
+#include "io_commands.hpp"
+#include "routine.hpp"
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include "rt_log.hpp"
+
+namespace
+{
+using commands::ArgSpec;
+using commands::ArgType;
+using commands::CommandArgs;
+using commands::CommandContext;
+using commands::CommandHandler;
+using commands::CommandSpec;
+using commands::IoCommandHandler;
+using ipc::Opcode;
+
+constexpr double I16_MIN = -32768.0;
+constexpr double I16_MAX = 32767.0;
+constexpr double U16_MAX = 65535.0;
+constexpr double I32_MIN = -2147483648.0;
+constexpr double I32_MAX = 2147483647.0;
+constexpr double U8_MAX  = 255.0;
+
+constexpr ArgSpec intArg(const char* name, double defaultValue, double min, double max, int8_t binSlot = -1)
+{
+    ArgSpec a;
+    a.name = name;
+    a.type = ArgType::Int;
+    a.defaultValue = defaultValue;
+    a.min = min;
+    a.max = max;
+    a.binSlot = binSlot;
+    return a;
+}
+
+constexpr ArgSpec requiredIntArg(const char* name, double min, double max)
+{
+    ArgSpec a = intArg(name, 0, min, max);
+    a.required = true;
+    return a;
+}
+
+constexpr ArgSpec floatArg(const char* name, double min, double max, int8_t binSlot = -1)
+{
+    ArgSpec a;
+    a.name = name;
+    a.type = ArgType::Float;
+    a.required = true;
+    a.min = min;
+    a.max = max;
+    a.binSlot = binSlot;
+    return a;
+}
+
+constexpr ArgSpec optionalFloatArg(const char* name, double defaultValue, double min, double max, int8_t binSlot = -1)
+{
+    ArgSpec a = floatArg(name, min, max, binSlot);
+    a.required = false;
+    a.defaultValue = defaultValue;
+    return a;
+}
+
+constexpr ArgSpec arrayArg(const char* name, size_t minLen, size_t maxLen, int8_t binSlot, int8_t binLenSlot = -1)
+{
+    ArgSpec a;
+    a.name = name;
+    a.type = ArgType::FloatArray;
+    a.required = true;
+    a.min = static_cast<double>(minLen);
+    a.max = static_cast<double>(maxLen);
+    a.binSlot = binSlot;
+    a.binLenSlot = binLenSlot;
+    return a;
+}
+
+constexpr ArgSpec optionalArrayArg(const char* name, size_t minLen, size_t maxLen)
+{
+    ArgSpec a = arrayArg(name, minLen, maxLen, -1);
+    a.required = false;
+    return a;
+}
+
+constexpr ArgSpec boolArg(const char* name, bool defaultValue)
+{
+    ArgSpec a;
+    a.name = name;
+    a.type = ArgType::Bool;
+    a.defaultValue = defaultValue ? 1.0 : 0.0;
+    a.max = 1.0;
+    return a;
+}
+
+constexpr ArgSpec stringArg(const char* name, bool required = false)
+{
+    ArgSpec a;
+    a.name = name;
+    a.type = ArgType::String;
+    a.required = required;
+    return a;
+}
+
+constexpr ArgSpec jsonArg(const char* name, bool required = false)
+{
+    ArgSpec a;
+    a.name = name;
+    a.type = ArgType::Json;
+    a.required = required;
+    return a;
+}
+
+constexpr CommandSpec command(std::string_view name, Opcode opcode, uint8_t flags, CommandHandler handler,
+                              const char* description, std::initializer_list<ArgSpec> args = {})
+{
+    CommandSpec spec;
+    spec.name = name;
+    spec.opcode = static_cast<uint16_t>(opcode);
+    spec.flags = flags;
+    spec.handler = handler;
+    spec.description = description;
+    size_t k = 0;
+    for (const ArgSpec& a : args) spec.args[k++] = a;
+    return spec;
+}
+
+constexpr CommandSpec ioCommand(std::string_view name, IoCommandHandler handler, const char* description,
+                                std::initializer_list<ArgSpec> args = {})
+{
+    CommandSpec spec = command(name, static_cast<Opcode>(0), commands::IoThread, nullptr, description, args);
+    spec.ioHandler = handler;
+    return spec;
+}
+
+static_assert(commands::MAX_ARRAY_LEN == std::tuple_size<JointValues>::value, "Array arguments are copied into JointValues");
+
+constexpr Opcode JSON_ONLY = static_cast<Opcode>(0);
+constexpr uint8_t MOTOR = commands::NeedsMotor;
+constexpr uint8_t ROBOT = 0;
+constexpr uint8_t URGENT = commands::HighPriority;
+
+// The writePID_* commands share their schema: angKp, angKi, spdKp, spdKi, iqKp, iqKi
+#define PID_ARGS { intArg("angKp", 100, 0, U8_MAX), intArg("angKi", 50, 0, U8_MAX), \
+                   intArg("spdKp", 50, 0, U8_MAX),  intArg("spdKi", 20, 0, U8_MAX), \
+                   intArg("iqKp", 50, 0, U8_MAX),   intArg("iqKi", 50, 0, U8_MAX) }
+
+/**********************************************************/
+/* Command table - add new commands here                  */
+/**********************************************************/
+constexpr CommandSpec COMMANDS[] = {
+    command("motorOn", Opcode::MotorOn, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->motorOn(); },
+        "Motor on (0x88)"),
+    command("motorOff", Opcode::MotorOff, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->motorOff(); },
+        "Motor off (0x80)"),
+    command("motorStop", Opcode::MotorStop, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->motorStop(); },
+        "Motor stop (0x81)"),
+    command("setHoldPosition", Opcode::SetHoldPosition, URGENT,
+        [](CommandContext& c, const CommandArgs&) { c.robot.setHoldPosition(); },
+        "Cancel the trajectory and command speed 0 on all motors"),
+    command("setESTOP", Opcode::SetESTOP, URGENT,
+        [](CommandContext& c, const CommandArgs&) { c.robot.setESTOP(); },
+        "Cancel the trajectory and stop all motors"),
+    command("openLoopControl", Opcode::OpenLoopControl, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->openLoopControl(static_cast<int16_t>(a.i(0))); },
+        "Open loop power (0xA0)",
+        { intArg("powerControl", 0, I16_MIN, I16_MAX, 0) }),
+    command("setTorque", Opcode::SetTorque, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->setTorque(static_cast<int16_t>(a.i(0))); },
+        "Torque closed loop (0xA1)",
+        { intArg("value", 0, I16_MIN, I16_MAX, 0) }),
+    command("setSpeed", Opcode::SetSpeed, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->setSpeed(static_cast<int32_t>(a.i(0))); },
+        "Speed closed loop (0xA2)",
+        { intArg("value", 0, I32_MIN, I32_MAX, 0) }),
+    command("setMultiAngle", Opcode::SetMultiAngle, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->setMultiAngle(a.i(0)); },
+        "Multi-turn angle (0xA3)",
+        { intArg("value", 0, I32_MIN, I32_MAX, 0) }),
+    command("setMultiAngleWithSpeed", Opcode::SetMultiAngleWithSpeed, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->setMultiAngleWithSpeed(a.i(0), static_cast<uint16_t>(a.i(1))); },
+        "Multi-turn angle with speed limit (0xA4)",
+        { intArg("angle", 0, I32_MIN, I32_MAX, 0), intArg("maxSpeed", 0, 0, U16_MAX, 1) }),
+    command("setSingleAngle", Opcode::SetSingleAngle, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->setSingleAngle(static_cast<uint8_t>(a.i(0)), a.i(1)); },
+        "Single-turn angle (0xA5)",
+        { intArg("spinDirection", 0, 0, 1, 0), intArg("angle", 0, I32_MIN, I32_MAX, 1) }),
+    command("setSingleAngleWithSpeed", Opcode::SetSingleAngleWithSpeed, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) {
+            RTLOG_INFO(Daemon, "[RealTimeDaemon] Received setSingleAngleWithSpeed | Spin: {} | Angle: {}", a.i(0), a.i(1));
+            c.motor->setSingleAngleWithSpeed(static_cast<uint8_t>(a.i(0)), a.i(1), static_cast<uint16_t>(a.i(2)));
+        },
+        "Single-turn angle with speed limit (0xA6)",
+        { intArg("spinDirection", 0, 0, 1, 0), intArg("angle", 0, I32_MIN, I32_MAX, 1), intArg("maxSpeed", 0, 0, U16_MAX, 2) }),
+    command("setIncrementAngle", Opcode::SetIncrementAngle, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->setIncrementAngle(a.i(0)); },
+        "Incremental angle (0xA7)",
+        { intArg("incAngle", 0, I32_MIN, I32_MAX, 0) }),
+    command("setIncrementAngleWithSpeed", Opcode::SetIncrementAngleWithSpeed, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->setIncrementAngleWithSpeed(a.i(0), static_cast<uint16_t>(a.i(1))); },
+        "Incremental angle with speed limit (0xA8)",
+        { intArg("incAngle", 0, I32_MIN, I32_MAX, 0), intArg("maxSpeed", 0, 0, U16_MAX, 1) }),
+    command("setMultiJointAngles", Opcode::SetMultiJointAngles, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            // Only command joints that have both an angle and a speed
+            size_t n = std::min(a.arrayLen[0], a.arrayLen[1]);
+            JointValues angles;
+            JointValues speeds;
+            std::copy(a.array[0], a.array[0] + commands::MAX_ARRAY_LEN, angles.begin());
+            std::copy(a.array[1], a.array[1] + commands::MAX_ARRAY_LEN, speeds.begin());
+            c.robot.setMultiJointAngles(angles, speeds, n);
+        },
+        "Joint angles [deg] and speeds for joints 1..n",
+        { arrayArg("angles", 1, commands::MAX_ARRAY_LEN, 0, 0), arrayArg("speeds", 1, commands::MAX_ARRAY_LEN, 7, 0) }),
+    command("setDifferentialAngles", Opcode::SetDifferentialAngles, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            RTLOG_INFO(Daemon, "[RealTimeDaemon] setDifferentialAngles: roll={} rad, pitch={} rad, maxSpeed={} deg/s",
+                       a.d(0), a.d(1), a.d(2));
+            c.robot.setDifferentialAngles(a.d(0), a.d(1), a.d(2));
+        },
+        "Wrist roll/pitch [rad] with motor speed limit [deg/s]",
+        { floatArg("roll", -10.0, 10.0, 0), floatArg("pitch", -10.0, 10.0, 1), floatArg("maxSpeed", 0.0, 100000.0, 2) }),
+    command("moveToJointPositionRuckig", Opcode::MoveToJointPositionRuckig, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            std::array<double, 7> target_positions;
+            for (size_t i = 0; i < target_positions.size(); ++i) {
+                target_positions[i] = a.array[0][i];
+            }
+
+            // Log the command for debugging
+            RTLOG_INFO(Daemon, "[RealTimeDaemon] moveToJointPositionRuckig: [{}, {}, {}, {}, {}, {}, {}] degrees",
+                       target_positions[0], target_positions[1], target_positions[2], target_positions[3],
+                       target_positions[4], target_positions[5], target_positions[6]);
+
+            c.robot.moveToJointPosition(target_positions);
+        },
+        "Jerk-limited trajectory to 7 joint targets [deg]",
+        { arrayArg("angles", 7, 7, 0) }),
+    command("queueWaypoint", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            JointWaypoint waypoint;
+            std::copy(a.array[0], a.array[0] + waypoint.position.size(), waypoint.position.begin());
+            waypoint.velocityCount = a.arrayLen[1];
+            std::copy(a.array[1], a.array[1] + waypoint.velocityCount, waypoint.velocity.begin());
+            c.robot.queueWaypoint(waypoint);
+        },
+        "Append a waypoint (7 joint targets [deg], optional pass-through speeds of joints 1..5 [deg/s]); "
+        "queued waypoints are passed through without stopping",
+        { arrayArg("angles", 7, 7, -1), optionalArrayArg("velocities", 1, 5) }),
+    command("clearWaypoints", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs&) { c.robot.clearWaypoints(); },
+        "Drop the queued waypoints and stop at the current segment's target"),
+    command("setTrajectoryMode", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            c.robot.setTrajectoryMode(a.i(0) ? TrajectoryMode::PlanOnce : TrajectoryMode::Online, a.d(1));
+        },
+        "Follow moves online (0) or plan once and replan on tracking error (1), from the next move",
+        { intArg("planOnce", 1, 0, 1), optionalFloatArg("replanThresholdDeg", 5.0, 0.1, 90.0) }),
+    command("playMotion", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) { c.robot.playMotion(static_cast<size_t>(a.i(0))); },
+        "Play a clip of the motion library (index from listMotions); no planning, replaces the active move",
+        { intArg("index", 0, 0, 65535) }),
+    command("setFeedOverride", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) { c.robot.setFeedOverride(a.d(0)); },
+        "Run the active and later moves at this fraction of their planned speed (0 = pause, up to 2); "
+        "ramps smoothly, no replanning",
+        { floatArg("scale", 0.0, RobotInterface::MAX_FEED_OVERRIDE) }),
+    command("setJointGains", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            // joint 0 = all; a negative gain keeps the current value
+            size_t first = a.i(0) == 0 ? 0 : static_cast<size_t>(a.i(0) - 1);
+            size_t last = a.i(0) == 0 ? 7 : first + 1;
+            for (size_t j = first; j < last; ++j) {
+                JointGains g = c.robot.jointGains(j);
+                if (a.d(1) >= 0.0) g.kp = static_cast<float>(a.d(1));
+                if (a.d(2) >= 0.0) g.ki = static_cast<float>(a.d(2));
+                if (a.d(3) >= 0.0) g.kv = static_cast<float>(a.d(3));
+                if (a.d(4) >= 0.0) g.ka = static_cast<float>(a.d(4));
+                if (a.d(5) >= 0.0) g.maxIntegral = static_cast<float>(a.d(5));
+                c.robot.setJointGains(j, g);
+            }
+        },
+        "Tune the joint tracking controller of one joint (1-7) or all (0): kp, ki, velocity and acceleration "
+        "feedforward, integral limit, in motor degrees; omitted gains are unchanged",
+        { intArg("joint", 0, 0, 7), optionalFloatArg("kp", -1.0, -1.0, 1000.0),
+          optionalFloatArg("ki", -1.0, -1.0, 1000.0), optionalFloatArg("kv", -1.0, -1.0, 2.0),
+          optionalFloatArg("ka", -1.0, -1.0, 1.0), optionalFloatArg("maxIntegral", -1.0, -1.0, 1000.0) }),
+    command("startRecording", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs&) { c.robot.startRecording(); },
+        "Record the arm's joint positions and speeds at 200 Hz (move it by hand or by commands); "
+        "replaces the last recording"),
+    command("stopRecording", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs&) { c.robot.stopRecording(); },
+        "Stop recording; then saveRecording or compileRecording"),
+    command("setTrajectoryCache", JSON_ONLY, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            c.robot.setTrajectoryCacheEnabled(a.i(0) != 0);
+            if (a.i(1)) c.robot.clearTrajectoryCache();
+        },
+        "Reuse the plans of repeated moves (1) or plan every move from scratch (0); clear=1 empties the cache",
+        { intArg("enabled", 1, 0, 1), intArg("clear", 0, 0, 1) }),
+    command("setMaxSpeedModifier", Opcode::SetMaxSpeedModifier, ROBOT,
+        [](CommandContext& c, const CommandArgs& a) {
+            RTLOG_INFO(Daemon, "[RealTimeDaemon] setMaxSpeedModifier: {}", a.d(0));
+            c.robot.setMaxSpeedModifier(static_cast<float>(a.d(0)));
+        },
+        "Scale all joint speed limits (0..1)",
+        { floatArg("modifier", 0.0, 1.0, 0) }),
+    command("syncSingleAndMulti", Opcode::SyncSingleAndMulti, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->clearMultiLoopAngle(); },
+        "Clear the multi-turn angle so it matches the single-turn angle"),
+    command("readPID", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readPID(); },
+        "Read PI gains (0x30)"),
+    command("writePID_RAM", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) {
+            c.motor->writePID_RAM(static_cast<uint8_t>(a.i(0)), static_cast<uint8_t>(a.i(1)), static_cast<uint8_t>(a.i(2)),
+                                  static_cast<uint8_t>(a.i(3)), static_cast<uint8_t>(a.i(4)), static_cast<uint8_t>(a.i(5)));
+        },
+        "Write PI gains to RAM (0x31)", PID_ARGS),
+    command("writePID_ROM", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) {
+            c.motor->writePID_ROM(static_cast<uint8_t>(a.i(0)), static_cast<uint8_t>(a.i(1)), static_cast<uint8_t>(a.i(2)),
+                                  static_cast<uint8_t>(a.i(3)), static_cast<uint8_t>(a.i(4)), static_cast<uint8_t>(a.i(5)));
+        },
+        "Write PI gains to ROM (0x32)", PID_ARGS),
+    command("readAcceleration", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readAcceleration(); },
+        "Read acceleration (0x33)"),
+    command("writeAcceleration", Opcode::WriteAcceleration, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->writeAcceleration(a.i(0)); },
+        "Write acceleration (0x34)",
+        { intArg("accel", 0, I32_MIN, I32_MAX, 0) }),
+    command("readEncoder", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readEncoder(); },
+        "Read encoder (0x90)"),
+    command("writeEncoderOffset", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs& a) { c.motor->writeEncoderOffset(static_cast<uint16_t>(a.i(0))); },
+        "Write encoder offset (0x91)",
+        { intArg("offset", 0, 0, U16_MAX) }),
+    command("writeCurrentPosAsZero", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->writeCurrentPosAsZero(); },
+        "Write current position to ROM as zero (0x19)"),
+    command("readMultiAngle", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readMultiAngle(); },
+        "Read multi-turn angle (0x92)"),
+    command("readSingleAngle", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readSingleAngle(); },
+        "Read single-turn angle (0x94)"),
+    command("clearAngle", JSON_ONLY, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->clearAngle(); },
+        "Clear motor angle (0x95)"),
+    command("readState1_Error", Opcode::ReadState1_Error, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readState1_Error(); },
+        "Read temperature, voltage and error flags (0x9A)"),
+    command("clearError", Opcode::ClearError, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->clearError(); },
+        "Clear error flags (0x9B)"),
+    command("readState2", Opcode::ReadState2, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readState2(); },
+        "Read temperature, current, speed, encoder (0x9C)"),
+    command("readState3", Opcode::ReadState3, MOTOR,
+        [](CommandContext& c, const CommandArgs&) { c.motor->readState3(); },
+        "Read phase currents (0x9D)"),
+
+    // Answered on the I/O thread (IoCommands, real_time_daemon.cpp)
+    ioCommand("setClientPolicy", &IoCommands::setClientPolicy,
+        "Slow-consumer policy of this connection (drop, coalesce, disconnect) and its outbound queue bound; "
+        "omitted settings are unchanged",
+        { stringArg("policy"), intArg("maxQueue", 0, 0, 100000) }),
+    ioCommand("getClientStats", &IoCommands::getClientStats, "Queue depth, lag and drop counters of every client"),
+    ioCommand("subscribe", &IoCommands::subscribe,
+        "Telemetry subscription: field groups, rate (divider of the control rate, or rateHz), optional delta "
+        "encoding with keyframeInterval and per-group thresholds",
+        { jsonArg("fields"), intArg("divider", 0, 1, 100000), optionalFloatArg("rateHz", 0.0, 0.0, 10000.0),
+          boolArg("delta", false), intArg("keyframeInterval", 0, 1, 100000), jsonArg("thresholds") }),
+    ioCommand("unsubscribe", &IoCommands::unsubscribe, "Back to the default motorStates broadcast"),
+    ioCommand("listCommands", &IoCommands::listCommands, "Every command with its argument schema"),
+    ioCommand("getRobotState", &IoCommands::getRobotState, "Coherent snapshot of the last completed control cycle"),
+    ioCommand("getLoopStats", &IoCommands::getLoopStats,
+        "Control loop phase timings, overruns, dropped commands and the real-time thread setup"),
+    ioCommand("setOverrunPolicy", &IoCommands::setOverrunPolicy,
+        "What an overrunning control loop does (catchUp, skip, shed, downrate); omitted settings are unchanged",
+        { stringArg("policy"), intArg("downrateAfter", 10, 1, 1000000), intArg("recoverAfter", 1000, 1, 1000000) }),
+    ioCommand("setControlRate", &IoCommands::setControlRate,
+        "Control loop rate; takes effect once no trajectory is running",
+        { requiredIntArg("rateHz", control_rate::MIN_HZ, control_rate::MAX_HZ) }),
+    ioCommand("setLogLevel", &IoCommands::setLogLevel, "Log level, of every module or of one",
+        { stringArg("level", true), stringArg("module") }),
+    ioCommand("getEstopStats", &IoCommands::getEstopStats, "Emergency channel latency against its budget"),
+    ioCommand("getCommandLatency", &IoCommands::getCommandLatency,
+        "Per command: parse, queue, execute, egress and total (recv -> first CAN frame) latency histograms"),
+    ioCommand("exportCommandTrace", &IoCommands::exportCommandTrace,
+        "Write the recent command traces for ui.perfetto.dev or chrome://tracing", { stringArg("path") }),
+    ioCommand("resetCommandLatency", &IoCommands::resetCommandLatency, "Forget the command latency histograms"),
+    ioCommand("getTrackingStats", &IoCommands::getTrackingStats,
+        "RMS/max tracking error, settling time and overshoot per joint of the recent trajectories"),
+    ioCommand("resetTrackingStats", &IoCommands::resetTrackingStats, "Forget the tracking statistics history"),
+    ioCommand("uploadRoutine", &IoCommands::uploadRoutine,
+        "Run a list of joint or pose waypoints (see parseRoutine); replace stops a running routine instead of "
+        "rejecting the upload",
+        { stringArg("name"), optionalFloatArg("speed", 1.0, JointWaypoint::MIN_SPEED, 1.0),
+          optionalFloatArg("dwell", 0.0, 0.0, Routine::MAX_DWELL_S), jsonArg("waypoints", true),
+          boolArg("replace", false) }),
+    ioCommand("stopRoutine", &IoCommands::stopRoutine, "Stop the routine; the active segment still ends on its waypoint"),
+    ioCommand("getRoutineStatus", &IoCommands::getRoutineStatus, "State and progress of the routine"),
+    ioCommand("listMotions", &IoCommands::listMotions, "Clips of the motion library, by the index playMotion takes"),
+    ioCommand("loadMotionLibrary", &IoCommands::loadMotionLibrary,
+        "Load a motion library file; adopted once no clip is playing", { stringArg("path") }),
+    ioCommand("saveRecording", &IoCommands::saveRecording, "Write the stopped recording to a file",
+        { stringArg("path") }),
+    ioCommand("compileRecording", &IoCommands::compileRecording,
+        "Compile the stopped recording (or a saved one) into a clip of the motion library; limit slows it down "
+        "to the joint limits",
+        { stringArg("name", true), stringArg("recording"), stringArg("library"),
+          optionalFloatArg("timeScale", 1.0, 0.01, 100.0), optionalFloatArg("smoothingS", 0.05, 0.0, 10.0),
+          boolArg("limit", true) }),
+    ioCommand("compilePath", &IoCommands::compilePath,
+        "Time-optimal clip along a spline through the waypoints (as uploadRoutine), stored in the motion library",
+        { stringArg("name", true), stringArg("library"), optionalFloatArg("speed", 1.0, JointWaypoint::MIN_SPEED, 1.0),
+          jsonArg("waypoints", true) }),
+};
+#undef PID_ARGS
+
+constexpr size_t NUM_COMMANDS = std::size(COMMANDS);
+
+/**********************************************************/
+/* Compile-time lookup tables                             */
+/**********************************************************/
+constexpr uint32_t hashName(std::string_view name)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (char c : name) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr size_t NAME_TABLE_SIZE = 256;  // power of two, at least twice the number of commands
+constexpr uint8_t EMPTY_SLOT = 0xFF;
+static_assert(NAME_TABLE_SIZE >= 2 * NUM_COMMANDS, "Grow NAME_TABLE_SIZE to keep lookups short");
+
+struct NameTable
+{
+    uint8_t slots[NAME_TABLE_SIZE] = {};
+    size_t maxProbe = 0;   // longest probe sequence of any command, bounds every lookup
+};
+
+constexpr NameTable buildNameTable()
+{
+    NameTable table;
+    for (auto& s : table.slots) s = EMPTY_SLOT;
+    for (size_t i = 0; i < NUM_COMMANDS; ++i) {
+        size_t h = hashName(COMMANDS[i].name) & (NAME_TABLE_SIZE - 1);
+        size_t probe = 0;
+        while (table.slots[h] != EMPTY_SLOT) {
+            h = (h + 1) & (NAME_TABLE_SIZE - 1);
+            probe++;
+        }
+        table.slots[h] = static_cast<uint8_t>(i);
+        if (probe > table.maxProbe) table.maxProbe = probe;
+    }
+    return table;
+}
+
+constexpr bool namesAndOpcodesUnique()
+{
+    for (size_t i = 0; i < NUM_COMMANDS; ++i) {
+        for (size_t j = i + 1; j < NUM_COMMANDS; ++j) {
+            if (COMMANDS[i].name == COMMANDS[j].name) return false;
+            if (COMMANDS[i].opcode != 0 && COMMANDS[i].opcode == COMMANDS[j].opcode) return false;
+        }
+    }
+    return true;
+}
+static_assert(namesAndOpcodesUnique(), "Duplicate command name or opcode in COMMANDS");
+static_assert(NUM_COMMANDS < EMPTY_SLOT, "Command indices must fit the lookup tables");
+
+// Control-thread commands get POD arguments only (they are queued); I/O-thread ones are JSON only
+constexpr bool handlersMatchThreads()
+{
+    for (const CommandSpec& spec : COMMANDS) {
+        bool io = (spec.flags & commands::IoThread) != 0;
+        if (io ? (spec.ioHandler == nullptr || spec.opcode != 0) : spec.handler == nullptr) return false;
+        for (size_t k = 0; !io && k < spec.argCount(); ++k) {
+            if (spec.args[k].type == ArgType::String || spec.args[k].type == ArgType::Json) return false;
+        }
+    }
+    return true;
+}
+static_assert(handlersMatchThreads(), "Command with a handler for the wrong thread, or String/Json args on a queued command");
+
+constexpr size_t OPCODE_TABLE_SIZE = 256;
+
+struct OpcodeTable
+{
+    uint8_t slots[OPCODE_TABLE_SIZE] = {};
+};
+
+constexpr OpcodeTable buildOpcodeTable()
+{
+    OpcodeTable table;
+    for (auto& s : table.slots) s = EMPTY_SLOT;
+    for (size_t i = 0; i < NUM_COMMANDS; ++i) {
+        if (COMMANDS[i].opcode != 0 && COMMANDS[i].opcode < OPCODE_TABLE_SIZE) {
+            table.slots[COMMANDS[i].opcode] = static_cast<uint8_t>(i);
+        }
+    }
+    return table;
+}
+
+constexpr NameTable NAME_TABLE = buildNameTable();
+constexpr OpcodeTable OPCODE_TABLE = buildOpcodeTable();
+
+const char* argTypeName(ArgType type)
+{
+    switch (type) {
+    case ArgType::Int:        return "int";
+    case ArgType::Float:      return "float";
+    case ArgType::FloatArray: return "float[]";
+    case ArgType::Bool:       return "bool";
+    case ArgType::String:     return "string";
+    case ArgType::Json:       return "json";
+    }
+    return "unknown";
+}
+
+bool checkMotorId(int motorId, std::string& error)
+{
+    if (motorId < 1 || motorId > static_cast<int>(ipc::NUM_MOTORS)) {
+        error = "motorID " + std::to_string(motorId) + " out of range";
+        return false;
+    }
+    return true;
+}
+
+bool checkScalar(const ArgSpec& a, double x, std::string& error)
+{
+    // Written so NaN fails too
+    if (!(x >= a.min && x <= a.max)) {
+        error = std::string(a.name) + " out of range [" + std::to_string(a.min) + ", " + std::to_string(a.max) + "]";
+        return false;
+    }
+    return true;
+}
+
+bool checkLength(const ArgSpec& a, size_t len, std::string& error)
+{
+    if (len < static_cast<size_t>(a.min) || len > static_cast<size_t>(a.max)) {
+        error = std::string(a.name) + " must have " + std::to_string(static_cast<size_t>(a.min)) + ".."
+              + std::to_string(static_cast<size_t>(a.max)) + " elements";
+        return false;
+    }
+    return true;
+}
+}
+
+namespace commands {
+
+const CommandSpec* find(std::string_view name)
+{
+    size_t h = hashName(name) & (NAME_TABLE_SIZE - 1);
+    for (size_t probe = 0; probe <= NAME_TABLE.maxProbe; ++probe) {
+        uint8_t slot = NAME_TABLE.slots[h];
+        if (slot == EMPTY_SLOT) return nullptr;
+        if (COMMANDS[slot].name == name) return &COMMANDS[slot];
+        h = (h + 1) & (NAME_TABLE_SIZE - 1);
+    }
+    return nullptr;
+}
+
+const CommandSpec* find(ipc::Opcode opcode)
+{
+    auto op = static_cast<uint16_t>(opcode);
+    if (op == 0 || op >= OPCODE_TABLE_SIZE || OPCODE_TABLE.slots[op] == EMPTY_SLOT) return nullptr;
+    return &COMMANDS[OPCODE_TABLE.slots[op]];
+}
+
+size_t count()
+{
+    return NUM_COMMANDS;
+}
+
+size_t index(const CommandSpec& spec)
+{
+    return static_cast<size_t>(&spec - COMMANDS);
+}
+
+const CommandSpec& at(size_t index)
+{
+    return COMMANDS[index];
+}
+
+bool parseJson(const CommandSpec& spec, const Json::Value& root, CommandArgs& args, std::string& error)
+{
+    if (spec.flags & NeedsMotor) {
+        const Json::Value& id = root["motorID"];
+        if (!id.isNull() && !id.isIntegral()) {
+            error = "motorID must be an integer";
+            return false;
+        }
+        args.motorId = id.isNull() ? 1 : id.asInt();
+        if (!checkMotorId(args.motorId, error)) return false;
+    }
+
+    for (size_t k = 0; k < spec.argCount(); ++k) {
+        const ArgSpec& a = spec.args[k];
+        const Json::Value& v = root[a.name];
+        if (v.isNull()) {
+            if (a.required) {
+                error = std::string("missing ") + a.name;
+                return false;
+            }
+            args.value[k] = a.defaultValue;
+            continue;
+        }
+
+        if (a.type == ArgType::FloatArray) {
+            if (!v.isArray()) {
+                error = std::string(a.name) + " must be an array";
+                return false;
+            }
+            if (!checkLength(a, v.size(), error)) return false;
+            for (Json::ArrayIndex j = 0; j < v.size(); ++j) {
+                if (!v[j].isNumeric()) {
+                    error = std::string(a.name) + " must contain numbers";
+                    return false;
+                }
+                args.array[k][j] = v[j].asFloat();
+            }
+            args.arrayLen[k] = static_cast<uint8_t>(v.size());
+        } else if (a.type == ArgType::Bool) {
+            if (!v.isBool()) {
+                error = std::string(a.name) + " must be true or false";
+                return false;
+            }
+            args.value[k] = v.asBool() ? 1.0 : 0.0;
+        } else if (a.type == ArgType::String) {
+            if (!v.isString()) {
+                error = std::string(a.name) + " must be a string";
+                return false;
+            }
+        } else if (a.type == ArgType::Json) {
+            continue;   // the handler checks the contents
+        } else {
+            if (!v.isNumeric()) {
+                error = std::string(a.name) + " must be a number";
+                return false;
+            }
+            double x = v.asDouble();
+            if (!checkScalar(a, x, error)) return false;
+            args.value[k] = x;
+        }
+    }
+    return true;
+}
+
+bool parseBinary(const CommandSpec& spec, const ipc::CommandMessage& msg, CommandArgs& args, std::string& error)
+{
+    constexpr int NUM_INT_SLOTS = sizeof(msg.i) / sizeof(msg.i[0]);
+    constexpr int NUM_FLOAT_SLOTS = sizeof(msg.f) / sizeof(msg.f[0]);
+
+    if (spec.flags & NeedsMotor) {
+        args.motorId = msg.motorId;
+        if (!checkMotorId(args.motorId, error)) return false;
+    }
+
+    for (size_t k = 0; k < spec.argCount(); ++k) {
+        const ArgSpec& a = spec.args[k];
+        if (a.binSlot < 0) {
+            args.value[k] = a.defaultValue;
+            continue;
+        }
+
+        if (a.type == ArgType::FloatArray) {
+            size_t len = a.binLenSlot >= 0 ? static_cast<size_t>(std::max(msg.i[a.binLenSlot], 0))
+                                           : static_cast<size_t>(a.max);
+            if (!checkLength(a, len, error)) return false;
+            if (a.binSlot + len > static_cast<size_t>(NUM_FLOAT_SLOTS)) {
+                error = std::string(a.name) + " does not fit the binary message";
+                return false;
+            }
+            for (size_t j = 0; j < len; ++j) {
+                args.array[k][j] = msg.f[a.binSlot + j];
+            }
+            args.arrayLen[k] = static_cast<uint8_t>(len);
+        } else {
+            double x = (a.type == ArgType::Int)
+                     ? (a.binSlot < NUM_INT_SLOTS ? static_cast<double>(msg.i[a.binSlot]) : a.defaultValue)
+                     : (a.binSlot < NUM_FLOAT_SLOTS ? static_cast<double>(msg.f[a.binSlot]) : a.defaultValue);
+            if (!checkScalar(a, x, error)) return false;
+            args.value[k] = x;
+        }
+    }
+    return true;
+}
+
+void execute(const CommandSpec& spec, RobotInterface& robot, const CommandArgs& args)
+{
+    // Only motor commands resolve a motor, robot-level commands never fail on motorID
+    Motor* motor = (spec.flags & NeedsMotor) ? &robot.getMotor(args.motorId) : nullptr;
+    CommandContext ctx{ robot, motor };
+    spec.handler(ctx, args);
+}
+
+void executeIo(const CommandSpec& spec, RealTimeDaemon& daemon, ClientConnection& client, const Json::Value& request,
+               const CommandArgs& args)
+{
+    IoCommandContext ctx{ daemon, client, request, spec };
+    spec.ioHandler(ctx, args);
+}
+
+bool IoCommandContext::has(size_t k) const
+{
+    return k < spec.argCount() && request.isMember(spec.args[k].name);
+}
+
+std::string IoCommandContext::text(size_t k, const std::string& fallback) const
+{
+    return has(k) ? request[spec.args[k].name].asString() : fallback;
+}
+
+const Json::Value& IoCommandContext::json(size_t k) const
+{
+    static const Json::Value null;
+    return has(k) ? request[spec.args[k].name] : null;
+}
+
+Json::Value describe()
+{
+    Json::Value list(Json::arrayValue);
+    for (const CommandSpec& spec : COMMANDS) {
+        Json::Value c;
+        c["name"] = std::string(spec.name);
+        c["description"] = spec.description;
+        c["motor"] = (spec.flags & NeedsMotor) != 0;
+        c["ioThread"] = (spec.flags & IoThread) != 0;
+        c["highPriority"] = (spec.flags & HighPriority) != 0;
+        if (spec.opcode != 0) {
+            c["opcode"] = spec.opcode;
+        }
+        c["args"] = Json::Value(Json::arrayValue);
+        for (size_t k = 0; k < spec.argCount(); ++k) {
+            const ArgSpec& a = spec.args[k];
+            Json::Value arg;
+            arg["name"] = a.name;
+            arg["type"] = argTypeName(a.type);
+            arg["required"] = a.required;
+            if (a.type == ArgType::FloatArray) {
+                arg["minLength"] = static_cast<int>(a.min);
+                arg["maxLength"] = static_cast<int>(a.max);
+            } else if (a.type == ArgType::Bool) {
+                if (!a.required) arg["default"] = a.defaultValue != 0.0;
+            } else if (a.type != ArgType::String && a.type != ArgType::Json) {
+                arg["min"] = a.min;
+                arg["max"] = a.max;
+                if (!a.required) arg["default"] = a.defaultValue;
+            }
+            c["args"].append(arg);
+        }
+        list.append(c);
+    }
+    return list;
+}
+
+} // namespace commands
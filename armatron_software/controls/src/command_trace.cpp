@@ -0,0 +1,199 @@
+#include "command_trace.hpp"
+#include "command_registry.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+namespace
+{
+const char* SEGMENT_NAMES[] = { "parse", "queue", "execute", "egress", "total" };
+
+// Cycles drawn behind one trace at most, however long the command sat in the queue
+constexpr uint32_t MAX_CYCLES_PER_TRACE = 64;
+
+// Chrome trace lanes (tid), one per stage
+enum Lane : int { CycleLane = 1, IoLane, QueueLane, ControlLane, CanLane };
+
+int64_t toNs(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+Json::Value laneName(int tid, const char* name)
+{
+    Json::Value e;
+    e["name"] = "thread_name";
+    e["ph"] = "M";
+    e["pid"] = 1;
+    e["tid"] = tid;
+    e["args"]["name"] = name;
+    return e;
+}
+}
+
+const char* traceHopName(TraceHop hop)
+{
+    switch (hop) {
+    case TraceHop::Received:  return "received";
+    case TraceHop::Queued:    return "queued";
+    case TraceHop::Dequeued:  return "dequeued";
+    case TraceHop::Executed:  return "executed";
+    case TraceHop::CanEgress: return "canEgress";
+    case TraceHop::Count:     break;
+    }
+    return "unknown";
+}
+
+void CommandTracer::record(const CommandTrace& trace)
+{
+    if (!m_ring.push(trace)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void CommandTracer::drain()
+{
+    if (m_perCommand.empty()) {
+        m_perCommand.resize(commands::count());
+    }
+
+    CommandTrace trace;
+    while (m_ring.pop(trace)) {
+        if (trace.command >= m_perCommand.size()) continue;
+        auto& entry = m_perCommand[trace.command];
+        if (!entry) {
+            entry = std::make_unique<PerCommand>();
+        }
+        PerCommand& pc = *entry;
+        pc.count++;
+
+        auto segment = [&](Segment s, TraceHop from, TraceHop to) {
+            if (trace.reached(from) && trace.reached(to)) {
+                pc.segments[s].record(static_cast<uint64_t>(std::max<int64_t>(0, toNs(trace[to] - trace[from]))));
+            }
+        };
+        segment(Parse, TraceHop::Received, TraceHop::Queued);
+        segment(Queue, TraceHop::Queued, TraceHop::Dequeued);
+        segment(Execute, TraceHop::Dequeued, TraceHop::Executed);
+        segment(Egress, TraceHop::Executed, TraceHop::CanEgress);
+        segment(Total, TraceHop::Received, TraceHop::CanEgress);
+        if (!trace.reached(TraceHop::CanEgress)) {
+            pc.noEgress++;
+        }
+
+        m_recent.push_back(trace);
+        if (m_recent.size() > EXPORT_WINDOW) {
+            m_recent.pop_front();
+        }
+    }
+}
+
+Json::Value CommandTracer::toJson() const
+{
+    Json::Value root;
+    root["commands"] = Json::Value(Json::objectValue);
+    for (size_t i = 0; i < m_perCommand.size(); ++i) {
+        if (!m_perCommand[i]) continue;
+        const PerCommand& pc = *m_perCommand[i];
+        Json::Value& j = root["commands"][std::string(commands::at(i).name)];
+        j["count"] = static_cast<Json::UInt64>(pc.count);
+        j["noEgress"] = static_cast<Json::UInt64>(pc.noEgress);
+        for (size_t s = 0; s < NUM_SEGMENTS; ++s) {
+            j[SEGMENT_NAMES[s]] = pc.segments[s].snapshot().toJson();
+        }
+    }
+    root["dropped"] = static_cast<Json::UInt64>(m_dropped.load(std::memory_order_relaxed));
+    return root;
+}
+
+std::vector<CommandTrace> CommandTracer::recent() const
+{
+    return { m_recent.begin(), m_recent.end() };
+}
+
+bool CommandTracer::exportChromeTrace(const std::vector<CommandTrace>& traces, const std::string& path, std::string& error)
+{
+    Json::Value events(Json::arrayValue);
+    events.append(laneName(CycleLane, "control cycles"));
+    events.append(laneName(IoLane, "I/O thread (parse)"));
+    events.append(laneName(QueueLane, "inbound queue"));
+    events.append(laneName(ControlLane, "control thread (execute)"));
+    events.append(laneName(CanLane, "until CAN egress"));
+
+    if (!traces.empty()) {
+        // Microseconds since the oldest trace; keeps the numbers readable in the viewer
+        auto origin = traces.front().cycleStart;
+        for (const CommandTrace& t : traces) {
+            origin = std::min(origin, t.reached(TraceHop::Received) ? t[TraceHop::Received] : t.cycleStart);
+        }
+        auto us = [&](std::chrono::steady_clock::time_point tp) { return toNs(tp - origin) / 1000.0; };
+
+        auto span = [&](const CommandTrace& t, int tid, const char* name, TraceHop from, TraceHop to) {
+            if (!t.reached(from) || !t.reached(to)) return;
+            Json::Value e;
+            e["name"] = name;
+            e["cat"] = std::string(commands::at(t.command).name);
+            e["ph"] = "X";
+            e["pid"] = 1;
+            e["tid"] = tid;
+            e["ts"] = us(t[from]);
+            e["dur"] = std::max(0.0, us(t[to]) - us(t[from]));
+            e["args"]["command"] = std::string(commands::at(t.command).name);
+            e["args"]["cycle"] = t.cycle;
+            events.append(e);
+        };
+
+        // Every cycle a command waited through, so queueing shows up against the cycle boundaries
+        std::set<uint32_t> cyclesShown;
+        for (const CommandTrace& t : traces) {
+            if (t.command >= commands::count()) continue;
+            span(t, IoLane, "parse", TraceHop::Received, TraceHop::Queued);
+            span(t, QueueLane, "queue", TraceHop::Queued, TraceHop::Dequeued);
+            span(t, ControlLane, "execute", TraceHop::Dequeued, TraceHop::Executed);
+            span(t, CanLane, "egress", TraceHop::Executed, TraceHop::CanEgress);
+
+            if (t.periodNs <= 0) continue;
+            auto waitedFrom = t.reached(TraceHop::Received) ? t[TraceHop::Received] : t.cycleStart;
+            for (uint32_t k = 0; k <= t.cycle && k < MAX_CYCLES_PER_TRACE; ++k) {
+                auto start = t.cycleStart - std::chrono::nanoseconds(t.periodNs * k);
+                if (k > 0 && start + std::chrono::nanoseconds(t.periodNs) <= waitedFrom) break;
+                if (!cyclesShown.insert(t.cycle - k).second) continue;
+                Json::Value e;
+                e["name"] = "cycle " + std::to_string(t.cycle - k);
+                e["ph"] = "X";
+                e["pid"] = 1;
+                e["tid"] = CycleLane;
+                e["ts"] = us(start);
+                e["dur"] = t.periodNs / 1000.0;
+                events.append(e);
+            }
+        }
+    }
+
+    Json::Value root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        error = "cannot open " + path;
+        return false;
+    }
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    out << Json::writeString(builder, root);
+    if (!out.good()) {
+        error = "write to " + path + " failed";
+        return false;
+    }
+    return true;
+}
+
+void CommandTracer::reset()
+{
+    drain();
+    m_perCommand.clear();
+    m_recent.clear();
+    m_dropped.store(0, std::memory_order_relaxed);
+}
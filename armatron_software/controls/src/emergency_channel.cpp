@@ -0,0 +1,209 @@
+#include "emergency_channel.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "rt_log.hpp"
+
+const char* emergencyActionName(EmergencyAction action)
+{
+    switch (action) {
+    case EmergencyAction::None: return "none";
+    case EmergencyAction::Stop: return "stop";
+    case EmergencyAction::Hold: return "hold";
+    }
+    return "unknown";
+}
+
+EmergencyChannel::EmergencyChannel(RobotInterface& robot, const std::string& socketPath)
+    : m_robot(robot)
+    , m_socketPath(socketPath)
+{
+}
+
+EmergencyChannel::~EmergencyChannel()
+{
+    stop();
+}
+
+void EmergencyChannel::start()
+{
+    ::unlink(m_socketPath.c_str());
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+        throw std::runtime_error("[EmergencyChannel] Failed to create socket");
+    }
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, m_socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(m_listenFd, 4) < 0) {
+        close(m_listenFd);
+        m_listenFd = -1;
+        throw std::runtime_error("[EmergencyChannel] Failed to bind/listen on " + m_socketPath);
+    }
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_running = true;
+    m_thread = std::thread(&EmergencyChannel::threadFunc, this);
+    RTLOG_INFO(Emergency, "[EmergencyChannel] Listening on {} (latency budget {} us)", m_socketPath, LATENCY_BUDGET_US);
+}
+
+void EmergencyChannel::stop()
+{
+    if (!m_running) return;
+    m_running = false;
+
+    uint64_t one = 1;
+    ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+    (void)ignored;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    close(m_listenFd);
+    close(m_wakeFd);
+    m_listenFd = -1;
+    m_wakeFd = -1;
+    ::unlink(m_socketPath.c_str());
+}
+
+bool EmergencyChannel::trigger(EmergencyAction action, std::chrono::steady_clock::time_point received, double& latencyUs)
+{
+    bool ok = (action == EmergencyAction::Hold) ? m_robot.sendHoldBurst() : m_robot.sendStopBurst();
+    auto sent = std::chrono::steady_clock::now();
+
+    // Stop wins over hold if both are pending
+    uint8_t requested = static_cast<uint8_t>(action);
+    uint8_t current = m_pending.load();
+    while (current != static_cast<uint8_t>(EmergencyAction::Stop) && !m_pending.compare_exchange_weak(current, requested)) {}
+
+    uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(sent - received).count());
+    m_count++;
+    m_lastNs = ns;
+    m_totalNs += ns;
+    uint64_t prevMax = m_maxNs.load();
+    while (ns > prevMax && !m_maxNs.compare_exchange_weak(prevMax, ns)) {}
+    if (!ok) m_failed++;
+
+    double us = ns / 1000.0;
+    latencyUs = us;
+    if (us > LATENCY_BUDGET_US) {
+        m_overBudget++;
+        RTLOG_WARN(Emergency, "[EmergencyChannel] {} took {} us, over the {} us budget",
+                   emergencyActionName(action), us, LATENCY_BUDGET_US);
+    }
+    if (!ok) {
+        RTLOG_ERROR(Emergency, "[EmergencyChannel] {} burst was not fully sent!", emergencyActionName(action));
+    }
+    // Logging happens after the burst so it never adds to the measured path
+    RTLOG_INFO(Emergency, "[EmergencyChannel] {} sent in {} us", emergencyActionName(action), us);
+    return ok;
+}
+
+EmergencyStats EmergencyChannel::stats() const
+{
+    EmergencyStats st;
+    st.count = m_count;
+    st.overBudget = m_overBudget;
+    st.failed = m_failed;
+    st.lastUs = m_lastNs / 1000.0;
+    st.maxUs = m_maxNs / 1000.0;
+    st.meanUs = st.count > 0 ? (m_totalNs / 1000.0) / st.count : 0.0;
+    return st;
+}
+
+void EmergencyChannel::threadFunc()
+{
+    // Best effort: run just below the control loop so a busy I/O thread cannot delay an ESTOP
+    sched_param param{};
+    param.sched_priority = EMERGENCY_THREAD_PRIORITY;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        RTLOG_WARN(Emergency, "[EmergencyChannel] Warning: running without real-time priority");
+    }
+
+    std::vector<pollfd> fds;
+    fds.push_back(pollfd{ m_listenFd, POLLIN, 0 });
+    fds.push_back(pollfd{ m_wakeFd, POLLIN, 0 });
+
+    while (m_running) {
+        int n = poll(fds.data(), fds.size(), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            RTLOG_ERROR(Emergency, "[EmergencyChannel] poll error: {}", strerror(errno));
+            break;
+        }
+
+        // Clients first: a request must not wait behind an accept
+        for (size_t i = 2; i < fds.size(); ) {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (!handleClient(fds[i].fd)) {
+                    close(fds[i].fd);
+                    fds.erase(fds.begin() + i);
+                    continue;
+                }
+            }
+            ++i;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int clientFd;
+            while ((clientFd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                if (fds.size() - 2 >= MAX_CLIENTS) {
+                    RTLOG_ERROR(Emergency, "[EmergencyChannel] Too many clients, rejecting FD={}", clientFd);
+                    close(clientFd);
+                    continue;
+                }
+                fds.push_back(pollfd{ clientFd, POLLIN, 0 });
+                RTLOG_DEBUG(Emergency, "[EmergencyChannel][DEBUG] Accepted client FD={}", clientFd);
+            }
+        }
+    }
+
+    for (size_t i = 2; i < fds.size(); ++i) {
+        close(fds[i].fd);
+    }
+}
+
+bool EmergencyChannel::handleClient(int fd)
+{
+    char buf[64];
+    while (true) {
+        ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        auto received = std::chrono::steady_clock::now();
+        if (r == 0) return false;
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+
+        // Act on the most severe request in the read; one burst is enough for a batch of presses
+        EmergencyAction action = EmergencyAction::None;
+        for (ssize_t i = 0; i < r; ++i) {
+            if (buf[i] == 'E' || buf[i] == 'S') {
+                action = EmergencyAction::Stop;
+            } else if (buf[i] == 'H' && action == EmergencyAction::None) {
+                action = EmergencyAction::Hold;
+            }
+        }
+        if (action == EmergencyAction::None) continue;
+
+        double us = 0.0;
+        bool ok = trigger(action, received, us);
+
+        char reply[128];
+        int len = std::snprintf(reply, sizeof(reply), "{\"type\":\"estopAck\",\"action\":\"%s\",\"latencyUs\":%.1f,\"ok\":%s}\n",
+                                emergencyActionName(action), us, ok ? "true" : "false");
+        ssize_t ignored = send(fd, reply, static_cast<size_t>(len), MSG_NOSIGNAL | MSG_DONTWAIT);
+        (void)ignored;
+    }
+}
@@ -0,0 +1,80 @@
+#include "io_worker.hpp"
+
+IoWorker::IoWorker(std::function<void()> notify)
+    : m_notify(std::move(notify))
+{
+}
+
+IoWorker::~IoWorker()
+{
+    stop();
+}
+
+void IoWorker::start()
+{
+    if (m_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_stopping = false;
+    }
+    m_thread = std::thread(&IoWorker::run, this);
+}
+
+void IoWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_wake.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_completions.clear();
+    m_pending = 0;
+}
+
+void IoWorker::post(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_pending++;
+    m_wake.notify_one();
+}
+
+void IoWorker::runCompletions()
+{
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        done.swap(m_completions);
+    }
+    for (Completion& completion : done) {
+        m_pending--;
+        if (completion) completion();
+    }
+}
+
+void IoWorker::run()
+{
+    std::unique_lock<std::mutex> lk(m_mutex);
+    while (true) {
+        m_wake.wait(lk, [this] { return m_stopping || !m_jobs.empty(); });
+        if (m_stopping) return;
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+
+        lk.unlock();
+        Completion completion = job();
+        lk.lock();
+
+        m_completions.push_back(std::move(completion));
+        lk.unlock();
+        m_notify();
+        lk.lock();
+    }
+}
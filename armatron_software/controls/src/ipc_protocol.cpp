@@ -0,0 +1,206 @@
+#include "ipc_protocol.hpp"
+#include <cstring>
+
+namespace
+{
+    // Little-endian writers, same byte order the MG motors use on the CAN bus
+    inline void put16(uint8_t*& p, uint16_t val)
+    {
+        p[0] = static_cast<uint8_t>( val       & 0xFF);
+        p[1] = static_cast<uint8_t>((val >> 8) & 0xFF);
+        p += 2;
+    }
+    inline void put32(uint8_t*& p, uint32_t val)
+    {
+        p[0] = static_cast<uint8_t>( val        & 0xFF);
+        p[1] = static_cast<uint8_t>((val >> 8)  & 0xFF);
+        p[2] = static_cast<uint8_t>((val >> 16) & 0xFF);
+        p[3] = static_cast<uint8_t>((val >> 24) & 0xFF);
+        p += 4;
+    }
+    inline void putFloat(uint8_t*& p, float val)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &val, sizeof(bits));
+        put32(p, bits);
+    }
+
+    inline uint16_t get16(const uint8_t*& p)
+    {
+        uint16_t val = static_cast<uint16_t>(p[0] | (p[1] << 8));
+        p += 2;
+        return val;
+    }
+    inline uint32_t get32(const uint8_t*& p)
+    {
+        uint32_t val = static_cast<uint32_t>(p[0])
+                     | (static_cast<uint32_t>(p[1]) << 8)
+                     | (static_cast<uint32_t>(p[2]) << 16)
+                     | (static_cast<uint32_t>(p[3]) << 24);
+        p += 4;
+        return val;
+    }
+    inline float getFloat(const uint8_t*& p)
+    {
+        uint32_t bits = get32(p);
+        float val;
+        std::memcpy(&val, &bits, sizeof(val));
+        return val;
+    }
+} // end anon
+
+namespace ipc {
+
+bool parseHello(const uint8_t* data, size_t len, uint16_t& version)
+{
+    if (len < HELLO_SIZE || std::memcmp(data, HELLO_MAGIC, sizeof(HELLO_MAGIC)) != 0) {
+        return false;
+    }
+    const uint8_t* p = data + sizeof(HELLO_MAGIC);
+    version = get16(p);
+    return true;
+}
+
+void appendFrame(std::string& out, FrameType type, const uint8_t* payload, size_t len)
+{
+    uint8_t header[FRAME_HEADER_SIZE];
+    uint8_t* p = header;
+    put16(p, static_cast<uint16_t>(len));
+    *p++ = static_cast<uint8_t>(type);
+    *p++ = 0;
+    out.append(reinterpret_cast<const char*>(header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(payload), len);
+}
+
+void appendU8(std::string& out, uint8_t val)
+{
+    out.push_back(static_cast<char>(val));
+}
+
+void appendU16(std::string& out, uint16_t val)
+{
+    uint8_t bytes[2];
+    uint8_t* p = bytes;
+    put16(p, val);
+    out.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+void appendU32(std::string& out, uint32_t val)
+{
+    uint8_t bytes[4];
+    uint8_t* p = bytes;
+    put32(p, val);
+    out.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+void appendFloat(std::string& out, float val)
+{
+    uint8_t bytes[4];
+    uint8_t* p = bytes;
+    putFloat(p, val);
+    out.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+uint16_t readU16(const uint8_t*& p) { return get16(p); }
+uint32_t readU32(const uint8_t*& p) { return get32(p); }
+float readFloat(const uint8_t*& p)  { return getFloat(p); }
+
+void appendHelloAck(std::string& out)
+{
+    uint8_t payload[4];
+    uint8_t* p = payload;
+    put16(p, PROTOCOL_VERSION);
+    *p++ = static_cast<uint8_t>(NUM_MOTORS);
+    *p++ = 0;
+    appendFrame(out, FrameType::HelloAck, payload, sizeof(payload));
+}
+
+void encodeCommand(const CommandMessage& msg, uint8_t* out)
+{
+    uint8_t* p = out;
+    put16(p, msg.opcode);
+    *p++ = msg.motorId;
+    *p++ = msg.reserved;
+    for (int32_t v : msg.i) put32(p, static_cast<uint32_t>(v));
+    for (float v : msg.f)   putFloat(p, v);
+}
+
+bool decodeCommand(const uint8_t* data, size_t len, CommandMessage& msg)
+{
+    if (len != COMMAND_MESSAGE_SIZE) return false;
+    const uint8_t* p = data;
+    msg.opcode   = get16(p);
+    msg.motorId  = *p++;
+    msg.reserved = *p++;
+    for (int32_t& v : msg.i) v = static_cast<int32_t>(get32(p));
+    for (float& v : msg.f)   v = getFloat(p);
+    return true;
+}
+
+void encodeState(const StateMessage& msg, uint8_t* out)
+{
+    uint8_t* p = out;
+    put32(p, msg.cycle);
+    *p++ = msg.numMotors;
+    *p++ = msg.twinActive;
+    put16(p, msg.reserved);
+    putFloat(p, msg.diffRollRad);
+    putFloat(p, msg.diffPitchRad);
+    for (float v : msg.twinJointAnglesDeg) putFloat(p, v);
+    for (const MotorStateRecord& m : msg.motors) {
+        *p++ = static_cast<uint8_t>(m.temperatureC);
+        *p++ = m.errorCode;
+        put16(p, m.encoderVal);
+        put16(p, static_cast<uint16_t>(m.torqueCurrentRaw));
+        put16(p, m.reserved);
+        putFloat(p, m.speedDeg_s);
+        putFloat(p, m.positionDeg_Mapped);
+        putFloat(p, m.multiTurnDeg_Mapped);
+        putFloat(p, m.multiTurnRaw);
+    }
+}
+
+bool decodeState(const uint8_t* data, size_t len, StateMessage& msg)
+{
+    if (len != STATE_MESSAGE_SIZE) return false;
+    const uint8_t* p = data;
+    msg.cycle        = get32(p);
+    msg.numMotors    = *p++;
+    msg.twinActive   = *p++;
+    msg.reserved     = get16(p);
+    msg.diffRollRad  = getFloat(p);
+    msg.diffPitchRad = getFloat(p);
+    for (float& v : msg.twinJointAnglesDeg) v = getFloat(p);
+    for (MotorStateRecord& m : msg.motors) {
+        m.temperatureC        = static_cast<int8_t>(*p++);
+        m.errorCode           = *p++;
+        m.encoderVal          = get16(p);
+        m.torqueCurrentRaw    = static_cast<int16_t>(get16(p));
+        m.reserved            = get16(p);
+        m.speedDeg_s          = getFloat(p);
+        m.positionDeg_Mapped  = getFloat(p);
+        m.multiTurnDeg_Mapped = getFloat(p);
+        m.multiTurnRaw        = getFloat(p);
+    }
+    return true;
+}
+
+bool FrameReader::next(FrameType& type, std::string& payload)
+{
+    if (m_corrupt || m_buffer.size() < FRAME_HEADER_SIZE) return false;
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(m_buffer.data());
+    uint16_t len = get16(p);
+    if (len > MAX_FRAME_PAYLOAD) {
+        m_corrupt = true;
+        return false;
+    }
+    if (m_buffer.size() < FRAME_HEADER_SIZE + len) return false;
+
+    type = static_cast<FrameType>(*p);
+    payload.assign(m_buffer, FRAME_HEADER_SIZE, len);
+    m_buffer.erase(0, FRAME_HEADER_SIZE + len);
+    return true;
+}
+
+} // namespace ipc
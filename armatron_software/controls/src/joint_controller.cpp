@@ -0,0 +1,73 @@
+#include "joint_controller.hpp"
+
+#include <algorithm>
+
+JointController::JointController()
+{
+    for (size_t i = 0; i < NUM_JOINTS; ++i) {
+        setGains(i, JointGains{});
+        m_scale[i] = 1.0f;
+    }
+    // The padding lane stays all zero and commands nothing
+}
+
+void JointController::setGains(size_t joint, const JointGains& gains)
+{
+    if (joint >= NUM_JOINTS) return;
+    m_kp[joint] = gains.kp;
+    m_ki[joint] = gains.ki;
+    m_kv[joint] = gains.kv;
+    m_ka[joint] = gains.ka;
+    m_maxIntegral[joint] = std::max(gains.maxIntegral, 0.0f);
+    m_integral[joint] = std::clamp(m_integral[joint], -m_maxIntegral[joint], m_maxIntegral[joint]);
+}
+
+JointGains JointController::gains(size_t joint) const
+{
+    JointGains g;
+    if (joint < NUM_JOINTS) {
+        g.kp = m_kp[joint];
+        g.ki = m_ki[joint];
+        g.kv = m_kv[joint];
+        g.ka = m_ka[joint];
+        g.maxIntegral = m_maxIntegral[joint];
+    }
+    return g;
+}
+
+void JointController::setUnitScale(size_t joint, float scale)
+{
+    if (joint < NUM_JOINTS) m_scale[joint] = scale;
+}
+
+void JointController::reset()
+{
+    m_integral.fill(0.0f);
+}
+
+void JointController::update(const Lanes& position, const Lanes& velocity, const Lanes& acceleration,
+                             const Lanes& measured, const Lanes& limit, float dt, Lanes& command)
+{
+    // Results go to locals first: with the members written only after the loop, the compiler
+    // knows nothing in the loop aliases and vectorizes it without runtime checks
+    Lanes integral = m_integral;
+    Lanes error;
+    Lanes out;
+    for (size_t i = 0; i < LANES; ++i) {
+        error[i] = position[i] - measured[i];
+        const float e = error[i] * m_scale[i];
+        const float feedforward = m_scale[i] * (m_kv[i] * velocity[i] + m_ka[i] * acceleration[i]);
+        float next = integral[i] + e * dt;
+        next = next > m_maxIntegral[i] ? m_maxIntegral[i] : next;
+        next = next < -m_maxIntegral[i] ? -m_maxIntegral[i] : next;
+        const float unsaturated = feedforward + m_kp[i] * e + m_ki[i] * next;
+        float saturated = unsaturated > limit[i] ? limit[i] : unsaturated;
+        saturated = saturated < -limit[i] ? -limit[i] : saturated;
+        // Anti-windup: only integrate while the command is not clipped
+        integral[i] = saturated == unsaturated ? next : integral[i];
+        out[i] = saturated;
+    }
+    m_integral = integral;
+    m_error = error;
+    command = out;
+}
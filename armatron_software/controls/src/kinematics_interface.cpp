@@ -1,7 +1,7 @@
 #include "kinematics_interface.hpp"
 #include "kdl_parser.hpp"
 #include <stdexcept>
-#include <iostream>
+#include "rt_log.hpp"
 
 KinematicsInterface::KinematicsInterface()
 {
@@ -12,13 +12,13 @@ bool KinematicsInterface::loadURDF(const std::string& urdf_path)
 {
     // Parse URDF file into KDL tree
     if (!kdl_parser::treeFromFile(urdf_path, tree)) {
-        std::cerr << "[KinematicsInterface] Failed to parse URDF file: " << urdf_path << std::endl;
+        RTLOG_ERROR(Kinematics, "[KinematicsInterface] Failed to parse URDF file: {}", urdf_path);
         return false;
     }
 
     // Extract chain from base to end-effector
     if (!tree.getChain("base_link", "end_effector", chain)) {
-        std::cerr << "[KinematicsInterface] Failed to get chain from base_link to end_effector" << std::endl;
+        RTLOG_ERROR(Kinematics, "[KinematicsInterface] Failed to get chain from base_link to end_effector");
         return false;
     }
 
@@ -26,8 +26,9 @@ bool KinematicsInterface::loadURDF(const std::string& urdf_path)
     fk_solver = std::make_unique<KDL::ChainFkSolverPos_recursive>(chain);
     ik_solver_vel = std::make_unique<KDL::ChainIkSolverVel_pinv>(chain);
     ik_solver_pos = std::make_unique<KDL::ChainIkSolverPos_NR>(chain, *fk_solver, *ik_solver_vel);
+    fk_joints = KDL::JntArray(7);
 
-    std::cout << "[KinematicsInterface] Successfully loaded URDF and initialized kinematic chain" << std::endl;
+    RTLOG_INFO(Kinematics, "[KinematicsInterface] Successfully loaded URDF and initialized kinematic chain");
     return true;
 }
 
@@ -43,15 +44,14 @@ bool KinematicsInterface::getForwardKinematics(
     KDL::Frame& end_effector_pose)
 {
     // Convert array to KDL joint array
-    KDL::JntArray kdl_joints(7);
     for(int i = 0; i < 7; i++) {
-        kdl_joints(i) = joint_angles[i];
+        fk_joints(i) = joint_angles[i];
     }
 
     // Calculate forward kinematics
-    int result = fk_solver->JntToCart(kdl_joints, end_effector_pose);
+    int result = fk_solver->JntToCart(fk_joints, end_effector_pose);
     if (result < 0) {
-        std::cerr << "[KinematicsInterface] Forward kinematics calculation failed" << std::endl;
+        RTLOG_ERROR(Kinematics, "[KinematicsInterface] Forward kinematics calculation failed");
         return false;
     }
 
@@ -75,7 +75,7 @@ bool KinematicsInterface::getInverseKinematics(
     // Calculate inverse kinematics
     int result = ik_solver_pos->CartToJnt(initial_guess, target_pose, result_joints);
     if (result < 0) {
-        std::cerr << "[KinematicsInterface] Inverse kinematics calculation failed" << std::endl;
+        RTLOG_ERROR(Kinematics, "[KinematicsInterface] Inverse kinematics calculation failed");
         return false;
     }
 
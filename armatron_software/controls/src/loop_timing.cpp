@@ -0,0 +1,184 @@
+#include "loop_timing.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+const char* loopPhaseName(LoopPhase phase)
+{
+    switch (phase) {
+    case LoopPhase::CommandDrain: return "commandDrain";
+    case LoopPhase::JointStates:  return "jointStates";
+    case LoopPhase::Differential: return "differential";
+    case LoopPhase::Trajectories: return "trajectories";
+    case LoopPhase::Broadcast:    return "broadcast";
+    case LoopPhase::Wait:         return "wait";
+    case LoopPhase::Count:        break;
+    }
+    return "unknown";
+}
+
+/**********************************************************/
+/* HistogramSnapshot                                      */
+/**********************************************************/
+size_t HistogramSnapshot::bucketIndex(uint64_t ns)
+{
+    if (ns < SUB_BUCKETS) {
+        return static_cast<size_t>(ns);
+    }
+    unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+    if (msb >= MAX_VALUE_BITS) {
+        return NUM_BUCKETS - 1;
+    }
+    unsigned shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((ns >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t HistogramSnapshot::bucketUpperNs(size_t index)
+{
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    unsigned shift = static_cast<unsigned>(index / SUB_BUCKETS) - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+double HistogramSnapshot::percentileUs(double percentile) const
+{
+    if (count == 0) return 0.0;
+    uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * count));
+    target = std::clamp<uint64_t>(target, 1, count);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= target) {
+            return std::min(bucketUpperNs(i), maxNs) / 1000.0;
+        }
+    }
+    return maxNs / 1000.0;
+}
+
+HistogramSnapshot HistogramSnapshot::since(const HistogramSnapshot& earlier) const
+{
+    HistogramSnapshot d;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        d.counts[i] = counts[i] - earlier.counts[i];
+    }
+    d.count = count - earlier.count;
+    d.sumNs = sumNs - earlier.sumNs;
+    // The exact maximum of the interval is not kept; use its highest bucket
+    for (size_t i = NUM_BUCKETS; i-- > 0; ) {
+        if (d.counts[i] > 0) {
+            d.maxNs = std::min(bucketUpperNs(i), maxNs);
+            break;
+        }
+    }
+    return d;
+}
+
+Json::Value HistogramSnapshot::toJson() const
+{
+    Json::Value v;
+    v["count"] = static_cast<Json::UInt64>(count);
+    v["meanUs"] = meanUs();
+    v["p50Us"] = percentileUs(50.0);
+    v["p99Us"] = percentileUs(99.0);
+    v["p999Us"] = percentileUs(99.9);
+    v["maxUs"] = maxNs / 1000.0;
+    return v;
+}
+
+/**********************************************************/
+/* LatencyHistogram                                       */
+/**********************************************************/
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot s;
+    for (size_t i = 0; i < HistogramSnapshot::NUM_BUCKETS; ++i) {
+        s.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+    }
+    s.count = m_count.load(std::memory_order_relaxed);
+    s.sumNs = m_sumNs.load(std::memory_order_relaxed);
+    s.maxNs = m_maxNs.load(std::memory_order_relaxed);
+    return s;
+}
+
+/**********************************************************/
+/* LoopTiming                                             */
+/**********************************************************/
+void LoopTiming::recordCycle(uint64_t workNs, bool missed)
+{
+    m_work.record(workNs);
+    if (missed) {
+        m_missed.store(m_missed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (++m_consecutiveMisses > m_maxConsecutiveMisses.load(std::memory_order_relaxed)) {
+            m_maxConsecutiveMisses.store(m_consecutiveMisses, std::memory_order_relaxed);
+        }
+    } else {
+        m_consecutiveMisses = 0;
+    }
+    m_cycles.store(m_cycles.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+LoopTiming::Snapshot LoopTiming::snapshot() const
+{
+    Snapshot s;
+    for (size_t i = 0; i < NUM_LOOP_PHASES; ++i) {
+        s.phases[i] = m_phases[i].snapshot();
+    }
+    s.work = m_work.snapshot();
+    s.jitter = m_jitter.snapshot();
+    s.cycles = m_cycles.load(std::memory_order_relaxed);
+    s.missedDeadlines = m_missed.load(std::memory_order_relaxed);
+    s.maxConsecutiveMisses = m_maxConsecutiveMisses.load(std::memory_order_relaxed);
+    return s;
+}
+
+LoopTiming::Snapshot LoopTiming::Snapshot::since(const Snapshot& earlier) const
+{
+    Snapshot d;
+    for (size_t i = 0; i < NUM_LOOP_PHASES; ++i) {
+        d.phases[i] = phases[i].since(earlier.phases[i]);
+    }
+    d.work = work.since(earlier.work);
+    d.jitter = jitter.since(earlier.jitter);
+    d.cycles = cycles - earlier.cycles;
+    d.missedDeadlines = missedDeadlines - earlier.missedDeadlines;
+    d.maxConsecutiveMisses = maxConsecutiveMisses;
+    return d;
+}
+
+Json::Value LoopTiming::Snapshot::toJson(double periodUs) const
+{
+    Json::Value v;
+    v["periodUs"] = periodUs;
+    v["cycles"] = static_cast<Json::UInt64>(cycles);
+    v["missedDeadlines"] = static_cast<Json::UInt64>(missedDeadlines);
+    v["maxConsecutiveMisses"] = static_cast<Json::UInt64>(maxConsecutiveMisses);
+    v["work"] = work.toJson();
+    v["jitter"] = jitter.toJson();
+    for (size_t i = 0; i < NUM_LOOP_PHASES; ++i) {
+        v["phases"][loopPhaseName(static_cast<LoopPhase>(i))] = phases[i].toJson();
+    }
+    return v;
+}
+
+std::string LoopTiming::Snapshot::summary(double periodUs) const
+{
+    std::string out;
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "%llu cycles, %llu missed | work p50 %.0f p99 %.0f max %.0f us of %.0f | jitter p99 %.0f max %.0f us |",
+                  static_cast<unsigned long long>(cycles), static_cast<unsigned long long>(missedDeadlines),
+                  work.percentileUs(50.0), work.percentileUs(99.0), work.maxNs / 1000.0, periodUs,
+                  jitter.percentileUs(99.0), jitter.maxNs / 1000.0);
+    out += buf;
+    for (size_t i = 0; i < NUM_LOOP_PHASES; ++i) {
+        if (static_cast<LoopPhase>(i) == LoopPhase::Wait) continue;
+        std::snprintf(buf, sizeof(buf), " %s %.0f/%.0f", loopPhaseName(static_cast<LoopPhase>(i)),
+                      phases[i].percentileUs(50.0), phases[i].percentileUs(99.0));
+        out += buf;
+    }
+    out += " (p50/p99 us)";
+    return out;
+}
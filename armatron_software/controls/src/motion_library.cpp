@@ -0,0 +1,193 @@
+#include "motion_library.hpp"
+#include "rt_log.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The motion library format is little-endian"
+#endif
+
+using namespace motion_library;
+
+namespace
+{
+uint32_t crc32(const uint8_t* data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+}
+
+MotionLibrary::~MotionLibrary()
+{
+    close();
+}
+
+bool MotionLibrary::open(const std::string& path, std::string& error)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        error = path + " is too short for a motion library";
+        ::close(fd);
+        return false;
+    }
+    size_t length = static_cast<size_t>(st.st_size);
+    // MAP_POPULATE reads it all in now rather than on the control thread's first access
+    void* base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        error = "mmap of " + path + " failed: " + strerror(errno);
+        return false;
+    }
+    m_base = base;
+    m_length = length;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(base);
+    FileHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + " is not a motion library";
+    } else if (header.version != VERSION) {
+        error = path + " is version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION);
+    } else if (header.headerSize != sizeof(FileHeader) || header.fileSize != length
+               || (length - sizeof(FileHeader)) / sizeof(ClipEntry) < header.clipCount) {
+        error = path + " is truncated or corrupt (" + std::to_string(length) + " of "
+                + std::to_string(header.fileSize) + " bytes)";
+    }
+
+    const ClipEntry* entries = reinterpret_cast<const ClipEntry*>(bytes + sizeof(FileHeader));
+    for (uint32_t i = 0; error.empty() && i < header.clipCount; ++i) {
+        const ClipEntry& entry = entries[i];
+        std::string where = path + " clip " + std::to_string(i) + ": ";
+        if (entry.name[NAME_LENGTH - 1] != '\0' || entry.rateHz == 0 || entry.sampleCount == 0) {
+            error = where + "bad name, rate or sample count";
+        } else if (entry.offset % alignof(Sample) != 0 || entry.offset > length
+                   || (length - entry.offset) / sizeof(Sample) < entry.sampleCount) {
+            error = where + "samples outside the file";
+        } else if (crc32(bytes + entry.offset, entry.sampleCount * sizeof(Sample)) != entry.crc32) {
+            error = where + "CRC mismatch";
+        } else {
+            MotionClip clip;
+            clip.name = entry.name;
+            clip.rateHz = entry.rateHz;
+            clip.sampleCount = entry.sampleCount;
+            clip.samples = reinterpret_cast<const Sample*>(bytes + entry.offset);
+            m_clips.push_back(clip);
+        }
+    }
+    if (!error.empty()) {
+        close();
+        return false;
+    }
+
+    // Keep it resident; the daemon's mlockall(MCL_FUTURE) may already cover it
+    if (mlock(m_base, m_length) != 0) {
+        RTLOG_WARN(General, "[MotionLibrary] mlock of {} bytes failed ({}); playback may page-fault",
+                   m_length, strerror(errno));
+    }
+    m_path = path;
+    RTLOG_INFO(General, "[MotionLibrary] Loaded {} clips from {}", m_clips.size(), path);
+    return true;
+}
+
+void MotionLibrary::close()
+{
+    if (m_base != nullptr) {
+        munmap(m_base, m_length);
+    }
+    m_base = nullptr;
+    m_length = 0;
+    m_path.clear();
+    m_clips.clear();
+}
+
+int MotionLibrary::find(const std::string& name) const
+{
+    for (size_t i = 0; i < m_clips.size(); ++i) {
+        if (name == m_clips[i].name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool MotionLibrary::write(const std::string& path, const std::vector<MotionClipData>& clips, std::string& error)
+{
+    FileHeader header {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.headerSize = sizeof(FileHeader);
+    header.clipCount = static_cast<uint32_t>(clips.size());
+
+    std::vector<ClipEntry> entries(clips.size());
+    uint64_t offset = sizeof(FileHeader) + clips.size() * sizeof(ClipEntry);
+    for (size_t i = 0; i < clips.size(); ++i) {
+        const MotionClipData& clip = clips[i];
+        if (clip.name.empty() || clip.name.size() >= NAME_LENGTH || clip.rateHz == 0 || clip.samples.empty()) {
+            error = "clip " + std::to_string(i) + " ('" + clip.name + "') needs a name of 1.."
+                    + std::to_string(NAME_LENGTH - 1) + " characters, a rate and samples";
+            return false;
+        }
+        for (const Sample& s : clip.samples) {
+            for (int j = 0; j < 7; ++j) {
+                if (!std::isfinite(s.position[j]) || !std::isfinite(s.velocity[j]) || !std::isfinite(s.acceleration[j])) {
+                    error = "clip '" + clip.name + "' has a non-finite sample";
+                    return false;
+                }
+            }
+        }
+        ClipEntry& entry = entries[i];
+        std::memset(&entry, 0, sizeof(entry));
+        std::memcpy(entry.name, clip.name.data(), clip.name.size());
+        entry.rateHz = clip.rateHz;
+        entry.sampleCount = static_cast<uint32_t>(clip.samples.size());
+        entry.offset = offset;
+        entry.crc32 = crc32(reinterpret_cast<const uint8_t*>(clip.samples.data()), clip.samples.size() * sizeof(Sample));
+        offset += clip.samples.size() * sizeof(Sample);
+    }
+    header.fileSize = offset;
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            error = "cannot open " + tmp;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ClipEntry));
+        for (const MotionClipData& clip : clips) {
+            out.write(reinterpret_cast<const char*>(clip.samples.data()), clip.samples.size() * sizeof(Sample));
+        }
+        if (!out.good()) {
+            error = "write to " + tmp + " failed";
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        error = "rename to " + path + " failed: " + strerror(errno);
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -1,6 +1,6 @@
 #include "motor_interface.hpp"
 #include <stdexcept>
-#include <iostream>
+#include "rt_log.hpp"
 #include <cstring>
 #include <unistd.h>
 #include <cmath>
@@ -10,13 +10,13 @@
 namespace
 {
     // Helper to pack a 16-bit into two bytes
-    inline void pack16(std::vector<uint8_t>& data, size_t idx, int16_t val)
+    inline void pack16(CanPayload& data, size_t idx, int16_t val)
     {
         data[idx]   = static_cast<uint8_t>( val       & 0xFF );
         data[idx+1] = static_cast<uint8_t>((val >> 8) & 0xFF );
     }
     // Helper to pack a 32-bit into four bytes
-    inline void pack32(std::vector<uint8_t>& data, size_t idx, int32_t val)
+    inline void pack32(CanPayload& data, size_t idx, int32_t val)
     {
         data[idx]   = static_cast<uint8_t>( val        & 0xFF );
         data[idx+1] = static_cast<uint8_t>((val >> 8)  & 0xFF );
@@ -116,7 +116,7 @@ void Motor::openLoopControl(int16_t powerControl)
 {
     // Command 0xA0
     // data => [0x00,0x00,0x00,0x00, powerLo, powerHi, 0x00,0x00]
-    std::vector<uint8_t> data(8, 0);
+    CanPayload data{};
     pack16(data, 4, powerControl);
 
     sendCmd(0xA0, data);
@@ -127,7 +127,7 @@ void Motor::setTorque(int16_t iqControl)
 {
     // 0xA1 => torque
     // data => [0x00,0x00,0x00, iqLo, iqHi, 0x00, 0x00, 0x00]
-    std::vector<uint8_t> d(8, 0);
+    CanPayload d{};
     pack16(d, 3, iqControl);
 
     sendCmd(0xA1, d);
@@ -146,11 +146,10 @@ void Motor::setSpeed(float speedControl)
         speedControl = speedControl * m_reduction_ratio;
     }
     int32_t speed_command = static_cast<int32_t>(speedControl);
-    std::vector<uint8_t> d(8, 0);
+    CanPayload d{};
     pack32(d, 3, speed_command);
 
-    // std::cerr << "[Motor::setSpeed] speedControl: " << speedControl << std::endl;
-    // std::cerr << "[Motor::setSpeed] speed_command: " << speed_command << std::endl;
+    RTLOG_DEBUG(Motor, "[Motor::setSpeed] speedControl: {} speed_command: {}", speedControl, speed_command);
 
     sendCmd(0xA2, d);
     readFrameForCommand(0xA2);
@@ -162,7 +161,7 @@ void Motor::setMultiAngle(int32_t angleControl)
     // data => [0x00,0x00,0x00, angle0, angle1, angle2, angle3, 0x00]
     int32_t clamped_angle = std::clamp(angleControl, static_cast<int32_t>(m_single_loop_ang_limit_low), static_cast<int32_t>(m_single_loop_ang_limit_high));
     int32_t scaled_angle = clamped_angle * 100 * m_reduction_ratio; // Scale to motor expectation
-    std::vector<uint8_t> d(8, 0);
+    CanPayload d{};
     pack32(d, 3, scaled_angle);
 
     sendCmd(0xA3, d);
@@ -177,12 +176,12 @@ void Motor::setMultiAngleWithSpeed(int32_t angle, uint16_t maxSpeed)
     int32_t scaled_angle = clamped_angle * 100 * m_reduction_ratio; // Scale to motor expectation
     uint16_t scaled_speed = std::clamp(maxSpeed, static_cast<uint16_t>(0), static_cast<uint16_t>(m_max_speed*m_max_speed_modifier)) * ((m_motorId == 6 || m_motorId == 7) ? 10 : m_reduction_ratio);
     if (scaled_speed == 0) { scaled_speed = 1;}
-    std::vector<uint8_t> d(7, 0);
+    CanPayload d{};
     d[1] = static_cast<uint8_t>( scaled_speed & 0xFF );
     d[2] = static_cast<uint8_t>((scaled_speed >> 8) & 0xFF );
     pack32(d, 3, scaled_angle);
-    //std::cerr << "[Motor::setMultiAngleWithSpeed] Input speed: " << maxSpeed << " | Scaled speed: " << scaled_speed << std::endl;
-    //std::cerr << "[Motor::setMultiAngleWithSpeed] Input angle: " << angle << " | Scaled angle: " << scaled_angle << std::endl;
+    RTLOG_DEBUG(Motor, "[Motor::setMultiAngleWithSpeed] Input speed: {} | Scaled speed: {}", maxSpeed, scaled_speed);
+    RTLOG_DEBUG(Motor, "[Motor::setMultiAngleWithSpeed] Input angle: {} | Scaled angle: {}", angle, scaled_angle);
 
     sendCmd(0xA4, d);
     readFrameForCommand(0xA4);
@@ -193,7 +192,7 @@ void Motor::setSingleAngle(uint8_t spinDirection, int32_t angle)
     // 0xA5 => single angle, data => [dir,0,0, angLo,angHi,angHi2,angHi3]
     int32_t clamped_angle = std::clamp(angle, static_cast<int32_t>(m_single_loop_ang_limit_low), static_cast<int32_t>(m_single_loop_ang_limit_high));
     int32_t scaled_angle = clamped_angle * 100 * m_reduction_ratio; // Scale to motor expectation
-    std::vector<uint8_t> d(7, 0);
+    CanPayload d{};
     d[0] = spinDirection;
     pack32(d, 3, scaled_angle);
     sendCmd(0xA5, d);
@@ -206,7 +205,7 @@ void Motor::setSingleAngleWithSpeed(uint8_t spinDirection, int32_t angle, uint16
     // data => [dir, spdLo,spdHi, angLo, angHi, angHi2, angHi3]
     int32_t clamped_angle = std::clamp(angle, static_cast<int32_t>(m_single_loop_ang_limit_low), static_cast<int32_t>(m_single_loop_ang_limit_high));
     int32_t scaled_angle = clamped_angle * 100 * m_reduction_ratio; // Scale to motor expectation
-    std::vector<uint8_t> d(7, 0);
+    CanPayload d{};
     d[0] = spinDirection;
     d[1] = static_cast<uint8_t>( maxSpeed & 0xFF );
     d[2] = static_cast<uint8_t>((maxSpeed >> 8) & 0xFF );
@@ -220,7 +219,7 @@ void Motor::setIncrementAngle(int32_t incAngle)
 {
     // 0xA7 => inc angle
     // data => [0x00,0x00,0x00, inc0,inc1,inc2,inc3]
-    std::vector<uint8_t> d(7,0);
+    CanPayload d{};
     pack32(d, 3, incAngle);
 
     sendCmd(0xA7, d);
@@ -231,7 +230,7 @@ void Motor::setIncrementAngleWithSpeed(int32_t incAngle, uint16_t maxSpeed)
 {
     // 0xA8 => inc angle + speed
     // data => [0x00, spdLo, spdHi, inc0, inc1, inc2, inc3]
-    std::vector<uint8_t> d(7,0);
+    CanPayload d{};
     d[1] = static_cast<uint8_t>(maxSpeed & 0xFF);
     d[2] = static_cast<uint8_t>((maxSpeed >> 8) & 0xFF);
     pack32(d, 3, incAngle);
@@ -244,22 +243,21 @@ void Motor::clearMultiLoopAngle(){
     sendCmd(0x93);
 }
 
-std::vector<uint8_t> Motor::readPID()
+MotorGains Motor::readPID()
 {
     // 0x30 => read PID param
     // data => [0x30, 0,0,0,0,0,0,0] 
-    std::cout << "[Motor::readPID] Sending read PID command for motor " << static_cast<int>(m_motorId) << std::endl;
+    RTLOG_INFO(Motor, "[Motor::readPID] Sending read PID command for motor {}", m_motorId);
     sendCmd(0x30);
     readFrameForCommand(0x30);
-    // Return a dummy vector or implement as needed.
-    return std::vector<uint8_t>();
+    return m_state.m_gains;
 }
 
 void Motor::writePID_RAM(uint8_t angKp, uint8_t angKi, uint8_t spdKp, uint8_t spdKi, uint8_t iqKp, uint8_t iqKi)
 {
     // 0x31 => write PID to RAM
     // data => [0x31, 0, angKp, angKi, spdKp, spdKi, iqKp, iqKi]
-    std::vector<uint8_t> d(8);
+    CanPayload d{};
     d[0] = 0x00;
     d[1] = angKp;
     d[2] = angKi;
@@ -275,7 +273,7 @@ void Motor::writePID_RAM(uint8_t angKp, uint8_t angKi, uint8_t spdKp, uint8_t sp
 void Motor::writePID_ROM(uint8_t angKp, uint8_t angKi, uint8_t spdKp, uint8_t spdKi, uint8_t iqKp, uint8_t iqKi)
 {
     // 0x32 => write PID to ROM
-    std::vector<uint8_t> d(8);
+    CanPayload d{};
     d[0] = 0x00;
     d[1] = angKp;
     d[2] = angKi;
@@ -302,7 +300,7 @@ void Motor::writeAcceleration(int32_t accel)
     // 0x34 => write accel
     // data => [0x34,0,0,0,acc0,acc1,acc2,acc3] 
     // We'll skip the second approach, we only have 8 data total, the first byte is command if we were doing raw, but we do do a separate param
-    std::vector<uint8_t> d(8,0);
+    CanPayload d{};
     pack32(d,3,accel);
 
     sendCmd(0x34, d);
@@ -320,7 +318,7 @@ void Motor::writeEncoderOffset(uint16_t offset)
 {
     // 0x91 => write offset to ROM
     // data => [0x91,0,0,0,0,0, offLo, offHi]
-    std::vector<uint8_t> d(7,0);
+    CanPayload d{};
     d[5] = static_cast<uint8_t>( offset & 0xFF );
     d[6] = static_cast<uint8_t>((offset >> 8) & 0xFF);
 
@@ -331,7 +329,7 @@ void Motor::writeEncoderOffset(uint16_t offset)
 void Motor::writeCurrentPosAsZero()
 {
     // 0x19 => write current pos to zero
-    std::vector<uint8_t> d(7,0);
+    CanPayload d{};
     sendCmd(0x19, d);
     readFrameForCommand(0x19);
 }
@@ -399,16 +397,16 @@ float Motor::motorRawToRadians(float rawValue) {
 float Motor::motorRadiansToRaw(float radians) {
     // Compute the raw value (rounding to the nearest integer)
     float rawValue = static_cast<float>((radians / TWO_PI) * m_single_loop_max_ang_raw);
-    std::cout << "[MotorInterface] called motorRadiansToRaw() w/ output: " << std::clamp(rawValue, m_single_loop_ang_limit_low, m_single_loop_ang_limit_high) << "\n";
-    std::cout << "[MotorInterface] called motorRadiansToRaw() w/ output: " << std::clamp(rawValue, m_single_loop_ang_limit_low, m_single_loop_ang_limit_high) << "\n";
     // Clamp the raw value to the allowed active range   
-    return std::clamp(rawValue, m_single_loop_ang_limit_low, m_single_loop_ang_limit_high);
+    float clamped = std::clamp(rawValue, m_single_loop_ang_limit_low, m_single_loop_ang_limit_high);
+    RTLOG_DEBUG(Motor, "[MotorInterface] called motorRadiansToRaw() w/ output: {}", clamped);
+    return clamped;
 }
 
 //-------------------------------------------
 //  Private Helpers
 //-------------------------------------------
-bool Motor::sendCmd(uint8_t command, const std::vector<uint8_t>& data)
+bool Motor::sendCmd(uint8_t command, const CanPayload& data)
 {
     return m_can.sendMessage(canID(), command, data);
 }
@@ -424,7 +422,7 @@ void Motor::readFrameForCommand(uint8_t expectedCmd)
     auto start = std::chrono::steady_clock::now();
 
     if (!(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(10))) {
-        std::cout << "[Motor Interface] CAN Loop Overrun (10ms - motor_interface.cpp::readFrameForCommand)\n";
+        RTLOG_WARN(Motor, "[Motor Interface] CAN Loop Overrun (10ms - motor_interface.cpp::readFrameForCommand)");
     }
     while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(10)) {
         if (m_can.receiveMessage(frame)) {
@@ -466,12 +464,10 @@ void Motor::readFrameForCommand(uint8_t expectedCmd)
             case 0x30:
             {
                 // Read PID parameters response: [0x30, 0, angleKp, angleKi, speedKp, speedKi, torqueKp, torqueKi]
-                std::cout << "[Motor::readFrameForCommand] Received PID response for motor " << static_cast<int>(m_motorId) << std::endl;
-                std::cout << "[Motor::readFrameForCommand] Raw data: ";
-                for (int i = 0; i < frame.can_dlc; i++) {
-                    std::cout << static_cast<int>(frame.data[i]) << " ";
-                }
-                std::cout << std::endl;
+                RTLOG_INFO(Motor, "[Motor::readFrameForCommand] Received PID response for motor {}", m_motorId);
+                RTLOG_DEBUG(Motor, "[Motor::readFrameForCommand] Raw data: {} {} {} {} {} {} {} {}",
+                            frame.data[0], frame.data[1], frame.data[2], frame.data[3],
+                            frame.data[4], frame.data[5], frame.data[6], frame.data[7]);
                 
                 m_state.m_gains.angKp = frame.data[2];
                 m_state.m_gains.angKi = frame.data[3];
@@ -480,13 +476,9 @@ void Motor::readFrameForCommand(uint8_t expectedCmd)
                 m_state.m_gains.iqKp = frame.data[6];
                 m_state.m_gains.iqKi = frame.data[7];
                 
-                std::cout << "[Motor::readFrameForCommand] Parsed gains: "
-                          << "angKp=" << static_cast<int>(m_state.m_gains.angKp) << " "
-                          << "angKi=" << static_cast<int>(m_state.m_gains.angKi) << " "
-                          << "spdKp=" << static_cast<int>(m_state.m_gains.spdKp) << " "
-                          << "spdKi=" << static_cast<int>(m_state.m_gains.spdKi) << " "
-                          << "iqKp=" << static_cast<int>(m_state.m_gains.iqKp) << " "
-                          << "iqKi=" << static_cast<int>(m_state.m_gains.iqKi) << std::endl;
+                RTLOG_INFO(Motor, "[Motor::readFrameForCommand] Parsed gains: angKp={} angKi={} spdKp={} spdKi={} iqKp={} iqKi={}",
+                           m_state.m_gains.angKp, m_state.m_gains.angKi, m_state.m_gains.spdKp,
+                           m_state.m_gains.spdKi, m_state.m_gains.iqKp, m_state.m_gains.iqKi);
                 break;
             }
             case 0x31:
@@ -604,7 +596,7 @@ void Motor::readFrameForCommand(uint8_t expectedCmd)
                 if (frame.can_dlc >= 8) {
                     int16_t offset = unpack16(frame, 6);
                     // For example, store the offset or print it.
-                    std::cout << "[Motor Interface] Current position zero offset: " << offset << "\n";
+                    RTLOG_INFO(Motor, "[Motor Interface] Current position zero offset: {}", offset);
                 }
                 break;
             }
@@ -613,7 +605,7 @@ void Motor::readFrameForCommand(uint8_t expectedCmd)
                 // Write encoder offset response. Echo confirmation.
                 if (frame.can_dlc >= 8) {
                     int16_t offset = unpack16(frame, 6);
-                    std::cout << "[Motor Interface] Encoder offset set to: " << offset << "\n";
+                    RTLOG_INFO(Motor, "[Motor Interface] Encoder offset set to: {}", offset);
                 }
                 break;
             }
@@ -625,5 +617,5 @@ void Motor::readFrameForCommand(uint8_t expectedCmd)
             return; // Successfully parsed matching frame.
         } // if receiveMessage
     } // while loop
-    std::cout << "[Motor Interface] CAN Loop Overrun (10ms - motor_interface.cpp::readFrameForCommand)\n";
+    RTLOG_WARN(Motor, "[Motor Interface] CAN Loop Overrun (10ms - motor_interface.cpp::readFrameForCommand)");
 }
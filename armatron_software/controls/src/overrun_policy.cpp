@@ -0,0 +1,145 @@
+#include "overrun_policy.hpp"
+#include <algorithm>
+#include "rt_log.hpp"
+
+bool parseOverrunPolicy(const std::string& name, OverrunPolicy& policy)
+{
+    if (name == "catchUp") {
+        policy = OverrunPolicy::CatchUp;
+    } else if (name == "skip") {
+        policy = OverrunPolicy::Skip;
+    } else if (name == "shed") {
+        policy = OverrunPolicy::Shed;
+    } else if (name == "downrate") {
+        policy = OverrunPolicy::Downrate;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* overrunPolicyName(OverrunPolicy policy)
+{
+    switch (policy) {
+    case OverrunPolicy::CatchUp:  return "catchUp";
+    case OverrunPolicy::Skip:     return "skip";
+    case OverrunPolicy::Shed:     return "shed";
+    case OverrunPolicy::Downrate: return "downrate";
+    }
+    return "unknown";
+}
+
+const char* shedLevelName(ShedLevel level)
+{
+    switch (level) {
+    case ShedLevel::None:      return "none";
+    case ShedLevel::Telemetry: return "telemetry";
+    case ShedLevel::Broadcast: return "broadcast";
+    }
+    return "unknown";
+}
+
+OverrunGovernor::OverrunGovernor(std::chrono::nanoseconds basePeriod)
+    : m_basePeriodNs(basePeriod.count())
+{
+}
+
+void OverrunGovernor::setBasePeriod(std::chrono::nanoseconds basePeriod)
+{
+    m_basePeriodNs.store(basePeriod.count(), std::memory_order_relaxed);
+    m_rateDivider.store(1, std::memory_order_relaxed);
+    m_consecutiveMisses = 0;
+    m_cleanCycles = 0;
+}
+
+void OverrunGovernor::configure(const OverrunConfig& config)
+{
+    m_policy = config.policy;
+    m_downrateAfter = std::max(1u, config.downrateAfter);
+    m_recoverAfter = std::max(1u, config.recoverAfter);
+    RTLOG_INFO(Daemon, "[OverrunGovernor] Policy {} (downrateAfter={}, recoverAfter={})", overrunPolicyName(config.policy),
+               m_downrateAfter.load(), m_recoverAfter.load());
+}
+
+std::chrono::steady_clock::time_point OverrunGovernor::endCycle(std::chrono::steady_clock::time_point deadline,
+                                                                std::chrono::steady_clock::time_point workEnd)
+{
+    OverrunPolicy policy = m_policy.load(std::memory_order_relaxed);
+    std::chrono::nanoseconds period = this->period();
+    unsigned int divider = m_rateDivider.load(std::memory_order_relaxed);
+
+    if (workEnd <= deadline) {
+        m_consecutiveMisses = 0;
+
+        // At a reduced rate a cycle only counts as clean if it would also fit the faster period with margin
+        bool clean = true;
+        if (divider > 1) {
+            auto work = workEnd - (deadline - period);
+            clean = work * 8 < (period / 2) * 6;
+        }
+        m_cleanCycles = clean ? m_cleanCycles + 1 : 0;
+
+        // Step back up one level at a time, restoring the most important work first
+        if (m_cleanCycles >= m_recoverAfter.load(std::memory_order_relaxed)) {
+            m_cleanCycles = 0;
+            if (divider > 1) {
+                setRateDivider(divider / 2);
+            } else if (shedLevel() != ShedLevel::None) {
+                setShedLevel(static_cast<ShedLevel>(static_cast<uint8_t>(shedLevel()) - 1));
+            }
+        }
+        return deadline;
+    }
+
+    m_cleanCycles = 0;
+    m_consecutiveMisses++;
+    if (policy == OverrunPolicy::CatchUp) {
+        return deadline;
+    }
+
+    // Resume on the first tick still ahead of us instead of bursting through the missed ones
+    uint64_t skipped = static_cast<uint64_t>((workEnd - deadline) / period) + 1;
+    m_skippedTicks.fetch_add(skipped, std::memory_order_relaxed);
+    auto next = deadline + period * skipped;
+
+    if (policy == OverrunPolicy::Shed && shedLevel() != ShedLevel::Broadcast) {
+        setShedLevel(static_cast<ShedLevel>(static_cast<uint8_t>(shedLevel()) + 1));
+    } else if (policy == OverrunPolicy::Downrate && m_consecutiveMisses >= m_downrateAfter.load(std::memory_order_relaxed)
+               && divider < MAX_RATE_DIVIDER) {
+        m_consecutiveMisses = 0;
+        setRateDivider(divider * 2);
+        next = workEnd + this->period();
+    }
+    return next;
+}
+
+void OverrunGovernor::setShedLevel(ShedLevel level)
+{
+    ShedLevel previous = shedLevel();
+    m_shedLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+    m_shedTransitions.fetch_add(1, std::memory_order_relaxed);
+    RTLOG_WARN(Daemon, "[OverrunGovernor] Shedding {} -> {}", shedLevelName(previous), shedLevelName(level));
+}
+
+void OverrunGovernor::setRateDivider(unsigned int divider)
+{
+    unsigned int previous = m_rateDivider.load(std::memory_order_relaxed);
+    m_rateDivider.store(divider, std::memory_order_relaxed);
+    m_rateTransitions.fetch_add(1, std::memory_order_relaxed);
+    double baseHz = 1e9 / basePeriod().count();
+    RTLOG_WARN(Daemon, "[OverrunGovernor] Control rate {} Hz -> {} Hz", baseHz / previous, baseHz / divider);
+}
+
+OverrunStats OverrunGovernor::stats() const
+{
+    OverrunStats st;
+    st.config.policy = m_policy;
+    st.config.downrateAfter = m_downrateAfter;
+    st.config.recoverAfter = m_recoverAfter;
+    st.skippedTicks = m_skippedTicks;
+    st.shedTransitions = m_shedTransitions;
+    st.rateTransitions = m_rateTransitions;
+    st.shedLevel = shedLevel();
+    st.rateDivider = m_rateDivider;
+    return st;
+}
@@ -0,0 +1,368 @@
+#include "path_parameterization.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+constexpr double GRID_STEP_DEG = 0.25;             // path length per grid interval
+constexpr size_t MIN_GRID_INTERVALS = 100;
+constexpr size_t MAX_GRID_INTERVALS = 2000;
+constexpr double MIN_WAYPOINT_DISTANCE_DEG = 1e-6; // closer waypoints are merged
+constexpr double MAX_PATH_ACCELERATION = 1e6;      // bounds s'' where no joint does (it never binds)
+constexpr double MAX_SQUARED_PATH_SPEED = 1e8;
+constexpr double EPS = 1e-12;
+constexpr int MAX_STRETCH_PASSES = 4;
+constexpr double STRETCH_MARGIN = 1.02;            // past the bare minimum, so one stretch usually does
+
+// a * x + b * u <= c, with x = s'^2 and u = s''
+struct HalfPlane
+{
+    double a;
+    double b;
+    double c;
+};
+
+// Largest x over the constraints. Two variables and ~20 constraints: checking every vertex is cheap
+bool maximizeX(const std::vector<HalfPlane>& constraints, double& best)
+{
+    bool found = false;
+    for (size_t i = 0; i < constraints.size(); ++i) {
+        for (size_t j = i + 1; j < constraints.size(); ++j) {
+            const HalfPlane& p = constraints[i];
+            const HalfPlane& q = constraints[j];
+            double det = p.a * q.b - q.a * p.b;
+            if (std::abs(det) < EPS * (std::abs(p.a) + std::abs(p.b)) * (std::abs(q.a) + std::abs(q.b))) continue;
+            double x = (p.c * q.b - q.c * p.b) / det;
+            double u = (p.a * q.c - q.a * p.c) / det;
+            if (found && x <= best) continue;
+            bool feasible = true;
+            for (const HalfPlane& r : constraints) {
+                double lhs = r.a * x + r.b * u;
+                if (lhs > r.c + 1e-9 * (1.0 + std::abs(r.c) + std::abs(r.a * x) + std::abs(r.b * u))) {
+                    feasible = false;
+                    break;
+                }
+            }
+            if (feasible) {
+                best = x;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+// Centered moving average; the ends are held, which is rest for s' and s''
+void boxFilter(std::vector<double>& values, long halfWindow, double before, double after)
+{
+    if (halfWindow <= 0 || values.empty()) return;
+    const long n = static_cast<long>(values.size());
+    std::vector<double> prefix(values.size() + 1, 0.0);
+    for (long i = 0; i < n; ++i) {
+        prefix[i + 1] = prefix[i] + values[i];
+    }
+    std::vector<double> out(values.size());
+    for (long i = 0; i < n; ++i) {
+        long lo = i - halfWindow;
+        long hi = i + halfWindow;
+        double sum = prefix[std::min(hi, n - 1) + 1] - prefix[std::max(lo, 0L)];
+        sum += before * static_cast<double>(std::max(0L, -lo));
+        sum += after * static_cast<double>(std::max(0L, hi - (n - 1)));
+        out[i] = sum / static_cast<double>(2 * halfWindow + 1);
+    }
+    values.swap(out);
+}
+}
+
+bool JointPath::build(const std::vector<Point>& waypoints, const std::vector<double>& speeds, const Point& unitsPerDeg,
+                      std::string& error)
+{
+    m_knots.clear();
+    m_points.clear();
+    m_curvature.clear();
+    m_speeds.clear();
+
+    for (size_t k = 0; k < waypoints.size(); ++k) {
+        double distance = 0.0;
+        if (!m_points.empty()) {
+            for (size_t j = 0; j < 7; ++j) {
+                double d = (waypoints[k][j] - m_points.back()[j]) / unitsPerDeg[j];
+                distance += d * d;
+            }
+            distance = std::sqrt(distance);
+            if (distance < MIN_WAYPOINT_DISTANCE_DEG) continue;
+        }
+        m_knots.push_back(m_knots.empty() ? 0.0 : m_knots.back() + distance);
+        m_points.push_back(waypoints[k]);
+        m_speeds.push_back(k < speeds.size() ? speeds[k] : 1.0);
+    }
+    const size_t n = m_points.size();
+    if (n < 2) {
+        error = "a path needs at least two distinct waypoints";
+        m_knots.clear();
+        m_points.clear();
+        m_speeds.clear();
+        return false;
+    }
+
+    // Natural spline: zero curvature at both ends, tridiagonal system for the inner knots (Thomas)
+    m_curvature.assign(n, Point{});
+    std::vector<double> diag(n, 0.0);
+    std::vector<double> upper(n, 0.0);
+    std::vector<Point> rhs(n, Point{});
+    for (size_t k = 1; k + 1 < n; ++k) {
+        double h0 = m_knots[k] - m_knots[k - 1];
+        double h1 = m_knots[k + 1] - m_knots[k];
+        double lower = h0 / 6.0;
+        diag[k] = (h0 + h1) / 3.0;
+        upper[k] = h1 / 6.0;
+        for (size_t j = 0; j < 7; ++j) {
+            rhs[k][j] = (m_points[k + 1][j] - m_points[k][j]) / h1 - (m_points[k][j] - m_points[k - 1][j]) / h0;
+        }
+        if (k > 1) {
+            double m = lower / diag[k - 1];
+            diag[k] -= m * upper[k - 1];
+            for (size_t j = 0; j < 7; ++j) {
+                rhs[k][j] -= m * rhs[k - 1][j];
+            }
+        }
+    }
+    for (size_t k = n - 2; k >= 1; --k) {
+        for (size_t j = 0; j < 7; ++j) {
+            double next = k + 2 < n ? m_curvature[k + 1][j] : 0.0;
+            m_curvature[k][j] = (rhs[k][j] - upper[k] * next) / diag[k];
+        }
+    }
+    return true;
+}
+
+size_t JointPath::segmentAt(double s) const
+{
+    size_t k = static_cast<size_t>(std::upper_bound(m_knots.begin(), m_knots.end(), s) - m_knots.begin());
+    return std::clamp(k, static_cast<size_t>(1), m_knots.size() - 1) - 1;
+}
+
+void JointPath::evaluate(double s, Point& q, Point& dq, Point& ddq) const
+{
+    s = std::clamp(s, 0.0, length());
+    const size_t k = segmentAt(s);
+    const double h = m_knots[k + 1] - m_knots[k];
+    const double a = (m_knots[k + 1] - s) / h;
+    const double b = 1.0 - a;
+    for (size_t j = 0; j < 7; ++j) {
+        const double m0 = m_curvature[k][j];
+        const double m1 = m_curvature[k + 1][j];
+        q[j] = a * m_points[k][j] + b * m_points[k + 1][j] + ((a * a * a - a) * m0 + (b * b * b - b) * m1) * h * h / 6.0;
+        dq[j] = (m_points[k + 1][j] - m_points[k][j]) / h - (3.0 * a * a - 1.0) / 6.0 * h * m0
+                + (3.0 * b * b - 1.0) / 6.0 * h * m1;
+        ddq[j] = a * m0 + b * m1;
+    }
+}
+
+double JointPath::speedAt(double s) const
+{
+    return m_speeds[segmentAt(std::clamp(s, 0.0, length())) + 1];
+}
+
+bool parameterizePath(const JointPath& path, const PathLimits& limits, uint32_t rateHz,
+                      std::vector<motion_library::Sample>& samples, PathParameterization& result, std::string& error)
+{
+    const auto started = std::chrono::steady_clock::now();
+    if (path.waypoints() < 2 || rateHz == 0) {
+        error = "no path to parameterize";
+        return false;
+    }
+
+    const double length = path.length();
+    const size_t intervals = std::clamp(static_cast<size_t>(std::ceil(length / GRID_STEP_DEG)),
+                                        MIN_GRID_INTERVALS, MAX_GRID_INTERVALS);
+    const double ds = length / static_cast<double>(intervals);
+
+    // Constraints at every grid point, in x = s'^2 and u = s''
+    std::vector<double> maxX(intervals + 1);
+    std::vector<JointPath::Point> dqs(intervals + 1);
+    std::vector<JointPath::Point> ddqs(intervals + 1);
+    std::vector<double> speedShare(intervals + 1);
+    for (size_t i = 0; i <= intervals; ++i) {
+        const double s = ds * static_cast<double>(i);
+        JointPath::Point q;
+        path.evaluate(s, q, dqs[i], ddqs[i]);
+        speedShare[i] = path.speedAt(s);
+        maxX[i] = MAX_SQUARED_PATH_SPEED;
+        for (size_t j = 0; j < 7; ++j) {
+            if (q[j] < limits.minPosition[j] - 1e-6 || q[j] > limits.maxPosition[j] + 1e-6) {
+                error = "the spline through the waypoints takes joint " + std::to_string(j + 1) + " to "
+                        + std::to_string(q[j]) + ", outside its limits (" + std::to_string(100.0 * s / length)
+                        + "% along the path); add waypoints there";
+                return false;
+            }
+            const double vmax = limits.maxVelocity[j] * speedShare[i];
+            if (vmax > 0.0 && std::abs(dqs[i][j]) > EPS) {
+                maxX[i] = std::min(maxX[i], (vmax / dqs[i][j]) * (vmax / dqs[i][j]));
+            }
+        }
+    }
+
+    auto addConstraints = [&](size_t i, std::vector<HalfPlane>& out) {
+        out.clear();
+        out.push_back({ 1.0, 0.0, maxX[i] });
+        out.push_back({ -1.0, 0.0, 0.0 });
+        out.push_back({ 0.0, 1.0, MAX_PATH_ACCELERATION });
+        out.push_back({ 0.0, -1.0, MAX_PATH_ACCELERATION });
+        for (size_t j = 0; j < 7; ++j) {
+            const double amax = limits.maxAcceleration[j] * speedShare[i];
+            if (amax <= 0.0) continue;
+            // joint acceleration = dq * s'' + ddq * s'^2
+            out.push_back({ ddqs[i][j], dqs[i][j], amax });
+            out.push_back({ -ddqs[i][j], -dqs[i][j], amax });
+        }
+    };
+
+    // Backward pass: reach[i] = largest x at grid point i from which the end is reachable at rest
+    std::vector<double> reach(intervals + 1, 0.0);
+    std::vector<HalfPlane> constraints;
+    constraints.reserve(20);
+    for (size_t i = intervals; i-- > 0;) {
+        addConstraints(i, constraints);
+        constraints.push_back({ 1.0, 2.0 * ds, reach[i + 1] });   // x + 2 ds u <= reach[i + 1]
+        constraints.push_back({ -1.0, -2.0 * ds, 0.0 });          // ... >= 0
+        double best = 0.0;
+        if (!maximizeX(constraints, best)) {
+            error = "no feasible path speed " + std::to_string(100.0 * i / intervals) + "% along the path";
+            return false;
+        }
+        reach[i] = std::max(best, 0.0);
+    }
+
+    // Forward pass: from rest, the largest s'' that stays inside the reachable sets
+    std::vector<double> x(intervals + 1, 0.0);
+    std::vector<double> u(intervals, 0.0);
+    std::vector<double> t(intervals + 1, 0.0);
+    for (size_t i = 0; i < intervals; ++i) {
+        double lo = -MAX_PATH_ACCELERATION;
+        double hi = MAX_PATH_ACCELERATION;
+        for (size_t j = 0; j < 7; ++j) {
+            const double amax = limits.maxAcceleration[j] * speedShare[i];
+            if (amax <= 0.0 || std::abs(dqs[i][j]) <= EPS) continue;
+            double b0 = (-amax - ddqs[i][j] * x[i]) / dqs[i][j];
+            double b1 = (amax - ddqs[i][j] * x[i]) / dqs[i][j];
+            lo = std::max(lo, std::min(b0, b1));
+            hi = std::min(hi, std::max(b0, b1));
+        }
+        hi = std::min(hi, (reach[i + 1] - x[i]) / (2.0 * ds));
+        lo = std::max(lo, -x[i] / (2.0 * ds));
+        double accel = hi >= lo ? hi : lo;
+        x[i + 1] = std::clamp(x[i] + 2.0 * ds * accel, 0.0, reach[i + 1]);
+        u[i] = (x[i + 1] - x[i]) / (2.0 * ds);
+        const double speeds = std::sqrt(x[i]) + std::sqrt(x[i + 1]);
+        if (speeds <= 0.0) {
+            error = "the path speed drops to zero " + std::to_string(100.0 * i / intervals) + "% along the path";
+            return false;
+        }
+        t[i + 1] = t[i] + 2.0 * ds / speeds;
+    }
+    const double optimalS = t[intervals];
+
+    // s, s', s'' of the optimal profile at time 'tau'; held at rest outside it
+    auto profileAt = [&](double tau, double& s, double& sd, double& sdd) {
+        if (tau <= 0.0) {
+            s = 0.0; sd = 0.0; sdd = 0.0;
+            return;
+        }
+        if (tau >= optimalS) {
+            s = length; sd = 0.0; sdd = 0.0;
+            return;
+        }
+        size_t i = static_cast<size_t>(std::upper_bound(t.begin(), t.end(), tau) - t.begin()) - 1;
+        i = std::min(i, intervals - 1);
+        const double dt = tau - t[i];
+        const double sd0 = std::sqrt(x[i]);
+        s = std::min(ds * static_cast<double>(i) + sd0 * dt + 0.5 * u[i] * dt * dt, ds * static_cast<double>(i + 1));
+        sd = std::max(sd0 + u[i] * dt, 0.0);
+        sdd = u[i];
+    };
+
+    // Path acceleration jumps between its bounds; averaging it over 2 amax / jmax bounds the jerk
+    double window = 0.0;
+    for (size_t j = 0; j < 7; ++j) {
+        if (limits.maxAcceleration[j] > 0.0 && limits.maxJerk[j] > 0.0) {
+            window = std::max(window, 2.0 * limits.maxAcceleration[j] / limits.maxJerk[j]);
+        }
+    }
+
+    const double rate = rateHz;
+    double stretch = 1.0;
+    std::vector<double> s;
+    std::vector<double> sd;
+    std::vector<double> sdd;
+    for (int pass = 0;; ++pass) {
+        const long halfWindow = std::lround(window * stretch * rate / 2.0);
+        const size_t count = static_cast<size_t>(std::ceil(optimalS * stretch * rate)) + 2 * static_cast<size_t>(halfWindow) + 1;
+        if (count > UINT32_MAX / 2) {
+            error = "the path would take too long";
+            return false;
+        }
+        s.resize(count);
+        sd.resize(count);
+        sdd.resize(count);
+        for (size_t m = 0; m < count; ++m) {
+            // The filter widens the profile by half a window at each end
+            const double time = (static_cast<double>(m) - static_cast<double>(halfWindow)) / rate;
+            profileAt(time / stretch, s[m], sd[m], sdd[m]);
+            sd[m] /= stretch;
+            sdd[m] /= stretch * stretch;
+        }
+        boxFilter(s, halfWindow, 0.0, length);
+        boxFilter(sd, halfWindow, 0.0, 0.0);
+        boxFilter(sdd, halfWindow, 0.0, 0.0);
+
+        // Stretching time by f divides v by f, a by f^2 and j by f^3
+        double worst = 0.0;
+        JointPath::Point q;
+        JointPath::Point dq;
+        JointPath::Point ddq;
+        JointPath::Point previous {};
+        for (size_t m = 0; m < count; ++m) {
+            path.evaluate(s[m], q, dq, ddq);
+            const double share = path.speedAt(s[m]);
+            for (size_t j = 0; j < 7; ++j) {
+                const double v = dq[j] * sd[m];
+                const double a = ddq[j] * sd[m] * sd[m] + dq[j] * sdd[m];
+                const double jerk = m > 0 ? (a - previous[j]) * rate : 0.0;
+                previous[j] = a;
+                if (limits.maxVelocity[j] > 0.0) worst = std::max(worst, std::abs(v) / (limits.maxVelocity[j] * share));
+                if (limits.maxAcceleration[j] > 0.0) worst = std::max(worst, std::sqrt(std::abs(a) / (limits.maxAcceleration[j] * share)));
+                if (limits.maxJerk[j] > 0.0) worst = std::max(worst, std::cbrt(std::abs(jerk) / (limits.maxJerk[j] * share)));
+            }
+        }
+        if (worst <= 1.0) break;
+        if (pass == MAX_STRETCH_PASSES) {
+            error = "could not bring the path under the joint limits (" + std::to_string(worst) + "x over)";
+            return false;
+        }
+        stretch *= worst * STRETCH_MARGIN;
+    }
+
+    samples.resize(s.size());
+    JointPath::Point q;
+    JointPath::Point dq;
+    JointPath::Point ddq;
+    for (size_t m = 0; m < s.size(); ++m) {
+        path.evaluate(s[m], q, dq, ddq);
+        motion_library::Sample& sample = samples[m];
+        for (size_t j = 0; j < 7; ++j) {
+            sample.position[j] = static_cast<float>(q[j]);
+            sample.velocity[j] = static_cast<float>(dq[j] * sd[m]);
+            sample.acceleration[j] = static_cast<float>(ddq[j] * sd[m] * sd[m] + dq[j] * sdd[m]);
+        }
+    }
+
+    result.durationS = static_cast<double>(samples.size()) / rate;
+    result.optimalDurationS = optimalS;
+    result.stretch = stretch;
+    result.gridPoints = intervals + 1;
+    result.computeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return true;
+}
@@ -1,34 +1,182 @@
 #include "real_time_daemon.hpp"
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <stdexcept>
-#include <iostream>
 #include <chrono>
 #include <cstring>
 #include <sstream>
 #include <fcntl.h>
 #include <jsoncpp/json/json.h>
 #include <algorithm>
-#include "utils.hpp"
+#include <map>
+#include <numeric>
+#include <cmath>
+#include "rt_log.hpp"
+#include "rt_alloc_guard.hpp"
+#include "motor_defs.hpp"
+#include "recording.hpp"
+#include "path_parameterization.hpp"
 
 
 namespace
 {
 const char* DEFAULT_SOCKET_PATH = "/home/debian/.armatron/robot_socket";
+const char* EMERGENCY_SOCKET_PATH = "/home/debian/.armatron/estop_socket";
+
+// Pull the value of the "cmd" key out of a JSON line without a full parse
+std::string extractCommandName(const std::string& line)
+{
+    size_t key = line.find("\"cmd\"");
+    if (key == std::string::npos) return {};
+    size_t colon = line.find_first_not_of(" \t", key + 5);
+    if (colon == std::string::npos || line[colon] != ':') return {};
+    size_t open = line.find_first_not_of(" \t", colon + 1);
+    if (open == std::string::npos || line[open] != '"') return {};
+    size_t close = line.find('"', open + 1);
+    if (close == std::string::npos) return {};
+    return line.substr(open + 1, close - open - 1);
+}
+
+std::string toCompactJson(const Json::Value& root)
+{
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, root);
+}
+
+uint64_t toNs(std::chrono::steady_clock::duration d)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+unsigned int checkedControlRate(unsigned int hz)
+{
+    if (!control_rate::valid(hz)) {
+        throw std::runtime_error("[RealTimeDaemon] Control rate " + std::to_string(hz) + " Hz is outside "
+                                 + std::to_string(control_rate::MIN_HZ) + ".." + std::to_string(control_rate::MAX_HZ) + " Hz");
+    }
+    return hz;
+}
+
+Json::Value jointArray(const double (&values)[7])
+{
+    Json::Value arr(Json::arrayValue);
+    for (double v : values) {
+        arr.append(v);
+    }
+    return arr;
+}
+
+// JOINT_n_MAX_* scaled like the motors scale them, in trajectory space (joints 6/7 in differential units)
+void trajectoryLimits(double modifier, std::array<double, 7>& velocity, std::array<double, 7>& acceleration,
+                      std::array<double, 7>& jerk)
+{
+    const double speeds[7] = { JOINT_1_MAX_SPEED, JOINT_2_MAX_SPEED, JOINT_3_MAX_SPEED, JOINT_4_MAX_SPEED,
+                               JOINT_5_MAX_SPEED, DIFF_MAX_SPEED, DIFF_MAX_SPEED };
+    const double accels[7] = { JOINT_1_MAX_ACCEL, JOINT_2_MAX_ACCEL, JOINT_3_MAX_ACCEL, JOINT_4_MAX_ACCEL,
+                               JOINT_5_MAX_ACCEL, DIFF_MAX_ACCEL, DIFF_MAX_ACCEL };
+    const double jerks[7] = { JOINT_1_MAX_JERK, JOINT_2_MAX_JERK, JOINT_3_MAX_JERK, JOINT_4_MAX_JERK,
+                              JOINT_5_MAX_JERK, DIFF_MAX_JERK, DIFF_MAX_JERK };
+    for (size_t i = 0; i < 7; ++i) {
+        double scale = modifier * (i >= 5 ? RobotInterface::DIFFERENTIAL_UNITS_PER_DEG : 1.0);
+        velocity[i] = speeds[i] * scale;
+        acceleration[i] = accels[i] * scale;
+        jerk[i] = jerks[i] * scale;
+    }
+}
+
+Json::Value robotSnapshotJson(const RobotSnapshot& snap)
+{
+    Json::Value reply;
+    reply["type"] = "robotState";
+    reply["sequence"] = static_cast<Json::UInt64>(snap.sequence);
+    if (snap.sequence == 0) {
+        return reply;   // the control loop has not published yet
+    }
+    reply["ageUs"] = static_cast<Json::Int64>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - snap.stamp).count());
+    reply["controlPeriodMs"] = snap.control_period_s * 1000.0;
+    reply["jointAnglesDeg"] = jointArray(snap.joint_angles_deg);
+    reply["jointSpeedsDegS"] = jointArray(snap.joint_speeds_deg_s);
+    reply["jointAccelerationsDegS2"] = jointArray(snap.joint_accelerations_deg_s2);
+    reply["targetJointAnglesDeg"] = jointArray(snap.target_joint_angles_deg);
+    reply["targetJointSpeedsDegS"] = jointArray(snap.target_joint_speeds_deg_s);
+    reply["differential"]["rollRad"] = snap.differential_motors.roll_angle_rad;
+    reply["differential"]["pitchRad"] = snap.differential_motors.pitch_angle_rad;
+    reply["trajectory"]["active"] = snap.trajectory_active;
+    reply["trajectory"]["duration"] = snap.trajectory_duration;
+    reply["trajectory"]["progress"] = snap.trajectory_progress;
+    reply["trajectory"]["mode"] = snap.trajectory_mode == TrajectoryMode::PlanOnce ? "planOnce" : "online";
+    reply["trajectory"]["replans"] = snap.replan_count;
+    reply["trajectory"]["queuedWaypoints"] = snap.queued_waypoints;
+    reply["trajectory"]["trackingErrorDeg"] = snap.tracking_error_deg;
+    reply["trajectory"]["feedOverride"] = snap.feed_override;
+    reply["trajectory"]["feedOverrideTarget"] = snap.feed_override_target;
+    if (snap.motion_clip >= 0) {
+        reply["trajectory"]["motionClip"] = snap.motion_clip;
+    }
+    reply["recording"]["state"] = recordingStateName(snap.recording);
+    reply["recording"]["samples"] = snap.recorded_samples;
+    reply["recording"]["durationS"] = static_cast<double>(snap.recorded_samples) / RobotInterface::RECORDING_RATE_HZ;
+    Json::Value& cache = reply["trajectory"]["cache"];
+    cache["enabled"] = snap.trajectory_cache_enabled;
+    cache["size"] = static_cast<Json::UInt>(snap.trajectory_cache.size);
+    cache["hits"] = static_cast<Json::UInt64>(snap.trajectory_cache.hits);
+    cache["misses"] = static_cast<Json::UInt64>(snap.trajectory_cache.misses);
+    cache["outOfTolerance"] = static_cast<Json::UInt64>(snap.trajectory_cache.outOfTolerance);
+    cache["evictions"] = static_cast<Json::UInt64>(snap.trajectory_cache.evictions);
+    reply["maxSpeedModifier"] = snap.max_speed_modifier;
+    for (const JointGains& g : snap.joint_gains) {
+        Json::Value gains;
+        gains["kp"] = g.kp;
+        gains["ki"] = g.ki;
+        gains["kv"] = g.kv;
+        gains["ka"] = g.ka;
+        gains["maxIntegral"] = g.maxIntegral;
+        reply["jointGains"].append(gains);
+    }
+    reply["twin"]["active"] = snap.twin_active;
+    reply["twin"]["jointAnglesDeg"] = jointArray(snap.twin_joint_angles_deg);
+    if (snap.pose_valid) {
+        double r, p, y;
+        snap.current_pose.M.GetRPY(r, p, y);
+        for (int i = 0; i < 3; ++i) {
+            reply["pose"]["position"].append(snap.current_pose.p(i));
+        }
+        reply["pose"]["rpy"].append(r);
+        reply["pose"]["rpy"].append(p);
+        reply["pose"]["rpy"].append(y);
+    }
+    return reply;
+}
 }
 
 /**********************************************************/
 /* Constructor / Destructor                               */
 /**********************************************************/
-RealTimeDaemon::RealTimeDaemon(RobotInterface& robot)
+RealTimeDaemon::RealTimeDaemon(RobotInterface& robot, unsigned int controlRateHz)
     : m_robot(robot)
     , m_sockfd(-1)
+    , m_epollFd(-1)
+    , m_wakeFd(-1)
     , m_socketPath(DEFAULT_SOCKET_PATH)
+    , m_worker([this] {
+          uint64_t one = 1;
+          ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+          (void)ignored;
+      })
+    , m_emergency(robot, EMERGENCY_SOCKET_PATH)
+    , m_overrun(control_rate::period(checkedControlRate(controlRateHz)))
+    , m_controlRateHz(controlRateHz)
+    , m_subscriptionRateHz(controlRateHz)
 {
+
     // We might remove any stale socket file
     ::unlink(m_socketPath.c_str());
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Constructor: Removed stale socket file if exists.\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Constructor: Removed stale socket file if exists.");
 }
 
 RealTimeDaemon::~RealTimeDaemon()
@@ -42,11 +190,11 @@ RealTimeDaemon::~RealTimeDaemon()
 void RealTimeDaemon::start()
 {
     m_running = true;
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Starting daemon.\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Starting daemon.");
 
-    // 1) Create the socket
-    m_sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Socket created: " << m_sockfd << "\n");
+    // 1) Create the socket (non-blocking, the I/O thread is driven by epoll)
+    m_sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Socket created: {}", m_sockfd);
     if (m_sockfd < 0) {
         throw std::runtime_error("Failed to create Unix domain socket");
     }
@@ -61,25 +209,51 @@ void RealTimeDaemon::start()
         close(m_sockfd);
         throw std::runtime_error("Failed to bind to " + m_socketPath);
     }
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Socket bound to " << m_socketPath << "\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Socket bound to {}", m_socketPath);
 
     // 3) Listen
     if (listen(m_sockfd, 5) < 0) {
         close(m_sockfd);
         throw std::runtime_error("listen() failed");
     }
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Listening on socket.\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Listening on socket.");
+
+    // 4) epoll instance + wake-up eventfd for the I/O thread
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epollFd < 0 || m_wakeFd < 0) {
+        close(m_sockfd);
+        throw std::runtime_error("Failed to create epoll/eventfd");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_sockfd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_sockfd, &ev);
+    ev.data.fd = m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
 
-    // 4) Start the socket thread
+    // 5) Emergency channel first, so ESTOP works before anything else is up
+    m_emergency.start();
+
+    // 6) Start the socket thread and its worker
+    m_worker.start();
     m_socketThread = std::thread(&RealTimeDaemon::socketThreadFunc, this);
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Socket thread started.\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Socket thread started.");
 
-    // 5) Start the real-time control thread
-    m_controlThread = std::thread(&RealTimeDaemon::controlThreadFunc, this);
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Control thread started.\n");
+    // 7) Start the real-time control thread; start() returns once it has configured itself
+    if (!m_controlThread.start(m_rtConfig, m_overrun.period(), [this] { controlThreadFunc(); })) {
+        throw std::runtime_error("[RealTimeDaemon] Failed to start the control thread: " + m_controlThread.report().notes);
+    }
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Control thread started.");
+    const rt::ThreadReport& rtReport = m_controlThread.report();
+    if (rtReport.granted != rtReport.requested || !rtReport.memoryLocked || !rtReport.notes.empty()) {
+        RTLOG_WARN(Daemon, "[RealTimeDaemon] Control thread: {}", rtReport.summary());
+    } else {
+        RTLOG_INFO(Daemon, "[RealTimeDaemon] Control thread: {}", rtReport.summary());
+    }
 
-    std::cout << "[RealTimeDaemon] Started, socket at " << m_socketPath << "\n";
-    std::cout << "[RealTimeDaemon] Control thread running at " << CONTROL_RATE_HZ << " Hz\n";
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] Started, socket at {}", m_socketPath);
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] Control thread running at {} Hz", m_controlRateHz.load());
 }
 
 void RealTimeDaemon::stop()
@@ -87,34 +261,44 @@ void RealTimeDaemon::stop()
     if (!m_running) return;
 
     m_running = false;
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Stopping daemon.\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Stopping daemon.");
 
-    // close socket
-    if (m_sockfd >= 0) {
-        close(m_sockfd);
-        m_sockfd = -1;
-        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Socket closed.\n");
+    // wake the I/O thread so it notices m_running == false
+    if (m_wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+        (void)ignored;
     }
 
     if (m_socketThread.joinable()) {
         m_socketThread.join();
-        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Socket thread joined.\n");
+        RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Socket thread joined.");
     }
+    m_worker.stop();
     if (m_controlThread.joinable()) {
         m_controlThread.join();
-        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Control thread joined.\n");
+        RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Control thread joined.");
     }
+    m_emergency.stop();
 
-    // Close all connected client sockets.
-    {
-        std::lock_guard<std::mutex> lk(m_clientFdsMutex);
-        for (auto fd : m_clientFds) {
-            close(fd);
-        }
-        m_clientFds.clear();
+    // Close all connected client sockets (ClientConnection closes its fd), then the listener.
+    m_clients.clear();
+    refreshTelemetryDemand();
+    if (m_sockfd >= 0) {
+        close(m_sockfd);
+        m_sockfd = -1;
+        RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Socket closed.");
+    }
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+        m_epollFd = -1;
+    }
+    if (m_wakeFd >= 0) {
+        close(m_wakeFd);
+        m_wakeFd = -1;
     }
     ::unlink(m_socketPath.c_str());
-    std::cout << "[RealTimeDaemon] Stopped.\n";
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] Stopped.");
 }
 
 /**********************************************************/
@@ -122,294 +306,1503 @@ void RealTimeDaemon::stop()
 /**********************************************************/
 void RealTimeDaemon::socketThreadFunc()
 {
+    epoll_event events[MAX_EPOLL_EVENTS];
+    m_lastLoopSummary = m_loopTiming.snapshot();
+    m_nextLoopSummary = std::chrono::steady_clock::now() + LOOP_SUMMARY_INTERVAL;
+
     while (m_running) {
-        int clientFd = accept(m_sockfd, nullptr, nullptr);
+        auto untilSummary = std::chrono::duration_cast<std::chrono::milliseconds>(m_nextLoopSummary - std::chrono::steady_clock::now());
+        int n = epoll_wait(m_epollFd, events, MAX_EPOLL_EVENTS, std::max<int>(0, static_cast<int>(untilSummary.count()) + 1));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] epoll_wait error: {}", strerror(errno));
+            break;
+        }
+
+        for (int e = 0; e < n; ++e) {
+            int fd = events[e].data.fd;
+            uint32_t what = events[e].events;
+
+            if (fd == m_sockfd) {
+                acceptClients();
+            } else if (fd == m_wakeFd) {
+                uint64_t count;
+                while (read(m_wakeFd, &count, sizeof(count)) > 0) {}
+                m_worker.runCompletions();
+                if (m_controlRateHz.load(std::memory_order_relaxed) != m_subscriptionRateHz) {
+                    rescaleSubscriptions();
+                }
+                distributeTelemetry();
+                distributeOutbound();
+                distributeRoutineProgress();
+            } else {
+                auto it = m_clients.find(fd);
+                if (it == m_clients.end()) continue;
+                ClientConnection& client = *it->second;
+
+                bool keep = true;
+                if (what & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    keep = handleClientReadable(client);
+                }
+                if (keep && (what & EPOLLOUT)) {
+                    keep = flushClient(client);
+                }
+                if (!keep) {
+                    closeClient(fd);
+                }
+            }
+        }
+
+        m_commandTracer.drain();
+        m_robot.trackingStats().drain();
+        if (std::chrono::steady_clock::now() >= m_nextLoopSummary) {
+            logLoopSummary();
+        }
+    }
+}
+
+void RealTimeDaemon::logLoopSummary()
+{
+    LoopTiming::Snapshot now = m_loopTiming.snapshot();
+    LoopTiming::Snapshot interval = now.since(m_lastLoopSummary);
+    m_lastLoopSummary = now;
+    m_nextLoopSummary += LOOP_SUMMARY_INTERVAL;
+    if (interval.cycles == 0) return;
+
+    uint64_t allocations = rtalloc::allocationCount();
+    uint64_t newAllocations = allocations - m_lastLoopSummaryAllocations;
+    m_lastLoopSummaryAllocations = allocations;
+
+    // Quiet when healthy: a missed deadline or an allocation on the control thread makes the summary a warning
+    rtlog::Level level = (interval.missedDeadlines > 0 || newAllocations > 0) ? rtlog::Level::Warn : rtlog::Level::Info;
+    std::string summary = interval.summary(m_overrun.period().count() / 1000.0);
+    if (rtalloc::enabled()) {
+        rtlog::log(level, rtlog::Module::Daemon, "[RealTimeDaemon] Loop: {} | {} heap allocations ({}/cycle)", summary,
+                   newAllocations, static_cast<double>(newAllocations) / interval.cycles);
+    } else {
+        rtlog::log(level, rtlog::Module::Daemon, "[RealTimeDaemon] Loop: {}", summary);
+    }
+}
+
+void RealTimeDaemon::acceptClients()
+{
+    while (true) {
+        int clientFd = accept4(m_sockfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (clientFd < 0) {
-            if (!m_running) break;
-            std::cerr << "[RealTimeDaemon] Accept error.\n";
-            continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && m_running) {
+                RTLOG_ERROR(Daemon, "[RealTimeDaemon] Accept error: {}", strerror(errno));
+            }
+            return;
         }
-        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Accepted client FD=" << clientFd << "\n");
+        RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Accepted client FD={}", clientFd);
 
-        {
-            // Add the client FD to our list.
-            std::lock_guard<std::mutex> lk(m_clientFdsMutex);
-            m_clientFds.push_back(clientFd);
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = clientFd;
+        if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, clientFd, &ev) < 0) {
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] Failed to register client FD={}", clientFd);
+            close(clientFd);
+            continue;
         }
-        // Spawn a new thread to handle incoming messages from this client.
-        std::thread(&RealTimeDaemon::clientHandler, this, clientFd).detach();
+        m_clients[clientFd] = std::make_unique<ClientConnection>(clientFd, m_defaultClientQueueSize, m_defaultClientPolicy);
     }
 }
 
-// This method handles reading from a single client connection.
-void RealTimeDaemon::clientHandler(int clientFd)
+// Reads from a single client connection until the socket would block.
+bool RealTimeDaemon::handleClientReadable(ClientConnection& client)
 {
-    char buf[1024];
-    std::stringstream partial;
-    while (m_running) {
-        ssize_t r = recv(clientFd, buf, sizeof(buf), 0);
-        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Received " << r << " bytes from client FD=" << clientFd << "\n");
-        if (r <= 0) {
-            if (!partial.str().empty()) {
-                std::string line = partial.str();
-                std::lock_guard<std::mutex> lk(m_inboundMutex);
-                m_inboundQueue.push( IPCMessage{ line } );
-                IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Flushed partial JSON: " << line << "\n");
+    char buf[4096];
+    ipc::FrameType frameType;
+    std::string payload;
+
+    while (true) {
+        ssize_t r = recv(client.fd(), buf, sizeof(buf), 0);
+        m_lastReceiveTime = std::chrono::steady_clock::now();
+        RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Received {} bytes from client FD={}", r, client.fd());
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        if (r == 0) {
+            std::string& partial = client.pendingText();
+            if (client.protocol() == ClientProtocol::Json && !partial.empty()) {
+                RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Flushed partial JSON: {}", partial);
+                processJsonLine(client, partial);
             }
-            break;
+            return false;
         }
-        for (int i = 0; i < r; i++) {
-            if (buf[i] == '\n') {
-                std::string line = partial.str();
-                partial.str(std::string());
-                partial.clear();
-                IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Received JSON line: " << line << "\n");
-                if (!line.empty()) {
-                    // Check if this is a high-priority command
-                    bool is_high_priority = false;
-                    if (line.find("\"cmd\":\"setESTOP\"") != std::string::npos || 
-                        line.find("\"cmd\": \"setESTOP\"") != std::string::npos ||
-                        line.find("\"cmd\":\"setHoldPosition\"") != std::string::npos || 
-                        line.find("\"cmd\": \"setHoldPosition\"") != std::string::npos) {
-                        is_high_priority = true;
-                        std::cout << "[RealTimeDaemon] Received HIGH PRIORITY command: " 
-                                  << (line.find("setESTOP") != std::string::npos ? "ESTOP" : "HOLD POSITION") 
-                                  << " - clearing command queue!" << std::endl;
-                    }
-                    
-                    if (is_high_priority) {
-                        std::lock_guard<std::mutex> lk(m_inboundMutex);
-                        IPCMessage message{line};
-                        
-                        // Clear the queue of any pending commands
-                        std::queue<IPCMessage> empty;
-                        std::swap(m_inboundQueue, empty);
-                        
-                        // Execute the high-priority command immediately
-                        if (line.find("setESTOP") != std::string::npos) {
-                            handleEmergencyStop();
-                        } else if (line.find("setHoldPosition") != std::string::npos) {
-                            handleHoldPosition();
-                        }
-                    } else {
-                        // Normal commands go through the queue
-                        std::lock_guard<std::mutex> lk(m_inboundMutex);
-                        IPCMessage message{line}; // Non-high-priority message
-                        m_inboundQueue.push(message);
-                        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Pushed JSON line into queue: " << line << "\n");
-                    }
+
+        if (client.protocol() == ClientProtocol::Binary) {
+            client.frames().append(buf, r);
+        } else {
+            client.pendingText().append(buf, r);
+        }
+
+        // Decide the protocol from the first bytes of the connection
+        if (client.protocol() == ClientProtocol::Unknown) {
+            std::string& pending = client.pendingText();
+            if (pending[0] != ipc::HELLO_MAGIC[0]) {
+                client.setProtocol(ClientProtocol::Json);
+                refreshTelemetryDemand();
+            } else if (pending.size() >= ipc::HELLO_SIZE) {
+                uint16_t version = 0;
+                if (!ipc::parseHello(reinterpret_cast<const uint8_t*>(pending.data()), pending.size(), version)) {
+                    RTLOG_ERROR(Daemon, "[RealTimeDaemon] Invalid binary hello from client FD={}. Closing connection.", client.fd());
+                    return false;
                 }
+                auto ack = std::make_shared<std::string>();
+                ipc::appendHelloAck(*ack);
+                client.enqueue(std::move(ack), MessageKind::Control);
+                RTLOG_INFO(Daemon, "[RealTimeDaemon] Client FD={} switched to binary protocol v{}", client.fd(), version);
+                client.frames().append(pending.data() + ipc::HELLO_SIZE, pending.size() - ipc::HELLO_SIZE);
+                pending.clear();
+                client.setProtocol(ClientProtocol::Binary);
+                refreshTelemetryDemand();
+                if (!flushClient(client)) return false;
             } else {
-                partial << buf[i];
+                continue; // wait for the rest of the hello
+            }
+        }
+
+        if (client.protocol() == ClientProtocol::Binary) {
+            while (client.frames().next(frameType, payload)) {
+                processBinaryFrame(client, frameType, payload);
+            }
+            if (client.frames().corrupt()) {
+                RTLOG_ERROR(Daemon, "[RealTimeDaemon] Oversized binary frame from client FD={}. Closing connection.", client.fd());
+                return false;
+            }
+        } else {
+            std::string& partial = client.pendingText();
+            size_t lineStart = 0;
+            size_t newline;
+            while ((newline = partial.find('\n', lineStart)) != std::string::npos) {
+                if (newline > lineStart) {
+                    processJsonLine(client, partial.substr(lineStart, newline - lineStart));
+                }
+                lineStart = newline + 1;
+            }
+            partial.erase(0, lineStart);
+            if (partial.size() > MAX_CLIENT_LINE_BYTES) {
+                RTLOG_ERROR(Daemon, "[RealTimeDaemon] Oversized JSON line from client FD={}. Closing connection.", client.fd());
+                return false;
             }
         }
     }
-    close(clientFd);
+}
+
+bool RealTimeDaemon::flushClient(ClientConnection& client)
+{
+    ClientConnection::FlushResult result = client.flush();
+    if (result == ClientConnection::FlushResult::Error) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Error writing to client FD={}. Closing connection.", client.fd());
+        return false;
+    }
+
+    // Only ask for EPOLLOUT while there is something left to write
+    bool wantWrite = (result == ClientConnection::FlushResult::WouldBlock);
+    if (wantWrite != client.writeArmed()) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.fd = client.fd();
+        epoll_ctl(m_epollFd, EPOLL_CTL_MOD, client.fd(), &ev);
+        client.setWriteArmed(wantWrite);
+    }
+    return true;
+}
+
+void RealTimeDaemon::closeClient(int fd)
+{
+    auto it = m_clients.find(fd);
+    if (it == m_clients.end()) return;
+
+    const ClientStats& stats = it->second->stats();
+    if (stats.droppedMessages > 0 || stats.coalescedMessages > 0) {
+        RTLOG_INFO(Daemon, "[RealTimeDaemon] Client FD={} dropped {} and coalesced {} state frames",
+                   fd, stats.droppedMessages, stats.coalescedMessages);
+    }
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    m_clients.erase(it); // closes the fd
+    refreshTelemetryDemand();
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Closed client FD={}", fd);
+}
+
+void RealTimeDaemon::distributeOutbound()
+{
+    std::vector<OutboundMessage> pending;
+    {
+        std::lock_guard<rt::PiMutex> lk(m_outboundMutex);
+        pending.swap(m_outboundQueue);
+    }
+
+    std::vector<int> failed;
+    for (const auto& msg : pending) {
+        for (auto& [fd, client] : m_clients) {
+            if (client->protocol() == msg.protocol && !client->enqueue(msg.data, msg.kind)) {
+                RTLOG_ERROR(Daemon, "[RealTimeDaemon] Client FD={} cannot keep up (policy {}). Disconnecting.",
+                            fd, slowConsumerPolicyName(client->policy()));
+                failed.push_back(fd);
+            }
+        }
+    }
+
+    for (auto& [fd, client] : m_clients) {
+        if (client->hasPendingOutput() && !client->writeArmed() && !flushClient(*client)) {
+            failed.push_back(fd);
+        }
+    }
+    for (int fd : failed) {
+        closeClient(fd);
+    }
+}
+
+void RealTimeDaemon::distributeTelemetry()
+{
+    if (!m_telemetry.update()) return;
+    const TelemetrySnapshot& snap = m_telemetry.read();
+
+    // Legacy clients have no groups; use a key no subscription can have
+    constexpr uint32_t LEGACY_KEY = ~0u;
+    std::map<std::pair<ClientProtocol, uint32_t>, ClientConnection::Buffer> encoded;
+
+    struct DeltaFrame
     {
-        std::lock_guard<std::mutex> lk(m_clientFdsMutex);
-        auto it = std::find(m_clientFds.begin(), m_clientFds.end(), clientFd);
-        if (it != m_clientFds.end()) {
-            m_clientFds.erase(it);
+        ClientConnection::Buffer data;
+        bool keyframe = false;
+    };
+    std::map<DeltaStreamKey, DeltaFrame> deltaFrames;
+
+    std::vector<int> failed;
+    for (auto& [fd, client] : m_clients) {
+        if (client->protocol() == ClientProtocol::Unknown) continue;
+
+        const telemetry::Subscription& sub = client->subscription();
+        unsigned int divider = sub.active ? sub.divider : control_rate::divider(m_subscriptionRateHz, STATE_BROADCAST_RATE_HZ);
+        if (snap.cycle % divider != 0) continue;
+        bool binary = client->protocol() == ClientProtocol::Binary;
+
+        bool ok = true;
+        if (sub.active && sub.delta) {
+            // Each delta stream advances once per snapshot, however many clients share it
+            DeltaStreamKey key = deltaStreamKey(*client);
+            auto [frameIt, isNew] = deltaFrames.try_emplace(key);
+            auto& encoder = m_deltaEncoders[key];
+            if (isNew) {
+                if (!encoder) {
+                    encoder = std::make_unique<telemetry::DeltaEncoder>(binary, sub.groups, sub.deltaOptions);
+                }
+                frameIt->second.data = encoder->encode(snap, frameIt->second.keyframe);
+            }
+            const DeltaFrame& frame = frameIt->second;
+
+            // Keyframes are control messages so a slow-consumer policy never drops the base of later deltas
+            if (frame.keyframe) {
+                ok = client->enqueue(frame.data, MessageKind::Control);
+                client->setNeedsKeyframe(false);
+            } else {
+                if (client->needsKeyframe()) {
+                    ok = client->enqueue(encoder->lastKeyframe(), MessageKind::Control);
+                    client->setNeedsKeyframe(false);
+                }
+                ok = ok && client->enqueue(frame.data, MessageKind::State);
+            }
+        } else {
+            // Identical subscriptions share one encoded buffer
+            auto key = std::make_pair(client->protocol(), sub.active ? sub.groups : LEGACY_KEY);
+            ClientConnection::Buffer& buf = encoded[key];
+            if (!buf) {
+                if (!sub.active) {
+                    buf = std::make_shared<const std::string>(binary ? telemetry::encodeLegacyBinary(snap)
+                                                                     : telemetry::encodeLegacyJson(snap));
+                } else {
+                    buf = std::make_shared<const std::string>(binary ? telemetry::encodeBinary(snap, sub.groups)
+                                                                     : telemetry::encodeJson(snap, sub.groups));
+                }
+            }
+            ok = client->enqueue(buf, MessageKind::State);
+        }
+
+        if (!ok) {
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] Client FD={} cannot keep up (policy {}). Disconnecting.",
+                        fd, slowConsumerPolicyName(client->policy()));
+            failed.push_back(fd);
         }
     }
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Closed client FD=" << clientFd << "\n");
+    for (int fd : failed) {
+        closeClient(fd);
+    }
+}
+
+RealTimeDaemon::DeltaStreamKey RealTimeDaemon::deltaStreamKey(const ClientConnection& client)
+{
+    const telemetry::Subscription& sub = client.subscription();
+    return DeltaStreamKey{ client.protocol(), sub.groups, sub.divider,
+                           sub.deltaOptions.keyframeInterval, sub.deltaOptions.thresholds };
+}
+
+void RealTimeDaemon::refreshTelemetryDemand()
+{
+    unsigned int legacy = 0;
+    unsigned int divider = 0;
+    bool cartesian = false;
+    std::map<DeltaStreamKey, std::unique_ptr<telemetry::DeltaEncoder>> usedEncoders;
+    for (auto& [fd, client] : m_clients) {
+        if (client->protocol() == ClientProtocol::Unknown) continue;
+        const telemetry::Subscription& sub = client->subscription();
+        if (!sub.active) {
+            legacy++;
+            continue;
+        }
+        if (sub.delta) {
+            DeltaStreamKey key = deltaStreamKey(*client);
+            auto it = m_deltaEncoders.find(key);
+            if (it != m_deltaEncoders.end()) {
+                usedEncoders.emplace(key, std::move(it->second));
+            }
+        }
+        // The control thread publishes every gcd(dividers) cycles, which serves every subscriber
+        divider = std::gcd(divider, sub.divider);
+        cartesian = cartesian || (sub.groups & telemetry::Cartesian);
+    }
+    m_deltaEncoders.swap(usedEncoders);
+    m_legacyClientCount = legacy;
+    m_telemetryDivider = divider;
+    m_cartesianWanted = cartesian;
+}
+
+void RealTimeDaemon::rescaleSubscriptions()
+{
+    unsigned int rate = m_controlRateHz.load(std::memory_order_relaxed);
+    for (auto& [fd, client] : m_clients) {
+        telemetry::Subscription sub = client->subscription();
+        if (!sub.active) continue;
+        if (sub.rateHz > 0.0) {
+            sub.divider = control_rate::divider(rate, sub.rateHz);
+        }
+        sub.divider = std::clamp(sub.divider, 1u, rate * MAX_TELEMETRY_PERIOD_S);
+        client->setSubscription(sub);
+    }
+    m_subscriptionRateHz = rate;
+    refreshTelemetryDemand();
+}
+
+void RealTimeDaemon::postOutbound(ClientProtocol protocol, MessageKind kind, std::string data)
+{
+    {
+        std::lock_guard<rt::PiMutex> lk(m_outboundMutex);
+        m_outboundQueue.push_back(OutboundMessage{ protocol, kind, std::make_shared<const std::string>(std::move(data)) });
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+bool RealTimeDaemon::replyToClient(ClientConnection& client, const std::string& json)
+{
+    auto out = std::make_shared<std::string>();
+    if (client.protocol() == ClientProtocol::Binary) {
+        ipc::appendFrame(*out, ipc::FrameType::Json, reinterpret_cast<const uint8_t*>(json.data()), json.size());
+    } else {
+        *out = json + "\n";
+    }
+    if (!client.enqueue(std::move(out), MessageKind::Control)) {
+        // The client is not reading; epoll will report the hang-up or the next broadcast disconnects it
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Reply to client FD={} dropped, outbound queue full", client.fd());
+        return false;
+    }
+    return flushClient(client);
 }
 
+bool RealTimeDaemon::replyToClient(int fd, const std::string& json)
+{
+    auto it = m_clients.find(fd);
+    return it != m_clients.end() && replyToClient(*it->second, json);
+}
+
+void RealTimeDaemon::handleIoCommand(ClientConnection& client, const commands::CommandSpec& spec, const std::string& line)
+{
+    Json::CharReaderBuilder rb;
+    Json::Value root;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(rb.newCharReader());
+    if (!reader->parse(line.data(), line.data() + line.size(), &root, &errs) || !root.isObject()) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Invalid JSON: {}", errs);
+        return;
+    }
+
+    commands::CommandArgs args;
+    std::string error;
+    if (!commands::parseJson(spec, root, args, error)) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] {}: {}", spec.name, error);
+        return;
+    }
+    commands::executeIo(spec, *this, client, root, args);
+}
 
 /**********************************************************/
-/* Control Thread                                         */
+/* I/O-thread command handlers (IoThread table entries)   */
 /**********************************************************/
-bool RealTimeDaemon::configureRealTimeThread()
+void IoCommands::setClientPolicy(Context& c, const Args& a)
 {
-    // First try to get real-time scheduling
-    struct sched_param param;
-    param.sched_priority = RT_THREAD_PRIORITY;
-    
-    int result = sched_setscheduler(0, RT_THREAD_POLICY, &param);
-    if (result != 0) {
-        if (errno == EPERM) {
-            std::cerr << "[RealTimeDaemon] Warning: No permission for real-time scheduling.\n"
-                      << "Please ensure the systemd service has proper real-time settings:\n"
-                      << "1. Check that the service file is installed in /etc/systemd/system/\n"
-                      << "2. Run: sudo systemctl daemon-reload\n"
-                      << "3. Run: sudo systemctl restart armatron-control.service\n";
+    // {"cmd":"setClientPolicy","policy":"coalesce","maxQueue":64}
+    SlowConsumerPolicy policy = c.client.policy();
+    if (c.has(0) && !parseSlowConsumerPolicy(c.text(0), policy)) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] setClientPolicy: unknown policy {}", c.text(0));
+        return;
+    }
+    c.client.setPolicy(policy);
+    if (c.has(1)) {
+        c.client.setMaxQueuedMessages(static_cast<size_t>(a.i(1)));
+    }
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] Client FD={} policy={} maxQueue={}", c.client.fd(),
+               slowConsumerPolicyName(c.client.policy()), c.client.maxQueuedMessages());
+}
+
+void IoCommands::getClientStats(Context& c, const Args&)
+{
+    c.daemon.replyToClient(c.client, c.daemon.clientStatsJson());
+}
+
+void IoCommands::subscribe(Context& c, const Args&)
+{
+    c.daemon.handleSubscribe(c.client, true, c.request);
+}
+
+void IoCommands::unsubscribe(Context& c, const Args&)
+{
+    c.daemon.handleSubscribe(c.client, false, c.request);
+}
+
+void IoCommands::listCommands(Context& c, const Args&)
+{
+    Json::Value reply;
+    reply["type"] = "commands";
+    reply["commands"] = commands::describe();
+    c.daemon.replyToClient(c.client, toCompactJson(reply));
+}
+
+void IoCommands::getRobotState(Context& c, const Args&)
+{
+    // Coherent copy of the last completed control cycle - never the live state
+    c.daemon.replyToClient(c.client, toCompactJson(robotSnapshotJson(c.daemon.m_robot.latestSnapshot())));
+}
+
+void IoCommands::getLoopStats(Context& c, const Args&)
+{
+    RealTimeDaemon& d = c.daemon;
+    Json::Value reply = d.m_loopTiming.snapshot().toJson(d.m_overrun.period().count() / 1000.0);
+    reply["type"] = "loopStats";
+    OverrunStats ov = d.m_overrun.stats();
+    reply["overrun"]["policy"] = overrunPolicyName(ov.config.policy);
+    reply["overrun"]["downrateAfter"] = ov.config.downrateAfter;
+    reply["overrun"]["recoverAfter"] = ov.config.recoverAfter;
+    reply["overrun"]["skippedTicks"] = static_cast<Json::UInt64>(ov.skippedTicks);
+    reply["overrun"]["shedTransitions"] = static_cast<Json::UInt64>(ov.shedTransitions);
+    reply["overrun"]["rateTransitions"] = static_cast<Json::UInt64>(ov.rateTransitions);
+    reply["overrun"]["shedLevel"] = shedLevelName(ov.shedLevel);
+    reply["overrun"]["rateHz"] = 1e9 / d.m_overrun.period().count();
+    reply["controlRateHz"] = d.m_controlRateHz.load();
+    if (unsigned int requested = d.m_requestedRateHz.load()) {
+        reply["requestedRateHz"] = requested;
+    }
+    reply["droppedCommands"] = static_cast<Json::UInt64>(d.m_droppedCommands.load());
+    reply["droppedLogRecords"] = static_cast<Json::UInt64>(rtlog::droppedCount());
+    reply["rt"] = d.m_controlThread.report().toJson();
+    if (rtalloc::enabled()) {
+        reply["rtAllocations"] = static_cast<Json::UInt64>(rtalloc::allocationCount());
+    }
+    d.replyToClient(c.client, toCompactJson(reply));
+}
+
+void IoCommands::setOverrunPolicy(Context& c, const Args& a)
+{
+    // {"cmd":"setOverrunPolicy","policy":"shed","downrateAfter":10,"recoverAfter":1000}
+    OverrunConfig config = c.daemon.m_overrun.stats().config;
+    if (c.has(0) && !parseOverrunPolicy(c.text(0), config.policy)) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] setOverrunPolicy: unknown policy {}", c.text(0));
+        return;
+    }
+    if (c.has(1)) config.downrateAfter = static_cast<unsigned int>(a.i(1));
+    if (c.has(2)) config.recoverAfter = static_cast<unsigned int>(a.i(2));
+    c.daemon.m_overrun.configure(config);
+}
+
+void IoCommands::setControlRate(Context& c, const Args& a)
+{
+    // {"cmd":"setControlRate","rateHz":500} - the schema already checked MIN_HZ..MAX_HZ
+    c.daemon.setControlRate(static_cast<unsigned int>(a.i(0)));
+}
+
+void IoCommands::setLogLevel(Context& c, const Args&)
+{
+    // {"cmd":"setLogLevel","level":"debug"} or {"cmd":"setLogLevel","level":"warn","module":"can"}
+    rtlog::Level level;
+    if (!rtlog::parseLevel(c.text(0), level)) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] setLogLevel: unknown level {}", c.text(0));
+        return;
+    }
+    if (c.has(1)) {
+        rtlog::Module module;
+        if (!rtlog::parseModule(c.text(1), module)) {
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] setLogLevel: unknown module {}", c.text(1));
+            return;
+        }
+        rtlog::setLevel(module, level);
+    } else {
+        rtlog::setLevel(level);
+    }
+}
+
+void IoCommands::getEstopStats(Context& c, const Args&)
+{
+    EmergencyStats st = c.daemon.m_emergency.stats();
+    Json::Value reply;
+    reply["type"] = "estopStats";
+    reply["count"] = static_cast<Json::UInt64>(st.count);
+    reply["overBudget"] = static_cast<Json::UInt64>(st.overBudget);
+    reply["failed"] = static_cast<Json::UInt64>(st.failed);
+    reply["lastUs"] = st.lastUs;
+    reply["maxUs"] = st.maxUs;
+    reply["meanUs"] = st.meanUs;
+    reply["budgetUs"] = EmergencyChannel::LATENCY_BUDGET_US;
+    reply["socket"] = c.daemon.m_emergency.socketPath();
+    c.daemon.replyToClient(c.client, toCompactJson(reply));
+}
+
+void IoCommands::getCommandLatency(Context& c, const Args&)
+{
+    // Per command: parse, queue, execute, egress and total (recv -> first CAN frame) histograms
+    c.daemon.m_commandTracer.drain();
+    Json::Value reply = c.daemon.m_commandTracer.toJson();
+    reply["type"] = "commandLatency";
+    c.daemon.replyToClient(c.client, toCompactJson(reply));
+}
+
+void IoCommands::exportCommandTrace(Context& c, const Args&)
+{
+    // {"cmd":"exportCommandTrace","path":"/tmp/trace.json"} - open in ui.perfetto.dev or chrome://tracing
+    // The traces are copied here; building and writing the JSON happens on the worker
+    RealTimeDaemon& d = c.daemon;
+    d.m_commandTracer.drain();
+    std::string path = c.text(0, RealTimeDaemon::DEFAULT_TRACE_PATH);
+    int fd = c.client.fd();
+    d.m_worker.post([&d, fd, path, traces = d.m_commandTracer.recent()]() -> IoWorker::Completion {
+        std::string error;
+        Json::Value reply;
+        reply["type"] = "commandTrace";
+        reply["path"] = path;
+        reply["ok"] = CommandTracer::exportChromeTrace(traces, path, error);
+        if (!error.empty()) {
+            reply["error"] = error;
+        }
+        return [&d, fd, reply] {
+            if (reply.isMember("error")) {
+                RTLOG_ERROR(Daemon, "[RealTimeDaemon] exportCommandTrace: {}", reply["error"].asString());
+            }
+            d.replyToClient(fd, toCompactJson(reply));
+        };
+    });
+}
+
+void IoCommands::resetCommandLatency(Context& c, const Args&)
+{
+    c.daemon.m_commandTracer.reset();
+}
+
+void IoCommands::getTrackingStats(Context& c, const Args&)
+{
+    TrackingStats& stats = c.daemon.m_robot.trackingStats();
+    stats.drain();
+    Json::Value reply = stats.toJson();
+    reply["type"] = "trackingStats";
+    c.daemon.replyToClient(c.client, toCompactJson(reply));
+}
+
+void IoCommands::resetTrackingStats(Context& c, const Args&)
+{
+    c.daemon.m_robot.trackingStats().reset();
+}
+
+void IoCommands::uploadRoutine(Context& c, const Args&)
+{
+    c.daemon.handleUploadRoutine(c.client, c.request);
+}
+
+void IoCommands::stopRoutine(Context& c, const Args&)
+{
+    // The active segment still ends at rest on its waypoint
+    c.daemon.m_routineStopRequested = true;
+}
+
+void IoCommands::getRoutineStatus(Context& c, const Args&)
+{
+    RealTimeDaemon& d = c.daemon;
+    d.m_routineStatus.update();
+    Json::Value reply = d.m_routineStatus.read().toJson();
+    reply["type"] = "routineStatus";
+    d.replyToClient(c.client, toCompactJson(reply));
+}
+
+void IoCommands::listMotions(Context& c, const Args&)
+{
+    // Clips of the motion library, by the index "playMotion" takes
+    RealTimeDaemon& d = c.daemon;
+    Json::Value reply;
+    reply["type"] = "motions";
+    reply["motions"] = Json::Value(Json::arrayValue);
+    if (d.m_offeredLibrary >= 0) {
+        const MotionLibrary* library = &d.m_motionLibraries[d.m_offeredLibrary];
+        reply["path"] = library->path();
+        reply["pending"] = d.m_robot.motionLibraryInUse() != library;   // adopted after the playing clip
+        for (size_t i = 0; i < library->size(); ++i) {
+            const MotionClip& clip = library->clip(i);
+            Json::Value m;
+            m["index"] = static_cast<Json::UInt>(i);
+            m["name"] = clip.name;
+            m["rateHz"] = clip.rateHz;
+            m["samples"] = clip.sampleCount;
+            m["durationS"] = clip.duration();
+            reply["motions"].append(m);
+        }
+    }
+    d.replyToClient(c.client, toCompactJson(reply));
+}
+
+void IoCommands::loadMotionLibrary(Context& c, const Args&)
+{
+    // {"cmd":"loadMotionLibrary","path":"/home/debian/.armatron/motions.armmot"}
+    // The file is opened (mmap, index parsed) on the worker, into the slot the control thread does not use
+    RealTimeDaemon& d = c.daemon;
+    std::string path = c.text(0, RealTimeDaemon::DEFAULT_MOTION_LIBRARY_PATH);
+    int fd = c.client.fd();
+    auto reply = [&d, fd, path](const std::string& error) {
+        Json::Value reply;
+        reply["type"] = "motionLibrary";
+        reply["path"] = path;
+        reply["ok"] = error.empty();
+        if (!error.empty()) {
+            reply["error"] = error;
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] loadMotionLibrary: {}", error);
         } else {
-            std::cerr << "[RealTimeDaemon] Warning: Failed to set real-time scheduling policy: " 
-                      << strerror(errno) << std::endl;
+            reply["clips"] = static_cast<Json::UInt>(d.m_motionLibraries[d.m_offeredLibrary].size());
+        }
+        d.replyToClient(fd, toCompactJson(reply));
+    };
+
+    int slot = 0;
+    std::string error;
+    if (!d.reserveLibrarySlot(slot, error)) {
+        reply(error);
+        return;
+    }
+    MotionLibrary* library = &d.m_motionLibraries[slot];
+    d.m_worker.post([&d, slot, library, path, reply]() -> IoWorker::Completion {
+        std::string error;
+        bool loaded = library->open(path, error);
+        return [&d, slot, loaded, error, reply] {
+            d.releaseLibrarySlot(slot, loaded);
+            reply(error);
+        };
+    });
+}
+
+void IoCommands::saveRecording(Context& c, const Args&)
+{
+    c.daemon.handleSaveRecording(c.client, c.request);
+}
+
+void IoCommands::compileRecording(Context& c, const Args&)
+{
+    c.daemon.handleCompileRecording(c.client, c.request);
+}
+
+void IoCommands::compilePath(Context& c, const Args&)
+{
+    c.daemon.handleCompilePath(c.client, c.request);
+}
+
+// {"cmd":"uploadRoutine","name":"pick","speed":0.5,"waypoints":[{"angles":[...]},{"pose":{...},"dwell":1}]}
+// See parseRoutine for the format; "replace":true stops a running routine instead of rejecting the upload
+void RealTimeDaemon::handleUploadRoutine(ClientConnection& client, const Json::Value& root)
+{
+    Json::Value reply;
+    reply["type"] = "routineUpload";
+    std::string error;
+
+    m_routineStatus.update();
+    const RoutineStatus& current = m_routineStatus.read();
+    if (current.state == RoutineState::Running && !root.get("replace", false).asBool()) {
+        error = "routine " + std::to_string(current.id) + " is running; send stopRoutine or \"replace\":true";
+    } else {
+        Routine& routine = m_routineUploads.writeBuffer();
+        if (parseRoutine(root, routineKinematics(), ikSeed(), routine, error)) {
+            routine.id = m_nextRoutineId++;
+            m_routineUploads.publish();
+            reply["id"] = routine.id;
+            reply["steps"] = static_cast<Json::UInt>(routine.count);
+            RTLOG_INFO(Daemon, "[RealTimeDaemon] Routine {} '{}' uploaded by FD={}, {} waypoints",
+                       routine.id, routine.name.data(), client.fd(), routine.count);
+        }
+    }
+
+    reply["ok"] = error.empty();
+    if (!error.empty()) {
+        reply["error"] = error;
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] uploadRoutine rejected: {}", error);
+    }
+    replyToClient(client, toCompactJson(reply));
+}
+
+bool RealTimeDaemon::loadMotionLibrary(const std::string& path, std::string& error)
+{
+    int slot = 0;
+    if (!reserveLibrarySlot(slot, error)) {
+        return false;
+    }
+    bool loaded = m_motionLibraries[slot].open(path, error);
+    releaseLibrarySlot(slot, loaded);
+    return loaded;
+}
+
+bool RealTimeDaemon::reserveLibrarySlot(int& slot, std::string& error)
+{
+    if (m_libraryBusy) {
+        error = "another motion library update is running, try again";
+        return false;
+    }
+    if (m_offeredLibrary >= 0 && m_robot.motionLibraryInUse() != &m_motionLibraries[m_offeredLibrary]) {
+        error = "the previous library is not in use yet (a clip is playing), try again";
+        return false;
+    }
+    // The other slot is not the one the control thread plays from
+    slot = m_offeredLibrary == 0 ? 1 : 0;
+    m_libraryBusy = true;
+    return true;
+}
+
+void RealTimeDaemon::releaseLibrarySlot(int slot, bool loaded)
+{
+    m_libraryBusy = false;
+    if (loaded) {
+        m_robot.offerMotionLibrary(&m_motionLibraries[slot]);
+        m_offeredLibrary = slot;
+    }
+}
+
+std::string RealTimeDaemon::motionLibraryPath(const Json::Value& root) const
+{
+    std::string path = m_offeredLibrary >= 0 ? m_motionLibraries[m_offeredLibrary].path() : DEFAULT_MOTION_LIBRARY_PATH;
+    return root.get("library", path).asString();
+}
+
+double RealTimeDaemon::speedModifier()
+{
+    const RobotSnapshot& snap = m_robot.latestSnapshot();
+    return snap.max_speed_modifier > 0.0f ? snap.max_speed_modifier : 1.0;
+}
+
+const MotionLibrary* RealTimeDaemon::offeredLibrary() const
+{
+    return m_offeredLibrary >= 0 ? &m_motionLibraries[m_offeredLibrary] : nullptr;
+}
+
+bool RealTimeDaemon::addMotionClip(MotionClipData clip, const std::string& libraryPath, const MotionLibrary* offered,
+                                   MotionLibrary& target, size_t& index, std::string& error)
+{
+    // Rewrite the library with the other clips unchanged
+    std::vector<MotionClipData> clips;
+    if (access(libraryPath.c_str(), F_OK) == 0) {
+        MotionLibrary existing;
+        const MotionLibrary* library = &existing;
+        if (offered && offered->path() == libraryPath) {
+            library = offered;
+        } else if (!existing.open(libraryPath, error)) {
+            return false;
         }
-        
-        // Try to get maximum normal priority as fallback
-        param.sched_priority = sched_get_priority_max(SCHED_OTHER);
-        if (sched_setscheduler(0, SCHED_OTHER, &param) != 0) {
-            std::cerr << "[RealTimeDaemon] Warning: Failed to set normal scheduling priority: "
-                      << strerror(errno) << std::endl;
+        for (size_t i = 0; i < library->size(); ++i) {
+            const MotionClip& c = library->clip(i);
+            if (clip.name == c.name) continue;
+            clips.push_back(MotionClipData{ c.name, c.rateHz, { c.samples, c.samples + c.sampleCount } });
         }
     }
+    index = clips.size();
+    clips.push_back(std::move(clip));
+    return MotionLibrary::write(libraryPath, clips, error) && target.open(libraryPath, error);
+}
 
-    // Try to lock memory (this might also fail without proper permissions)
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
-        if (errno == ENOMEM) {
-            std::cerr << "[RealTimeDaemon] Warning: Failed to lock memory - insufficient memory limits.\n"
-                      << "Please ensure the systemd service has LimitMEMLOCK=infinity set.\n";
+// {"cmd":"saveRecording","path":"/home/debian/.armatron/wave.armrec"} - after stopRecording
+void RealTimeDaemon::handleSaveRecording(ClientConnection& client, const Json::Value& root)
+{
+    Json::Value reply;
+    reply["type"] = "recordingSaved";
+    reply["path"] = root.get("path", DEFAULT_RECORDING_PATH).asString();
+    auto finish = [this, fd = client.fd()](Json::Value reply, const std::string& error) {
+        reply["ok"] = error.empty();
+        if (!error.empty()) {
+            reply["error"] = error;
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] saveRecording: {}", error);
+        }
+        replyToClient(fd, toCompactJson(reply));
+    };
+
+    // The control thread does not record into the buffer again until endReadRecording()
+    const RecordedSample* samples = nullptr;
+    size_t count = 0;
+    if (!m_robot.beginReadRecording(samples, count)) {
+        finish(reply, "no stopped recording; send startRecording and stopRecording first");
+        return;
+    }
+    m_worker.post([this, reply, finish, samples, count]() mutable -> IoWorker::Completion {
+        std::string error;
+        recording::save(reply["path"].asString(), samples, count, RobotInterface::RECORDING_RATE_HZ, error);
+        m_robot.endReadRecording();
+        reply["samples"] = static_cast<Json::UInt>(count);
+        reply["durationS"] = static_cast<double>(count) / RobotInterface::RECORDING_RATE_HZ;
+        return [reply, finish, error] { finish(reply, error); };
+    });
+}
+
+// {"cmd":"compileRecording","name":"wave","timeScale":1.5,"smoothingS":0.05,"limit":true}
+// "recording" compiles a file from saveRecording instead of the recording in memory, "library" picks
+// the library file (default: the loaded one). The clip replaces one of the same name; with "limit"
+// the clip is slowed down until it respects JOINT_n_MAX_* scaled by the current speed modifier.
+void RealTimeDaemon::handleCompileRecording(ClientConnection& client, const Json::Value& root)
+{
+    Json::Value reply;
+    reply["type"] = "recordingCompiled";
+    reply["name"] = root["name"].asString();
+    reply["library"] = motionLibraryPath(root);
+    auto finish = [this, fd = client.fd()](Json::Value reply, const std::string& error) {
+        std::string name = reply["name"].asString();
+        std::string libraryPath = reply["library"].asString();
+        reply["ok"] = error.empty();
+        if (!error.empty()) {
+            reply["error"] = error;
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] compileRecording '{}': {}", name, error);
         } else {
-            std::cerr << "[RealTimeDaemon] Warning: Failed to lock memory: " 
-                      << strerror(errno) << std::endl;
+            RTLOG_INFO(Daemon, "[RealTimeDaemon] Recording compiled into '{}' of {} ({} s, slowed down {}x)",
+                       name, libraryPath, reply["durationS"].asDouble(), reply["slowdown"].asDouble());
         }
+        replyToClient(fd, toCompactJson(reply));
+    };
+
+    recording::CompileOptions options;
+    options.timeScale = root.get("timeScale", options.timeScale).asDouble();
+    options.smoothingS = root.get("smoothingS", options.smoothingS).asDouble();
+    options.limit = root.get("limit", options.limit).asBool();
+    options.rateHz = m_controlRateHz.load();
+    trajectoryLimits(speedModifier(), options.maxVelocity, options.maxAcceleration, options.maxJerk);
+
+    int slot = 0;
+    std::string error;
+    if (!reserveLibrarySlot(slot, error)) {
+        finish(reply, error);
+        return;
+    }
+    bool fromFile = root.isMember("recording");
+    std::string recordingPath = root.get("recording", "").asString();
+    const RecordedSample* recorded = nullptr;
+    size_t count = 0;
+    if (!fromFile && !m_robot.beginReadRecording(recorded, count)) {
+        releaseLibrarySlot(slot, false);
+        finish(reply, "no stopped recording; send startRecording and stopRecording first");
+        return;
     }
 
-    // Try to set CPU affinity
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(0, &cpuset);  // Pin to CPU 0
+    const MotionLibrary* offered = offeredLibrary();
+    MotionLibrary* target = &m_motionLibraries[slot];
+    m_worker.post([this, reply, finish, options, slot, fromFile, recordingPath, recorded, count, offered, target]()
+                  mutable -> IoWorker::Completion {
+        std::string error;
+        std::vector<RecordedSample> samples;
+        uint32_t rateHz = RobotInterface::RECORDING_RATE_HZ;
+        if (fromFile) {
+            recording::load(recordingPath, samples, rateHz, error);
+        } else {
+            samples.assign(recorded, recorded + count);
+            m_robot.endReadRecording();
+        }
+
+        MotionClipData clip;
+        double slowdown = 1.0;
+        if (error.empty()) {
+            clip.name = reply["name"].asString();
+            recording::compile(samples, rateHz, options, clip, slowdown, error);
+        }
+
+        bool added = false;
+        if (error.empty()) {
+            reply["samples"] = static_cast<Json::UInt>(clip.samples.size());
+            reply["durationS"] = static_cast<double>(clip.samples.size()) / clip.rateHz;
+            reply["slowdown"] = slowdown;
+            size_t index = 0;
+            added = addMotionClip(std::move(clip), reply["library"].asString(), offered, *target, index, error);
+            if (added) {
+                reply["index"] = static_cast<Json::UInt>(index);
+            }
+        }
+        return [this, reply, finish, slot, added, error] {
+            releaseLibrarySlot(slot, added);
+            finish(reply, error);
+        };
+    });
+}
 
-    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
-        std::cerr << "[RealTimeDaemon] Warning: Failed to set CPU affinity: " 
-                  << strerror(errno) << std::endl;
+KinematicsInterface* RealTimeDaemon::routineKinematics()
+{
+    if (!m_routineKinematics && !m_robot.urdfPath().empty()) {
+        m_routineKinematics = std::make_unique<KinematicsInterface>();
+        if (!m_routineKinematics->loadURDF(m_robot.urdfPath())) {
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] Failed to load URDF {} for pose waypoints", m_robot.urdfPath());
+        }
     }
+    return m_routineKinematics && m_routineKinematics->getChain().getNrOfJoints() > 0 ? m_routineKinematics.get() : nullptr;
+}
 
-    // Return true if we got real-time scheduling, false otherwise
-    return (result == 0);
+std::array<double, 7> RealTimeDaemon::ikSeed()
+{
+    // Pose waypoints are solved from where the arm is now, then each from the one before
+    const RobotSnapshot& snap = m_robot.latestSnapshot();
+    std::array<double, 7> seed {};
+    for (size_t i = 0; i < 5; ++i) {
+        seed[i] = snap.joint_angles_deg[i] * M_PI / 180.0;
+    }
+    seed[5] = snap.differential_motors.roll_angle_rad;
+    seed[6] = snap.differential_motors.pitch_angle_rad;
+    return seed;
 }
 
-void RealTimeDaemon::lockMemory()
+// {"cmd":"compilePath","name":"sweep","speed":0.8,"waypoints":[{"angles":[...]},{"pose":{...},"speed":0.5},...]}
+// Waypoints as uploadRoutine ("dwell" is ignored: the path runs through every waypoint). The spline through
+// them is time-parameterized under JOINT_n_MAX_* and stored as a clip like compileRecording ("library").
+// The clip starts at rest on the first waypoint; the reply compares its duration with stop-and-go Ruckig moves.
+void RealTimeDaemon::handleCompilePath(ClientConnection& client, const Json::Value& root)
 {
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
-        std::cerr << "[RealTimeDaemon] Failed to lock memory: " 
-                  << strerror(errno) << std::endl;
+    Json::Value reply;
+    reply["type"] = "pathCompiled";
+    reply["name"] = root["name"].asString();
+    reply["library"] = motionLibraryPath(root);
+    auto finish = [this, fd = client.fd()](Json::Value reply, const std::string& error) {
+        std::string name = reply["name"].asString();
+        std::string libraryPath = reply["library"].asString();
+        reply["ok"] = error.empty();
+        if (!error.empty()) {
+            reply["error"] = error;
+            RTLOG_ERROR(Daemon, "[RealTimeDaemon] compilePath '{}': {}", name, error);
+        } else {
+            RTLOG_INFO(Daemon, "[RealTimeDaemon] Path '{}' compiled into {}: {} s ({} s time-optimal, stretched {}x) in {} ms",
+                       name, libraryPath, reply["durationS"].asDouble(), reply["optimalDurationS"].asDouble(),
+                       reply["stretch"].asDouble(), reply["computeMs"].asDouble());
+        }
+        replyToClient(fd, toCompactJson(reply));
+    };
+
+    // Pose waypoints are solved here, with the I/O thread's IK; the path itself is built on the worker
+    std::string error;
+    auto routine = std::make_unique<Routine>();
+    std::vector<JointPath::Point> points;
+    std::vector<double> speeds;
+    if (!parseRoutine(root, routineKinematics(), ikSeed(), *routine, error)) {
+        finish(reply, error);
+        return;
     }
+    for (size_t k = 0; k < routine->count; ++k) {
+        points.push_back(RobotInterface::toTrajectorySpace(routine->steps[k].position));
+        speeds.push_back(routine->steps[k].speed);
+    }
+
+    PathLimits limits;
+    trajectoryLimits(speedModifier(), limits.maxVelocity, limits.maxAcceleration, limits.maxJerk);
+    const double lows[5] = { JOINT_1_ANGLE_LIMIT_LOW, JOINT_2_ANGLE_LIMIT_LOW, JOINT_3_ANGLE_LIMIT_LOW,
+                             JOINT_4_ANGLE_LIMIT_LOW, JOINT_5_ANGLE_LIMIT_LOW };
+    const double highs[5] = { JOINT_1_ANGLE_LIMIT_HIGH, JOINT_2_ANGLE_LIMIT_HIGH, JOINT_3_ANGLE_LIMIT_HIGH,
+                              JOINT_4_ANGLE_LIMIT_HIGH, JOINT_5_ANGLE_LIMIT_HIGH };
+    for (size_t i = 0; i < 5; ++i) {
+        limits.minPosition[i] = lows[i];
+        limits.maxPosition[i] = highs[i];
+    }
+
+    int slot = 0;
+    if (!reserveLibrarySlot(slot, error)) {
+        finish(reply, error);
+        return;
+    }
+    const MotionLibrary* offered = offeredLibrary();
+    MotionLibrary* target = &m_motionLibraries[slot];
+    uint32_t rateHz = m_controlRateHz.load();
+    m_worker.post([this, reply, finish, points, speeds, limits, rateHz, slot, offered, target]()
+                  mutable -> IoWorker::Completion {
+        const JointPath::Point unitsPerDeg = { 1.0, 1.0, 1.0, 1.0, 1.0, RobotInterface::DIFFERENTIAL_UNITS_PER_DEG,
+                                               RobotInterface::DIFFERENTIAL_UNITS_PER_DEG };
+        std::string error;
+        JointPath path;
+        MotionClipData clip;
+        PathParameterization result;
+        clip.name = reply["name"].asString();
+        clip.rateHz = rateHz;
+        bool added = false;
+        if (path.build(points, speeds, unitsPerDeg, error)
+            && parameterizePath(path, limits, clip.rateHz, clip.samples, result, error)) {
+            reply["samples"] = static_cast<Json::UInt>(clip.samples.size());
+            reply["durationS"] = result.durationS;
+            reply["optimalDurationS"] = result.optimalDurationS;
+            reply["stretch"] = result.stretch;
+            reply["gridPoints"] = static_cast<Json::UInt>(result.gridPoints);
+            reply["computeMs"] = result.computeMs;
+
+            // Reference: the same waypoints as rest-to-rest Ruckig moves with the same limits
+            ruckig::Ruckig<7> otg;
+            ruckig::InputParameter<7> input;
+            ruckig::Trajectory<7> segment;
+            double ruckigS = 0.0;
+            for (size_t k = 1; k < points.size() && ruckigS >= 0.0; ++k) {
+                for (size_t i = 0; i < 7; ++i) {
+                    input.current_position[i] = points[k - 1][i];
+                    input.target_position[i] = points[k][i];
+                    input.max_velocity[i] = limits.maxVelocity[i] * speeds[k];
+                    input.max_acceleration[i] = limits.maxAcceleration[i] * speeds[k];
+                    input.max_jerk[i] = limits.maxJerk[i] * speeds[k];
+                }
+                ruckigS = otg.calculate(input, segment) == ruckig::Result::Working ? ruckigS + segment.get_duration() : -1.0;
+            }
+            if (ruckigS >= 0.0) {
+                reply["ruckigStopAndGoDurationS"] = ruckigS;
+            }
+
+            size_t index = 0;
+            added = addMotionClip(std::move(clip), reply["library"].asString(), offered, *target, index, error);
+            if (added) {
+                reply["index"] = static_cast<Json::UInt>(index);
+            }
+        }
+        return [this, reply, finish, slot, added, error] {
+            releaseLibrarySlot(slot, added);
+            finish(reply, error);
+        };
+    });
 }
 
-void RealTimeDaemon::setThreadAffinity()
+void RealTimeDaemon::distributeRoutineProgress()
 {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(0, &cpuset);  // Pin to CPU 0
+    m_routineStatus.update();
+    const RoutineStatus& status = m_routineStatus.read();
+    if (status.state == RoutineState::Idle) return;
 
-    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
-        std::cerr << "[RealTimeDaemon] Failed to set CPU affinity: " 
-                  << strerror(errno) << std::endl;
+    auto now = std::chrono::steady_clock::now();
+    bool changed = status.id != m_lastRoutineReport.id || status.state != m_lastRoutineReport.state
+                   || status.step != m_lastRoutineReport.step;
+    bool due = status.state == RoutineState::Running && now >= m_nextRoutineReport;
+    if (!changed && !due) return;
+
+    m_lastRoutineReport = status;
+    m_nextRoutineReport = now + ROUTINE_REPORT_INTERVAL;
+    Json::Value report = status.toJson();
+    report["type"] = "routineProgress";
+    std::string json = toCompactJson(report);
+    for (auto& [fd, client] : m_clients) {
+        replyToClient(*client, json);
     }
 }
 
-void RealTimeDaemon::controlThreadFunc()
+// {"cmd":"subscribe","fields":["positions","speeds"],"divider":4}  (or "rateHz":50 instead of divider)
+// {"cmd":"unsubscribe"} returns the client to the default motorStates broadcast
+void RealTimeDaemon::handleSubscribe(ClientConnection& client, bool subscribe, const Json::Value& root)
 {
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Control thread running.\n");
-    
-    // Configure real-time settings
-    if (!configureRealTimeThread()) {
-        std::cerr << "[RealTimeDaemon] Failed to configure real-time thread. Continuing with soft real-time.\n";
+    telemetry::Subscription sub;
+    if (subscribe) {
+        sub.active = true;
+        const Json::Value& fields = root["fields"];
+        if (fields.isArray()) {
+            for (const auto& f : fields) {
+                uint32_t bits = 0;
+                if (!telemetry::parseFieldGroup(f.asString(), bits)) {
+                    RTLOG_ERROR(Daemon, "[RealTimeDaemon] subscribe: unknown field group {}", f.asString());
+                    return;
+                }
+                sub.groups |= bits;
+            }
+        } else {
+            sub.groups = telemetry::AllGroups;
+        }
+
+        unsigned int divider = control_rate::divider(m_subscriptionRateHz, STATE_BROADCAST_RATE_HZ);
+        if (root.isMember("divider")) {
+            divider = root["divider"].asUInt();
+        } else if (root.isMember("rateHz") && root["rateHz"].asDouble() > 0.0) {
+            sub.rateHz = root["rateHz"].asDouble();
+            divider = control_rate::divider(m_subscriptionRateHz, sub.rateHz);
+        }
+        sub.divider = std::clamp(divider, 1u, m_subscriptionRateHz * MAX_TELEMETRY_PERIOD_S);
+
+        // "delta":true, optional "keyframeInterval" (frames) and "thresholds":{"positions":0.05,...}
+        sub.delta = root.get("delta", false).asBool();
+        if (sub.delta) {
+            if (root.isMember("keyframeInterval")) {
+                sub.deltaOptions.keyframeInterval = std::max(1u, root["keyframeInterval"].asUInt());
+            }
+            const Json::Value& thresholds = root["thresholds"];
+            if (thresholds.isObject()) {
+                for (const auto& name : thresholds.getMemberNames()) {
+                    uint32_t bits = 0;
+                    if (!telemetry::parseFieldGroup(name, bits) || bits == telemetry::AllGroups) {
+                        RTLOG_ERROR(Daemon, "[RealTimeDaemon] subscribe: unknown threshold group {}", name);
+                        return;
+                    }
+                    size_t group = 0;
+                    while (!(bits & (1u << group))) group++;
+                    sub.deltaOptions.thresholds[group] = std::max(0.0f, thresholds[name].asFloat());
+                }
+            }
+        }
     }
-    
-    // Control loop configuration
-    constexpr std::chrono::nanoseconds CONTROL_PERIOD{1000000000 / CONTROL_RATE_HZ};
-    
+    client.setSubscription(sub);
+    refreshTelemetryDemand();
+
+    Json::Value reply;
+    reply["type"] = sub.active ? "subscribed" : "unsubscribed";
+    if (sub.active) {
+        reply["fields"] = Json::Value(Json::arrayValue);
+        for (uint32_t bit = 1; bit & telemetry::AllGroups; bit <<= 1) {
+            if (sub.groups & bit) {
+                reply["fields"].append(telemetry::fieldGroupName(static_cast<telemetry::FieldGroup>(bit)));
+            }
+        }
+        reply["divider"] = sub.divider;
+        reply["rateHz"] = static_cast<double>(m_subscriptionRateHz) / sub.divider;
+        reply["delta"] = sub.delta;
+        if (sub.delta) {
+            // Delta frames refer to channels by index; tell the client what each index is
+            reply["keyframeInterval"] = sub.deltaOptions.keyframeInterval;
+            reply["channels"] = Json::Value(Json::arrayValue);
+            for (const auto& name : telemetry::channelNames(sub.groups)) {
+                reply["channels"].append(name);
+            }
+        }
+    }
+    if (sub.active) {
+        RTLOG_INFO(Daemon, "[RealTimeDaemon] Client FD={} {} every {} cycles", client.fd(), reply["type"].asString(), sub.divider);
+    } else {
+        RTLOG_INFO(Daemon, "[RealTimeDaemon] Client FD={} {}", client.fd(), reply["type"].asString());
+    }
+    replyToClient(client, toCompactJson(reply));
+}
+
+std::string RealTimeDaemon::clientStatsJson()
+{
+    auto now = std::chrono::steady_clock::now();
+    Json::Value jroot;
+    jroot["type"] = "clientStats";
+    jroot["clients"] = Json::Value(Json::arrayValue);
+    for (auto& [fd, client] : m_clients) {
+        const ClientStats& st = client->stats();
+        Json::Value c;
+        c["fd"] = fd;
+        c["protocol"] = client->protocol() == ClientProtocol::Binary ? "binary" : "json";
+        c["policy"] = slowConsumerPolicyName(client->policy());
+        c["maxQueue"] = static_cast<Json::UInt64>(client->maxQueuedMessages());
+        c["queueDepth"] = static_cast<Json::UInt64>(client->queueDepth());
+        c["maxQueueDepth"] = static_cast<Json::UInt64>(st.maxQueueDepth);
+        c["lagMs"] = client->lag(now).count() / 1000.0;
+        c["sentMessages"] = static_cast<Json::UInt64>(st.sentMessages);
+        c["sentBytes"] = static_cast<Json::UInt64>(st.sentBytes);
+        c["dropped"] = static_cast<Json::UInt64>(st.droppedMessages);
+        c["coalesced"] = static_cast<Json::UInt64>(st.coalescedMessages);
+        c["subscribed"] = client->subscription().active;
+        if (client->subscription().active) {
+            c["groups"] = client->subscription().groups;
+            c["divider"] = client->subscription().divider;
+            c["delta"] = client->subscription().delta;
+        }
+        jroot["clients"].append(c);
+    }
+    return toCompactJson(jroot);
+}
+
+void RealTimeDaemon::processJsonLine(ClientConnection& client, const std::string& line)
+{
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Received JSON line: {}", line);
+
+    // IoThread commands (client settings, statistics, uploads) are answered right here
+    const commands::CommandSpec* spec = commands::find(extractCommandName(line));
+    if (spec && (spec->flags & commands::IoThread)) {
+        handleIoCommand(client, *spec, line);
+        return;
+    }
+
+    if (spec && (spec->flags & commands::HighPriority)) {
+        // Execute the high-priority command immediately - the burst goes out before anything else
+        handleHighPriority(*spec);
+    } else {
+        // Normal commands are parsed and validated here, the control thread only executes them
+        QueuedCommand command;
+        if (parseCommand(line, command)) {
+            queueCommand(command);
+            RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Pushed command into queue: {}", command.spec->name);
+        }
+    }
+}
+
+void RealTimeDaemon::handleHighPriority(const commands::CommandSpec& spec)
+{
+    bool estop = spec.opcode == static_cast<uint16_t>(ipc::Opcode::SetESTOP);
+    if (estop) {
+        handleEmergencyStop(m_lastReceiveTime);
+    } else {
+        handleHoldPosition(m_lastReceiveTime);
+    }
+    // The control thread clears the command queue when it picks up the pending ESTOP/hold
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] Received HIGH PRIORITY command: {} - clearing command queue!",
+               estop ? "ESTOP" : "HOLD POSITION");
+}
+
+void RealTimeDaemon::processBinaryFrame(ClientConnection& client, ipc::FrameType type, const std::string& payload)
+{
+    // Binary clients can still send any JSON command wrapped in a Json frame
+    if (type == ipc::FrameType::Json) {
+        processJsonLine(client, payload);
+        return;
+    }
+    if (type != ipc::FrameType::Command) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Ignoring binary frame of type {}", type);
+        return;
+    }
+
+    ipc::CommandMessage message;
+    if (!ipc::decodeCommand(reinterpret_cast<const uint8_t*>(payload.data()), payload.size(), message)) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Malformed binary command ({} bytes)", payload.size());
+        return;
+    }
+
+    const commands::CommandSpec* spec = commands::find(static_cast<ipc::Opcode>(message.opcode));
+    if (spec && (spec->flags & commands::HighPriority)) {
+        handleHighPriority(*spec);
+    } else {
+        QueuedCommand command;
+        if (parseBinaryCommand(message, command)) {
+            queueCommand(command);
+        }
+    }
+}
+
+void RealTimeDaemon::queueCommand(QueuedCommand& command)
+{
+    command.received = m_lastReceiveTime;
+    command.queued = std::chrono::steady_clock::now();
+    if (!m_inboundQueue.push(command)) {
+        m_droppedCommands++;
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Command queue full, dropped {}", command.spec->name);
+    }
+}
+
+
+/**********************************************************/
+/* Control Thread                                         */
+/**********************************************************/
+bool RealTimeDaemon::setControlRate(unsigned int hz)
+{
+    if (!control_rate::valid(hz)) return false;
+    m_requestedRateHz.store(hz, std::memory_order_relaxed);
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] Control rate {} Hz requested, switching when no trajectory is running", hz);
+    return true;
+}
+
+bool RealTimeDaemon::applyRequestedControlRate()
+{
+    unsigned int requested = m_requestedRateHz.load(std::memory_order_relaxed);
+    if (requested == 0 || m_robot.getState().trajectory_active) return false;
+    unsigned int expected = requested;   // a newer request stays pending for the next cycle
+    m_requestedRateHz.compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+
+    unsigned int previous = m_controlRateHz.load(std::memory_order_relaxed);
+    if (requested == previous) return false;
+    m_overrun.setBasePeriod(control_rate::period(requested));
+    m_controlRateHz.store(requested, std::memory_order_relaxed);
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] Control rate {} Hz -> {} Hz", previous, requested);
+    return true;
+}
+
+void RealTimeDaemon::controlThreadFunc()
+{
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Control thread running.");
+
+    // Scheduling, memory locking and the prefaulted stack are set up by RtThread before we get here.
+    // A SCHED_DEADLINE thread sleeps until the next tick; spinning would use up its runtime.
+    const bool deadlineScheduled = m_controlThread.report().granted == rt::SchedPolicy::Deadline;
+
+    // Control loop configuration; the overrun governor may lower the rate under sustained overload
+    std::chrono::nanoseconds period = m_overrun.period();
+    m_robot.setControlPeriod(std::chrono::duration<double>(period).count());
+    unsigned int broadcastDivider = control_rate::divider(m_controlRateHz.load(), STATE_BROADCAST_RATE_HZ);
+
     auto nextTime = std::chrono::steady_clock::now();
+    auto cycleStart = nextTime;
+    auto phaseStart = nextTime;
     unsigned int cycleCount = 0;
 
+    // Commands whose handler sent no actuation frame; they get the first one of the cycle
+    std::array<CommandTrace, MAX_TRACES_AWAITING_EGRESS> awaitingEgress;
+    size_t awaiting = 0;
+    auto recordAwaiting = [&](bool sent, std::chrono::steady_clock::time_point sentAt) {
+        for (size_t i = 0; i < awaiting; ++i) {
+            if (sent) awaitingEgress[i][TraceHop::CanEgress] = sentAt;
+            m_commandTracer.record(awaitingEgress[i]);
+        }
+        awaiting = 0;
+    };
+
+    // Close the current phase: record its duration and start the next one
+    auto endPhase = [&](LoopPhase phase) {
+        auto now = std::chrono::steady_clock::now();
+        m_loopTiming.recordPhase(phase, toNs(now - phaseStart));
+        phaseStart = now;
+    };
+
     while (m_running) {
-        // 1) Process inbound commands first
-        {
-            // Lock both mutexes to prevent conflicts with emergency commands
-            std::lock_guard<std::mutex> lk(m_inboundMutex);
-            std::lock_guard<std::mutex> em_lk(m_emergency_mutex);
-            
-            while (!m_inboundQueue.empty()) {
-                auto msg = m_inboundQueue.front();
-                m_inboundQueue.pop();
-                IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Processing command: " << msg.json << "\n");
-                handleCommand(msg.json);
+        // 0) An ESTOP/hold burst went out since the last cycle: drop the trajectory and
+        //    repeat the burst, so nothing sent during the in-flight cycle restarts motion
+        EmergencyAction emergency = m_emergency.takePending();
+        if (emergency != EmergencyAction::None) {
+            m_robot.resetRuckigState();
+            m_routineRunner.abort(m_robot, emergency == EmergencyAction::Stop ? "emergency stop" : "hold position");
+            if (emergency == EmergencyAction::Stop) {
+                m_robot.sendStopBurst();
+            } else {
+                m_robot.sendHoldBurst();
             }
+            m_inboundQueue.clear();
         }
 
-        // 2) Do real-time update for all motors
-        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Updating all motors.\n");
-        m_robot.updateAll(); // This does CAN read/writes and state management
-        IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Updated all motors.\n");
-
-        // 3) Broadcast states at configured rate
-        if (++cycleCount % BROADCAST_DIVIDER == 0) {
-            Json::Value jroot;
-            jroot["type"] = "motorStates";
-
-            // gather each motor's state
-            for (int i = 1; i < 8; i++) {
-                auto &mot = m_robot.getMotor(i);
-                auto st   = mot.getState();
-                Json::Value mjs;
-                mjs["temp"]       = st.temperatureC;
-                mjs["torqueA"]    = st.torqueCurrentA;
-                mjs["speedDeg_s"] = st.speedDeg_s;
-                mjs["posDeg"]     = st.positionDeg;
-                mjs["multiTurnRaw"] = st.multiTurnPosition;
-                mjs["multiTurnRad_Mapped"] = st.multiTurnRad_Mapped;
-                mjs["multiTurnDeg_Mapped"] = st.multiTurnDeg_Mapped;
-                mjs["error"]      = (st.errorPresent ? 1 : 0);
-                mjs["encoder_val"] = st.encoderVal;
-                mjs["positionRad_Mapped"] = st.positionRad_Mapped;
-                mjs["positionDeg_Mapped"] = st.positionDeg_Mapped;
-                
-                // Add motor gains
-                Json::Value gains;
-                gains["angKp"] = static_cast<int>(st.m_gains.angKp);
-                gains["angKi"] = static_cast<int>(st.m_gains.angKi);
-                gains["spdKp"] = static_cast<int>(st.m_gains.spdKp);
-                gains["spdKi"] = static_cast<int>(st.m_gains.spdKi);
-                gains["iqKp"]  = static_cast<int>(st.m_gains.iqKp);
-                gains["iqKi"]  = static_cast<int>(st.m_gains.iqKi);
-                mjs["gains"] = gains;
-                
-                jroot["motors"][std::to_string(i)] = mjs;
+        // Rate switches wait for the current trajectory to finish
+        if (applyRequestedControlRate()) {
+            period = m_overrun.period();
+            m_robot.setControlPeriod(std::chrono::duration<double>(period).count());
+            broadcastDivider = control_rate::divider(m_controlRateHz.load(), STATE_BROADCAST_RATE_HZ);
+            if (deadlineScheduled && !rt::setDeadline(period, m_rtConfig.deadlineRuntimeFraction)) {
+                RTLOG_ERROR(Daemon, "[RealTimeDaemon] SCHED_DEADLINE period update failed: {}", strerror(errno));
             }
+            nextTime = std::chrono::steady_clock::now();
+        }
 
-            // Add diff crossbar and tool data
-            jroot["diff_roll_rad"] = m_robot.getState().differential_motors.roll_angle_rad;
-            jroot["diff_pitch_rad"] = m_robot.getState().differential_motors.pitch_angle_rad;
-            jroot["diff_roll_deg"] = m_robot.getState().differential_motors.roll_angle_deg;
-            jroot["diff_pitch_deg"] = m_robot.getState().differential_motors.pitch_angle_deg;
-
-            // Add digital twin data
-            const auto& state = m_robot.getState();
-            if (state.twin_active) {
-                Json::Value twinData;
-                twinData["active"] = true;
-                Json::Value twinAngles;
-                
-                // Add first 5 joints from the array
-                for (int i = 0; i < 5; ++i) {
-                    twinAngles.append(state.twin_joint_angles_deg[i]);
-                }
-                
-                // Add differential angles for joints 6 and 7
-                twinAngles.append(state.twin_diff_pitch_rad);
-                twinAngles.append(state.twin_diff_roll_rad);
-                
-                twinData["joint_angles_deg"] = twinAngles;
-                jroot["twin"] = twinData;
+        // 1) Process inbound commands first (already parsed and validated by the I/O thread)
+        QueuedCommand command;
+        while (m_inboundQueue.pop(command)) {
+            RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Processing command: {}", command.spec->name);
+            CommandTrace trace;
+            trace.command = static_cast<uint16_t>(commands::index(*command.spec));
+            trace.cycle = cycleCount + 1;
+            trace.cycleStart = cycleStart;
+            trace.periodNs = period.count();
+            trace[TraceHop::Received] = command.received;
+            trace[TraceHop::Queued] = command.queued;
+            trace[TraceHop::Dequeued] = std::chrono::steady_clock::now();
+            CANHandler::armEgressProbe();
+            executeCommand(command);
+            trace[TraceHop::Executed] = std::chrono::steady_clock::now();
+
+            std::chrono::steady_clock::time_point sentAt;
+            if (CANHandler::egressSince(sentAt)) {
+                recordAwaiting(true, sentAt);
+                trace[TraceHop::CanEgress] = sentAt;
+                m_commandTracer.record(trace);
+            } else if (awaiting < awaitingEgress.size()) {
+                awaitingEgress[awaiting++] = trace;
             } else {
-                jroot["twin"]["active"] = false;
+                m_commandTracer.record(trace);
             }
+        }
+        if (awaiting > 0) {
+            CANHandler::armEgressProbe();
+        }
 
-            Json::StreamWriterBuilder builder;
-            builder["indentation"] = ""; // Force compact, single-line output.
-            std::string outStr = Json::writeString(builder, jroot);
-            IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Broadcasting state: " << outStr << "\n");
-            sendJson(outStr); 
+        // A newly uploaded routine replaces the running one
+        if (m_routineStopRequested.exchange(false)) {
+            m_routineRunner.abort(m_robot, "stopped by a client");
+        }
+        if (m_routineUploads.update()) {
+            m_routineRunner.start(m_routineUploads.read(), m_robot);
         }
 
-        // Busy wait until next tick for hard real-time
-        nextTime += CONTROL_PERIOD;
-        while (std::chrono::steady_clock::now() < nextTime) {
-            // Busy wait - this is more deterministic than sleep
+        endPhase(LoopPhase::CommandDrain);
+
+        // 2) Do real-time update for all motors (RobotInterface::updateCycle, timing each phase)
+        RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Updating all motors.");
+        m_robot.updateCycle([&](LoopPhase phase) {
+            if (phase == LoopPhase::Trajectories) {
+                bool routineChanged = m_routineRunner.cycle(m_robot);   // tops up the waypoint queue
+                if (routineChanged || m_routineRunner.running()) {
+                    m_routineStatus.writeBuffer() = m_routineRunner.status();
+                    m_routineStatus.publish();
+                }
+                if (routineChanged) {
+                    uint64_t one = 1;
+                    ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+                    (void)ignored;
+                }
+            }
+            endPhase(phase);
+        });
+        RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Updated all motors.");
+        if (awaiting > 0) {
+            std::chrono::steady_clock::time_point sentAt;
+            bool sent = CANHandler::egressSince(sentAt);
+            recordAwaiting(sent, sentAt);
+        }
+
+        // 3) Publish the robot snapshot, plus a telemetry snapshot when any client is due one;
+        //    encoding happens on the I/O thread
+        ++cycleCount;
+        //    Under the Shed overrun policy subscription telemetry goes first, then the default broadcast
+        unsigned int subscriptionDivider = m_telemetryDivider;
+        ShedLevel shed = m_overrun.shedLevel();
+        bool legacyDue = shed < ShedLevel::Broadcast && m_legacyClientCount > 0 && cycleCount % broadcastDivider == 0;
+        bool subscriptionDue = shed == ShedLevel::None && subscriptionDivider > 0 && cycleCount % subscriptionDivider == 0;
+        bool telemetryDue = legacyDue || subscriptionDue;
+        bool poseValid = telemetryDue && m_cartesianWanted && m_robot.updateCartesianPose();
+        m_robot.publishSnapshot();
+        if (telemetryDue) {
+            publishTelemetry(cycleCount, poseValid);
+        }
+        endPhase(LoopPhase::Broadcast);
+
+        // Busy wait until next tick for hard real-time. On an overrun the governor picks the
+        // next tick (catch up, skip to the next aligned tick, or a lower rate)
+        auto deadline = nextTime + period;
+        auto workEnd = phaseStart;
+        bool missed = workEnd > deadline;
+        m_loopTiming.recordCycle(toNs(workEnd - cycleStart), missed);
+        nextTime = m_overrun.endCycle(deadline, workEnd);
+        if (m_overrun.period() != period) {
+            period = m_overrun.period();
+            m_robot.setControlPeriod(std::chrono::duration<double>(period).count());
+        }
+        if (deadlineScheduled) {
+            rt::sleepUntil(nextTime);
+        } else {
+            while (std::chrono::steady_clock::now() < nextTime) {
+                // Busy wait - this is more deterministic than sleep
+            }
+        }
+        endPhase(LoopPhase::Wait);
+        if (!missed) {
+            // How late we woke up after the tick; an overrun is counted above instead
+            m_loopTiming.recordJitter(toNs(phaseStart - nextTime));
+        }
+        cycleStart = phaseStart;
+
+        // Everything the loop needs has been touched once; from here on a heap allocation is a bug
+        if (cycleCount == 1) {
+            rtalloc::armThisThread();
         }
     }
+    rtalloc::disarmThisThread();
 }
 
 /**********************************************************/
-/* handleCommand                                          */
+/* Command parsing (I/O thread) and execution             */
 /**********************************************************/
-void RealTimeDaemon::handleCommand(const std::string& jsonStr)
+bool RealTimeDaemon::parseCommand(const std::string& jsonStr, QueuedCommand& out)
 {
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Handling command: " << jsonStr << "\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Handling command: {}", jsonStr);
     // Parse JSON using JsonCPP
     Json::CharReaderBuilder rb;
     Json::Value root;
@@ -417,173 +1810,93 @@ void RealTimeDaemon::handleCommand(const std::string& jsonStr)
     std::unique_ptr<Json::CharReader> reader(rb.newCharReader());
     bool ok = reader->parse(jsonStr.data(), jsonStr.data() + jsonStr.size(), &root, &errs);
     if (!ok) {
-        std::cerr << "[RealTimeDaemon] Invalid JSON: " << errs << "\n";
-        return;
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Invalid JSON: {}", errs);
+        return false;
     }
-    if (!root.isObject()) return;
-    
+    if (!root.isObject()) return false;
+
     std::string cmd = root["cmd"].asString();
-    int motorID = root.get("motorID", 1).asInt();
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] Command parsed: " << cmd << " for motorID " << motorID << "\n");
+    out.spec = commands::find(cmd);
+    if (!out.spec) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Unknown command: {}", cmd);
+        return false;
+    }
+    if (out.spec->flags & commands::IoThread) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] {} is answered by the I/O thread, not queued", cmd);
+        return false;
+    }
+
+    std::string error;
+    if (!commands::parseJson(*out.spec, root, out.args, error)) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] {}: {}", cmd, error);
+        return false;
+    }
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Command parsed: {} for motorID {}", cmd, out.args.motorId);
+    return true;
+}
+
+bool RealTimeDaemon::parseBinaryCommand(const ipc::CommandMessage& msg, QueuedCommand& out)
+{
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] Handling binary opcode {} for motorID {}", msg.opcode, msg.motorId);
+    out.spec = commands::find(static_cast<ipc::Opcode>(msg.opcode));
+    if (!out.spec) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] Unknown binary opcode: {}", msg.opcode);
+        return false;
+    }
 
+    std::string error;
+    if (!commands::parseBinary(*out.spec, msg, out.args, error)) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] {}: {}", out.spec->name, error);
+        return false;
+    }
+    return true;
+}
+
+void RealTimeDaemon::executeCommand(const QueuedCommand& command)
+{
     try {
-        auto &mot = m_robot.getMotor(motorID);
-
-        if (cmd == "motorOn") {
-            mot.motorOn();
-        } else if (cmd == "motorOff") {
-            mot.motorOff();
-        } else if (cmd == "motorStop") {
-            mot.motorStop();
-        } else if (cmd == "setHoldPosition") {
-            m_robot.setHoldPosition();
-        } else if (cmd == "setESTOP") {
-            m_robot.setESTOP();
-        } else if (cmd == "openLoopControl") {
-            int power = root.get("powerControl", 0).asInt();
-            mot.openLoopControl(static_cast<int16_t>(power));
-        } else if (cmd == "setTorque") {
-            int value = root.get("value", 0).asInt();
-            mot.setTorque(static_cast<int16_t>(value));
-        } else if (cmd == "setSpeed") {
-            int value = root.get("value", 0).asInt();
-            mot.setSpeed(static_cast<int32_t>(value));
-        } else if (cmd == "setMultiAngle") {
-            int value = root.get("value", 0).asInt();
-            mot.setMultiAngle(static_cast<int32_t>(value));
-        } else if (cmd == "setMultiAngleWithSpeed") {
-            int angle = root.get("angle", 0).asInt();
-            int maxSpeed = root.get("maxSpeed", 0).asInt();
-            mot.setMultiAngleWithSpeed(static_cast<int32_t>(angle), static_cast<uint16_t>(maxSpeed));
-        } else if (cmd == "setSingleAngle") {
-            int spin = root.get("spinDirection", 0).asInt();
-            int angle = root.get("angle", 0).asInt();
-            mot.setSingleAngle(static_cast<uint8_t>(spin), static_cast<int32_t>(angle));
-        } else if (cmd == "setSingleAngleWithSpeed") {
-            int spin = root.get("spinDirection", 0).asInt();
-            int angle = root.get("angle", 0).asInt();
-            int maxSpeed = root.get("maxSpeed", 0).asInt();
-            std::cout << "[RealTimeDaemon] Received setSingleAngleWithSpeed | Spin: " << spin << " | Angle: " << angle << "\n";
-            mot.setSingleAngleWithSpeed(static_cast<uint8_t>(spin), static_cast<int32_t>(angle), static_cast<uint16_t>(maxSpeed));
-        } else if (cmd == "setMultiJointAngles") {
-            std::vector<float> angles;
-            std::vector<float> speeds;
-            if (root.isMember("angles") && root["angles"].isArray() &&
-                root.isMember("speeds") && root["speeds"].isArray()) {
-                const Json::Value anglesJson = root["angles"];
-                const Json::Value speedsJson = root["speeds"];
-                for (Json::ArrayIndex i = 0; i < anglesJson.size(); i++) {
-                    angles.push_back(anglesJson[i].asFloat());
-                }
-                for (Json::ArrayIndex i = 0; i < speedsJson.size(); i++) {
-                    speeds.push_back(speedsJson[i].asFloat());
-                }
-                m_robot.setMultiJointAngles(angles, speeds);
-            } else {
-                std::cerr << "[RealTimeDaemon] setMultiJointAngles: Invalid or missing angles/speeds arrays." << std::endl;
-            }
-        } else if (cmd == "setDifferentialAngles") {
-            if (root.isMember("roll") && root.isMember("pitch") && 
-                root.isMember("maxSpeed")) {
-                double roll = root["roll"].asDouble();
-                double pitch = root["pitch"].asDouble();
-                double max_motor_speed = root["maxSpeed"].asDouble();
-                std::cerr << "[RealTimeDaemon] setDifferentialAngles: "
-                         << "roll=" << roll << " rad, "
-                         << "pitch=" << pitch << " rad, "
-                         << "maxSpeed=" << max_motor_speed << " deg/s, " << std::endl;
-                m_robot.setDifferentialAngles(roll, pitch, max_motor_speed);
-            } else {
-                std::cerr << "[RealTimeDaemon] setDifferentialAngles: Invalid or missing parameters." << std::endl;
-            }
-        } else if (cmd == "moveToJointPositionRuckig") {
-            if (root.isMember("angles") && root["angles"].isArray() && root["angles"].size() == 7) {
-                std::array<double, 7> target_positions;
-                const Json::Value anglesJson = root["angles"];
-                
-                // Convert JSON angles to array
-                for (Json::ArrayIndex i = 0; i < anglesJson.size(); i++) {
-                    target_positions[i] = anglesJson[i].asDouble();
-                }
-                
-                // Log the command for debugging
-                std::cerr << "[RealTimeDaemon] moveToJointPositionRuckig: [";
-                for (size_t i = 0; i < target_positions.size(); ++i) {
-                    std::cerr << target_positions[i];
-                    if (i < target_positions.size() - 1) std::cerr << ", ";
-                }
-                std::cerr << "] degrees" << std::endl;
-                
-                // Execute the trajectory
-                m_robot.moveToJointPosition(target_positions);
-            } else {
-                std::cerr << "[RealTimeDaemon] moveToJointPositionRuckig: Invalid or missing angles array. Expected 7 angles." << std::endl;
+        commands::execute(*command.spec, m_robot, command.args);
+    } catch (std::exception &ex) {
+        RTLOG_ERROR(Daemon, "[RealTimeDaemon] {} exception: {}", command.spec->name, ex.what());
+    }
+}
+
+void RealTimeDaemon::publishTelemetry(unsigned int cycle, bool poseValid)
+{
+    const auto& state = m_robot.getState();
+
+    {
+        TelemetrySnapshot& snap = m_telemetry.writeBuffer();
+        snap.cycle = cycle;
+        for (size_t i = 0; i < ipc::NUM_MOTORS; ++i) {
+            snap.motors[i] = m_robot.getMotor(static_cast<int>(i) + 1).getState();
+        }
+        snap.diffRollRad = state.differential_motors.roll_angle_rad;
+        snap.diffPitchRad = state.differential_motors.pitch_angle_rad;
+        snap.diffRollDeg = state.differential_motors.roll_angle_deg;
+        snap.diffPitchDeg = state.differential_motors.pitch_angle_deg;
+
+        snap.twinActive = state.twin_active;
+        for (int i = 0; i < 5; ++i) {
+            snap.twinJointAnglesDeg[i] = state.twin_joint_angles_deg[i];
+        }
+        snap.twinJointAnglesDeg[5] = state.twin_diff_pitch_rad;
+        snap.twinJointAnglesDeg[6] = state.twin_diff_roll_rad;
+
+        snap.poseValid = poseValid;
+        if (poseValid) {
+            const KDL::Frame& pose = state.current_pose;
+            for (int i = 0; i < 3; ++i) {
+                snap.posePosition[i] = pose.p(i);
             }
-        } else if (cmd == "setMaxSpeedModifier") {
-            double modifier = root["modifier"].asDouble();
-            std::cerr << "[RealTimeDaemon] setMaxSpeedModifier: " << modifier << std::endl;
-            m_robot.setMaxSpeedModifier(modifier);
-        } else if (cmd == "setIncrementAngle") {
-            int value = root.get("incAngle", 0).asInt();
-            mot.setIncrementAngle(static_cast<int32_t>(value));
-        } else if (cmd == "setIncrementAngleWithSpeed") {
-            int incAngle = root.get("incAngle", 0).asInt();
-            int maxSpeed = root.get("maxSpeed", 0).asInt();
-            mot.setIncrementAngleWithSpeed(static_cast<int32_t>(incAngle), static_cast<uint16_t>(maxSpeed));
-        } else if (cmd == "syncSingleAndMulti"){
-            mot.clearMultiLoopAngle();
-        } else if (cmd == "readPID") {
-            auto pid = mot.readPID();
-            // Optionally, you can send the PID values back to the client.
-        } else if (cmd == "writePID_RAM") {
-            uint8_t angKp = root.get("angKp", 100).asUInt();
-            uint8_t angKi = root.get("angKi", 50).asUInt();
-            uint8_t spdKp = root.get("spdKp", 50).asUInt();
-            uint8_t spdKi = root.get("spdKi", 20).asUInt();
-            uint8_t iqKp  = root.get("iqKp", 50).asUInt();
-            uint8_t iqKi  = root.get("iqKi", 50).asUInt();
-            mot.writePID_RAM(angKp, angKi, spdKp, spdKi, iqKp, iqKi);
-        } else if (cmd == "writePID_ROM") {
-            uint8_t angKp = root.get("angKp", 100).asUInt();
-            uint8_t angKi = root.get("angKi", 50).asUInt();
-            uint8_t spdKp = root.get("spdKp", 50).asUInt();
-            uint8_t spdKi = root.get("spdKi", 20).asUInt();
-            uint8_t iqKp  = root.get("iqKp", 50).asUInt();
-            uint8_t iqKi  = root.get("iqKi", 50).asUInt();
-            mot.writePID_ROM(angKp, angKi, spdKp, spdKi, iqKp, iqKi);
-        } else if (cmd == "readAcceleration") {
-            int32_t accel = mot.readAcceleration();
-            // Optionally send accel back
-        } else if (cmd == "writeAcceleration") {
-            int accel = root.get("accel", 0).asInt();
-            mot.writeAcceleration(static_cast<int32_t>(accel));
-        } else if (cmd == "readEncoder") {
-            mot.readEncoder();
-        } else if (cmd == "writeEncoderOffset") {
-            int offset = root.get("offset", 0).asInt();
-            mot.writeEncoderOffset(static_cast<uint16_t>(offset));
-        } else if (cmd == "writeCurrentPosAsZero") {
-            mot.writeCurrentPosAsZero();
-        } else if (cmd == "readMultiAngle") {
-            mot.readMultiAngle();
-        } else if (cmd == "readSingleAngle") {
-            mot.readSingleAngle();
-        } else if (cmd == "clearAngle") {
-            mot.clearAngle();
-        } else if (cmd == "readState1_Error") {
-            mot.readState1_Error();
-        } else if (cmd == "clearError") {
-            mot.clearError();
-        } else if (cmd == "readState2") {
-            mot.readState2();
-        } else if (cmd == "readState3") {
-            mot.readState3();
-        } else {
-            std::cerr << "[RealTimeDaemon] Unknown command: " << cmd << "\n";
+            pose.M.GetRPY(snap.poseRPY[0], snap.poseRPY[1], snap.poseRPY[2]);
         }
-    } catch (std::exception &ex) {
-        std::cerr << "[RealTimeDaemon] handleCommand exception: " << ex.what() << "\n";
+        m_telemetry.publish();
     }
+
+    uint64_t one = 1;
+    ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+    (void)ignored;
 }
 
 
@@ -594,41 +1907,30 @@ void RealTimeDaemon::sendJson(const std::string& jsonStr)
 {
     // Append a newline to ensure the Node side can correctly detect message boundaries.
     std::string jsonWithNewline = jsonStr + "\n";
-    IFRTDEBUG(std::cout << "[RealTimeDaemon][DEBUG] sendJson called with: " << jsonWithNewline << "\n");
+    RTLOG_DEBUG(Daemon, "[RealTimeDaemon][DEBUG] sendJson called with: {}", jsonWithNewline);
     
-    // Send the JSON string to all connected clients.
-    std::lock_guard<std::mutex> lk(m_clientFdsMutex);
-    for (auto it = m_clientFds.begin(); it != m_clientFds.end(); ) {
-        ssize_t written = write(*it, jsonWithNewline.c_str(), jsonWithNewline.size());
-        if (written < 0) {
-            std::cerr << "[RealTimeDaemon] Error writing to client FD=" << *it << ". Closing connection.\n";
-            close(*it);
-            it = m_clientFds.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    // The I/O thread writes it to every JSON client; a slow client never blocks the caller.
+    postOutbound(ClientProtocol::Json, MessageKind::State, std::move(jsonWithNewline));
+}
+
+void RealTimeDaemon::setDefaultClientPolicy(SlowConsumerPolicy policy, size_t maxQueuedMessages)
+{
+    m_defaultClientPolicy = policy;
+    m_defaultClientQueueSize = maxQueuedMessages;
 }
 
 // Direct emergency commands - can be called from any thread
-void RealTimeDaemon::handleEmergencyStop()
+void RealTimeDaemon::handleEmergencyStop(std::chrono::steady_clock::time_point received)
 {
-    std::cout << "[RealTimeDaemon] EMERGENCY STOP TRIGGERED - DIRECT EXECUTION" << std::endl;
-    
-    // Lock to ensure we don't have conflicts with the control thread
-    std::lock_guard<std::mutex> lock(m_emergency_mutex);
-    
-    // Directly call the robot ESTOP method - bypassing the command queue
-    m_robot.setESTOP();
+    // Pre-encoded 0x81 burst straight to the CAN socket - no lock, no waiting for the control cycle
+    double latencyUs = 0.0;
+    m_emergency.trigger(EmergencyAction::Stop, received, latencyUs);
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] EMERGENCY STOP TRIGGERED - DIRECT EXECUTION ({} us)", latencyUs);
 }
 
-void RealTimeDaemon::handleHoldPosition()
+void RealTimeDaemon::handleHoldPosition(std::chrono::steady_clock::time_point received)
 {
-    std::cout << "[RealTimeDaemon] HOLD POSITION TRIGGERED - DIRECT EXECUTION" << std::endl;
-    
-    // Lock to ensure we don't have conflicts with the control thread
-    std::lock_guard<std::mutex> lock(m_emergency_mutex);
-    
-    // Directly call the robot hold position method - bypassing the command queue
-    m_robot.setHoldPosition();
+    double latencyUs = 0.0;
+    m_emergency.trigger(EmergencyAction::Hold, received, latencyUs);
+    RTLOG_INFO(Daemon, "[RealTimeDaemon] HOLD POSITION TRIGGERED - DIRECT EXECUTION ({} us)", latencyUs);
 }
@@ -0,0 +1,274 @@
+#include "recording.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+const char* recordingStateName(RecordingState state)
+{
+    switch (state) {
+    case RecordingState::Idle:      return "idle";
+    case RecordingState::Recording: return "recording";
+    case RecordingState::Stopped:   return "stopped";
+    case RecordingState::Reading:   return "reading";
+    }
+    return "unknown";
+}
+
+namespace recording {
+
+namespace
+{
+// Position channels in trajectory units (0.001 deg, 0.01 differential units), speeds per second
+constexpr float QUANTUM[NUM_CHANNELS] = {
+    0.001f, 0.001f, 0.001f, 0.001f, 0.001f, 0.01f, 0.01f,
+    0.01f, 0.01f, 0.01f, 0.01f, 0.01f, 0.1f, 0.1f,
+    0.001f, 0.001f,
+};
+
+constexpr int MAX_LIMIT_PASSES = 6;
+constexpr double LIMIT_MARGIN = 1.02;   // stretch a little past the bare minimum so one pass usually does
+
+float channel(const RecordedSample& s, size_t c)
+{
+    if (c < 7) return s.position[c];
+    if (c < 14) return s.velocity[c - 7];
+    return c == 14 ? s.roll_deg : s.pitch_deg;
+}
+
+void setChannel(RecordedSample& s, size_t c, float value)
+{
+    if (c < 7) s.position[c] = value;
+    else if (c < 14) s.velocity[c - 7] = value;
+    else if (c == 14) s.roll_deg = value;
+    else s.pitch_deg = value;
+}
+
+void putVarint(std::string& out, int64_t value)
+{
+    uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    while (zigzag >= 0x80) {
+        out.push_back(static_cast<char>((zigzag & 0x7F) | 0x80));
+        zigzag >>= 7;
+    }
+    out.push_back(static_cast<char>(zigzag));
+}
+
+bool getVarint(const std::string& in, size_t& pos, int64_t& value)
+{
+    uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) return false;
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        zigzag |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Centered moving average with the ends held, so the clip keeps its first and last positions
+void smooth(std::vector<double>& values, size_t halfWindow)
+{
+    if (halfWindow == 0 || values.size() < 2) return;
+    const long n = static_cast<long>(values.size());
+    const long h = static_cast<long>(halfWindow);
+    std::vector<double> prefix(values.size() + 1, 0.0);
+    for (long i = 0; i < n; ++i) {
+        prefix[i + 1] = prefix[i] + values[i];
+    }
+    auto at = [&](long i) { return values[std::clamp(i, 0L, n - 1)]; };
+    std::vector<double> out(values.size());
+    for (long i = 0; i < n; ++i) {
+        long lo = i - h;
+        long hi = i + h;
+        double sum = prefix[std::min(hi, n - 1) + 1] - prefix[std::max(lo, 0L)];
+        for (long k = lo; k < 0; ++k) sum += at(k);        // ends held at the first / last value
+        for (long k = n; k <= hi; ++k) sum += at(k);
+        out[i] = sum / static_cast<double>(2 * h + 1);
+    }
+    values.swap(out);
+}
+
+// Central difference, zero at the ends (the clip starts and ends at rest)
+std::vector<double> differentiate(const std::vector<double>& values, double rateHz)
+{
+    std::vector<double> out(values.size(), 0.0);
+    for (size_t i = 1; i + 1 < values.size(); ++i) {
+        out[i] = (values[i + 1] - values[i - 1]) * rateHz * 0.5;
+    }
+    return out;
+}
+}
+
+bool save(const std::string& path, const RecordedSample* samples, size_t count, uint32_t rateHz, std::string& error)
+{
+    FileHeader header {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.channels = NUM_CHANNELS;
+    header.rateHz = rateHz;
+    header.sampleCount = static_cast<uint32_t>(count);
+    std::copy(std::begin(QUANTUM), std::end(QUANTUM), header.quantum);
+
+    std::string payload;
+    payload.reserve(count * NUM_CHANNELS * 2);
+    std::array<int64_t, NUM_CHANNELS> previous {};
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t c = 0; c < NUM_CHANNELS; ++c) {
+            int64_t q = static_cast<int64_t>(std::llround(channel(samples[i], c) / QUANTUM[c]));
+            putVarint(payload, q - previous[c]);
+            previous[c] = q;
+        }
+    }
+    header.payloadBytes = static_cast<uint32_t>(payload.size());
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            error = "cannot open " + tmp;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!out.good()) {
+            error = "write to " + tmp + " failed";
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        error = "rename to " + path + " failed";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load(const std::string& path, std::vector<RecordedSample>& samples, uint32_t& rateHz, std::string& error)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    FileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + " is not a recording";
+        return false;
+    }
+    if (header.version != VERSION || header.channels != NUM_CHANNELS || header.rateHz == 0) {
+        error = path + ": unsupported recording version " + std::to_string(header.version);
+        return false;
+    }
+    std::string payload(header.payloadBytes, '\0');
+    if (!in.read(&payload[0], static_cast<std::streamsize>(payload.size()))) {
+        error = path + " is truncated";
+        return false;
+    }
+
+    samples.assign(header.sampleCount, RecordedSample{});
+    std::array<int64_t, NUM_CHANNELS> value {};
+    size_t pos = 0;
+    for (RecordedSample& s : samples) {
+        for (size_t c = 0; c < NUM_CHANNELS; ++c) {
+            int64_t delta;
+            if (!getVarint(payload, pos, delta)) {
+                error = path + " is corrupt";
+                return false;
+            }
+            value[c] += delta;
+            setChannel(s, c, static_cast<float>(value[c] * static_cast<double>(header.quantum[c])));
+        }
+    }
+    rateHz = header.rateHz;
+    return true;
+}
+
+bool compile(const std::vector<RecordedSample>& samples, uint32_t rateHz, const CompileOptions& options,
+             MotionClipData& clip, double& appliedSlowdown, std::string& error)
+{
+    if (samples.size() < 2 || rateHz == 0) {
+        error = "the recording is empty";
+        return false;
+    }
+    if (!(options.timeScale > 0.0) || options.rateHz == 0 || options.smoothingS < 0.0) {
+        error = "timeScale and the clip rate must be positive";
+        return false;
+    }
+
+    // Held still for one smoothing window at each end, so the clip eases out of and into rest
+    const double padS = options.smoothingS;
+    const double recordedS = static_cast<double>(samples.size() - 1) / rateHz + 2.0 * padS;
+    const double outRate = options.rateHz;
+    appliedSlowdown = 1.0;
+    std::array<std::vector<double>, 7> position;
+    std::array<std::vector<double>, 7> velocity;
+    std::array<std::vector<double>, 7> acceleration;
+
+    for (int pass = 0; pass < MAX_LIMIT_PASSES; ++pass) {
+        // Resample onto the clip's rate; clip time t plays recording time t * timeScale / slowdown
+        const double durationS = recordedS / options.timeScale * appliedSlowdown;
+        const size_t count = static_cast<size_t>(std::floor(durationS * outRate)) + 1;
+        if (count > UINT32_MAX / 2) {
+            error = "the clip would be too long";
+            return false;
+        }
+        // The window is in recording time, so stretching the clip does not let noise back in
+        const size_t halfWindow = static_cast<size_t>(std::lround(options.smoothingS * outRate / 2.0 * durationS / recordedS));
+
+        double worst = 0.0;   // how far over the limits, as a time stretch factor
+        for (size_t j = 0; j < 7; ++j) {
+            std::vector<double>& p = position[j];
+            p.resize(count);
+            for (size_t m = 0; m < count; ++m) {
+                double source = (static_cast<double>(m) / outRate / durationS * recordedS - padS) * rateHz;
+                source = std::clamp(source, 0.0, static_cast<double>(samples.size() - 1));
+                size_t k = static_cast<size_t>(source);
+                size_t k1 = std::min(k + 1, samples.size() - 1);
+                double f = source - static_cast<double>(k);
+                p[m] = samples[k].position[j] * (1.0 - f) + samples[k1].position[j] * f;
+            }
+            smooth(p, halfWindow);
+            smooth(p, halfWindow);
+            velocity[j] = differentiate(p, outRate);
+            acceleration[j] = differentiate(velocity[j], outRate);
+            std::vector<double> jerk = differentiate(acceleration[j], outRate);
+
+            // Stretching time by s divides v by s, a by s^2 and j by s^3
+            for (size_t m = 0; m < count; ++m) {
+                if (options.maxVelocity[j] > 0.0) worst = std::max(worst, std::abs(velocity[j][m]) / options.maxVelocity[j]);
+                if (options.maxAcceleration[j] > 0.0) worst = std::max(worst, std::sqrt(std::abs(acceleration[j][m]) / options.maxAcceleration[j]));
+                if (options.maxJerk[j] > 0.0) worst = std::max(worst, std::cbrt(std::abs(jerk[m]) / options.maxJerk[j]));
+            }
+        }
+        if (!options.limit || worst <= 1.0) break;
+        if (pass == MAX_LIMIT_PASSES - 1) {
+            error = "could not bring the recording under the joint limits (" + std::to_string(worst) + "x over)";
+            return false;
+        }
+        appliedSlowdown *= worst * LIMIT_MARGIN;
+    }
+
+    const size_t count = position[0].size();
+    clip.rateHz = options.rateHz;
+    clip.samples.resize(count);
+    for (size_t m = 0; m < count; ++m) {
+        motion_library::Sample& s = clip.samples[m];
+        for (size_t j = 0; j < 7; ++j) {
+            s.position[j] = static_cast<float>(position[j][m]);
+            s.velocity[j] = static_cast<float>(velocity[j][m]);
+            s.acceleration[j] = static_cast<float>(acceleration[j][m]);
+        }
+    }
+    return true;
+}
+
+} // namespace recording
@@ -1,9 +1,13 @@
 #include "robot_interface.hpp"
 #include "motor_defs.hpp"
 #include <stdexcept>
-#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "rt_log.hpp"
 
 RobotInterface::RobotInterface(CANHandler& canRef, const std::string& urdf_path)
+    : m_can(canRef)
+    , m_urdfPath(urdf_path)
 {
     // Create 7 motors with IDs 0 through 6 - NOTE THE NEGATIVE 1's NEED TO BE CHANGED TO TORQUE CONSTANTS
     // Joint 1 - MG8015 - Base Shoulder
@@ -21,10 +25,35 @@ RobotInterface::RobotInterface(CANHandler& canRef, const std::string& urdf_path)
     // // Joint 7 - MG4005 - Wrist Differential #2
     m_motors.emplace_back(static_cast<uint8_t>(7), canRef, MG4005_REDUCTION_RATIO, MG4005_SINGLE_TURN_DEG_SCALE_MAX, JOINT_7_NM_TO_IQ_M, JOINT_7_NM_TO_IQ_B, JOINT_7_ANGLE_LIMIT_LOW, JOINT_7_ANGLE_LIMIT_HIGH, DIFF_MAX_SPEED, DIFF_MAX_ACCEL, DIFF_MAX_JERK, true);
 
+    // Pre-encode the emergency bursts so sending them needs no allocation or motor state
+    for (size_t i = 0; i < m_motors.size(); ++i) {
+        m_stopFrames[i] = m_motors[i].encodeCommand(0x81);
+        m_holdFrames[i] = m_motors[i].encodeCommand(0xA2); // speed 0 => all data bytes zero
+    }
+
+    m_recording.resize(RECORDING_CAPACITY);
+
+    // Joints 6/7 are tracked in raw motor units. Their default Kp of 80 per motor degree is the
+    // Kp of 8 per raw unit they always had.
+    for (size_t i = 5; i < 7; ++i) {
+        JointGains gains;
+        gains.kp = 80.0f;
+        m_controller.setUnitScale(i, static_cast<float>(1.0 / DIFFERENTIAL_UNITS_PER_DEG));
+        m_controller.setGains(i, gains);
+    }
+
+    // Feed override starts settled at 100%
+    m_feedInput.current_position[0] = 1.0;
+    m_feedInput.target_position[0] = 1.0;
+    m_feedInput.max_velocity[0] = FEED_OVERRIDE_MAX_RATE;
+    m_feedInput.max_acceleration[0] = FEED_OVERRIDE_MAX_ACCEL;
+    m_feedInput.max_jerk[0] = FEED_OVERRIDE_MAX_JERK;
+    m_feedOutput.new_position[0] = 1.0;
+
     // Initialize kinematics if URDF path is provided
     if (!urdf_path.empty()) {
         if (!m_kinematics.loadURDF(urdf_path)) {
-            std::cerr << "Failed to load URDF file: " << urdf_path << std::endl;
+            RTLOG_ERROR(Robot, "Failed to load URDF file: {}", urdf_path);
         }
     }
 }
@@ -37,12 +66,11 @@ Motor& RobotInterface::getMotor(int i)
     return m_motors[i - 1];
 }
 
-// Called from real-time daemon every CONTROL_PERIOD (200Hz default)
+// Called every control period (200Hz default, see setControlPeriod)
 void RobotInterface::updateAll()
 {
-    updateJointStates();
-    updateDifferentialMotors();
-    updateJointTrajectories();
+    updateCycle([](LoopPhase) {});
+    publishSnapshot();
 
 
     // Update Cartesian state if kinematics is initialized
@@ -55,24 +83,90 @@ void RobotInterface::updateAll()
     // }
 }
 
+// Forward kinematics on demand - only called when a client subscribed to the Cartesian pose
+bool RobotInterface::updateCartesianPose()
+{
+    if (m_kinematics.getChain().getNrOfJoints() == 0) {
+        return false;
+    }
+    std::array<double, 7> current_joints;
+    for (size_t i = 0; i < m_motors.size() && i < current_joints.size(); ++i) {
+        current_joints[i] = m_motors[i].getState().multiTurnRad_Mapped;
+    }
+    m_poseFresh = m_kinematics.getForwardKinematics(current_joints, m_state.current_pose);
+    return m_poseFresh;
+}
+
+void RobotInterface::publishSnapshot()
+{
+    RobotSnapshot& snap = m_snapshots.writeBuffer();
+    snap.sequence = ++m_snapshotSequence;
+    snap.stamp = m_lastStateRead;
+    snap.control_period_s = m_state.control_period_s;
+
+    for (size_t i = 0; i < 7; ++i) {
+        snap.motors[i] = i < m_motors.size() ? m_motors[i].getState() : MotorState{};
+        snap.joint_angles_deg[i] = m_state.joint_angles_deg[i];
+        snap.joint_speeds_deg_s[i] = m_state.joint_speeds_deg_s[i];
+        snap.joint_accelerations_deg_s2[i] = m_state.joint_accelerations_deg_s2[i];
+        snap.target_joint_angles_deg[i] = m_state.target_joint_angles_deg[i];
+        snap.target_joint_speeds_deg_s[i] = m_state.target_joint_speeds_deg_s[i];
+        snap.twin_joint_angles_deg[i] = m_state.twin_joint_angles_deg[i];
+    }
+    snap.differential_motors = m_state.differential_motors;
+
+    snap.trajectory_active = m_state.trajectory_active;
+    snap.trajectory_duration = m_state.trajectory_duration;
+    snap.trajectory_progress = m_state.trajectory_progress;
+    snap.trajectory_mode = m_state.trajectory_mode;
+    snap.replan_count = m_state.replan_count;
+    snap.queued_waypoints = static_cast<uint32_t>(m_waypointCount);
+    snap.motion_clip = m_playbackIndex;
+    snap.feed_override = m_feedOutput.new_position[0];
+    snap.feed_override_target = m_feedInput.target_position[0];
+    snap.recording = m_recordingState.load(std::memory_order_relaxed);
+    snap.recorded_samples = static_cast<uint32_t>(m_recordedCount);
+    snap.trajectory_cache = m_trajectoryCache.stats();
+    snap.trajectory_cache_enabled = m_trajectoryCache.enabled();
+    snap.tracking_error_deg = m_state.tracking_error_deg;
+    snap.max_speed_modifier = m_state.max_speed_modifier;
+    for (size_t i = 0; i < 7; ++i) {
+        snap.joint_gains[i] = m_controller.gains(i);
+    }
+
+    snap.twin_active = m_state.twin_active;
+    snap.twin_diff_roll_rad = m_state.twin_diff_roll_rad;
+    snap.twin_diff_pitch_rad = m_state.twin_diff_pitch_rad;
+
+    snap.pose_valid = m_poseFresh;
+    snap.current_pose = m_state.current_pose;
+
+    m_snapshots.publish();
+}
+
+const RobotSnapshot& RobotInterface::latestSnapshot()
+{
+    m_snapshots.update();
+    return m_snapshots.read();
+}
+
 // Sets joint angles for motors 1 through n - input angles in deg (they are converted to raw units after)
-void RobotInterface::setMultiJointAngles(std::vector<float> joint_angles, std::vector<float> joint_speeds) {
-    for (int i = 1; i <= joint_angles.size(); i++){
+void RobotInterface::setMultiJointAngles(const JointValues& joint_angles, const JointValues& joint_speeds, size_t count) {
+    for (size_t i = 1; i <= std::min(count, joint_angles.size()); i++){
         float ang_target_deg = joint_angles.at(i-1);
-        //std::cout << "[RobotInterface] Multi Joint Command Received | Motor: " << i << " | Target (deg): " << ang_target_deg << "\n";
+        RTLOG_DEBUG(Robot, "[RobotInterface] Multi Joint Command Received | Motor: {} | Target (deg): {}", i, ang_target_deg);
         if ((i <= 5 && ang_target_deg >= 0.0) || (i == 6 || i == 7)) {
             auto &curr_mot = m_motors[i-1];
             float ang_target_raw = joint_angles.at(i-1);
             float maxSpeed = abs(joint_speeds.at(i-1));
             m_motors[i-1].setMultiAngleWithSpeed(static_cast<int32_t>(ang_target_raw), static_cast<uint16_t>(maxSpeed));
-            //std::cout << "                 Target Angle Raw: " << ang_target_raw << "\n";
-            //std::cout << "                 MaxSpeed: " << maxSpeed << "\n";
+            RTLOG_DEBUG(Robot, "                 Target Angle Raw: {} MaxSpeed: {}", ang_target_raw, maxSpeed);
         }
     }
 }
 
-void RobotInterface::setMultiJointSpeeds(std::vector<float> joint_speeds) {
-    for (int i = 1; i <= joint_speeds.size(); i++){
+void RobotInterface::setMultiJointSpeeds(const JointValues& joint_speeds) {
+    for (size_t i = 1; i <= joint_speeds.size(); i++){
         auto &m = m_motors[i-1];
         float speed_target_deg_s = std::clamp(joint_speeds.at(i-1), 
                                       -m.getMaxSpeed()*m.getMaxSpeedModifier(),
@@ -156,9 +250,6 @@ std::pair<double, double> RobotInterface::getTwinDifferentialAnglesRad(double ta
 
 // Calculate differential motor positions for given roll and pitch targets
 std::pair<int32_t, int32_t> RobotInterface::getDifferentialAngles(double target_roll_rad, double target_pitch_rad) {
-    // Get current motor angles in raw units (degrees * 10)
-    double current_left = m_motors[6].getState().multiTurnPosition;
-    double current_right = m_motors[5].getState().multiTurnPosition;
     // Convert pitch limits from degrees to radians
     const double PITCH_LIMIT_LOW_RAD = DIFF_PITCH_ANGLE_LIMIT_LOW * M_PI / 180.0;
     const double PITCH_LIMIT_HIGH_RAD = DIFF_PITCH_ANGLE_LIMIT_HIGH * M_PI / 180.0;
@@ -182,14 +273,10 @@ std::pair<int32_t, int32_t> RobotInterface::getDifferentialAngles(double target_
     target_left = target_left * (180.0 / M_PI) * 10.0;
     target_right = target_right * (180.0 / M_PI) * 10.0;
     
-    // Calculate differences from current positions
-    double left_diff = target_left - current_left;
-    double right_diff = target_right - current_right;
-    
-    // Calculate final target positions
-    int32_t final_left = static_cast<int32_t>(current_left + left_diff);
-    int32_t final_right = static_cast<int32_t>(current_right + right_diff);
-    
+    // Absolute multi-turn targets; they do not depend on where the motors are now
+    int32_t final_left = static_cast<int32_t>(target_left);
+    int32_t final_right = static_cast<int32_t>(target_right);
+
     return {final_left, final_right};
 }
 
@@ -201,15 +288,13 @@ void RobotInterface::setDifferentialAngles(double target_roll_rad, double target
     m_motors[6].setMultiAngleWithSpeed(final_left, max_motor_speed);
     m_motors[5].setMultiAngleWithSpeed(final_right, max_motor_speed);
 
-    std::cerr << "[RobotInterface::setDifferentialAngles] Command Summary:" << std::endl
-              << "  Inputs:" << std::endl
-              << "    Target Roll: " << target_roll_rad << " rad (" << target_roll_rad * 180.0/M_PI << " deg)" << std::endl
-              << "    Target Pitch: " << target_pitch_rad << " rad (" << target_pitch_rad * 180.0/M_PI << " deg)" << std::endl
-              << "    Wrapped Pitch: " << std::fmod(target_pitch_rad + M_PI, 2*M_PI) - M_PI << " rad (" 
-              << (std::fmod(target_pitch_rad + M_PI, 2*M_PI) - M_PI) * 180.0/M_PI << " deg)" << std::endl
-              << "  Final Commands:" << std::endl
-              << "    Left Motor (ID 7): Position=" << final_left << " (0.1 deg)" << std::endl
-              << "    Right Motor (ID 6): Position=" << final_right << " (0.1 deg)" << std::endl;
+    double wrapped_pitch_rad = std::fmod(target_pitch_rad + M_PI, 2*M_PI) - M_PI;
+    RTLOG_DEBUG(Robot, "[RobotInterface::setDifferentialAngles] Command Summary:");
+    RTLOG_DEBUG(Robot, "    Target Roll: {} rad ({} deg)", target_roll_rad, target_roll_rad * 180.0/M_PI);
+    RTLOG_DEBUG(Robot, "    Target Pitch: {} rad ({} deg)", target_pitch_rad, target_pitch_rad * 180.0/M_PI);
+    RTLOG_DEBUG(Robot, "    Wrapped Pitch: {} rad ({} deg)", wrapped_pitch_rad, wrapped_pitch_rad * 180.0/M_PI);
+    RTLOG_DEBUG(Robot, "    Left Motor (ID 7): Position={} (0.1 deg)", final_left);
+    RTLOG_DEBUG(Robot, "    Right Motor (ID 6): Position={} (0.1 deg)", final_right);
 }
 
 // Move to joint position along ruckig generated joint trajectories
@@ -219,14 +304,12 @@ void RobotInterface::setDifferentialAngles(double target_roll_rad, double target
 void RobotInterface::moveToJointPosition(const std::array<double, 7>& target_position)
 {   
     if (m_state.trajectory_active) {
-        std::cerr << "[RobotInterface::moveToJointPosition] Trajectory already active. Resetting ruckig state and running new trajectory." << std::endl;
+        RTLOG_INFO(Robot, "[RobotInterface::moveToJointPosition] Trajectory already active. Resetting ruckig state and running new trajectory.");
         resetRuckigState();
     }
-    std::cerr << "[RobotInterface::moveToJointPosition] Target Position: ";
-    for (size_t i = 0; i < 7; ++i) {
-        std::cerr << target_position[i] << " ";
-    }
-    std::cerr << std::endl;
+    RTLOG_INFO(Robot, "[RobotInterface::moveToJointPosition] Target Position: {} {} {} {} {} {} {}",
+               target_position[0], target_position[1], target_position[2], target_position[3],
+               target_position[4], target_position[5], target_position[6]);
     // Set target positions in state
     for (size_t i = 0; i < 5; ++i) {
         m_state.target_joint_angles_deg[i] = target_position[i];
@@ -238,18 +321,14 @@ void RobotInterface::moveToJointPosition(const std::array<double, 7>& target_pos
     double target_roll_rad = target_position[5] * M_PI / 180.0;
     double target_pitch_rad = target_position[6] * M_PI / 180.0;
 
-    std::cerr << "[RobotInterface::moveToJointPosition] DIFFERENTIAL CONVERSION:" << std::endl;
-    std::cerr << "  Target Roll: " << target_position[5] << " deg (" << target_roll_rad << " rad)" << std::endl;
-    std::cerr << "  Target Pitch: " << target_position[6] << " deg (" << target_pitch_rad << " rad)" << std::endl;
-    
-    // Log current motor states
-    std::cerr << "  Current Left Motor (7): " << m_motors[6].getState().multiTurnPosition << " (raw)" << std::endl;
-    std::cerr << "  Current Right Motor (6): " << m_motors[5].getState().multiTurnPosition << " (raw)" << std::endl;
+    RTLOG_DEBUG(Robot, "[RobotInterface::moveToJointPosition] DIFFERENTIAL CONVERSION:");
+    RTLOG_DEBUG(Robot, "  Target Roll: {} deg ({} rad)", target_position[5], target_roll_rad);
+    RTLOG_DEBUG(Robot, "  Target Pitch: {} deg ({} rad)", target_position[6], target_pitch_rad);
 
     auto [final_left, final_right] = getDifferentialAngles(target_roll_rad, target_pitch_rad);
-    
-    std::cerr << "  Calculated Left Motor (7): " << final_left << " (raw) - diff: " << (final_left - m_motors[6].getState().multiTurnPosition) << std::endl;
-    std::cerr << "  Calculated Right Motor (6): " << final_right << " (raw) - diff: " << (final_right - m_motors[5].getState().multiTurnPosition) << std::endl;
+
+    RTLOG_DEBUG(Robot, "  Left Motor (7): current {} calculated {} (raw)", m_motors[6].getState().multiTurnPosition, final_left);
+    RTLOG_DEBUG(Robot, "  Right Motor (6): current {} calculated {} (raw)", m_motors[5].getState().multiTurnPosition, final_right);
     
     m_state.target_joint_angles_deg[6] = final_left;
     m_state.target_joint_angles_deg[5] = final_right;
@@ -268,17 +347,22 @@ void RobotInterface::moveToJointPosition(const std::array<double, 7>& target_pos
     }
 
     // Log the actual input to Ruckig
-    std::cerr << "[RobotInterface::moveToJointPosition] RUCKIG INPUT VERIFICATION:" << std::endl;
-    std::cerr << "  Current Position: ";
-    for (size_t i = 0; i < 7; ++i) {
-        std::cerr << m_state.ruckig_input.current_position[i] << (i < 6 ? ", " : "");
-    }
-    std::cerr << std::endl;
-    std::cerr << "  Target Position: ";
-    for (size_t i = 0; i < 7; ++i) {
-        std::cerr << m_state.ruckig_input.target_position[i] << (i < 6 ? ", " : "");
+    const auto& in = m_state.ruckig_input;
+    RTLOG_DEBUG(Robot, "[RobotInterface::moveToJointPosition] RUCKIG INPUT VERIFICATION:");
+    RTLOG_DEBUG(Robot, "  Current Position: {}, {}, {}, {}, {}, {}, {}",
+                in.current_position[0], in.current_position[1], in.current_position[2], in.current_position[3],
+                in.current_position[4], in.current_position[5], in.current_position[6]);
+    RTLOG_DEBUG(Robot, "  Target Position: {}, {}, {}, {}, {}, {}, {}",
+                in.target_position[0], in.target_position[1], in.target_position[2], in.target_position[3],
+                in.target_position[4], in.target_position[5], in.target_position[6]);
+
+    // Plan-once moves are computed here, once; online moves are computed by Ruckig::update every cycle
+    m_state.segment_dwell_s = 0.0;
+    m_state.trajectory_planned = m_state.trajectory_mode == TrajectoryMode::PlanOnce;
+    if (m_state.trajectory_planned && !planTrajectory()) {
+        setHoldPosition();
+        return;
     }
-    std::cerr << std::endl;
 
     // Activate trajectory
     m_state.trajectory_active = true;
@@ -287,68 +371,37 @@ void RobotInterface::moveToJointPosition(const std::array<double, 7>& target_pos
 
 void RobotInterface::updateJointTrajectories()
 {
+    // A new library only replaces the old one between clips
+    if (m_playback == nullptr && m_pendingLibrary.load(std::memory_order_relaxed) != nullptr) {
+        m_motionLibrary = m_pendingLibrary.exchange(nullptr, std::memory_order_acquire);
+        m_libraryInUse.store(m_motionLibrary, std::memory_order_release);
+    }
+    // Trajectory time of this cycle: the time that passed, scaled by the feed override
+    double step = advanceFeedOverride();
     if (!m_state.trajectory_active) return;
 
+    if (m_playback != nullptr) {
+        samplePlayback(step);
+        return;
+    }
+    if (m_state.trajectory_planned) {
+        samplePlannedTrajectory(step);
+        return;
+    }
+
+    if (step <= 0.0) {
+        // Paused: hold the last setpoint; Ruckig's clock resumes with the override
+        std::array<double, 7> still {};
+        trackSetpoint(m_state.ruckig_input.current_position, still, still);
+        return;
+    }
+    m_state.ruckig_otg.delta_time = step;
     ruckig::Result r = m_state.ruckig_otg.update(m_state.ruckig_input, m_state.ruckig_output);
     if (r == ruckig::Result::Working) {
-        // Debug the raw Ruckig output
-        // std::cerr << "[RobotInterface::updateJointTrajectories] RAW RUCKIG OUTPUT ANALYSIS:" << std::endl;
-        // for (size_t i = 0; i < 7; ++i) {
-        //     std::cerr << "  Joint " << i+1 
-        //             << " - Current: " << m_state.ruckig_input.current_position[i]
-        //             << ", Target: " << m_state.ruckig_input.target_position[i] 
-        //             << ", Ruckig New: " << m_state.ruckig_output.new_position[i]
-        //             << ", Delta: " << (m_state.ruckig_output.new_position[i] - m_state.ruckig_input.current_position[i])
-        //             << std::endl;
-        // }
-        
-        // Convert arrays to vectors with proper type conversion
-        std::vector<float> positions(7);
-        std::vector<float> velocities(7);
-        
-        for (size_t i = 0; i < 7; ++i) {
-            positions[i] = static_cast<float>(m_state.ruckig_output.new_position[i]);
-            velocities[i] = static_cast<float>(m_state.ruckig_output.new_velocity[i]);
-        }
-
-        setTwinJointAngles(positions);
-        std::vector<float> twin_joint_accelerations(7);
-        for (size_t i = 0; i < 7; ++i) {
-            twin_joint_accelerations[i] = static_cast<float>(m_state.ruckig_output.new_acceleration[i]);
-        }
-        setTwinJointAccelerations(twin_joint_accelerations);
-        setTwinJointSpeeds(velocities);
-
-        // Adjust speeds for differential motors
-        velocities[5] /= 10.0f;
-        velocities[6] /= 10.0f;
-
-        // Apply PI controller to adjust velocities
-        for (size_t i = 0; i < 7; ++i) {
-            // Calculate position error (current Ruckig position - actual motor position)
-            // Note: m_state.joint_angles_deg[i] was updated in updateAll() at 200Hz
-            m_state.pi_controller.position_error[i] = positions[i] - m_state.joint_angles_deg[i];
-            
-            // Update integral error (with anti-windup)
-            float new_integral = m_state.pi_controller.integral_error[i] + 
-                               m_state.pi_controller.position_error[i] * (1.0f/200.0f); // dt = 1/200 for 200Hz
-            
-            // Anti-windup: limit integral term to prevent excessive accumulation
-            m_state.pi_controller.integral_error[i] = std::clamp(new_integral, 
-                                                               -m_state.pi_controller.max_integral, 
-                                                               m_state.pi_controller.max_integral);
-            
-            // Calculate velocity correction
-            float velocity_correction = m_state.pi_controller.Kp * m_state.pi_controller.position_error[i] +
-                                     m_state.pi_controller.Ki * m_state.pi_controller.integral_error[i];
-            
-            // Apply correction to velocity
-            velocities[i] += velocity_correction;
-        
-        }
-
-        // Command adjusted velocities
-        setMultiJointSpeeds(velocities);
+        std::array<double, 7> velocity = m_state.ruckig_output.new_velocity;
+        std::array<double, 7> acceleration = m_state.ruckig_output.new_acceleration;
+        applyFeedOverride(velocity, acceleration);
+        trackSetpoint(m_state.ruckig_output.new_position, velocity, acceleration);
 
         // Update Ruckig input for next cycle using current states
         for (size_t i = 0; i < 7; ++i) {
@@ -358,16 +411,477 @@ void RobotInterface::updateJointTrajectories()
         }
         m_state.ruckig_output.pass_to_input(m_state.ruckig_input);
     } else if (r == ruckig::Result::Finished) {
-        m_state.trajectory_active = false;
-        std::cout << "Trajectory duration: " << m_state.ruckig_output.trajectory.get_duration() << " [s]. Setting hold position." << std::endl;
-        setHoldPosition(); // THIS IS A HACK TO STOP ROBOT WHEN RUCKIG FINISHES, WILL NEED TO CHANGE WHEN DIRECTLY MOVING INTO ANOTHER TRAJECTORY.
+        finishTrajectory(m_state.ruckig_output.trajectory.get_duration());
     } else {
         // Handle errors by stopping trajectory and setting robot to hold position
         setHoldPosition();
-        std::cout << "Trajectory error: " << r << std::endl;
+        RTLOG_ERROR(Robot, "Trajectory error: {}", r);
     }
 }
 
+void RobotInterface::samplePlannedTrajectory(double step)
+{
+    // Advance by the time that really passed (whole periods, see updateJointStates) times the override
+    m_state.trajectory_time += step;
+    double duration = m_state.trajectory_duration;
+    bool switched = false;
+    // A waypoint with a dwell holds the segment's final setpoint that much longer
+    if (m_state.trajectory_time >= duration + m_state.segment_dwell_s && m_waypointCount > 0) {
+        if (!m_nextSegmentReady) {
+            planNextSegment();   // the waypoint arrived too late to be planned ahead
+        }
+        if (m_nextSegmentReady) {
+            // Flow into the next segment; it starts exactly where this one ends, with the time left over
+            m_state.trajectory_time -= duration + m_state.segment_dwell_s;
+            m_state.segment_dwell_s = popWaypoint().dwell_s;
+            m_state.ruckig_input = m_nextInput;
+            std::swap(m_state.planned_trajectory, m_nextSegment);
+            m_nextSegmentReady = false;
+            m_state.trajectory_duration = m_state.planned_trajectory.get_duration();
+            for (size_t i = 0; i < 7; ++i) {
+                m_state.target_joint_angles_deg[i] = m_state.ruckig_input.target_position[i];
+                m_state.target_joint_speeds_deg_s[i] = m_state.ruckig_input.target_velocity[i];
+            }
+            switched = true;
+        }
+    }
+    duration = m_state.trajectory_duration;   // a failed plan-ahead replans the active segment
+    if (m_state.trajectory_time >= duration + m_state.segment_dwell_s) {
+        finishTrajectory(duration);
+        return;
+    }
+    // Plan the following segment now, not on the cycle that needs it (nor on the one that just switched)
+    if (m_waypointCount > 0 && !m_nextSegmentReady && !switched) {
+        planNextSegment();
+        duration = m_state.trajectory_duration;
+    }
+
+    std::array<double, 7> position;
+    std::array<double, 7> velocity;
+    std::array<double, 7> acceleration;
+    m_state.planned_trajectory.at_time(std::min(m_state.trajectory_time, duration), position, velocity, acceleration);
+
+    // The PI loop absorbs small tracking errors; only a large one (a stall, a collision, a joint
+    // that could not keep up) is worth a new plan, and then from where the arm really is
+    double worstErrorDeg = 0.0;
+    for (size_t i = 0; i < 7; ++i) {
+        double error = std::abs(position[i] - m_state.joint_angles_deg[i]);
+        if (i == 5 || i == 6) error /= DIFFERENTIAL_UNITS_PER_DEG;
+        worstErrorDeg = std::max(worstErrorDeg, error);
+    }
+    if (worstErrorDeg > m_state.replan_threshold_deg && m_state.trajectory_time >= REPLAN_HOLDOFF_S) {
+        for (size_t i = 0; i < 7; ++i) {
+            m_state.ruckig_input.current_position[i] = m_state.joint_angles_deg[i];
+            m_state.ruckig_input.current_velocity[i] = velocity[i];        // keep the commanded motion smooth
+            m_state.ruckig_input.current_acceleration[i] = acceleration[i];
+        }
+        if (!planTrajectory()) {
+            setHoldPosition();
+            return;
+        }
+        m_state.replan_count++;
+        RTLOG_WARN(Robot, "[RobotInterface] Tracking error {} deg over {} deg, replanned ({} s left)",
+                   worstErrorDeg, m_state.replan_threshold_deg, m_state.trajectory_duration);
+        duration = m_state.trajectory_duration;
+        m_state.planned_trajectory.at_time(0.0, position, velocity, acceleration);
+    }
+
+    m_state.trajectory_progress = duration > 0.0 ? std::min(m_state.trajectory_time / duration, 1.0) : 1.0;
+    applyFeedOverride(velocity, acceleration);
+    trackSetpoint(position, velocity, acceleration);
+}
+
+void RobotInterface::samplePlayback(double step)
+{
+    // Clip time follows the periods that passed (more than one after an overrun), so the clip keeps
+    // to wall-clock time; under a feed override it lands between samples
+    m_playbackCursor += step * m_playback->rateHz;
+    if (m_playbackCursor > static_cast<double>(m_playback->sampleCount - 1)) {
+        double duration = m_playback->duration();
+        m_playback = nullptr;
+        m_playbackIndex = -1;
+        finishTrajectory(duration);
+        return;
+    }
+
+    m_playbackSample = static_cast<uint32_t>(m_playbackCursor);
+    const motion_library::Sample& a = m_playback->samples[m_playbackSample];
+    const motion_library::Sample& b = m_playback->samples[std::min(m_playbackSample + 1, m_playback->sampleCount - 1)];
+    const double f = m_playbackCursor - static_cast<double>(m_playbackSample);
+    std::array<double, 7> position;
+    std::array<double, 7> velocity;
+    std::array<double, 7> acceleration;
+    for (size_t i = 0; i < 7; ++i) {
+        position[i] = a.position[i] + (b.position[i] - a.position[i]) * f;
+        velocity[i] = a.velocity[i] + (b.velocity[i] - a.velocity[i]) * f;
+        acceleration[i] = a.acceleration[i] + (b.acceleration[i] - a.acceleration[i]) * f;
+    }
+    m_state.trajectory_time = m_playbackCursor / m_playback->rateHz;
+    m_state.trajectory_progress = m_playbackCursor / m_playback->sampleCount;
+    applyFeedOverride(velocity, acceleration);
+    trackSetpoint(position, velocity, acceleration);
+}
+
+void RobotInterface::setFeedOverride(double scale)
+{
+    scale = std::clamp(scale, 0.0, MAX_FEED_OVERRIDE);
+    m_feedInput.target_position[0] = scale;
+    RTLOG_INFO(Robot, "[RobotInterface] Feed override {}% -> {}%", m_feedOutput.new_position[0] * 100.0, scale * 100.0);
+}
+
+double RobotInterface::advanceFeedOverride()
+{
+    const double dt = m_state.state_dt_s;
+    const double before = m_feedOutput.new_position[0];
+    bool settled = m_feedInput.current_position[0] == m_feedInput.target_position[0]
+                   && m_feedInput.current_velocity[0] == 0.0 && m_feedInput.current_acceleration[0] == 0.0;
+    if (!settled && dt > 0.0) {
+        m_feedOtg.delta_time = dt;
+        ruckig::Result r = m_feedOtg.update(m_feedInput, m_feedOutput);
+        if (r == ruckig::Result::Working) {
+            m_feedOutput.pass_to_input(m_feedInput);
+        } else {
+            if (r != ruckig::Result::Finished) {
+                RTLOG_WARN(Robot, "[RobotInterface] Feed override ramp failed ({}), switching directly", r);
+            }
+            // Land exactly on the target so the next cycles skip the update
+            m_feedInput.current_position[0] = m_feedInput.target_position[0];
+            m_feedInput.current_velocity[0] = 0.0;
+            m_feedInput.current_acceleration[0] = 0.0;
+            m_feedOutput.new_position[0] = m_feedInput.target_position[0];
+            m_feedOutput.new_velocity[0] = 0.0;
+            m_feedOutput.new_acceleration[0] = 0.0;
+        }
+    }
+    // Mean override over the cycle
+    return std::max(0.0, 0.5 * (before + m_feedOutput.new_position[0]) * dt);
+}
+
+void RobotInterface::applyFeedOverride(std::array<double, 7>& velocity, std::array<double, 7>& acceleration) const
+{
+    // p(tau(t)) with dtau/dt = s: v = s * dp/dtau, a = s^2 * d2p/dtau2 + ds/dt * dp/dtau
+    const double s = m_feedOutput.new_position[0];
+    const double sDot = m_feedOutput.new_velocity[0];
+    if (s == 1.0 && sDot == 0.0) return;
+    for (size_t i = 0; i < 7; ++i) {
+        acceleration[i] = acceleration[i] * s * s + velocity[i] * sDot;
+        velocity[i] *= s;
+    }
+}
+
+bool RobotInterface::playMotion(size_t index)
+{
+    if (m_motionLibrary == nullptr || index >= m_motionLibrary->size()) {
+        RTLOG_ERROR(Robot, "[RobotInterface] playMotion: no clip {} in the motion library", index);
+        return false;
+    }
+    const MotionClip& clip = m_motionLibrary->clip(index);
+    long rateHz = std::lround(1.0 / m_state.control_period_s);
+    if (static_cast<long>(clip.rateHz) != rateHz) {
+        RTLOG_ERROR(Robot, "[RobotInterface] playMotion: '{}' is sampled at {} Hz, the control loop runs at {} Hz",
+                    clip.name, clip.rateHz, rateHz);
+        return false;
+    }
+    for (size_t i = 0; i < 7; ++i) {
+        double tolerance = PLAYBACK_START_TOLERANCE_DEG * (i >= 5 ? DIFFERENTIAL_UNITS_PER_DEG : 1.0);
+        if (std::abs(clip.samples[0].position[i] - m_state.joint_angles_deg[i]) > tolerance) {
+            RTLOG_ERROR(Robot, "[RobotInterface] playMotion: '{}' starts with joint {} at {}, it is at {} - move there first",
+                        clip.name, i + 1, clip.samples[0].position[i], m_state.joint_angles_deg[i]);
+            return false;
+        }
+    }
+
+    if (m_state.trajectory_active) {
+        resetRuckigState();
+    }
+    for (size_t i = 0; i < 7; ++i) {
+        m_state.target_joint_angles_deg[i] = clip.samples[clip.sampleCount - 1].position[i];
+        m_state.target_joint_speeds_deg_s[i] = 0.0;
+        m_state.target_joint_accelerations_deg_s2[i] = 0.0;
+    }
+    m_playback = &clip;
+    m_playbackIndex = static_cast<int32_t>(index);
+    m_playbackSample = 0;
+    m_playbackCursor = 0.0;
+    m_state.trajectory_planned = false;
+    m_state.trajectory_duration = clip.duration();
+    m_state.trajectory_time = 0.0;
+    m_state.trajectory_progress = 0.0;
+    m_state.trajectory_active = true;
+    RTLOG_INFO(Robot, "[RobotInterface] Playing '{}' ({} samples, {} s)", clip.name, clip.sampleCount, clip.duration());
+    return true;
+}
+
+bool RobotInterface::planTrajectory()
+{
+    ruckig::Result r = calculateTrajectory(m_state.ruckig_input, m_state.planned_trajectory);
+    if (r != ruckig::Result::Working) {
+        RTLOG_ERROR(Robot, "[RobotInterface] Trajectory planning failed: {}", r);
+        return false;
+    }
+    m_state.trajectory_duration = m_state.planned_trajectory.get_duration();
+    m_state.trajectory_time = 0.0;
+    return true;
+}
+
+ruckig::Result RobotInterface::calculateTrajectory(const ruckig::InputParameter<7>& input, ruckig::Trajectory<7>& trajectory)
+{
+    if (m_trajectoryCache.lookup(input, trajectory)) {
+        return ruckig::Result::Working;
+    }
+    ruckig::Result r = m_state.ruckig_otg.calculate(input, trajectory);
+    if (r == ruckig::Result::Working) {
+        m_trajectoryCache.insert(input, trajectory);
+    }
+    return r;
+}
+
+void RobotInterface::trackSetpoint(const std::array<double, 7>& position, const std::array<double, 7>& velocity,
+                                   const std::array<double, 7>& acceleration)
+{
+    JointValues positions;
+    JointValues velocities;
+    JointValues twin_joint_accelerations;
+    for (size_t i = 0; i < 7; ++i) {
+        positions[i] = static_cast<float>(position[i]);
+        velocities[i] = static_cast<float>(velocity[i]);
+        twin_joint_accelerations[i] = static_cast<float>(acceleration[i]);
+    }
+
+    setTwinJointAngles(positions);
+    setTwinJointAccelerations(twin_joint_accelerations);
+    setTwinJointSpeeds(velocities);
+
+    // Controller inputs, padded to its vector width
+    JointController::Lanes setpoint {};
+    JointController::Lanes speed {};
+    JointController::Lanes accel {};
+    JointController::Lanes measured {};
+    JointController::Lanes limits {};
+    JointController::Lanes commands {};
+    for (size_t i = 0; i < 7; ++i) {
+        setpoint[i] = positions[i];
+        speed[i] = velocities[i];
+        accel[i] = twin_joint_accelerations[i];
+        // m_state.joint_angles_deg was updated in updateJointStates() this cycle
+        measured[i] = static_cast<float>(m_state.joint_angles_deg[i]);
+        limits[i] = m_motors[i].getMaxSpeed() * m_motors[i].getMaxSpeedModifier();
+    }
+    m_controller.update(setpoint, speed, accel, measured, limits, static_cast<float>(m_state.state_dt_s), commands);
+
+    m_state.tracking_error_deg = 0.0;
+    for (size_t i = 0; i < 7; ++i) {
+        m_state.pi_controller.position_error[i] = m_controller.positionError(i);
+        double errorDeg = std::abs(m_state.pi_controller.position_error[i]);
+        if (i == 5 || i == 6) errorDeg /= DIFFERENTIAL_UNITS_PER_DEG;
+        m_state.tracking_error_deg = std::max(m_state.tracking_error_deg, errorDeg);
+    }
+
+    for (size_t i = 0; i < 7; ++i) {
+        velocities[i] = commands[i];
+    }
+    setMultiJointSpeeds(velocities);
+    m_trackingStats.sample(m_state.pi_controller.position_error, m_state.joint_angles_deg, m_state.state_dt_s);
+}
+
+void RobotInterface::finishTrajectory(double duration)
+{
+    m_state.trajectory_active = false;
+    if (m_waypointCount > 0) {
+        startWaypointSegment();
+        return;
+    }
+    RTLOG_INFO(Robot, "Trajectory duration: {} [s]. Setting hold position.", duration);
+    m_trackingStats.finish(m_state.target_joint_angles_deg);
+    setHoldPosition(); // THIS IS A HACK TO STOP ROBOT WHEN RUCKIG FINISHES, WILL NEED TO CHANGE WHEN DIRECTLY MOVING INTO ANOTHER TRAJECTORY.
+}
+
+bool RobotInterface::queueWaypoint(const JointWaypoint& waypoint)
+{
+    if (m_waypointCount == MAX_WAYPOINTS) {
+        RTLOG_ERROR(Robot, "[RobotInterface] Waypoint queue full ({}), waypoint dropped", MAX_WAYPOINTS);
+        return false;
+    }
+    JointWaypoint& slot = m_waypoints[(m_waypointHead + m_waypointCount) % MAX_WAYPOINTS];
+    slot = waypoint;
+    slot.velocityCount = std::min(waypoint.velocityCount, waypoint.velocity.size());
+    slot.position = toTrajectorySpace(waypoint.position);
+    slot.speed = std::clamp(waypoint.speed, JointWaypoint::MIN_SPEED, 1.0);
+    slot.dwell_s = std::max(waypoint.dwell_s, 0.0);
+    m_waypointCount++;
+
+    if (!m_state.trajectory_active) {
+        startWaypointSegment();
+    } else if (m_nextSegmentReady && m_waypointCount == 2) {
+        // The planned-ahead segment stops at its waypoint; plan it again to flow into this one
+        m_nextSegmentReady = false;
+    }
+    return true;
+}
+
+void RobotInterface::clearWaypoints()
+{
+    m_waypointEpoch++;
+    m_waypointCount = 0;
+    m_nextSegmentReady = false;
+    if (!m_state.trajectory_active || !m_state.trajectory_planned) return;
+
+    bool moving = false;
+    for (size_t i = 0; i < 7; ++i) {
+        moving = moving || m_state.ruckig_input.target_velocity[i] != 0.0;
+    }
+    if (!moving) return;
+
+    // The active segment was heading into the next waypoint at speed; end it at rest instead
+    std::array<double, 7> position;
+    std::array<double, 7> velocity;
+    std::array<double, 7> acceleration;
+    m_state.planned_trajectory.at_time(m_state.trajectory_time, position, velocity, acceleration);
+    for (size_t i = 0; i < 7; ++i) {
+        m_state.ruckig_input.current_position[i] = position[i];
+        m_state.ruckig_input.current_velocity[i] = velocity[i];
+        m_state.ruckig_input.current_acceleration[i] = acceleration[i];
+        m_state.ruckig_input.target_velocity[i] = 0.0;
+        m_state.target_joint_speeds_deg_s[i] = 0.0;
+    }
+    if (!planTrajectory()) {
+        setHoldPosition();
+    }
+}
+
+const JointWaypoint* RobotInterface::waypointAt(size_t index) const
+{
+    if (index >= m_waypointCount) return nullptr;
+    return &m_waypoints[(m_waypointHead + index) % MAX_WAYPOINTS];
+}
+
+JointWaypoint RobotInterface::popWaypoint()
+{
+    JointWaypoint front = m_waypoints[m_waypointHead];
+    m_waypointHead = (m_waypointHead + 1) % MAX_WAYPOINTS;
+    m_waypointCount--;
+    m_waypointsStarted++;
+    return front;
+}
+
+std::array<double, 7> RobotInterface::toTrajectorySpace(const std::array<double, 7>& target_position)
+{
+    std::array<double, 7> target;
+    for (size_t i = 0; i < 5; ++i) {
+        target[i] = target_position[i];
+    }
+    auto [final_left, final_right] = getDifferentialAngles(target_position[5] * M_PI / 180.0, target_position[6] * M_PI / 180.0);
+    target[5] = final_right;
+    target[6] = final_left;
+    return target;
+}
+
+std::array<double, 7> RobotInterface::passThroughVelocity(const std::array<double, 7>& from, const JointWaypoint& via,
+                                                          const JointWaypoint* next) const
+{
+    std::array<double, 7> velocity {};
+    if (next == nullptr || via.dwell_s > 0.0) return velocity;   // last waypoint or a dwell: stop there
+
+    for (size_t i = 0; i < 7; ++i) {
+        double limit = m_state.joint_max_speeds_deg_s[i] * std::min(via.speed, next->speed);
+        if (i < via.velocityCount) {
+            velocity[i] = std::clamp(via.velocity[i], -limit, limit);
+            continue;
+        }
+        // A joint that reverses (or holds still) at the waypoint passes it at rest. One that keeps
+        // going passes at a share of its limit, less when one side of the waypoint is a short hop
+        double in = via.position[i] - from[i];
+        double out = next->position[i] - via.position[i];
+        if (in * out <= 0.0) continue;
+        double ratio = std::min(std::abs(in), std::abs(out)) / std::max(std::abs(in), std::abs(out));
+        velocity[i] = std::copysign(limit * BLEND_SPEED_FRACTION * ratio, out);
+    }
+    return velocity;
+}
+
+void RobotInterface::setSegmentTarget(ruckig::InputParameter<7>& input, const std::array<double, 7>& target,
+                                      const std::array<double, 7>& targetVelocity, double speed) const
+{
+    // Scaled like the max speed modifier: velocity, acceleration and jerk alike
+    for (size_t i = 0; i < 7; ++i) {
+        input.target_position[i] = target[i];
+        input.target_velocity[i] = targetVelocity[i];
+        input.target_acceleration[i] = 0.0;
+        input.max_velocity[i] = m_state.joint_max_speeds_deg_s[i] * speed;
+        input.max_acceleration[i] = m_state.joint_max_accelerations_deg_s2[i] * speed;
+        input.max_jerk[i] = m_state.joint_max_jerks_deg_s3[i] * speed;
+    }
+}
+
+void RobotInterface::startWaypointSegment()
+{
+    JointWaypoint via = popWaypoint();
+    std::array<double, 7> from;
+    for (size_t i = 0; i < 7; ++i) {
+        from[i] = m_state.joint_angles_deg[i];
+        m_state.ruckig_input.current_position[i] = m_state.joint_angles_deg[i];
+        m_state.ruckig_input.current_velocity[i] = m_state.joint_speeds_deg_s[i];
+        m_state.ruckig_input.current_acceleration[i] = m_state.joint_accelerations_deg_s2[i];
+    }
+    setSegmentTarget(m_state.ruckig_input, via.position, passThroughVelocity(from, via, waypointAt(0)), via.speed);
+    for (size_t i = 0; i < 7; ++i) {
+        m_state.target_joint_angles_deg[i] = m_state.ruckig_input.target_position[i];
+        m_state.target_joint_speeds_deg_s[i] = m_state.ruckig_input.target_velocity[i];
+        m_state.target_joint_accelerations_deg_s2[i] = 0.0;
+    }
+
+    m_nextSegmentReady = false;
+    m_state.segment_dwell_s = via.dwell_s;
+    m_state.trajectory_planned = true;
+    if (!planTrajectory()) {
+        setHoldPosition();   // also drops the rest of the queue
+        return;
+    }
+    m_state.trajectory_active = true;
+    m_state.trajectory_progress = 0.0;
+    RTLOG_INFO(Robot, "[RobotInterface] Waypoint segment started ({} s, {} waypoints queued)",
+               m_state.trajectory_duration, m_waypointCount);
+}
+
+void RobotInterface::planNextSegment()
+{
+    const JointWaypoint* via = waypointAt(0);
+    if (via == nullptr) return;
+
+    std::array<double, 7> from;
+    m_nextInput = m_state.ruckig_input;
+    for (size_t i = 0; i < 7; ++i) {
+        from[i] = m_state.ruckig_input.target_position[i];
+        m_nextInput.current_position[i] = m_state.ruckig_input.target_position[i];
+        m_nextInput.current_velocity[i] = m_state.ruckig_input.target_velocity[i];
+        m_nextInput.current_acceleration[i] = m_state.ruckig_input.target_acceleration[i];
+    }
+    setSegmentTarget(m_nextInput, via->position, passThroughVelocity(from, *via, waypointAt(1)), via->speed);
+
+    ruckig::Result r = calculateTrajectory(m_nextInput, m_nextSegment);
+    m_nextSegmentReady = r == ruckig::Result::Working;
+    if (!m_nextSegmentReady) {
+        // Stop at the current target rather than arrive there at speed with nowhere to go
+        RTLOG_ERROR(Robot, "[RobotInterface] Planning the next waypoint segment failed: {} - dropping the queue", r);
+        clearWaypoints();
+    }
+}
+
+void RobotInterface::setTrajectoryMode(TrajectoryMode mode, double replanThresholdDeg)
+{
+    m_state.trajectory_mode = mode;
+    m_state.replan_threshold_deg = replanThresholdDeg;
+    RTLOG_INFO(Robot, "[RobotInterface] Trajectory mode {} (replan above {} deg){}",
+               mode == TrajectoryMode::PlanOnce ? "plan-once" : "online", replanThresholdDeg,
+               m_state.trajectory_active ? ", from the next move" : "");
+}
+
+void RobotInterface::setTrajectoryCacheEnabled(bool enabled)
+{
+    m_trajectoryCache.setEnabled(enabled);
+    RTLOG_INFO(Robot, "[RobotInterface] Trajectory cache {}", enabled ? "enabled" : "disabled");
+}
+
 // New function: Move to Cartesian pose using inverse kinematics
 // bool RobotInterface::moveToCartesianPose(const KDL::Frame& target_pose)
 // {
@@ -404,12 +918,94 @@ void RobotInterface::setHoldPosition() {
     } 
 }
 
+bool RobotInterface::startRecording()
+{
+    RecordingState state = m_recordingState.load(std::memory_order_acquire);
+    if (state == RecordingState::Recording) return true;
+    if (state == RecordingState::Reading
+        || !m_recordingState.compare_exchange_strong(state, RecordingState::Recording, std::memory_order_acquire)) {
+        RTLOG_WARN(Robot, "[RobotInterface] startRecording: the last recording is being saved, try again");
+        return false;
+    }
+    m_recordedCount = 0;
+    m_recordingElapsed = 0.0;
+    recordSamples();   // the current position is the first sample
+    RTLOG_INFO(Robot, "[RobotInterface] Recording at {} Hz, up to {} s", RECORDING_RATE_HZ,
+               RECORDING_CAPACITY / RECORDING_RATE_HZ);
+    return true;
+}
+
+void RobotInterface::stopRecording()
+{
+    RecordingState expected = RecordingState::Recording;
+    if (m_recordingState.compare_exchange_strong(expected, RecordingState::Stopped, std::memory_order_release)) {
+        RTLOG_INFO(Robot, "[RobotInterface] Recording stopped: {} samples, {} s", m_recordedCount,
+                   static_cast<double>(m_recordedCount) / RECORDING_RATE_HZ);
+    }
+}
+
+void RobotInterface::recordSamples()
+{
+    constexpr double period = 1.0 / RECORDING_RATE_HZ;
+    const double dt = m_state.state_dt_s;
+    if (m_recordedCount == 0) {
+        m_recordingElapsed = period;   // sample the current read right away
+    } else {
+        m_recordingElapsed += dt;
+    }
+    while (m_recordingElapsed >= period) {
+        if (m_recordedCount == m_recording.size()) {
+            stopRecording();
+            return;
+        }
+        // The sample time lies 'back' seconds before this read, between it and the previous one
+        double back = m_recordingElapsed - period;
+        double f = dt > 0.0 ? std::clamp(1.0 - back / dt, 0.0, 1.0) : 1.0;
+        RecordedSample& sample = m_recording[m_recordedCount++];
+        for (size_t i = 0; i < 7; ++i) {
+            double angle = m_state.prev_joint_angles_deg[i] + (m_state.joint_angles_deg[i] - m_state.prev_joint_angles_deg[i]) * f;
+            double speed = m_state.prev_joint_speeds_deg_s[i] + (m_state.joint_speeds_deg_s[i] - m_state.prev_joint_speeds_deg_s[i]) * f;
+            sample.position[i] = static_cast<float>(angle);
+            sample.velocity[i] = static_cast<float>(speed);
+        }
+        sample.roll_deg = static_cast<float>(m_state.differential_motors.roll_angle_deg);
+        sample.pitch_deg = static_cast<float>(m_state.differential_motors.pitch_angle_deg);
+        m_recordingElapsed -= period;
+    }
+}
+
+bool RobotInterface::beginReadRecording(const RecordedSample*& samples, size_t& count)
+{
+    RecordingState expected = RecordingState::Stopped;
+    if (!m_recordingState.compare_exchange_strong(expected, RecordingState::Reading, std::memory_order_acquire)) {
+        return false;
+    }
+    samples = m_recording.data();
+    count = m_recordedCount;
+    return true;
+}
+
+void RobotInterface::endReadRecording()
+{
+    m_recordingState.store(RecordingState::Stopped, std::memory_order_release);
+}
+
 void RobotInterface::resetRuckigState()
 {
     // Reset trajectory state
     m_state.trajectory_active = false;
     m_state.trajectory_duration = 0.0;
     m_state.trajectory_progress = 0.0;
+    m_state.trajectory_planned = false;
+    m_state.trajectory_time = 0.0;
+    m_state.segment_dwell_s = 0.0;
+    m_playback = nullptr;
+    m_playbackIndex = -1;
+    m_waypointCount = 0;
+    m_waypointEpoch++;
+    m_nextSegmentReady = false;
+    m_controller.reset();
+    m_trackingStats.abort();   // a move that had not finished yet
 
     // Reset Ruckig input parameters to current state
     for (size_t i = 0; i < 7; ++i) {
@@ -430,18 +1026,28 @@ void RobotInterface::resetRuckigState()
 
     // Reset Ruckig output parameters
     m_state.ruckig_output = ruckig::OutputParameter<7>();
-    std::cout << "[RobotInterface::resetRuckigState] Ruckig state reset." << std::endl;
+    RTLOG_INFO(Robot, "[RobotInterface::resetRuckigState] Ruckig state reset.");
 }
 
 void RobotInterface::setESTOP() { 
-    std::cout << "\n\n[RobotInterface::setESTOP] EMERGENCY STOP ACTIVATING - trajectory_active=" << (m_state.trajectory_active ? "true" : "false") << "\n\n";
+    RTLOG_WARN(Robot, "[RobotInterface::setESTOP] EMERGENCY STOP ACTIVATING - trajectory_active={}", m_state.trajectory_active);
     resetRuckigState(); 
     for (auto &m : m_motors) { 
         m.motorStop(); 
     } 
 }
 
-void RobotInterface::setTwinJointAngles(std::vector<float> angles)
+bool RobotInterface::sendStopBurst()
+{
+    return m_can.sendFrames(m_stopFrames.data(), m_stopFrames.size()) == m_stopFrames.size();
+}
+
+bool RobotInterface::sendHoldBurst()
+{
+    return m_can.sendFrames(m_holdFrames.data(), m_holdFrames.size()) == m_holdFrames.size();
+}
+
+void RobotInterface::setTwinJointAngles(const JointValues& angles)
 {
     for (size_t i = 0; i < 7; ++i) {
         m_state.twin_joint_angles_deg[i] = angles[i];
@@ -449,21 +1055,40 @@ void RobotInterface::setTwinJointAngles(std::vector<float> angles)
 
 }
 
-void RobotInterface::setTwinJointSpeeds(std::vector<float> speeds)
+void RobotInterface::setTwinJointSpeeds(const JointValues& speeds)
 {
     for (size_t i = 0; i < 7; ++i) {
         m_state.twin_joint_speeds_deg_s[i] = speeds[i];
     }
 }
 
-void RobotInterface::setTwinJointAccelerations(std::vector<float> accelerations)
+void RobotInterface::setTwinJointAccelerations(const JointValues& accelerations)
 {
     for (size_t i = 0; i < 7; ++i) {
         m_state.twin_joint_accelerations_deg_s2[i] = accelerations[i];
     }
 }
 
+void RobotInterface::setControlPeriod(double seconds)
+{
+    m_state.control_period_s = seconds;
+    m_state.ruckig_otg.delta_time = seconds;
+    RTLOG_INFO(Robot, "[RobotInterface] Control period set to {} ms", seconds * 1000.0);
+}
+
 void RobotInterface::updateJointStates() {
+    // Differentiate over the time that really passed, in whole periods: a skipped tick doubles
+    // the distance travelled, while wake-up jitter should not add noise to the speed estimate
+    auto now = std::chrono::steady_clock::now();
+    double dt = m_state.control_period_s;
+    if (m_lastStateRead != std::chrono::steady_clock::time_point{}) {
+        double elapsed = std::chrono::duration<double>(now - m_lastStateRead).count();
+        dt = std::max(1.0, std::round(elapsed / m_state.control_period_s)) * m_state.control_period_s;
+    }
+    m_lastStateRead = now;
+    m_state.state_dt_s = dt;
+    m_poseFresh = false;   // the pose belongs to the previous joint read until updateCartesianPose runs
+
     int i = 0;
     for(auto &m : m_motors) {
         // Get current speed before reading new state
@@ -486,9 +1111,9 @@ void RobotInterface::updateJointStates() {
             m_state.joint_max_accelerations_deg_s2[i] = m.getMaxAcceleration()*m.getMaxSpeedModifier();
             m_state.joint_max_jerks_deg_s3[i] = m.getMaxJerk()*m.getMaxSpeedModifier();
         }
-        // Calculate velocity and acceleration using previous and new speed with 200Hz control rate (0.005s timestep)
-        m_state.joint_speeds_deg_s[i] = (m_state.joint_angles_deg[i] - m_state.prev_joint_angles_deg[i]) / 0.005;
-        m_state.joint_accelerations_deg_s2[i] = (m_state.joint_speeds_deg_s[i] - m_state.prev_joint_speeds_deg_s[i]) / 0.005;
+        // Calculate velocity and acceleration using previous and new speed over the elapsed time
+        m_state.joint_speeds_deg_s[i] = (m_state.joint_angles_deg[i] - m_state.prev_joint_angles_deg[i]) / dt;
+        m_state.joint_accelerations_deg_s2[i] = (m_state.joint_speeds_deg_s[i] - m_state.prev_joint_speeds_deg_s[i]) / dt;
         updateTwinDifferentialAnglesRad();
         
         i++;
@@ -0,0 +1,268 @@
+#include "routine.hpp"
+#include "motor_defs.hpp"
+#include "rt_log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// Joints 1-5 [deg]; the wrist roll is continuous, the pitch is checked on its own
+constexpr double JOINT_LIMIT_LOW[5] = { JOINT_1_ANGLE_LIMIT_LOW, JOINT_2_ANGLE_LIMIT_LOW, JOINT_3_ANGLE_LIMIT_LOW,
+                                        JOINT_4_ANGLE_LIMIT_LOW, JOINT_5_ANGLE_LIMIT_LOW };
+constexpr double JOINT_LIMIT_HIGH[5] = { JOINT_1_ANGLE_LIMIT_HIGH, JOINT_2_ANGLE_LIMIT_HIGH, JOINT_3_ANGLE_LIMIT_HIGH,
+                                         JOINT_4_ANGLE_LIMIT_HIGH, JOINT_5_ANGLE_LIMIT_HIGH };
+
+constexpr double DEG_PER_RAD = 180.0 / M_PI;
+
+bool readNumbers(const Json::Value& value, double* out, size_t minCount, size_t maxCount, size_t& count)
+{
+    if (!value.isArray() || value.size() < minCount || value.size() > maxCount) return false;
+    count = value.size();
+    for (Json::ArrayIndex i = 0; i < value.size(); ++i) {
+        if (!value[i].isNumeric() || !std::isfinite(value[i].asDouble())) return false;
+        out[i] = value[i].asDouble();
+    }
+    return true;
+}
+
+std::string checkLimits(const std::array<double, 7>& position)
+{
+    for (size_t i = 0; i < 5; ++i) {
+        if (position[i] < JOINT_LIMIT_LOW[i] || position[i] > JOINT_LIMIT_HIGH[i]) {
+            return "joint " + std::to_string(i + 1) + " at " + std::to_string(position[i]) + " deg is outside "
+                   + std::to_string(JOINT_LIMIT_LOW[i]) + ".." + std::to_string(JOINT_LIMIT_HIGH[i]);
+        }
+    }
+    if (position[6] < DIFF_PITCH_ANGLE_LIMIT_LOW || position[6] > DIFF_PITCH_ANGLE_LIMIT_HIGH) {
+        return "wrist pitch at " + std::to_string(position[6]) + " deg is outside "
+               + std::to_string(DIFF_PITCH_ANGLE_LIMIT_LOW) + ".." + std::to_string(DIFF_PITCH_ANGLE_LIMIT_HIGH);
+    }
+    return {};
+}
+
+bool readFactor(const Json::Value& value, const char* key, double fallback, double low, double high,
+                double& out, std::string& error)
+{
+    out = fallback;
+    if (!value.isMember(key)) return true;
+    if (!value[key].isNumeric() || !(value[key].asDouble() >= low && value[key].asDouble() <= high)) {
+        error = std::string("\"") + key + "\" must be a number in " + std::to_string(low) + ".." + std::to_string(high);
+        return false;
+    }
+    out = value[key].asDouble();
+    return true;
+}
+}
+
+const char* routineStateName(RoutineState state)
+{
+    switch (state) {
+    case RoutineState::Idle:    return "idle";
+    case RoutineState::Running: return "running";
+    case RoutineState::Done:    return "done";
+    case RoutineState::Aborted: return "aborted";
+    }
+    return "unknown";
+}
+
+Json::Value RoutineStatus::toJson() const
+{
+    Json::Value j;
+    j["id"] = id;
+    j["name"] = std::string(name.data());
+    j["state"] = routineStateName(state);
+    if (state == RoutineState::Aborted) {
+        j["reason"] = reason;
+    }
+    j["step"] = step;
+    j["steps"] = steps;
+    j["elapsedS"] = elapsed_s;
+    j["trackingErrorDeg"] = tracking_error_deg;
+    j["maxTrackingErrorDeg"] = max_tracking_error_deg;
+    j["rmsTrackingErrorDeg"] = rms_tracking_error_deg;
+    j["replans"] = replans;
+    return j;
+}
+
+bool parseRoutine(const Json::Value& request, KinematicsInterface* kinematics,
+                  const std::array<double, 7>& seed, Routine& out, std::string& error)
+{
+    const Json::Value& waypoints = request["waypoints"];
+    if (!waypoints.isArray() || waypoints.empty() || waypoints.size() > Routine::MAX_STEPS) {
+        error = "\"waypoints\" must be an array of 1.." + std::to_string(Routine::MAX_STEPS) + " waypoints";
+        return false;
+    }
+    double defaultSpeed;
+    double defaultDwell;
+    if (!readFactor(request, "speed", 1.0, JointWaypoint::MIN_SPEED, 1.0, defaultSpeed, error)
+        || !readFactor(request, "dwell", 0.0, 0.0, Routine::MAX_DWELL_S, defaultDwell, error)) {
+        return false;
+    }
+
+    std::string name = request.get("name", "").asString();
+    out.name.fill('\0');
+    std::memcpy(out.name.data(), name.data(), std::min(name.size(), out.name.size() - 1));
+    out.count = 0;
+
+    std::array<double, 7> previousRad = seed;   // IK seed: the waypoint before
+    for (Json::ArrayIndex w = 0; w < waypoints.size(); ++w) {
+        const Json::Value& wp = waypoints[w];
+        std::string where = "waypoint " + std::to_string(w) + ": ";
+        if (!wp.isObject()) {
+            error = where + "not an object";
+            return false;
+        }
+
+        JointWaypoint& step = out.steps[w];
+        step = JointWaypoint{};
+        size_t count = 0;
+        if (wp.isMember("angles")) {
+            if (!readNumbers(wp["angles"], step.position.data(), 7, 7, count)) {
+                error = where + "\"angles\" must be 7 numbers [deg]";
+                return false;
+            }
+        } else if (wp.isMember("pose")) {
+            if (kinematics == nullptr) {
+                error = where + "Cartesian waypoints need the URDF, which is not loaded";
+                return false;
+            }
+            double position[3];
+            double rpy[3];
+            if (!readNumbers(wp["pose"]["position"], position, 3, 3, count)
+                || !readNumbers(wp["pose"]["rpy"], rpy, 3, 3, count)) {
+                error = where + "\"pose\" needs \"position\" [m] and \"rpy\" [rad], 3 numbers each";
+                return false;
+            }
+            KDL::Frame target(KDL::Rotation::RPY(rpy[0], rpy[1], rpy[2]), KDL::Vector(position[0], position[1], position[2]));
+            std::array<double, 7> solution;
+            if (!kinematics->getInverseKinematics(target, previousRad, solution)) {
+                error = where + "no inverse kinematics solution";
+                return false;
+            }
+            // The chain's last two joints are the wrist roll and pitch
+            for (size_t i = 0; i < 7; ++i) {
+                step.position[i] = solution[i] * DEG_PER_RAD;
+            }
+        } else {
+            error = where + "needs \"angles\" or \"pose\"";
+            return false;
+        }
+
+        std::string limit = checkLimits(step.position);
+        if (!limit.empty()) {
+            error = where + limit;
+            return false;
+        }
+        if (wp.isMember("velocities") && !readNumbers(wp["velocities"], step.velocity.data(), 1, step.velocity.size(),
+                                                      step.velocityCount)) {
+            error = where + "\"velocities\" must be 1..5 numbers [deg/s]";
+            return false;
+        }
+        if (!readFactor(wp, "speed", defaultSpeed, JointWaypoint::MIN_SPEED, 1.0, step.speed, error)
+            || !readFactor(wp, "dwell", defaultDwell, 0.0, Routine::MAX_DWELL_S, step.dwell_s, error)) {
+            error = where + error;
+            return false;
+        }
+
+        for (size_t i = 0; i < 7; ++i) {
+            previousRad[i] = step.position[i] / DEG_PER_RAD;
+        }
+        out.count++;
+    }
+    return true;
+}
+
+void RoutineRunner::start(const Routine& routine, RobotInterface& robot)
+{
+    if (running()) {
+        abort(robot, "replaced by a new routine");
+    }
+
+    m_routine = &routine;
+    m_next = 0;
+    m_status = RoutineStatus{};
+    m_status.id = routine.id;
+    m_status.name = routine.name;
+    m_status.steps = static_cast<uint32_t>(routine.count);
+    m_sumSquaredError = 0.0;
+    m_errorSamples = 0;
+    m_changed = true;
+
+    m_status.state = RoutineState::Running;
+    m_waiting = true;
+    RTLOG_INFO(Daemon, "[RoutineRunner] Routine {} '{}' accepted, {} waypoints", routine.id, m_status.name.data(),
+               routine.count);
+}
+
+void RoutineRunner::abort(RobotInterface& robot, const char* reason)
+{
+    if (!running()) return;
+    if (!m_waiting) {
+        robot.clearWaypoints();
+    }
+    finish(RoutineState::Aborted, reason);
+}
+
+bool RoutineRunner::cycle(RobotInterface& robot)
+{
+    // The step count comes from the waypoint queue, so the routine waits for it to drain and the
+    // arm to stop (a replaced routine's last segment, a jog) before it queues anything
+    if (running() && m_waiting && !robot.getState().trajectory_active && robot.queuedWaypoints() == 0) {
+        m_waiting = false;
+        m_startedBase = robot.waypointsStarted();
+        m_epoch = robot.waypointEpoch();
+        m_replanBase = robot.getState().replan_count;
+        RTLOG_INFO(Daemon, "[RoutineRunner] Routine {} started", m_status.id);
+    }
+
+    if (running() && !m_waiting) {
+        while (m_next < m_routine->count && robot.queuedWaypoints() < FEED_AHEAD
+               && robot.queueWaypoint(m_routine->steps[m_next])) {
+            m_next++;
+        }
+
+        const RobotState& state = robot.getState();
+        uint32_t step = static_cast<uint32_t>(robot.waypointsStarted() - m_startedBase) - (state.trajectory_active ? 1 : 0);
+        if (step != m_status.step) {
+            m_status.step = step;
+            m_changed = true;
+        }
+        m_status.elapsed_s += state.state_dt_s;
+        m_status.replans = state.replan_count - m_replanBase;
+        if (state.trajectory_active) {
+            m_status.tracking_error_deg = state.tracking_error_deg;
+            m_status.max_tracking_error_deg = std::max(m_status.max_tracking_error_deg, state.tracking_error_deg);
+            m_sumSquaredError += state.tracking_error_deg * state.tracking_error_deg;
+            m_errorSamples++;
+            m_status.rms_tracking_error_deg = std::sqrt(m_sumSquaredError / m_errorSamples);
+        }
+
+        if (robot.waypointEpoch() != m_epoch) {
+            finish(RoutineState::Aborted, "waypoints dropped (hold, ESTOP, another move or a failed plan)");
+        } else if (!state.trajectory_active && robot.queuedWaypoints() == 0 && m_next == m_routine->count) {
+            m_status.tracking_error_deg = 0.0;
+            finish(RoutineState::Done, "");
+        }
+    }
+
+    bool changed = m_changed;
+    m_changed = false;
+    return changed;
+}
+
+void RoutineRunner::finish(RoutineState state, const char* reason)
+{
+    m_status.state = state;
+    m_status.reason = reason;
+    m_routine = nullptr;
+    m_changed = true;
+    if (state == RoutineState::Done) {
+        RTLOG_INFO(Daemon, "[RoutineRunner] Routine {} done in {} s, max tracking error {} deg",
+                   m_status.id, m_status.elapsed_s, m_status.max_tracking_error_deg);
+    } else {
+        RTLOG_WARN(Daemon, "[RoutineRunner] Routine {} aborted at waypoint {}/{}: {}",
+                   m_status.id, m_status.step, m_status.steps, reason);
+    }
+}
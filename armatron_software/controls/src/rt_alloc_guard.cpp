@@ -0,0 +1,118 @@
+#include "rt_alloc_guard.hpp"
+
+#ifdef RT_ALLOC_GUARD
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+// glibc's real allocator entry points; the definitions below interpose the public names
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void  __libc_free(void* ptr);
+}
+
+namespace
+{
+std::atomic<uint64_t> g_allocations { 0 };
+bool g_trap = false;
+
+// initial-exec TLS never allocates itself, so it is safe to touch from inside malloc
+__thread bool t_armed __attribute__((tls_model("initial-exec"))) = false;
+
+inline void onAllocation()
+{
+    if (!t_armed) return;
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (g_trap) {
+        static const char msg[] = "[RtAllocGuard] Heap allocation on the real-time thread, aborting\n";
+        ssize_t ignored = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        (void)ignored;
+        abort();
+    }
+}
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+    onAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    onAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    onAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    onAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    onAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size)
+{
+    onAllocation();
+    void* p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+}
+
+namespace rtalloc {
+
+bool enabled() { return true; }
+
+void armThisThread()
+{
+    const char* trap = getenv("ARMATRON_RT_ALLOC_TRAP");
+    g_trap = trap && std::strcmp(trap, "1") == 0;
+    t_armed = true;
+}
+
+void disarmThisThread() { t_armed = false; }
+
+uint64_t allocationCount() { return g_allocations.load(std::memory_order_relaxed); }
+
+} // namespace rtalloc
+
+#else
+
+namespace rtalloc {
+
+bool enabled() { return false; }
+void armThisThread() {}
+void disarmThisThread() {}
+uint64_t allocationCount() { return 0; }
+
+} // namespace rtalloc
+
+#endif // RT_ALLOC_GUARD
@@ -0,0 +1,325 @@
+#include "rt_config.hpp"
+
+#include <algorithm>
+#include <alloca.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+namespace rt {
+
+namespace
+{
+// Stack kept back from prefaulting: what is already in use below the thread entry, plus slack
+constexpr size_t STACK_PREFAULT_MARGIN = 64 * 1024;
+constexpr size_t PAGE_BYTES = 4096;
+
+// Linux struct sched_attr (glibc only gained a sched_setattr wrapper recently)
+struct SchedAttr
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t  sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+std::chrono::nanoseconds deadlineRuntime(std::chrono::nanoseconds period, double runtimeFraction)
+{
+    double fraction = std::clamp(runtimeFraction, 0.05, 0.95);
+    return std::chrono::nanoseconds(static_cast<int64_t>(period.count() * fraction));
+}
+
+// Touch every page of 'bytes' of stack below the current frame so the control loop never
+// takes a page fault on a deeper call; with mlockall(MCL_FUTURE) the pages stay resident
+__attribute__((noinline)) size_t prefaultStack(size_t bytes)
+{
+    volatile unsigned char* stack = static_cast<volatile unsigned char*>(alloca(bytes));
+    for (size_t i = 0; i < bytes; i += PAGE_BYTES) {
+        stack[i] = 0;
+    }
+    return bytes;
+}
+
+void addNote(ThreadReport& report, const std::string& note)
+{
+    if (!report.notes.empty()) report.notes += "; ";
+    report.notes += note;
+}
+}
+
+bool parseSchedPolicy(const std::string& name, SchedPolicy& policy)
+{
+    if (name == "other") {
+        policy = SchedPolicy::Other;
+    } else if (name == "fifo") {
+        policy = SchedPolicy::Fifo;
+    } else if (name == "deadline") {
+        policy = SchedPolicy::Deadline;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* schedPolicyName(SchedPolicy policy)
+{
+    switch (policy) {
+    case SchedPolicy::Other:    return "other";
+    case SchedPolicy::Fifo:     return "fifo";
+    case SchedPolicy::Deadline: return "deadline";
+    }
+    return "unknown";
+}
+
+std::string ThreadReport::summary() const
+{
+    std::string s;
+    switch (granted) {
+    case SchedPolicy::Deadline:
+        s = "SCHED_DEADLINE runtime " + std::to_string(deadlineRuntime.count() / 1000) + " us / period "
+            + std::to_string(deadlinePeriod.count() / 1000) + " us";
+        break;
+    case SchedPolicy::Fifo:
+        s = "SCHED_FIFO priority " + std::to_string(priority);
+        break;
+    case SchedPolicy::Other:
+        s = "SCHED_OTHER (soft real-time)";
+        break;
+    }
+    if (granted != requested) s += std::string(" [requested ") + schedPolicyName(requested) + "]";
+    s += cpu >= 0 ? ", CPU " + std::to_string(cpu) : std::string(", not pinned");
+    s += memoryLocked ? ", memory locked" : ", memory NOT locked";
+    if (stackSize > 0) {
+        s += ", stack " + std::to_string(stackSize / 1024) + " KiB (" + std::to_string(prefaultedBytes / 1024) + " KiB prefaulted)";
+    } else {
+        s += ", default stack";
+    }
+    if (!notes.empty()) s += " - " + notes;
+    return s;
+}
+
+Json::Value ThreadReport::toJson() const
+{
+    Json::Value j;
+    j["requested"] = schedPolicyName(requested);
+    j["granted"] = schedPolicyName(granted);
+    if (granted == SchedPolicy::Fifo) {
+        j["priority"] = priority;
+    }
+    if (granted == SchedPolicy::Deadline) {
+        j["runtimeUs"] = static_cast<Json::Int64>(deadlineRuntime.count() / 1000);
+        j["periodUs"] = static_cast<Json::Int64>(deadlinePeriod.count() / 1000);
+    }
+    j["cpu"] = cpu;
+    j["memoryLocked"] = memoryLocked;
+    j["stackBytes"] = static_cast<Json::UInt64>(stackSize);
+    j["prefaultedBytes"] = static_cast<Json::UInt64>(prefaultedBytes);
+    if (!notes.empty()) {
+        j["notes"] = notes;
+    }
+    return j;
+}
+
+/**********************************************************/
+/* RtThread                                               */
+/**********************************************************/
+RtThread::~RtThread()
+{
+    join();
+}
+
+bool RtThread::start(const ThreadConfig& config, std::chrono::nanoseconds period, std::function<void()> body)
+{
+    if (m_started) return false;
+    m_config = config;
+    m_period = period;
+    m_body = std::move(body);
+    m_report = ThreadReport();
+    m_report.requested = config.policy;
+    m_ready = false;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    size_t stackSize = std::max<size_t>(config.stackSize, PTHREAD_STACK_MIN);
+    if (pthread_attr_setstacksize(&attr, stackSize) == 0) {
+        m_report.stackSize = stackSize;
+    } else {
+        addNote(m_report, "stack size " + std::to_string(stackSize) + " rejected, using the default stack");
+    }
+    int err = pthread_create(&m_thread, &attr, &RtThread::entry, this);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        addNote(m_report, std::string("pthread_create: ") + strerror(err));
+        return false;
+    }
+    m_started = true;
+
+    pthread_mutex_lock(&m_readyMutex);
+    while (!m_ready) {
+        pthread_cond_wait(&m_readyCond, &m_readyMutex);
+    }
+    pthread_mutex_unlock(&m_readyMutex);
+    return true;
+}
+
+void RtThread::join()
+{
+    if (!m_started) return;
+    pthread_join(m_thread, nullptr);
+    m_started = false;
+}
+
+void* RtThread::entry(void* self)
+{
+    RtThread& t = *static_cast<RtThread*>(self);
+    const ThreadConfig& cfg = t.m_config;
+    ThreadReport& report = t.m_report;
+
+    // 1) Lock memory first, so the pages prefaulted below stay resident
+    if (cfg.lockMemory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            report.memoryLocked = true;
+        } else if (errno == ENOMEM) {
+            addNote(report, "mlockall: RLIMIT_MEMLOCK too low (set LimitMEMLOCK=infinity)");
+        } else {
+            addNote(report, std::string("mlockall: ") + strerror(errno));
+        }
+    }
+
+    // 2) Scheduling, falling back Deadline -> Fifo -> Other
+    SchedPolicy want = cfg.policy;
+    if (want == SchedPolicy::Deadline) {
+        if (setDeadline(t.m_period, cfg.deadlineRuntimeFraction)) {
+            report.granted = SchedPolicy::Deadline;
+            report.deadlineRuntime = deadlineRuntime(t.m_period, cfg.deadlineRuntimeFraction);
+            report.deadlinePeriod = t.m_period;
+        } else {
+            addNote(report, std::string("SCHED_DEADLINE: ") + strerror(errno));
+            want = SchedPolicy::Fifo;
+        }
+    }
+    if (want == SchedPolicy::Fifo) {
+        sched_param param {};
+        param.sched_priority = cfg.priority;
+        if (sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+            report.granted = SchedPolicy::Fifo;
+            report.priority = cfg.priority;
+        } else if (errno == EPERM) {
+            addNote(report, "SCHED_FIFO: no permission (check LimitRTPRIO / CAP_SYS_NICE for the service)");
+        } else {
+            addNote(report, std::string("SCHED_FIFO: ") + strerror(errno));
+        }
+    }
+    if (report.granted == SchedPolicy::Other) {
+        // Best we can do without real-time rights: the highest nice level allowed
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), -20) != 0) {
+            addNote(report, std::string("nice -20: ") + strerror(errno));
+        }
+    }
+
+    // 3) Pin to the CPU. A SCHED_DEADLINE task may not have a restricted affinity mask
+    if (cfg.cpu >= 0) {
+        if (report.granted == SchedPolicy::Deadline) {
+            addNote(report, "CPU pinning skipped under SCHED_DEADLINE (isolate with cpusets instead)");
+        } else {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cfg.cpu, &cpuset);
+            if (sched_setaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+                report.cpu = cfg.cpu;
+            } else {
+                addNote(report, "pin to CPU " + std::to_string(cfg.cpu) + ": " + strerror(errno));
+            }
+        }
+    }
+
+    // 4) Prefault the stack
+    if (report.stackSize > 2 * STACK_PREFAULT_MARGIN) {
+        report.prefaultedBytes = prefaultStack(report.stackSize - STACK_PREFAULT_MARGIN);
+    }
+
+    pthread_mutex_lock(&t.m_readyMutex);
+    t.m_ready = true;
+    pthread_cond_signal(&t.m_readyCond);
+    pthread_mutex_unlock(&t.m_readyMutex);
+
+    t.m_body();
+    return nullptr;
+}
+
+bool setDeadline(std::chrono::nanoseconds period, double runtimeFraction)
+{
+#ifdef SYS_sched_setattr
+    SchedAttr attr {};
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = static_cast<uint64_t>(deadlineRuntime(period, runtimeFraction).count());
+    attr.sched_deadline = static_cast<uint64_t>(period.count());
+    attr.sched_period = static_cast<uint64_t>(period.count());
+    return syscall(SYS_sched_setattr, 0, &attr, 0) == 0;
+#else
+    (void)period;
+    (void)runtimeFraction;
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+void sleepUntil(std::chrono::steady_clock::time_point t)
+{
+    // steady_clock is CLOCK_MONOTONIC on Linux
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000LL);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+/**********************************************************/
+/* PiMutex                                                */
+/**********************************************************/
+PiMutex::PiMutex()
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&m_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+PiMutex::~PiMutex()
+{
+    pthread_mutex_destroy(&m_mutex);
+}
+
+void PiMutex::lock()
+{
+    pthread_mutex_lock(&m_mutex);
+}
+
+bool PiMutex::try_lock()
+{
+    return pthread_mutex_trylock(&m_mutex) == 0;
+}
+
+void PiMutex::unlock()
+{
+    pthread_mutex_unlock(&m_mutex);
+}
+
+} // namespace rt
@@ -0,0 +1,251 @@
+#include "rt_log.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace rtlog {
+
+namespace
+{
+constexpr size_t RING_CAPACITY = 2048;   // power of two
+static_assert((RING_CAPACITY & (RING_CAPACITY - 1)) == 0, "RING_CAPACITY must be a power of two");
+
+constexpr auto WRITER_IDLE_SLEEP = std::chrono::milliseconds(5);
+
+const char* const LEVEL_NAMES[] = { "debug", "info", "warn", "error", "off" };
+const char* const MODULE_NAMES[NUM_MODULES] = {
+    "general", "can", "motor", "robot", "kinematics", "daemon", "emergency"
+};
+
+/**
+ * @brief Bounded multi-producer / single-consumer queue (per-slot sequence numbers).
+ *
+ * Producers claim a slot with one CAS on the enqueue counter, fill the record in place and
+ * publish it by bumping the slot's sequence. The consumer is the writer thread (or, before
+ * start(), whichever thread holds g_drainMutex).
+ */
+struct Slot
+{
+    std::atomic<size_t> sequence;
+    Record record;
+};
+
+std::array<Slot, RING_CAPACITY> g_slots;
+alignas(64) std::atomic<size_t> g_enqueuePos { 0 };
+alignas(64) size_t g_dequeuePos = 0;
+
+std::atomic<uint64_t> g_dropped { 0 };
+uint64_t g_droppedReported = 0;
+
+std::array<std::atomic<uint8_t>, NUM_MODULES> g_levels;
+
+std::atomic<bool> g_running { false };
+std::thread g_writer;
+std::mutex g_drainMutex;
+std::mutex g_lifecycleMutex;
+
+struct RingInit
+{
+    RingInit()
+    {
+        for (size_t i = 0; i < RING_CAPACITY; ++i) {
+            g_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        for (auto& l : g_levels) {
+            l.store(static_cast<uint8_t>(Level::Debug), std::memory_order_relaxed);
+        }
+    }
+} g_ringInit;
+
+void formatArg(const Record& r, const Record::Arg& a, char* out, size_t size)
+{
+    switch (a.type) {
+    case Record::ArgType::Int:    snprintf(out, size, "%" PRId64, a.i); break;
+    case Record::ArgType::UInt:   snprintf(out, size, "%" PRIu64, a.u); break;
+    case Record::ArgType::Double: snprintf(out, size, "%g", a.d); break;
+    case Record::ArgType::Bool:   snprintf(out, size, "%s", a.u ? "true" : "false"); break;
+    case Record::ArgType::Char:   snprintf(out, size, "%c", static_cast<char>(a.u)); break;
+    case Record::ArgType::Hex:    snprintf(out, size, "0x%" PRIX64, a.u); break;
+    case Record::ArgType::Text:   snprintf(out, size, "%s", r.text + a.u); break;
+    }
+}
+
+void writeRecord(const Record& r)
+{
+    char line[512];
+    size_t len = 0;
+    size_t argIndex = 0;
+    const char* f = r.format;
+
+    while (*f && len < sizeof(line) - 2) {
+        if (f[0] == '{' && f[1] == '}' && argIndex < r.numArgs) {
+            char arg[128];
+            formatArg(r, r.args[argIndex++], arg, sizeof(arg));
+            for (const char* a = arg; *a && len < sizeof(line) - 2; ++a) line[len++] = *a;
+            f += 2;
+        } else {
+            line[len++] = *f++;
+        }
+    }
+    if (len == 0 || line[len - 1] != '\n') line[len++] = '\n';
+    line[len] = '\0';
+
+    std::fputs(line, r.level >= Level::Warn ? stderr : stdout);
+}
+
+/**
+ * @brief Format and write everything queued so far. Caller holds g_drainMutex.
+ */
+size_t drainLocked()
+{
+    size_t written = 0;
+    while (true) {
+        Slot& slot = g_slots[g_dequeuePos & (RING_CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != g_dequeuePos + 1) break;
+        writeRecord(slot.record);
+        slot.sequence.store(g_dequeuePos + RING_CAPACITY, std::memory_order_release);
+        ++g_dequeuePos;
+        ++written;
+    }
+
+    uint64_t dropped = g_dropped.load(std::memory_order_relaxed);
+    if (dropped != g_droppedReported) {
+        std::fprintf(stderr, "[RtLog] %" PRIu64 " log records dropped (ring full)\n", dropped - g_droppedReported);
+        g_droppedReported = dropped;
+    }
+    if (written > 0) std::fflush(stdout);
+    return written;
+}
+
+void writerLoop()
+{
+    while (g_running.load(std::memory_order_acquire)) {
+        size_t written;
+        {
+            std::lock_guard<std::mutex> lock(g_drainMutex);
+            written = drainLocked();
+        }
+        if (written == 0) std::this_thread::sleep_for(WRITER_IDLE_SLEEP);
+    }
+}
+}
+
+const char* levelName(Level level)
+{
+    return LEVEL_NAMES[static_cast<size_t>(level)];
+}
+
+const char* moduleName(Module module)
+{
+    return module < Module::Count ? MODULE_NAMES[static_cast<size_t>(module)] : "unknown";
+}
+
+bool parseLevel(const std::string& name, Level& level)
+{
+    for (size_t i = 0; i <= static_cast<size_t>(Level::Off); ++i) {
+        if (name == LEVEL_NAMES[i]) {
+            level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseModule(const std::string& name, Module& module)
+{
+    for (size_t i = 0; i < NUM_MODULES; ++i) {
+        if (name == MODULE_NAMES[i]) {
+            module = static_cast<Module>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool enabled(Level level, Module module)
+{
+    return static_cast<uint8_t>(level) >= g_levels[static_cast<size_t>(module)].load(std::memory_order_relaxed);
+}
+
+void setLevel(Module module, Level level)
+{
+    g_levels[static_cast<size_t>(module)].store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+void setLevel(Level level)
+{
+    for (auto& l : g_levels) l.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+Level level(Module module)
+{
+    return static_cast<Level>(g_levels[static_cast<size_t>(module)].load(std::memory_order_relaxed));
+}
+
+Record* beginRecord()
+{
+    size_t pos = g_enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = g_slots[pos & (RING_CAPACITY - 1)];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (g_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return &slot.record;
+            }
+        } else if (diff < 0) {
+            g_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            pos = g_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void commitRecord(Record* record)
+{
+    size_t index = static_cast<size_t>(reinterpret_cast<const char*>(record) -
+                                       reinterpret_cast<const char*>(&g_slots[0].record)) / sizeof(Slot);
+    Slot& slot = g_slots[index];
+    // A claimed slot's sequence still equals the position it was claimed at
+    size_t pos = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(pos + 1, std::memory_order_release);
+
+    if (!g_running.load(std::memory_order_acquire)) {
+        // No writer thread yet (startup, tools): write synchronously
+        std::lock_guard<std::mutex> lock(g_drainMutex);
+        drainLocked();
+    }
+}
+
+void start()
+{
+    std::lock_guard<std::mutex> lock(g_lifecycleMutex);
+    if (g_running.load()) return;
+    g_running.store(true, std::memory_order_release);
+    g_writer = std::thread(writerLoop);
+}
+
+void stop()
+{
+    std::lock_guard<std::mutex> lock(g_lifecycleMutex);
+    if (!g_running.load()) return;
+    g_running.store(false, std::memory_order_release);
+    if (g_writer.joinable()) g_writer.join();
+
+    std::lock_guard<std::mutex> drain(g_drainMutex);
+    drainLocked();
+    std::fflush(stderr);
+}
+
+uint64_t droppedCount()
+{
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace rtlog
@@ -0,0 +1,481 @@
+#include "telemetry.hpp"
+#include <jsoncpp/json/json.h>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+struct GroupName
+{
+    telemetry::FieldGroup group;
+    const char* name;
+};
+
+constexpr GroupName GROUP_NAMES[] = {
+    { telemetry::Positions, "positions" },
+    { telemetry::Speeds,    "speeds"    },
+    { telemetry::Currents,  "currents"  },
+    { telemetry::Health,    "health"    },
+    { telemetry::Gains,     "gains"     },
+    { telemetry::Twin,      "twin"      },
+    { telemetry::Cartesian, "cartesian" },
+};
+
+std::string writeCompact(const Json::Value& root)
+{
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = ""; // Force compact, single-line output.
+    return Json::writeString(builder, root);
+}
+
+/**
+ * @brief Walk the delta-mode channels of 'groups' in wire order. 'f' gets
+ *        (group index, exact compare, field name, joint/element index, value).
+ *        Pass snap = nullptr to walk the layout only (values are 0).
+ */
+template <typename F>
+void forEachChannel(const TelemetrySnapshot* snap, uint32_t groups, F&& f)
+{
+    static const TelemetrySnapshot empty{};
+    const TelemetrySnapshot& s = snap ? *snap : empty;
+    const size_t n = ipc::NUM_MOTORS;
+
+    if (groups & telemetry::Positions) {
+        for (size_t i = 0; i < n; ++i) f(0, false, "positionDeg", i, s.motors[i].multiTurnDeg_Mapped);
+        f(0, false, "diff_roll_rad", 0, s.diffRollRad);
+        f(0, false, "diff_pitch_rad", 0, s.diffPitchRad);
+    }
+    if (groups & telemetry::Speeds) {
+        for (size_t i = 0; i < n; ++i) f(1, false, "speedDeg_s", i, s.motors[i].speedDeg_s);
+    }
+    if (groups & telemetry::Currents) {
+        for (size_t i = 0; i < n; ++i) f(2, false, "torqueA", i, s.motors[i].torqueCurrentA);
+    }
+    if (groups & telemetry::Health) {
+        for (size_t i = 0; i < n; ++i) {
+            f(3, false, "temp", i, s.motors[i].temperatureC);
+            f(3, true,  "errorCode", i, s.motors[i].errorCode);
+            f(3, false, "busVoltage", i, s.motors[i].busVoltage);
+        }
+    }
+    if (groups & telemetry::Gains) {
+        for (size_t i = 0; i < n; ++i) {
+            const MotorGains& g = s.motors[i].m_gains;
+            f(4, true, "angKp", i, g.angKp);
+            f(4, true, "angKi", i, g.angKi);
+            f(4, true, "spdKp", i, g.spdKp);
+            f(4, true, "spdKi", i, g.spdKi);
+            f(4, true, "iqKp", i, g.iqKp);
+            f(4, true, "iqKi", i, g.iqKi);
+        }
+    }
+    if (groups & telemetry::Twin) {
+        f(5, true, "twin_active", 0, s.twinActive ? 1.0 : 0.0);
+        for (size_t i = 0; i < n; ++i) f(5, false, "twin_joint_angles_deg", i, s.twinJointAnglesDeg[i]);
+    }
+    if (groups & telemetry::Cartesian) {
+        f(6, true, "pose_valid", 0, s.poseValid ? 1.0 : 0.0);
+        f(6, false, "pose_x", 0, s.posePosition[0]);
+        f(6, false, "pose_y", 0, s.posePosition[1]);
+        f(6, false, "pose_z", 0, s.posePosition[2]);
+        f(6, false, "pose_roll", 0, s.poseRPY[0]);
+        f(6, false, "pose_pitch", 0, s.poseRPY[1]);
+        f(6, false, "pose_yaw", 0, s.poseRPY[2]);
+    }
+}
+
+// Per-motor channels are named field[joint], joint counted from 1 like the motor IDs
+bool isPerMotorField(const char* field)
+{
+    return std::strncmp(field, "diff_", 5) != 0 && std::strncmp(field, "pose_", 5) != 0
+        && std::strcmp(field, "twin_active") != 0;
+}
+
+Json::Value twinAnglesJson(const TelemetrySnapshot& snap)
+{
+    Json::Value twinAngles(Json::arrayValue);
+    for (double v : snap.twinJointAnglesDeg) {
+        twinAngles.append(v);
+    }
+    return twinAngles;
+}
+}
+
+namespace telemetry {
+
+bool parseFieldGroup(const std::string& name, uint32_t& bits)
+{
+    if (name == "all") {
+        bits = AllGroups;
+        return true;
+    }
+    for (const auto& g : GROUP_NAMES) {
+        if (name == g.name) {
+            bits = g.group;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* fieldGroupName(FieldGroup group)
+{
+    for (const auto& g : GROUP_NAMES) {
+        if (g.group == group) return g.name;
+    }
+    return "unknown";
+}
+
+std::string encodeJson(const TelemetrySnapshot& snap, uint32_t groups)
+{
+    Json::Value jroot;
+    jroot["type"] = "telemetry";
+    jroot["cycle"] = snap.cycle;
+
+    if (groups & Positions) {
+        Json::Value pos(Json::arrayValue);
+        for (const MotorState& st : snap.motors) pos.append(st.multiTurnDeg_Mapped);
+        jroot["positionDeg"] = pos;
+        jroot["diff_roll_rad"] = snap.diffRollRad;
+        jroot["diff_pitch_rad"] = snap.diffPitchRad;
+    }
+    if (groups & Speeds) {
+        Json::Value spd(Json::arrayValue);
+        for (const MotorState& st : snap.motors) spd.append(st.speedDeg_s);
+        jroot["speedDeg_s"] = spd;
+    }
+    if (groups & Currents) {
+        Json::Value cur(Json::arrayValue);
+        for (const MotorState& st : snap.motors) cur.append(st.torqueCurrentA);
+        jroot["torqueA"] = cur;
+    }
+    if (groups & Health) {
+        Json::Value temp(Json::arrayValue), volts(Json::arrayValue), err(Json::arrayValue);
+        for (const MotorState& st : snap.motors) {
+            temp.append(st.temperatureC);
+            volts.append(st.busVoltage);
+            err.append(static_cast<int>(st.errorCode));
+        }
+        jroot["temp"] = temp;
+        jroot["busVoltage"] = volts;
+        jroot["errorCode"] = err;
+    }
+    if (groups & Gains) {
+        Json::Value gains(Json::arrayValue);
+        for (const MotorState& st : snap.motors) {
+            Json::Value g;
+            g["angKp"] = static_cast<int>(st.m_gains.angKp);
+            g["angKi"] = static_cast<int>(st.m_gains.angKi);
+            g["spdKp"] = static_cast<int>(st.m_gains.spdKp);
+            g["spdKi"] = static_cast<int>(st.m_gains.spdKi);
+            g["iqKp"]  = static_cast<int>(st.m_gains.iqKp);
+            g["iqKi"]  = static_cast<int>(st.m_gains.iqKi);
+            gains.append(g);
+        }
+        jroot["gains"] = gains;
+    }
+    if (groups & Twin) {
+        jroot["twin"]["active"] = snap.twinActive;
+        if (snap.twinActive) {
+            jroot["twin"]["joint_angles_deg"] = twinAnglesJson(snap);
+        }
+    }
+    if (groups & Cartesian) {
+        Json::Value pose;
+        pose["valid"] = snap.poseValid;
+        if (snap.poseValid) {
+            pose["x"] = snap.posePosition[0];
+            pose["y"] = snap.posePosition[1];
+            pose["z"] = snap.posePosition[2];
+            pose["roll"] = snap.poseRPY[0];
+            pose["pitch"] = snap.poseRPY[1];
+            pose["yaw"] = snap.poseRPY[2];
+        }
+        jroot["pose"] = pose;
+    }
+
+    return writeCompact(jroot) + "\n";
+}
+
+std::string encodeBinary(const TelemetrySnapshot& snap, uint32_t groups)
+{
+    std::string payload;
+    payload.reserve(256);
+    ipc::appendU32(payload, snap.cycle);
+    ipc::appendU32(payload, groups);
+
+    if (groups & Positions) {
+        for (const MotorState& st : snap.motors) ipc::appendFloat(payload, static_cast<float>(st.multiTurnDeg_Mapped));
+        ipc::appendFloat(payload, static_cast<float>(snap.diffRollRad));
+        ipc::appendFloat(payload, static_cast<float>(snap.diffPitchRad));
+    }
+    if (groups & Speeds) {
+        for (const MotorState& st : snap.motors) ipc::appendFloat(payload, static_cast<float>(st.speedDeg_s));
+    }
+    if (groups & Currents) {
+        for (const MotorState& st : snap.motors) ipc::appendFloat(payload, static_cast<float>(st.torqueCurrentA));
+    }
+    if (groups & Health) {
+        for (const MotorState& st : snap.motors) {
+            ipc::appendU8(payload, static_cast<uint8_t>(static_cast<int8_t>(st.temperatureC)));
+            ipc::appendU8(payload, st.errorCode);
+            ipc::appendU16(payload, 0);
+            ipc::appendFloat(payload, static_cast<float>(st.busVoltage));
+        }
+    }
+    if (groups & Gains) {
+        for (const MotorState& st : snap.motors) {
+            ipc::appendU8(payload, st.m_gains.angKp);
+            ipc::appendU8(payload, st.m_gains.angKi);
+            ipc::appendU8(payload, st.m_gains.spdKp);
+            ipc::appendU8(payload, st.m_gains.spdKi);
+            ipc::appendU8(payload, st.m_gains.iqKp);
+            ipc::appendU8(payload, st.m_gains.iqKi);
+        }
+    }
+    if (groups & Twin) {
+        ipc::appendU32(payload, snap.twinActive ? 1u : 0u);
+        for (double v : snap.twinJointAnglesDeg) ipc::appendFloat(payload, static_cast<float>(v));
+    }
+    if (groups & Cartesian) {
+        ipc::appendU32(payload, snap.poseValid ? 1u : 0u);
+        for (double v : snap.posePosition) ipc::appendFloat(payload, static_cast<float>(v));
+        for (double v : snap.poseRPY)      ipc::appendFloat(payload, static_cast<float>(v));
+    }
+
+    std::string frame;
+    ipc::appendFrame(frame, ipc::FrameType::Telemetry, reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+    return frame;
+}
+
+std::vector<std::string> channelNames(uint32_t groups)
+{
+    std::vector<std::string> names;
+    forEachChannel(nullptr, groups, [&](size_t, bool, const char* field, size_t index, double) {
+        names.push_back(isPerMotorField(field) ? std::string(field) + "[" + std::to_string(index + 1) + "]"
+                                               : std::string(field));
+    });
+    return names;
+}
+
+/**********************************************************/
+/* Delta mode                                             */
+/**********************************************************/
+DeltaEncoder::DeltaEncoder(bool binary, uint32_t groups, const DeltaOptions& options)
+    : m_binary(binary)
+    , m_groups(groups)
+    , m_options(options)
+{
+    forEachChannel(nullptr, groups, [&](size_t group, bool exact, const char*, size_t, double) {
+        m_thresholds.push_back(exact ? -1.0f : m_options.thresholds[group]);
+    });
+    m_keyValues.resize(m_thresholds.size());
+    m_current.resize(m_thresholds.size());
+    m_changed.reserve(m_thresholds.size());
+    if (m_options.keyframeInterval == 0) m_options.keyframeInterval = 1;
+}
+
+DeltaEncoder::Buffer DeltaEncoder::encode(const TelemetrySnapshot& snap, bool& keyframe)
+{
+    size_t c = 0;
+    forEachChannel(&snap, m_groups, [&](size_t, bool, const char*, size_t, double value) {
+        m_current[c++] = static_cast<float>(value);
+    });
+
+    // Channels that moved past their threshold since the last keyframe
+    m_changed.clear();
+    for (size_t i = 0; i < m_current.size(); ++i) {
+        float diff = std::fabs(m_current[i] - m_keyValues[i]);
+        if (m_thresholds[i] < 0.0f ? (m_current[i] != m_keyValues[i]) : (diff > m_thresholds[i])) {
+            m_changed.push_back(static_cast<uint16_t>(i));
+        }
+    }
+
+    // A delta entry is 6 bytes, a keyframe entry 4: fall back to a keyframe when it is no bigger
+    keyframe = !m_lastKeyframe
+            || ++m_framesSinceKeyframe >= m_options.keyframeInterval
+            || m_changed.size() * 6 >= m_current.size() * 4;
+
+    auto out = std::make_shared<std::string>();
+    if (keyframe) {
+        m_keyValues = m_current;
+        m_keyframeSeq++;
+        m_framesSinceKeyframe = 0;
+    }
+
+    if (m_binary) {
+        std::string payload;
+        payload.reserve(12 + m_current.size() * 6);
+        ipc::appendU32(payload, snap.cycle);
+        ipc::appendU32(payload, m_groups);
+        ipc::appendU16(payload, m_keyframeSeq);
+        if (keyframe) {
+            ipc::appendU16(payload, static_cast<uint16_t>(m_current.size()));
+            for (float v : m_current) ipc::appendFloat(payload, v);
+        } else {
+            ipc::appendU16(payload, static_cast<uint16_t>(m_changed.size()));
+            for (uint16_t i : m_changed) {
+                ipc::appendU16(payload, i);
+                ipc::appendFloat(payload, m_current[i]);
+            }
+        }
+        ipc::appendFrame(*out, keyframe ? ipc::FrameType::TelemetryKey : ipc::FrameType::TelemetryDelta,
+                         reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+    } else {
+        Json::Value jroot;
+        jroot["type"] = keyframe ? "telemetryKey" : "telemetryDelta";
+        jroot["cycle"] = snap.cycle;
+        jroot["seq"] = m_keyframeSeq;
+        if (keyframe) {
+            Json::Value values(Json::arrayValue);
+            for (float v : m_current) values.append(v);
+            jroot["values"] = values;
+        } else {
+            Json::Value idx(Json::arrayValue), val(Json::arrayValue);
+            for (uint16_t i : m_changed) {
+                idx.append(i);
+                val.append(m_current[i]);
+            }
+            jroot["idx"] = idx;
+            jroot["val"] = val;
+        }
+        *out = writeCompact(jroot) + "\n";
+    }
+
+    if (keyframe) {
+        m_lastKeyframe = out;
+    }
+    return out;
+}
+
+bool DeltaDecoder::apply(ipc::FrameType type, const uint8_t* payload, size_t len)
+{
+    constexpr size_t HEADER = 12;
+    if (len < HEADER || (type != ipc::FrameType::TelemetryKey && type != ipc::FrameType::TelemetryDelta)) {
+        return false;
+    }
+    const uint8_t* p = payload;
+    uint32_t cycle = ipc::readU32(p);
+    uint32_t groups = ipc::readU32(p);
+    uint16_t seq = ipc::readU16(p);
+    uint16_t count = ipc::readU16(p);
+
+    if (type == ipc::FrameType::TelemetryKey) {
+        if (len != HEADER + count * 4u) return false;
+        m_keyValues.resize(count);
+        for (float& v : m_keyValues) v = ipc::readFloat(p);
+        m_values = m_keyValues;
+        m_groups = groups;
+        m_keyframeSeq = seq;
+        m_cycle = cycle;
+        m_synced = true;
+        return true;
+    }
+
+    if (len != HEADER + count * 6u) return false;
+    if (!m_synced || seq != m_keyframeSeq || groups != m_groups) {
+        m_synced = false; // missed a keyframe, wait for the next one
+        return false;
+    }
+    // Deltas are relative to the keyframe, so start from it again
+    m_values = m_keyValues;
+    for (uint16_t k = 0; k < count; ++k) {
+        uint16_t index = ipc::readU16(p);
+        float value = ipc::readFloat(p);
+        if (index >= m_values.size()) {
+            m_synced = false;
+            return false;
+        }
+        m_values[index] = value;
+    }
+    m_cycle = cycle;
+    return true;
+}
+
+std::string encodeLegacyJson(const TelemetrySnapshot& snap)
+{
+    Json::Value jroot;
+    jroot["type"] = "motorStates";
+
+    // gather each motor's state
+    for (size_t i = 0; i < ipc::NUM_MOTORS; i++) {
+        const MotorState& st = snap.motors[i];
+        Json::Value mjs;
+        mjs["temp"]       = st.temperatureC;
+        mjs["torqueA"]    = st.torqueCurrentA;
+        mjs["speedDeg_s"] = st.speedDeg_s;
+        mjs["posDeg"]     = st.positionDeg;
+        mjs["multiTurnRaw"] = st.multiTurnPosition;
+        mjs["multiTurnRad_Mapped"] = st.multiTurnRad_Mapped;
+        mjs["multiTurnDeg_Mapped"] = st.multiTurnDeg_Mapped;
+        mjs["error"]      = (st.errorPresent ? 1 : 0);
+        mjs["encoder_val"] = st.encoderVal;
+        mjs["positionRad_Mapped"] = st.positionRad_Mapped;
+        mjs["positionDeg_Mapped"] = st.positionDeg_Mapped;
+
+        // Add motor gains
+        Json::Value gains;
+        gains["angKp"] = static_cast<int>(st.m_gains.angKp);
+        gains["angKi"] = static_cast<int>(st.m_gains.angKi);
+        gains["spdKp"] = static_cast<int>(st.m_gains.spdKp);
+        gains["spdKi"] = static_cast<int>(st.m_gains.spdKi);
+        gains["iqKp"]  = static_cast<int>(st.m_gains.iqKp);
+        gains["iqKi"]  = static_cast<int>(st.m_gains.iqKi);
+        mjs["gains"] = gains;
+
+        jroot["motors"][std::to_string(i + 1)] = mjs;
+    }
+
+    // Add diff crossbar and tool data
+    jroot["diff_roll_rad"] = snap.diffRollRad;
+    jroot["diff_pitch_rad"] = snap.diffPitchRad;
+    jroot["diff_roll_deg"] = snap.diffRollDeg;
+    jroot["diff_pitch_deg"] = snap.diffPitchDeg;
+
+    // Add digital twin data
+    if (snap.twinActive) {
+        Json::Value twinData;
+        twinData["active"] = true;
+        twinData["joint_angles_deg"] = twinAnglesJson(snap);
+        jroot["twin"] = twinData;
+    } else {
+        jroot["twin"]["active"] = false;
+    }
+
+    // Newline so the Node side can detect message boundaries
+    return writeCompact(jroot) + "\n";
+}
+
+std::string encodeLegacyBinary(const TelemetrySnapshot& snap)
+{
+    ipc::StateMessage msg;
+    msg.cycle = snap.cycle;
+    msg.numMotors = ipc::NUM_MOTORS;
+    msg.twinActive = snap.twinActive ? 1 : 0;
+    msg.diffRollRad = static_cast<float>(snap.diffRollRad);
+    msg.diffPitchRad = static_cast<float>(snap.diffPitchRad);
+    for (size_t i = 0; i < ipc::NUM_MOTORS; ++i) {
+        msg.twinJointAnglesDeg[i] = static_cast<float>(snap.twinJointAnglesDeg[i]);
+    }
+
+    for (size_t i = 0; i < ipc::NUM_MOTORS; ++i) {
+        const MotorState& st = snap.motors[i];
+        auto& rec = msg.motors[i];
+        rec.temperatureC        = static_cast<int8_t>(st.temperatureC);
+        rec.errorCode           = st.errorCode;
+        rec.encoderVal          = static_cast<uint16_t>(st.encoderVal);
+        rec.torqueCurrentRaw    = static_cast<int16_t>(st.torqueCurrentA);
+        rec.speedDeg_s          = static_cast<float>(st.speedDeg_s);
+        rec.positionDeg_Mapped  = static_cast<float>(st.positionDeg_Mapped);
+        rec.multiTurnDeg_Mapped = static_cast<float>(st.multiTurnDeg_Mapped);
+        rec.multiTurnRaw        = static_cast<float>(st.multiTurnPosition);
+    }
+
+    uint8_t payload[ipc::STATE_MESSAGE_SIZE];
+    ipc::encodeState(msg, payload);
+    std::string frame;
+    ipc::appendFrame(frame, ipc::FrameType::State, payload, sizeof(payload));
+    return frame;
+}
+
+} // namespace telemetry
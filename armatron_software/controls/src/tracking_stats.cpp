@@ -0,0 +1,150 @@
+#include "tracking_stats.hpp"
+#include "rt_log.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+TrackingStats::TrackingStats(const std::array<double, 7>& unitsPerDeg)
+    : m_unitsPerDeg(unitsPerDeg)
+{
+}
+
+void TrackingStats::sample(const float (&error)[7], const double (&position)[7], double dt)
+{
+    if (m_phase == Phase::Settling) {
+        publish();   // the next move started before the settling window was over
+    }
+    if (m_phase == Phase::Idle) {
+        m_current = TrackingSummary{};
+        m_current.id = m_nextId++;
+        m_sumSquared.fill(0.0);
+        for (size_t i = 0; i < 7; ++i) {
+            m_start[i] = position[i] / m_unitsPerDeg[i];
+        }
+        m_phase = Phase::Tracking;
+    }
+
+    m_current.samples++;
+    m_current.durationS += dt;
+    for (size_t i = 0; i < 7; ++i) {
+        double e = std::abs(static_cast<double>(error[i])) / m_unitsPerDeg[i];
+        m_sumSquared[i] += e * e;
+        m_current.maxErrorDeg[i] = std::max(m_current.maxErrorDeg[i], e);
+    }
+}
+
+void TrackingStats::finish(const double (&target)[7])
+{
+    if (m_phase != Phase::Tracking) return;
+    m_current.completed = true;
+    for (size_t i = 0; i < 7; ++i) {
+        m_target[i] = target[i] / m_unitsPerDeg[i];
+        double travel = m_target[i] - m_start[i];
+        m_direction[i] = std::abs(travel) > SETTLE_BAND_DEG ? std::copysign(1.0, travel) : 0.0;
+        m_lastOutside[i] = 0.0;
+    }
+    m_phase = Phase::Settling;
+}
+
+void TrackingStats::abort()
+{
+    if (m_phase != Phase::Tracking) return;
+    publish();
+}
+
+void TrackingStats::settle(const double (&position)[7], double dt)
+{
+    if (m_phase != Phase::Settling) return;
+    m_current.settleWindowS += dt;
+    for (size_t i = 0; i < 7; ++i) {
+        double p = position[i] / m_unitsPerDeg[i];
+        double e = m_target[i] - p;
+        if (std::abs(e) > SETTLE_BAND_DEG) {
+            m_lastOutside[i] = m_current.settleWindowS;
+        }
+        m_current.overshootDeg[i] = std::max(m_current.overshootDeg[i], (p - m_target[i]) * m_direction[i]);
+        m_current.finalErrorDeg[i] = e;
+    }
+    if (m_current.settleWindowS >= SETTLE_WINDOW_S) {
+        publish();
+    }
+}
+
+void TrackingStats::publish()
+{
+    TrackingSummary& s = m_current;
+    double worstRms = 0.0;
+    double worstMax = 0.0;
+    double worstSettling = 0.0;
+    double worstOvershoot = 0.0;
+    s.settled = s.completed && s.settleWindowS > 0.0;
+    for (size_t i = 0; i < 7; ++i) {
+        s.rmsErrorDeg[i] = s.samples > 0 ? std::sqrt(m_sumSquared[i] / s.samples) : 0.0;
+        bool settled = s.completed && s.settleWindowS > 0.0 && std::abs(s.finalErrorDeg[i]) <= SETTLE_BAND_DEG;
+        s.settlingS[i] = settled ? m_lastOutside[i] : -1.0;
+        s.settled = s.settled && settled;
+        worstRms = std::max(worstRms, s.rmsErrorDeg[i]);
+        worstMax = std::max(worstMax, s.maxErrorDeg[i]);
+        worstSettling = std::max(worstSettling, s.settlingS[i]);
+        worstOvershoot = std::max(worstOvershoot, s.overshootDeg[i]);
+    }
+
+    if (!s.completed) {
+        RTLOG_INFO(Robot, "[TrackingStats] Trajectory {} stopped after {} s: RMS error {} deg, max {} deg",
+                   s.id, s.durationS, worstRms, worstMax);
+    } else if (s.settled) {
+        RTLOG_INFO(Robot, "[TrackingStats] Trajectory {} ({} s): RMS error {} deg, max {} deg, settled in {} s, overshoot {} deg",
+                   s.id, s.durationS, worstRms, worstMax, worstSettling, worstOvershoot);
+    } else {
+        RTLOG_INFO(Robot, "[TrackingStats] Trajectory {} ({} s): RMS error {} deg, max {} deg, not settled after {} s, overshoot {} deg",
+                   s.id, s.durationS, worstRms, worstMax, s.settleWindowS, worstOvershoot);
+    }
+
+    if (!m_ring.push(s)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_phase = Phase::Idle;
+}
+
+void TrackingStats::drain()
+{
+    TrackingSummary summary;
+    while (m_ring.pop(summary)) {
+        m_history.push_back(summary);
+        if (m_history.size() > HISTORY) {
+            m_history.pop_front();
+        }
+    }
+}
+
+Json::Value TrackingStats::toJson() const
+{
+    Json::Value root;
+    root["history"] = Json::Value(Json::arrayValue);
+    for (const TrackingSummary& s : m_history) {
+        Json::Value j;
+        j["id"] = s.id;
+        j["completed"] = s.completed;
+        j["settled"] = s.settled;
+        j["durationS"] = s.durationS;
+        j["settleWindowS"] = s.settleWindowS;
+        j["samples"] = s.samples;
+        for (size_t i = 0; i < 7; ++i) {
+            Json::Value joint;
+            joint["rmsDeg"] = s.rmsErrorDeg[i];
+            joint["maxDeg"] = s.maxErrorDeg[i];
+            joint["settlingS"] = s.settlingS[i];
+            joint["overshootDeg"] = s.overshootDeg[i];
+            joint["finalErrorDeg"] = s.finalErrorDeg[i];
+            j["joints"].append(joint);
+        }
+        root["history"].append(j);
+    }
+    root["dropped"] = static_cast<Json::UInt64>(m_dropped.load(std::memory_order_relaxed));
+    return root;
+}
+
+void TrackingStats::reset()
+{
+    m_history.clear();
+}
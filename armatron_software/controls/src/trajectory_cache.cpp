@@ -0,0 +1,141 @@
+#include "trajectory_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+int64_t quantize(double value, double quantum)
+{
+    return static_cast<int64_t>(std::llround(value / quantum));
+}
+
+// FNV-1a over the quantized values; only used to skip full key compares
+uint64_t hashValues(const int64_t* values, size_t count)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < count; ++i) {
+        h ^= static_cast<uint64_t>(values[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+}
+
+TrajectoryCache::TrajectoryCache(const std::array<double, 7>& unitsPerDeg)
+    : m_unitsPerDeg(unitsPerDeg)
+{
+}
+
+TrajectoryCache::Key TrajectoryCache::makeKey(const ruckig::InputParameter<7>& input) const
+{
+    Key key;
+    size_t k = 0;
+    for (size_t i = 0; i < 7; ++i) {
+        double scale = m_unitsPerDeg[i];
+        key.values[k++] = quantize(input.current_position[i], START_POSITION_QUANTUM * scale);
+        key.values[k++] = quantize(input.current_velocity[i], START_VELOCITY_QUANTUM * scale);
+        key.values[k++] = quantize(input.current_acceleration[i], START_ACCELERATION_QUANTUM * scale);
+        key.values[k++] = quantize(input.target_position[i], TARGET_QUANTUM * scale);
+        key.values[k++] = quantize(input.target_velocity[i], TARGET_QUANTUM * scale);
+        key.values[k++] = quantize(input.target_acceleration[i], TARGET_QUANTUM * scale);
+        key.values[k++] = quantize(input.max_velocity[i], TARGET_QUANTUM * scale);
+        key.values[k++] = quantize(input.max_acceleration[i], TARGET_QUANTUM * scale);
+        key.values[k++] = quantize(input.max_jerk[i], TARGET_QUANTUM * scale);
+    }
+    key.hash = hashValues(key.values.data(), key.values.size());
+    return key;
+}
+
+bool TrajectoryCache::startWithinTolerance(const Entry& entry, const ruckig::InputParameter<7>& input) const
+{
+    for (size_t i = 0; i < 7; ++i) {
+        double scale = m_unitsPerDeg[i];
+        if (std::abs(input.current_position[i] - entry.startPosition[i]) > START_POSITION_TOLERANCE * scale
+            || std::abs(input.current_velocity[i] - entry.startVelocity[i]) > START_VELOCITY_TOLERANCE * scale
+            || std::abs(input.current_acceleration[i] - entry.startAcceleration[i]) > START_ACCELERATION_TOLERANCE * scale) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TrajectoryCache::lookup(const ruckig::InputParameter<7>& input, ruckig::Trajectory<7>& out)
+{
+    if (!m_enabled) return false;
+
+    Key key = makeKey(input);
+    for (Entry& entry : m_entries) {
+        if (!entry.used || !(entry.key == key)) continue;
+        if (!startWithinTolerance(entry, input)) {
+            m_stats.outOfTolerance++;
+            break;
+        }
+        entry.lastUsed = ++m_tick;
+        out = entry.trajectory;
+        m_stats.hits++;
+        return true;
+    }
+    m_stats.misses++;
+    return false;
+}
+
+void TrajectoryCache::insert(const ruckig::InputParameter<7>& input, const ruckig::Trajectory<7>& trajectory)
+{
+    if (!m_enabled) return;
+
+    Key key = makeKey(input);
+    // Same key (its start was out of tolerance, the newer start wins), else a free entry, else the LRU one
+    Entry* slot = nullptr;
+    for (Entry& entry : m_entries) {
+        if (entry.used && entry.key == key) {
+            slot = &entry;
+            break;
+        }
+    }
+    if (slot == nullptr) {
+        for (Entry& entry : m_entries) {
+            if (!entry.used) {
+                slot = &entry;
+                m_stats.size++;
+                break;
+            }
+        }
+    }
+    if (slot == nullptr) {
+        slot = &*std::min_element(m_entries.begin(), m_entries.end(),
+                                  [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+        m_stats.evictions++;
+    }
+
+    slot->used = true;
+    slot->lastUsed = ++m_tick;
+    slot->key = key;
+    for (size_t i = 0; i < 7; ++i) {
+        slot->startPosition[i] = input.current_position[i];
+        slot->startVelocity[i] = input.current_velocity[i];
+        slot->startAcceleration[i] = input.current_acceleration[i];
+    }
+    slot->trajectory = trajectory;
+}
+
+void TrajectoryCache::clear()
+{
+    for (Entry& entry : m_entries) {
+        entry.used = false;
+    }
+    m_stats.size = 0;
+}
+
+void TrajectoryCache::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    if (!enabled) {
+        clear();
+    }
+}
+
+TrajectoryCache::Stats TrajectoryCache::stats() const
+{
+    return m_stats;
+}
@@ -7,6 +7,7 @@ const fs = require('fs');
 const { exec } = require('child_process');
 
 const SOCKET_PATH = '/home/debian/.armatron/robot_socket';
+const ESTOP_SOCKET_PATH = '/home/debian/.armatron/estop_socket';
 const DEBUG = false;
 
 const app = express();
@@ -17,6 +18,7 @@ const io = new Server(httpServer);
 app.use(express.json());
 
 let client = null; // we'll hold a single connection to the daemon
+let estopClient = null; // dedicated connection for ESTOP / hold, never behind other traffic
 
 // Service logs streaming
 let logStreamProcess = null;
@@ -69,6 +71,26 @@ function connectToDaemon() {
     });
 }
 
+function connectToEstopChannel() {
+    const sock = net.createConnection(ESTOP_SOCKET_PATH, () => {
+        console.log("[Node] Connected to daemon emergency channel.");
+        estopClient = sock;
+    });
+    sock.on('data', (data) => {
+        // one {"type":"estopAck",...} line per request
+        data.toString().split('\n').forEach((line) => {
+            if (line.trim().length > 0) console.log("[Node] Emergency channel:", line.trim());
+        });
+    });
+    sock.on('error', (err) => {
+        console.error("[Node] Emergency socket error:", err.message);
+    });
+    sock.on('close', () => {
+        estopClient = null;
+        setTimeout(connectToEstopChannel, 2000);
+    });
+}
+
 // Serve static files from the dist directory
 app.use(express.static(path.join(__dirname, 'dist')));
 
@@ -212,6 +234,11 @@ io.on('connection', (socket) => {
 
     socket.on('sendCommand', (msg) => {
         console.log("[Node] Received command from browser:", msg);
+        // ESTOP / hold take the emergency channel when it is up (one byte per request)
+        if (estopClient && msg && (msg.cmd === 'setESTOP' || msg.cmd === 'setHoldPosition')) {
+            estopClient.write(msg.cmd === 'setESTOP' ? 'E' : 'H');
+            return;
+        }
         // Forward command to daemon
         if (client) {
             let line = JSON.stringify(msg) + "\n";
@@ -238,4 +265,4 @@ httpServer.listen(PORT, () => {
 });
 
 // Connect to the daemon
-connectToDaemon(); 
\ No newline at end of file
+connectToDaemon(); connectToEstopChannel();